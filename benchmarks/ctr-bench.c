@@ -0,0 +1,496 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * ctr-bench: synthetic workloads to measure span construction and the
+ * encoders/decoders. Every run generates the same data so numbers can be
+ * compared across builds:
+ *
+ *   ctr-bench [workload] [iterations]
+ */
+
+#include <ctraces/ctraces.h>
+#include <ctraces/ctr_decode_msgpack.h>
+
+#include <cfl/cfl.h>
+#include <cfl/cfl_kvlist.h>
+#include <cfl/cfl_time.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Allocation counter: on glibc the allocator entry points are wrapped so every
+ * malloc(), calloc() and realloc() done by the library is accounted.
+ */
+#if defined(__GLIBC__)
+#define BENCH_COUNT_ALLOCS 1
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static uint64_t bench_allocs;
+
+void *malloc(size_t size)
+{
+    bench_allocs++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    bench_allocs++;
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    bench_allocs++;
+    return __libc_realloc(ptr, size);
+}
+#else
+static uint64_t bench_allocs;
+#endif
+
+struct bench_workload {
+    char *name;
+    int spans;
+    int attributes;     /* attributes per span */
+    int depth;          /* nesting of kvlist attributes, 0 for flat */
+    int events;         /* events per span */
+    int links;          /* links per span */
+};
+
+static struct bench_workload workloads[] = {
+    {"small",     100,   4, 0, 1, 0},
+    {"medium",   1000,  16, 2, 4, 2},
+    {"large",   10000,  32, 3, 8, 4},
+    {"flat",    10000,   8, 0, 0, 0},
+    {"nested",   1000,   8, 6, 0, 0},
+    {NULL,          0,   0, 0, 0, 0}
+};
+
+struct bench_data {
+    struct bench_workload *workload;
+    struct ctrace *ctx;
+    cfl_sds_t otlp;
+    char *msgpack;
+    size_t msgpack_size;
+};
+
+struct bench_result {
+    uint64_t ns;
+    uint64_t allocs;
+    uint64_t bytes;
+};
+
+static uint64_t bench_now()
+{
+#ifndef _WIN32
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#else
+    return cfl_time_now();
+#endif
+}
+
+static struct cfl_kvlist *create_kvlist(int depth)
+{
+    struct cfl_kvlist *kvlist;
+
+    kvlist = cfl_kvlist_create();
+    if (!kvlist) {
+        return NULL;
+    }
+
+    cfl_kvlist_insert_string(kvlist, "name", "nested value");
+    cfl_kvlist_insert_int64(kvlist, "level", depth);
+
+    if (depth > 1) {
+        cfl_kvlist_insert_kvlist(kvlist, "child", create_kvlist(depth - 1));
+    }
+
+    return kvlist;
+}
+
+static void fill_id(unsigned char *buf, size_t len, uint64_t seed)
+{
+    size_t i;
+
+    /* deterministic ids so every run encodes the same bytes */
+    for (i = 0; i < len; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        buf[i] = (unsigned char) (seed >> 56);
+    }
+}
+
+static struct ctrace *create_workload(struct bench_workload *workload)
+{
+    int i;
+    int j;
+    char key[32];
+    unsigned char trace_id[16];
+    unsigned char span_id[8];
+    struct ctrace *ctx;
+    struct ctrace_span *root;
+    struct ctrace_span *span;
+    struct ctrace_span_event *event;
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_scope_span *scope_span;
+    struct ctrace_attributes *attr;
+
+    ctx = ctr_create(NULL);
+    if (!ctx) {
+        return NULL;
+    }
+
+    resource_span = ctr_resource_span_create(ctx);
+    attr = ctr_attributes_create();
+    ctr_attributes_set_string(attr, "service.name", "ctr-bench");
+    ctr_attributes_set_string(attr, "host.name", "localhost");
+    ctr_resource_set_attributes(resource_span->resource, attr);
+
+    scope_span = ctr_scope_span_create(resource_span);
+    ctr_scope_span_set_instrumentation_scope(scope_span,
+        ctr_instrumentation_scope_create("ctr-bench", "1.0", 0, NULL));
+
+    root = NULL;
+    fill_id(trace_id, sizeof(trace_id), 1);
+
+    for (i = 0; i < workload->spans; i++) {
+        span = ctr_span_create(ctx, scope_span, "bench-span", root);
+        if (!span) {
+            ctr_destroy(ctx);
+            return NULL;
+        }
+
+        fill_id(span_id, sizeof(span_id), i + 2);
+        ctr_span_set_trace_id(span, trace_id, sizeof(trace_id));
+        ctr_span_set_span_id(span, span_id, sizeof(span_id));
+        ctr_span_kind_set(span, CTRACE_SPAN_SERVER);
+        ctr_span_start_ts(ctx, span, 1000000000ULL + i);
+        ctr_span_end_ts(ctx, span, 2000000000ULL + i);
+
+        for (j = 0; j < workload->attributes; j++) {
+            snprintf(key, sizeof(key) - 1, "attribute.%d", j);
+
+            if (workload->depth > 0 && j % 4 == 0) {
+                ctr_span_set_attribute_kvlist(span, key, create_kvlist(workload->depth));
+            }
+            else if (j % 4 == 1) {
+                ctr_span_set_attribute_int64(span, key, i * j);
+            }
+            else if (j % 4 == 2) {
+                ctr_span_set_attribute_double(span, key, i * 1.5);
+            }
+            else {
+                ctr_span_set_attribute_string(span, key, "a benchmark attribute value");
+            }
+        }
+
+        for (j = 0; j < workload->events; j++) {
+            event = ctr_span_event_add_ts(span, "bench-event", 1500000000ULL + j);
+            ctr_span_event_set_attribute_string(event, "message", "something happened");
+            ctr_span_event_set_attribute_int64(event, "index", j);
+        }
+
+        for (j = 0; j < workload->links; j++) {
+            fill_id(span_id, sizeof(span_id), i * 31 + j);
+            ctr_link_create(span, trace_id, sizeof(trace_id), span_id, sizeof(span_id));
+        }
+
+        if (!root) {
+            root = span;
+        }
+    }
+
+    return ctx;
+}
+
+/* benchmarks: each callback runs one operation and returns the bytes processed */
+
+static ssize_t run_span_create(struct bench_data *data)
+{
+    struct ctrace *ctx;
+
+    ctx = create_workload(data->workload);
+    if (!ctx) {
+        return -1;
+    }
+    ctr_destroy(ctx);
+
+    return 0;
+}
+
+static ssize_t run_encode_opentelemetry(struct bench_data *data)
+{
+    size_t len;
+    cfl_sds_t buf;
+
+    buf = ctr_encode_opentelemetry_create(data->ctx);
+    if (!buf) {
+        return -1;
+    }
+    len = cfl_sds_len(buf);
+    ctr_encode_opentelemetry_destroy(buf);
+
+    return len;
+}
+
+static ssize_t run_encode_opentelemetry_direct(struct bench_data *data)
+{
+    size_t len;
+    cfl_sds_t buf;
+
+    buf = ctr_encode_opentelemetry_direct_create(data->ctx);
+    if (!buf) {
+        return -1;
+    }
+    len = cfl_sds_len(buf);
+    ctr_encode_opentelemetry_destroy(buf);
+
+    return len;
+}
+
+static ssize_t run_decode_opentelemetry(struct bench_data *data)
+{
+    int ret;
+    size_t offset = 0;
+    struct ctrace *ctx;
+
+    ret = ctr_decode_opentelemetry_create(&ctx, data->otlp, cfl_sds_len(data->otlp), &offset);
+    if (ret != 0) {
+        return -1;
+    }
+    ctr_decode_opentelemetry_destroy(ctx);
+
+    return cfl_sds_len(data->otlp);
+}
+
+static ssize_t run_decode_opentelemetry_direct(struct bench_data *data)
+{
+    int ret;
+    size_t offset = 0;
+    struct ctrace *ctx;
+
+    ret = ctr_decode_opentelemetry_direct_create(&ctx, data->otlp,
+                                                 cfl_sds_len(data->otlp), &offset);
+    if (ret != 0) {
+        return -1;
+    }
+    ctr_destroy(ctx);
+
+    return cfl_sds_len(data->otlp);
+}
+
+static ssize_t run_encode_msgpack(struct bench_data *data)
+{
+    int ret;
+    char *buf;
+    size_t size;
+
+    ret = ctr_encode_msgpack_create(data->ctx, &buf, &size);
+    if (ret != 0) {
+        return -1;
+    }
+    ctr_encode_msgpack_destroy(buf);
+
+    return size;
+}
+
+static ssize_t run_decode_msgpack(struct bench_data *data)
+{
+    int ret;
+    size_t offset = 0;
+    struct ctrace *ctx;
+
+    ret = ctr_decode_msgpack_create(&ctx, data->msgpack, data->msgpack_size, &offset);
+    if (ret != 0) {
+        return -1;
+    }
+    ctr_decode_msgpack_destroy(ctx);
+
+    return data->msgpack_size;
+}
+
+static ssize_t run_encode_text(struct bench_data *data)
+{
+    size_t len;
+    cfl_sds_t buf;
+
+    buf = ctr_encode_text_create(data->ctx);
+    if (!buf) {
+        return -1;
+    }
+    len = cfl_sds_len(buf);
+    ctr_encode_text_destroy(buf);
+
+    return len;
+}
+
+struct bench_case {
+    char *name;
+    ssize_t (*run)(struct bench_data *);
+};
+
+static struct bench_case cases[] = {
+    {"span_create",                 run_span_create},
+    {"encode_opentelemetry",        run_encode_opentelemetry},
+    {"encode_opentelemetry_direct", run_encode_opentelemetry_direct},
+    {"decode_opentelemetry",        run_decode_opentelemetry},
+    {"decode_opentelemetry_direct", run_decode_opentelemetry_direct},
+    {"encode_msgpack",              run_encode_msgpack},
+    {"decode_msgpack",              run_decode_msgpack},
+    {"encode_text",                 run_encode_text},
+    {NULL,                          NULL}
+};
+
+static int bench_run(struct bench_case *bc, struct bench_data *data, int iterations,
+                     struct bench_result *result)
+{
+    int i;
+    ssize_t ret;
+    uint64_t start;
+    uint64_t allocs;
+
+    /* warm up */
+    if (bc->run(data) < 0) {
+        return -1;
+    }
+
+    memset(result, 0, sizeof(struct bench_result));
+
+    allocs = bench_allocs;
+    start = bench_now();
+
+    for (i = 0; i < iterations; i++) {
+        ret = bc->run(data);
+        if (ret < 0) {
+            return -1;
+        }
+        result->bytes += ret;
+    }
+
+    result->ns = bench_now() - start;
+    result->allocs = bench_allocs - allocs;
+
+    return 0;
+}
+
+static void bench_print(struct bench_case *bc, struct bench_data *data, int iterations,
+                        struct bench_result *result)
+{
+    double secs;
+    double spans;
+
+    secs = result->ns / 1e9;
+    spans = (double) data->workload->spans * iterations;
+
+    printf("%-28s %-8s %8d %12.0f %12.0f",
+           bc->name, data->workload->name, iterations,
+           (double) result->ns / iterations,
+           spans / secs);
+
+    if (result->bytes > 0) {
+        printf(" %10.2f", result->bytes / secs / (1024 * 1024));
+    }
+    else {
+        printf(" %10s", "-");
+    }
+
+#ifdef BENCH_COUNT_ALLOCS
+    printf(" %12.1f\n", (double) result->allocs / iterations);
+#else
+    printf(" %12s\n", "n/a");
+#endif
+}
+
+static int bench_workload(struct bench_workload *workload, int iterations)
+{
+    int ret;
+    struct bench_case *bc;
+    struct bench_data data;
+    struct bench_result result;
+
+    memset(&data, 0, sizeof(data));
+    data.workload = workload;
+
+    data.ctx = create_workload(workload);
+    if (!data.ctx) {
+        fprintf(stderr, "[ctr-bench] cannot create workload '%s'\n", workload->name);
+        return -1;
+    }
+
+    data.otlp = ctr_encode_opentelemetry_create(data.ctx);
+    ret = ctr_encode_msgpack_create(data.ctx, &data.msgpack, &data.msgpack_size);
+    if (!data.otlp || ret != 0) {
+        fprintf(stderr, "[ctr-bench] cannot encode workload '%s'\n", workload->name);
+        ctr_destroy(data.ctx);
+        return -1;
+    }
+
+    for (bc = cases; bc->name; bc++) {
+        if (bench_run(bc, &data, iterations, &result) != 0) {
+            fprintf(stderr, "[ctr-bench] %s failed on '%s'\n", bc->name, workload->name);
+            continue;
+        }
+        bench_print(bc, &data, iterations, &result);
+    }
+
+    ctr_encode_opentelemetry_destroy(data.otlp);
+    ctr_encode_msgpack_destroy(data.msgpack);
+    ctr_destroy(data.ctx);
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = 0;
+    char *name = NULL;
+    struct bench_workload *workload;
+
+    if (argc > 1) {
+        name = argv[1];
+    }
+
+    if (argc > 2) {
+        iterations = atoi(argv[2]);
+    }
+
+    printf("%-28s %-8s %8s %12s %12s %10s %12s\n",
+           "benchmark", "workload", "iters", "ns/op", "spans/s", "MB/s", "allocs/op");
+
+    for (workload = workloads; workload->name; workload++) {
+        if (name && strcmp(name, workload->name) != 0) {
+            continue;
+        }
+
+        /* scale the iterations so every workload processes a similar volume */
+        bench_workload(workload,
+                       iterations > 0 ? iterations : 1 + 100000 / workload->spans);
+    }
+
+    return 0;
+}
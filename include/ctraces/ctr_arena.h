@@ -0,0 +1,74 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef CTR_ARENA_H
+#define CTR_ARENA_H
+
+#include <cfl/cfl_sds.h>
+
+#include <stddef.h>
+
+/*
+ * Arena allocator
+ * ---------------
+ * Memory is bump-allocated from a list of chunks and released all at once
+ * when the arena is destroyed. A reset rewinds every chunk and keeps it for
+ * the next allocations. Individual allocations are never freed.
+ *
+ * The ctr_arena_* helpers below accept a NULL arena, in that case they fall
+ * back to the system allocator so callers can use the same code path for
+ * both arena and heap backed contexts.
+ */
+
+#define CTR_ARENA_CHUNK_SIZE_DEFAULT  (64 * 1024)
+#define CTR_ARENA_ALIGNMENT           16
+
+struct ctr_arena_chunk {
+    size_t size;                    /* usable bytes in the chunk */
+    size_t used;                    /* bytes handed out so far   */
+    struct ctr_arena_chunk *next;
+};
+
+struct ctr_arena {
+    size_t chunk_size;              /* default size for new chunks */
+    size_t allocated;               /* total bytes reserved by chunks */
+    struct ctr_arena_chunk *chunks; /* current chunk is always the head */
+    struct ctr_arena_chunk *spare;  /* rewound chunks kept by a reset */
+};
+
+struct ctr_arena *ctr_arena_create(size_t chunk_size);
+void ctr_arena_destroy(struct ctr_arena *arena);
+void ctr_arena_reset(struct ctr_arena *arena);
+
+/* hand every chunk of 'src' over to 'dst' and release 'src' */
+void ctr_arena_merge(struct ctr_arena *dst, struct ctr_arena *src);
+
+/* zeroed memory */
+void *ctr_arena_alloc(struct ctr_arena *arena, size_t size);
+void ctr_arena_free(struct ctr_arena *arena, void *ptr);
+
+/*
+ * sds strings: the header layout is compatible with cfl_sds_t so they can be
+ * read with the cfl_sds API, but arena strings must never be resized.
+ */
+cfl_sds_t ctr_arena_sds_create_len(struct ctr_arena *arena, const char *str, size_t len);
+cfl_sds_t ctr_arena_sds_create(struct ctr_arena *arena, const char *str);
+void ctr_arena_sds_destroy(struct ctr_arena *arena, cfl_sds_t str);
+
+#endif
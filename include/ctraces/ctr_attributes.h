@@ -31,6 +31,8 @@ struct ctrace_attributes {
 
 struct ctrace_attributes *ctr_attributes_create();
 void ctr_attributes_destroy(struct ctrace_attributes *attr);
+struct ctrace_attributes *ctr_attributes_copy(struct ctrace_attributes *attr);
+int ctr_attributes_copy_pair(struct ctrace_attributes *attr, struct cfl_kvpair *pair);
 int ctr_attributes_count(struct ctrace_attributes *attr);
 int ctr_attributes_set_string(struct ctrace_attributes *attr, char *key, char *value);
 int ctr_attributes_set_bool(struct ctrace_attributes *attr, char *key, int b);
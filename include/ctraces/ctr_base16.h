@@ -0,0 +1,43 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef CTR_BASE16_H
+#define CTR_BASE16_H
+
+#include <stddef.h>
+
+/*
+ * Hex kernels used to format and parse trace and span IDs. On x86 they
+ * process 16 bytes per SSE2 register, other targets use a table driven
+ * scalar loop. None of them allocate memory.
+ */
+
+/* write 2 * len lowercase hex characters to 'out', no terminator is added */
+void ctr_base16_encode(const void *data, size_t len, char *out);
+
+/*
+ * decode 'len' hex characters (any case) into len / 2 bytes, returns -1 if
+ * the length is odd or a character is not a hex digit.
+ */
+int ctr_base16_decode(const char *hex, size_t len, void *out);
+
+/* same as above but upper case digits are rejected, as W3C trace context requires */
+int ctr_base16_decode_lower(const char *hex, size_t len, void *out);
+
+#endif
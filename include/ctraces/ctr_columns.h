@@ -0,0 +1,156 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef CTR_COLUMNS_H
+#define CTR_COLUMNS_H
+
+#include <ctraces/ctraces.h>
+
+/*
+ * Columnar span batches
+ * ---------------------
+ * A structure-of-arrays copy of the spans of a context, meant for stages
+ * that scan many spans (aggregations, filters): row 'i' of every column
+ * holds a field of the i-th span, spans are ordered by resource span and
+ * scope span as in the source context.
+ *
+ * Strings (span names, trace states, status messages, event names and
+ * string attribute values) are dictionary encoded: columns hold indexes in
+ * 'strings', CTR_COLUMNS_NONE when the value is not set. IDs are stored
+ * inline and are all zeros when not set.
+ *
+ * Span attributes get one typed column per key for string, boolean,
+ * integer and double values. Values of another type, or of a different
+ * type than the first one seen for the key, are kept in 'attr_other'.
+ *
+ * Events and links of span 'i' are the entries 'offset[i]' to
+ * 'offset[i + 1]' of their tables.
+ */
+
+#define CTR_COLUMNS_NONE   UINT32_MAX
+
+#define CTR_COLUMNS_INTERN_CACHE   64
+
+struct ctr_columns_dict {
+    cfl_sds_t *values;
+    uint32_t count;
+    uint32_t size;
+
+    /* open addressing table of value indexes plus one, zero when empty */
+    uint32_t *slots;
+    uint32_t slots_size;
+
+    /* interned names resolved by address, direct-mapped (ctr_intern.h) */
+    const char *interned[CTR_COLUMNS_INTERN_CACHE];
+    uint32_t interned_index[CTR_COLUMNS_INTERN_CACHE];
+};
+
+struct ctr_columns_attr {
+    cfl_sds_t key;
+    int type;                       /* CFL_VARIANT_STRING, _BOOL, _INT or _DOUBLE */
+    uint8_t *valid;                 /* rows holding a value */
+
+    /* the array matching the column type */
+    uint32_t *str;                  /* string index */
+    int64_t *i64;                   /* integers and booleans */
+    double *f64;
+};
+
+struct ctr_columns_events {
+    size_t count;
+    uint32_t *offset;               /* per span, 'rows + 1' entries */
+    uint64_t *time;
+    uint32_t *name;
+    uint32_t *dropped_attr_count;
+    struct ctrace_attributes **attr;   /* NULL when empty */
+};
+
+struct ctr_columns_links {
+    size_t count;
+    uint32_t *offset;               /* per span, 'rows + 1' entries */
+    unsigned char (*trace_id)[CTR_ID_OTEL_TRACE_SIZE];
+    unsigned char (*span_id)[CTR_ID_OTEL_SPAN_SIZE];
+    uint32_t *trace_state;
+    uint32_t *flags;
+    uint32_t *dropped_attr_count;
+    struct ctrace_attributes **attr;   /* NULL when empty */
+};
+
+struct ctr_columns {
+    size_t rows;
+
+    /* span columns */
+    unsigned char (*trace_id)[CTR_ID_OTEL_TRACE_SIZE];
+    unsigned char (*span_id)[CTR_ID_OTEL_SPAN_SIZE];
+    unsigned char (*parent_span_id)[CTR_ID_OTEL_SPAN_SIZE];
+    uint64_t *start_time;
+    uint64_t *end_time;
+    uint32_t *name;
+    uint32_t *trace_state;
+    uint32_t *schema_url;
+    int32_t *flags;
+    uint8_t *kind;
+    uint8_t *status_code;
+    uint32_t *status_message;
+    uint32_t *dropped_attr_count;
+    uint32_t *dropped_events_count;
+    uint32_t *dropped_links_count;
+    uint32_t *scope;                /* index in 'scope_spans' */
+
+    /* attribute columns */
+    struct ctr_columns_attr *attrs;
+    size_t attr_count;
+    struct ctrace_attributes **attr_other;   /* per span, NULL when empty */
+
+    struct ctr_columns_events events;
+    struct ctr_columns_links links;
+    struct ctr_columns_dict strings;
+
+    /*
+     * copies of the resource and scope spans of the source, without spans,
+     * owned by the 'meta' context.
+     */
+    struct ctrace *meta;
+    struct ctrace_scope_span **scope_spans;
+    size_t scope_count;
+};
+
+/*
+ * Build a batch from the spans of 'ctx', which is not modified. Returns
+ * NULL on error or if a span ID does not have the OpenTelemetry size.
+ */
+struct ctr_columns *ctr_columns_create(struct ctrace *ctx);
+void ctr_columns_destroy(struct ctr_columns *cols);
+
+/*
+ * Create a new context with the spans of the batch. If 'selection' is set
+ * only the rows with a nonzero entry are added.
+ */
+struct ctrace *ctr_columns_to_ctrace(struct ctr_columns *cols, uint8_t *selection);
+
+/* the string behind a dictionary index, NULL for CTR_COLUMNS_NONE */
+cfl_sds_t ctr_columns_string(struct ctr_columns *cols, uint32_t index);
+
+/* dictionary index of a string, CTR_COLUMNS_NONE if it is not in the batch */
+uint32_t ctr_columns_string_lookup(struct ctr_columns *cols, char *str, size_t len);
+
+/* the column of a span attribute, NULL if no span has it */
+struct ctr_columns_attr *ctr_columns_attr_get(struct ctr_columns *cols, char *key);
+
+#endif
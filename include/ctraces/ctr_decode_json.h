@@ -0,0 +1,62 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef CTR_DECODE_JSON_H
+#define CTR_DECODE_JSON_H
+
+#include <ctraces/ctraces.h>
+
+#define CTR_DECODE_JSON_SUCCESS                 0
+#define CTR_DECODE_JSON_INSUFFICIENT_DATA      -1
+#define CTR_DECODE_JSON_INVALID_ARGUMENT       -2
+#define CTR_DECODE_JSON_CORRUPTED_DATA         -3
+#define CTR_DECODE_JSON_INVALID_PAYLOAD        -4
+#define CTR_DECODE_JSON_ALLOCATION_ERROR       -5
+
+/* maximum nesting of objects and arrays in a document */
+#define CTR_DECODE_JSON_MAX_DEPTH              64
+
+/*
+ * OTLP/JSON decoder: an ExportTraceServiceRequest document is tokenized
+ * incrementally and spans are built as their members arrive, without an
+ * intermediate tree. Both lowerCamelCase and the original proto field
+ * names are accepted, unknown members are skipped.
+ */
+int ctr_decode_json_create(struct ctrace **out_context, char *in_buf, size_t in_size,
+                           size_t *offset);
+int ctr_decode_json_create_with_opts(struct ctrace **out_context, struct ctrace_opts *opts,
+                                     char *in_buf, size_t in_size, size_t *offset);
+void ctr_decode_json_destroy(struct ctrace *context);
+
+/*
+ * Stream decoder: every byte given is consumed, a document split across
+ * buffers is resumed on the next call. CTR_DECODE_JSON_INSUFFICIENT_DATA is
+ * returned when the buffer ends inside a document, CTR_DECODE_JSON_SUCCESS
+ * with the context of a complete document and '*offset' past its end.
+ * After an error the stream must be destroyed.
+ */
+struct ctr_decode_json_stream;
+
+struct ctr_decode_json_stream *ctr_decode_json_stream_create(struct ctrace_opts *opts);
+void ctr_decode_json_stream_destroy(struct ctr_decode_json_stream *stream);
+int ctr_decode_json_stream_next(struct ctr_decode_json_stream *stream,
+                                struct ctrace **out_context,
+                                char *in_buf, size_t in_size, size_t *offset);
+
+#endif
@@ -21,12 +21,17 @@
 #define CTR_DECODE_MSGPACK_H
 
 #include <ctraces/ctraces.h>
+#include <ctraces/ctr_mpack_utils_defs.h>
 
 #define CTR_DECODE_MSGPACK_SUCCESS                (CTR_MPACK_SUCCESS)
 #define CTR_DECODE_MSGPACK_INVALID_ARGUMENT_ERROR (CTR_MPACK_INVALID_ARGUMENT_ERROR)
 #define CTR_DECODE_MSGPACK_INVALID_STATE          (CTR_MPACK_ERROR_CUTOFF + 1)
 #define CTR_DECODE_MSGPACK_ALLOCATION_ERROR       (CTR_MPACK_ERROR_CUTOFF + 2)
 #define CTR_DECODE_MSGPACK_VARIANT_DECODE_ERROR   (CTR_MPACK_ERROR_CUTOFF + 3)
+#define CTR_DECODE_MSGPACK_INSUFFICIENT_DATA      (CTR_MPACK_INSUFFICIENT_DATA)
+
+/* stream flags */
+#define CTR_DECODE_MSGPACK_STREAM_MERGE           1
 
 struct ctr_msgpack_decode_context {
     struct ctrace_resource_span *resource_span;
@@ -39,6 +44,27 @@ struct ctr_msgpack_decode_context {
 };
 
 int ctr_decode_msgpack_create(struct ctrace **out_context, char *in_buf, size_t in_size, size_t *offset);
+int ctr_decode_msgpack_create_with_opts(struct ctrace **out_context, struct ctrace_opts *opts,
+                                        char *in_buf, size_t in_size, size_t *offset);
 void ctr_decode_msgpack_destroy(struct ctrace *context);
 
+/*
+ * Stream decoder for buffers holding concatenated ctraces payloads. The
+ * reader is kept across calls as long as the caller keeps feeding the same
+ * buffer, and a trailing partial object is reported as
+ * CTR_DECODE_MSGPACK_INSUFFICIENT_DATA without consuming it so the caller
+ * can retry once more bytes arrived. With CTR_DECODE_MSGPACK_STREAM_MERGE
+ * every object is appended to a single context retrieved with
+ * ctr_decode_msgpack_stream_take().
+ */
+struct ctr_decode_msgpack_stream;
+
+struct ctr_decode_msgpack_stream *ctr_decode_msgpack_stream_create(struct ctrace_opts *opts,
+                                                                   int flags);
+void ctr_decode_msgpack_stream_destroy(struct ctr_decode_msgpack_stream *stream);
+int ctr_decode_msgpack_stream_next(struct ctr_decode_msgpack_stream *stream,
+                                   struct ctrace **out_context,
+                                   char *in_buf, size_t in_size, size_t *offset);
+struct ctrace *ctr_decode_msgpack_stream_take(struct ctr_decode_msgpack_stream *stream);
+
 #endif
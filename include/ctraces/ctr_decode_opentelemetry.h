@@ -45,6 +45,32 @@ struct opentelemetry_decode_value {
 
 int ctr_decode_opentelemetry_create(struct ctrace **out_ctr, char *in_buf, size_t in_size,
                                     size_t *offset);
+
+/*
+ * Reusable scratch context for the protobuf-c unpacked tree: its memory is
+ * served from an arena that is reset after every decode call. A scratch
+ * context must not be shared between threads.
+ */
+struct ctr_decode_opentelemetry_scratch;
+
+struct ctr_decode_opentelemetry_scratch *ctr_decode_opentelemetry_scratch_create(size_t chunk_size);
+void ctr_decode_opentelemetry_scratch_destroy(struct ctr_decode_opentelemetry_scratch *scratch);
+
+/* bytes reserved by the scratch arena, they are kept across decode calls */
+size_t ctr_decode_opentelemetry_scratch_size(struct ctr_decode_opentelemetry_scratch *scratch);
+int ctr_decode_opentelemetry_create_with_scratch(struct ctrace **out_ctr,
+                                                 struct ctr_decode_opentelemetry_scratch *scratch,
+                                                 char *in_buf,
+                                                 size_t in_size, size_t *offset);
+
+/* same result as above, decoded straight from the wire format */
+int ctr_decode_opentelemetry_direct_create(struct ctrace **out_ctr, char *in_buf,
+                                           size_t in_size, size_t *offset);
+int ctr_decode_opentelemetry_direct_create_with_opts(struct ctrace **out_ctr,
+                                                     struct ctrace_opts *opts,
+                                                     char *in_buf,
+                                                     size_t in_size, size_t *offset);
+
 void ctr_decode_opentelemetry_destroy(struct ctrace *ctr);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,35 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef CTR_ENCODE_JSON_H
+#define CTR_ENCODE_JSON_H
+
+#include <ctraces/ctraces.h>
+
+/*
+ * OTLP/JSON encoder: the ExportTraceServiceRequest JSON mapping, with IDs
+ * as lowercase hex and 64-bit integers as strings.
+ */
+cfl_sds_t ctr_encode_json_create(struct ctrace *ctx);
+void ctr_encode_json_destroy(cfl_sds_t json);
+
+/* stream the document, the writer is flushed at the end */
+int ctr_encode_json_write(struct ctrace *ctx, struct ctr_writer *writer);
+
+#endif
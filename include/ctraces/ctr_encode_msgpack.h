@@ -23,6 +23,9 @@
 #include <ctraces/ctraces.h>
 
 int ctr_encode_msgpack_create(struct ctrace *ctx,  char **out_buf, size_t *out_size);
+ssize_t ctr_encode_msgpack_size(struct ctrace *ctx);
+int ctr_encode_msgpack_to_buffer(struct ctrace *ctx, char *buf, size_t size,
+                                 size_t *out_size);
 void ctr_encode_msgpack_destroy(char *buf);
 
 #endif
@@ -23,6 +23,59 @@
 #include <ctraces/ctraces.h>
 
 cfl_sds_t ctr_encode_opentelemetry_create(struct ctrace *ctr);
+
+/* same output as above, written without the protobuf-c object tree */
+cfl_sds_t ctr_encode_opentelemetry_direct_create(struct ctrace *ctr);
+
+/*
+ * Same output as above, encoded by up to 'nthreads' threads (the caller
+ * included). Resource spans are encoded in parallel, a resource span holding
+ * more than its share of the spans is cut at its scope spans. With
+ * 'nthreads' lower than 2 the context is encoded on the calling thread.
+ *
+ * Workers are taken from a pool shared by all callers, started on first use
+ * and kept, idle, until the process exits.
+ */
+#define CTR_ENCODE_OPENTELEMETRY_MAX_THREADS    64
+
+cfl_sds_t ctr_encode_opentelemetry_create_parallel(struct ctrace *ctr, int nthreads);
+
+/*
+ * Split the context into independent ExportTraceServiceRequest payloads of at
+ * most 'max_size' bytes each, repeating the resource and scope headers as
+ * needed. Every payload is passed to 'cb' which takes ownership of the buffer
+ * (release it with ctr_encode_opentelemetry_destroy()), a non-zero return
+ * value from the callback stops the encoding.
+ *
+ * Returns 0 on success or -1 on error, including the case of a single span
+ * that does not fit in 'max_size' with its headers. Payloads already passed
+ * to the callback are not recalled.
+ */
+typedef int (*ctr_encode_opentelemetry_chunk_fn_t)(cfl_sds_t buf, void *data);
+
+int ctr_encode_opentelemetry_split(struct ctrace *ctr, size_t max_size,
+                                   ctr_encode_opentelemetry_chunk_fn_t cb, void *data);
+
+/*
+ * Stream the context as one ExportTraceServiceRequest through 'writer'. Each
+ * resource_spans entry is sized first, so only the lengths of its embedded
+ * messages and the writer chunk are kept in memory, never the payload. The
+ * output is the same as ctr_encode_opentelemetry_create() and the writer is
+ * flushed at the end.
+ */
+int ctr_encode_opentelemetry_write(struct ctrace *ctr, struct ctr_writer *writer);
+
+/*
+ * Same as above through a callback writer that passes chunks of up to
+ * 'chunk_size' bytes (CTR_ENCODE_OPENTELEMETRY_CHUNK_SIZE if zero) to 'cb'.
+ * A non-zero return value from the callback stops the encoding. Returns 0
+ * on success or -1 on error.
+ */
+#define CTR_ENCODE_OPENTELEMETRY_CHUNK_SIZE     65536
+
+int ctr_encode_opentelemetry_stream(struct ctrace *ctr, size_t chunk_size,
+                                    ctr_writer_cb_t cb, void *data);
+
 void ctr_encode_opentelemetry_destroy(cfl_sds_t text);
 
 #endif
\ No newline at end of file
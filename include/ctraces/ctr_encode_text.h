@@ -25,5 +25,8 @@
 cfl_sds_t ctr_encode_text_create(struct ctrace *ctx);
 void ctr_encode_text_destroy(cfl_sds_t text);
 
+/* stream the text output, the writer is flushed at the end */
+int ctr_encode_text_write(struct ctrace *ctx, struct ctr_writer *writer);
+
 
 #endif
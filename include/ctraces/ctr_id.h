@@ -27,18 +27,41 @@
 #define CTR_ID_TRACE_DEFAULT         "000000F1BI700000000000F1BI700000"
 #define CTR_ID_SPAN_DEFAULT          "000000F1BI700000"
 
+/*
+ * IDs up to CTR_ID_INLINE_SIZE bytes (all OpenTelemetry trace and span IDs)
+ * are stored inline, longer ones use an external buffer. Unused inline bytes
+ * are always zero so two inline IDs are compared with two 64-bit loads.
+ */
+#define CTR_ID_INLINE_SIZE      16
+
+/* flags */
+#define CTR_ID_EMBEDDED          1   /* storage owned by a parent structure */
+
+struct ctrace_span;
+
 struct ctrace_id {
-    cfl_sds_t buf;
+    uint32_t len;
+    uint32_t flags;
+    struct ctr_arena *arena;    /* owner arena, NULL if heap allocated */
+    unsigned char *ext;         /* external buffer for long IDs */
+    unsigned char bytes[CTR_ID_INLINE_SIZE];
 };
 
 struct ctrace_id *ctr_id_create_random(size_t size);
+int ctr_id_generate_trace_span(struct ctrace_span *span);
 struct ctrace_id *ctr_id_create(void *buf, size_t len);
+struct ctrace_id *ctr_id_create_arena(struct ctr_arena *arena, void *buf, size_t len);
+void ctr_id_init(struct ctrace_id *cid, struct ctr_arena *arena);
+void ctr_id_reset(struct ctrace_id *cid);
 void ctr_id_destroy(struct ctrace_id *cid);
 int ctr_id_set(struct ctrace_id *cid, void *buf, size_t len);
+int ctr_id_assign(struct ctrace_id **ref, struct ctrace_id *data, void *buf, size_t len);
 int ctr_id_cmp(struct ctrace_id *cid1, struct ctrace_id *cid2);
 size_t ctr_id_get_len(struct ctrace_id *cid);
 void *ctr_id_get_buf(struct ctrace_id *cid);
 cfl_sds_t ctr_id_to_lower_base16(struct ctrace_id *cid);
+int ctr_id_to_lower_base16_buf(struct ctrace_id *cid, char *buf, size_t size);
+int ctr_id_set_base16(struct ctrace_id *cid, const char *hex, size_t len);
 struct ctrace_id *ctr_id_from_base16(cfl_sds_t id);
 
 #endif
@@ -0,0 +1,79 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef CTR_INDEX_H
+#define CTR_INDEX_H
+
+#include <ctraces/ctraces.h>
+
+/*
+ * Trace and span ID index
+ * -----------------------
+ * Optional hash index over the spans of a context, enabled with the
+ * CTR_OPTS_ID_INDEX option or ctr_index_enable(). Spans are indexed by span
+ * ID and grouped by trace ID. The index follows the span IDs set with the
+ * ctr_span_set_*_id() functions, ctr_id_generate_trace_span() and the
+ * decoders, and drops spans on ctr_span_destroy(). Spans without IDs are not
+ * indexed.
+ *
+ * Traces are iterated with cfl_list_foreach() over 'ctx->index->trace_list'
+ * (struct ctr_index_trace, _head) and the spans of a trace over
+ * 'trace->spans' (struct ctrace_span, _head_trace).
+ */
+
+/* all the spans of one trace */
+struct ctr_index_trace {
+    uint64_t hash;
+    int span_count;
+    uint64_t timestamp;             /* zero on creation, free for index users */
+    struct cfl_list spans;
+    struct cfl_list _head;          /* link to 'struct ctr_index->trace_list' */
+};
+
+struct ctr_index_slot {
+    uint64_t hash;
+    void *ptr;                      /* NULL for an empty slot */
+};
+
+/* open addressing with linear probing, 'size' is a power of two */
+struct ctr_index_table {
+    struct ctr_index_slot *slots;
+    size_t size;
+    size_t count;
+};
+
+struct ctr_index {
+    struct ctr_index_table spans;   /* struct ctrace_span by span ID */
+    struct ctr_index_table traces;  /* struct ctr_index_trace by trace ID */
+    struct cfl_list trace_list;     /* traces in order of first appearance */
+};
+
+int ctr_index_enable(struct ctrace *ctx);
+void ctr_index_disable(struct ctrace *ctx);
+
+/* the first span found with the given span ID, or NULL */
+struct ctrace_span *ctr_index_span_lookup(struct ctrace *ctx, void *span_id, size_t len);
+struct ctr_index_trace *ctr_index_trace_lookup(struct ctrace *ctx, void *trace_id, size_t len);
+int ctr_index_trace_count(struct ctrace *ctx);
+
+/* keep the index in sync after the IDs of a span changed, no-op if disabled */
+int ctr_index_span_update(struct ctrace_span *span);
+void ctr_index_span_remove(struct ctrace_span *span);
+
+#endif
@@ -0,0 +1,51 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef CTR_INTERN_H
+#define CTR_INTERN_H
+
+#include <ctraces/ctraces.h>
+
+/*
+ * String interning
+ * ----------------
+ * With the CTR_OPTS_INTERN option a context keeps one copy of every span
+ * and event name, spans and events reference it instead of owning a copy.
+ * Interned strings live until ctr_destroy(), so the table stops growing at
+ * CTR_INTERN_MAX_STRINGS entries and further names get private copies.
+ *
+ * Two spans with the same interned name share the same pointer, consumers
+ * can compare names by address before comparing their content.
+ */
+
+#define CTR_INTERN_MAX_STRINGS   65536
+
+struct ctr_intern {
+    cfl_sds_t *slots;               /* open addressing, NULL for an empty slot */
+    size_t size;                    /* power of two */
+    size_t count;
+};
+
+struct ctr_intern *ctr_intern_create();
+void ctr_intern_destroy(struct ctr_intern *intern);
+
+/* the interned copy of a string, NULL if the table is full or on error */
+cfl_sds_t ctr_intern_get(struct ctr_intern *intern, const char *str, size_t len);
+
+#endif
@@ -32,6 +32,11 @@ struct ctrace_link {
 
     /* --- INTERNAL --- */
     struct cfl_list _head;            /* link to 'struct span->links' list */
+    struct ctrace_span *span;         /* parent span */
+
+    /* inline storage for the IDs */
+    struct ctrace_id trace_id_data;
+    struct ctrace_id span_id_data;
 };
 
 struct ctrace_link *ctr_link_create(struct ctrace_span *span,
@@ -42,6 +47,8 @@ struct ctrace_link *ctr_link_create_with_cid(struct ctrace_span *span,
                                              struct ctrace_id *trace_id_cid,
 					 					     struct ctrace_id *span_id_cid);
 
+int ctr_link_set_trace_id(struct ctrace_link *link, void *buf, size_t len);
+int ctr_link_set_span_id(struct ctrace_link *link, void *buf, size_t len);
 int ctr_link_set_trace_state(struct ctrace_link *link, char *trace_state);
 int ctr_link_set_attributes(struct ctrace_link *link, struct ctrace_attributes *attr);
 void ctr_link_set_dropped_attr_count(struct ctrace_link *link, uint32_t count);
@@ -0,0 +1,37 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef CTR_MERGE_H
+#define CTR_MERGE_H
+
+#include <ctraces/ctraces.h>
+
+/*
+ * Move every span of 'src' into 'dst'. Resource spans with the same resource
+ * attributes and schema URL, and scope spans with the same instrumentation
+ * scope and schema URL, are coalesced into the ones already present in
+ * 'dst'. Spans are moved, not copied: 'src' is left empty and must still be
+ * released with ctr_destroy().
+ *
+ * Both contexts must use the same allocation mode (arena or heap). Names
+ * interned by 'src' are interned again (or copied) in 'dst'.
+ */
+int ctr_merge(struct ctrace *dst, struct ctrace *src);
+
+#endif
@@ -24,6 +24,8 @@
 #include <cfl/cfl_sds.h>
 #include <mpack/mpack.h>
 
+struct ctr_arena;
+
 typedef int (*ctr_mpack_unpacker_entry_callback_fn_t)(mpack_reader_t *reader,
                                                       size_t index, void *context);
 
@@ -44,6 +46,16 @@ int ctr_mpack_consume_string_tag(mpack_reader_t *reader, cfl_sds_t *output_buffe
 int ctr_mpack_consume_binary_tag(mpack_reader_t *reader, cfl_sds_t *output_buffer);
 int ctr_mpack_consume_string_or_nil_tag(mpack_reader_t *reader, cfl_sds_t *output_buffer);
 int ctr_mpack_consume_binary_or_nil_tag(mpack_reader_t *reader, cfl_sds_t *output_buffer);
+int ctr_mpack_consume_string_tag_arena(mpack_reader_t *reader,
+                                       struct ctr_arena *arena,
+                                       cfl_sds_t *output_buffer);
+int ctr_mpack_consume_string_or_nil_tag_arena(mpack_reader_t *reader,
+                                              struct ctr_arena *arena,
+                                              cfl_sds_t *output_buffer);
+int ctr_mpack_consume_string_tag_inplace(mpack_reader_t *reader,
+                                         const char **str, size_t *length);
+int ctr_mpack_consume_string_or_nil_tag_inplace(mpack_reader_t *reader,
+                                                const char **str, size_t *length);
 int ctr_mpack_unpack_map(mpack_reader_t *reader,
                          struct ctr_mpack_map_entry_callback_t *callback_list,
                          void *context);
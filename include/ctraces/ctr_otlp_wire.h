@@ -0,0 +1,199 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef CTR_OTLP_WIRE_H
+#define CTR_OTLP_WIRE_H
+
+#include <ctraces/ctraces.h>
+
+/*
+ * OTLP wire writer
+ * ----------------
+ * Serialize a CTraces context straight into the protobuf wire format of an
+ * ExportTraceServiceRequest message, without building the intermediate
+ * protobuf-c object tree.
+ *
+ * Encoding is done in two passes over the native lists: the sizing pass
+ * records the length of every embedded message (in pre-order) and the writing
+ * pass consumes those lengths while emitting the bytes. Both passes must be
+ * run over the same, unmodified, data and in the same order.
+ *
+ * The packing rules are the ones used by protobuf-c, so the output is
+ * byte-identical to ctr_encode_opentelemetry_create() as long as every
+ * attribute holds a type that AnyValue can represent. Key/value pairs and
+ * array entries of any other type (e.g. CFL_VARIANT_UINT) are skipped, while
+ * the protobuf-c encoder drops the whole enclosing list.
+ *
+ * The field numbers below are also used by the direct decoder.
+ */
+
+/* protobuf wire types */
+#define CTR_OTLP_WIRE_VARINT                    0
+#define CTR_OTLP_WIRE_FIXED64                   1
+#define CTR_OTLP_WIRE_LEN                       2
+#define CTR_OTLP_WIRE_FIXED32                   5
+
+#define CTR_OTLP_FIELD_TAG(f, t)                ((uint64_t) (((f) << 3) | (t)))
+
+/*
+ * Field numbers from opentelemetry/proto/{collector/trace,trace,common,resource}/v1
+ */
+
+/* ExportTraceServiceRequest */
+#define CTR_OTLP_REQUEST_RESOURCE_SPANS         1
+
+/* ResourceSpans */
+#define CTR_OTLP_RESOURCE_SPANS_RESOURCE        1
+#define CTR_OTLP_RESOURCE_SPANS_SCOPE_SPANS     2
+#define CTR_OTLP_RESOURCE_SPANS_SCHEMA_URL      3
+
+/* Resource */
+#define CTR_OTLP_RESOURCE_ATTRIBUTES            1
+#define CTR_OTLP_RESOURCE_DROPPED_ATTRIBUTES    2
+
+/* ScopeSpans */
+#define CTR_OTLP_SCOPE_SPANS_SCOPE              1
+#define CTR_OTLP_SCOPE_SPANS_SPANS              2
+#define CTR_OTLP_SCOPE_SPANS_SCHEMA_URL         3
+
+/* InstrumentationScope */
+#define CTR_OTLP_SCOPE_NAME                     1
+#define CTR_OTLP_SCOPE_VERSION                  2
+#define CTR_OTLP_SCOPE_ATTRIBUTES               3
+#define CTR_OTLP_SCOPE_DROPPED_ATTRIBUTES       4
+
+/* Span */
+#define CTR_OTLP_SPAN_TRACE_ID                  1
+#define CTR_OTLP_SPAN_SPAN_ID                   2
+#define CTR_OTLP_SPAN_TRACE_STATE               3
+#define CTR_OTLP_SPAN_PARENT_SPAN_ID            4
+#define CTR_OTLP_SPAN_NAME                      5
+#define CTR_OTLP_SPAN_KIND                      6
+#define CTR_OTLP_SPAN_START_TIME                7
+#define CTR_OTLP_SPAN_END_TIME                  8
+#define CTR_OTLP_SPAN_ATTRIBUTES                9
+#define CTR_OTLP_SPAN_DROPPED_ATTRIBUTES        10
+#define CTR_OTLP_SPAN_EVENTS                    11
+#define CTR_OTLP_SPAN_DROPPED_EVENTS            12
+#define CTR_OTLP_SPAN_LINKS                     13
+#define CTR_OTLP_SPAN_DROPPED_LINKS             14
+#define CTR_OTLP_SPAN_STATUS                    15
+#define CTR_OTLP_SPAN_FLAGS                     16
+
+/* Span.Event */
+#define CTR_OTLP_EVENT_TIME                     1
+#define CTR_OTLP_EVENT_NAME                     2
+#define CTR_OTLP_EVENT_ATTRIBUTES               3
+#define CTR_OTLP_EVENT_DROPPED_ATTRIBUTES       4
+
+/* Span.Link */
+#define CTR_OTLP_LINK_TRACE_ID                  1
+#define CTR_OTLP_LINK_SPAN_ID                   2
+#define CTR_OTLP_LINK_TRACE_STATE               3
+#define CTR_OTLP_LINK_ATTRIBUTES                4
+#define CTR_OTLP_LINK_DROPPED_ATTRIBUTES        5
+#define CTR_OTLP_LINK_FLAGS                     6
+
+/* Status */
+#define CTR_OTLP_STATUS_MESSAGE                 2
+#define CTR_OTLP_STATUS_CODE                    3
+
+/* KeyValue */
+#define CTR_OTLP_KEY_VALUE_KEY                  1
+#define CTR_OTLP_KEY_VALUE_VALUE                2
+
+/* AnyValue */
+#define CTR_OTLP_ANY_VALUE_STRING               1
+#define CTR_OTLP_ANY_VALUE_BOOL                 2
+#define CTR_OTLP_ANY_VALUE_INT                  3
+#define CTR_OTLP_ANY_VALUE_DOUBLE               4
+#define CTR_OTLP_ANY_VALUE_ARRAY                5
+#define CTR_OTLP_ANY_VALUE_KVLIST               6
+#define CTR_OTLP_ANY_VALUE_BYTES                7
+
+/* ArrayValue and KeyValueList */
+#define CTR_OTLP_LIST_VALUES                    1
+
+struct ctr_otlp_wire {
+    /* embedded message sizes, in pre-order */
+    size_t *sizes;
+    size_t sizes_count;
+    size_t sizes_alloc;
+    size_t sizes_index;
+
+    /* output buffer */
+    char *buf;
+    size_t buf_len;
+    size_t buf_size;
+
+    /* when streaming, 'buf' is the chunk of this writer */
+    struct ctr_writer *writer;
+
+    int error;
+};
+
+void ctr_otlp_wire_init(struct ctr_otlp_wire *wire);
+void ctr_otlp_wire_exit(struct ctr_otlp_wire *wire);
+void ctr_otlp_wire_reset(struct ctr_otlp_wire *wire);
+void ctr_otlp_wire_set_buffer(struct ctr_otlp_wire *wire, char *buf, size_t size);
+
+/* sizing pass: returns the number of bytes to be written or -1 on error */
+ssize_t ctr_otlp_wire_size_request(struct ctr_otlp_wire *wire, struct ctrace *ctx);
+ssize_t ctr_otlp_wire_size_resource_span(struct ctr_otlp_wire *wire,
+                                         struct ctrace_resource_span *resource_span);
+
+/* writing pass: returns 0 on success */
+int ctr_otlp_wire_write_request(struct ctr_otlp_wire *wire, struct ctrace *ctx);
+int ctr_otlp_wire_write_resource_span(struct ctr_otlp_wire *wire,
+                                      struct ctrace_resource_span *resource_span);
+
+/*
+ * A 'resource_spans' entry can also be produced in parts, e.g. by different
+ * threads: the head (tag, length and resource), every 'scope_spans' entry
+ * and the tail (schema_url). The head needs the total size of the scope
+ * spans entries. Each part is sized and written with its own sizes.
+ */
+ssize_t ctr_otlp_wire_size_scope_span(struct ctr_otlp_wire *wire,
+                                      struct ctrace_scope_span *scope_span);
+ssize_t ctr_otlp_wire_size_resource_span_head(struct ctr_otlp_wire *wire,
+                                              struct ctrace_resource_span *resource_span,
+                                              size_t scope_spans_size);
+size_t ctr_otlp_wire_size_resource_span_tail(struct ctrace_resource_span *resource_span);
+
+int ctr_otlp_wire_write_scope_span(struct ctr_otlp_wire *wire,
+                                   struct ctrace_scope_span *scope_span);
+int ctr_otlp_wire_write_resource_span_head(struct ctr_otlp_wire *wire,
+                                           struct ctrace_resource_span *resource_span,
+                                           size_t scope_spans_size);
+int ctr_otlp_wire_write_resource_span_tail(struct ctr_otlp_wire *wire,
+                                           struct ctrace_resource_span *resource_span);
+
+/*
+ * size and write 'ctx' as a sequence of requests of at most 'max_size' bytes,
+ * see ctr_encode_opentelemetry_split().
+ */
+int ctr_otlp_wire_split_request(struct ctr_otlp_wire *wire, struct ctrace *ctx,
+                                size_t max_size,
+                                ctr_encode_opentelemetry_chunk_fn_t cb, void *data);
+
+/* write 'ctx' as a single request through 'writer', see ctr_encode_opentelemetry_write() */
+int ctr_otlp_wire_stream_request(struct ctr_otlp_wire *wire, struct ctrace *ctx,
+                                 struct ctr_writer *writer);
+
+#endif
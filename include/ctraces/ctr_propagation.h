@@ -0,0 +1,70 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef CTR_PROPAGATION_H
+#define CTR_PROPAGATION_H
+
+#include <ctraces/ctraces.h>
+
+/*
+ * W3C Trace Context propagation
+ * -----------------------------
+ * https://www.w3.org/TR/trace-context/
+ *
+ * traceparent values are parsed and validated in a single pass into the
+ * fixed size structure below, tracestate lists are iterated in place. None
+ * of the functions allocate memory.
+ */
+
+#define CTR_TRACEPARENT_SIZE         55  /* "00-" trace_id "-" span_id "-" flags */
+#define CTR_TRACEPARENT_VERSION      0x00
+#define CTR_TRACEPARENT_SAMPLED      0x01
+
+#define CTR_TRACESTATE_MAX_MEMBERS   32
+
+struct ctr_traceparent {
+    uint8_t version;
+    uint8_t flags;
+    unsigned char trace_id[CTR_ID_OTEL_TRACE_SIZE];
+    unsigned char span_id[CTR_ID_OTEL_SPAN_SIZE];
+};
+
+/* cursor over the members of a tracestate header */
+struct ctr_tracestate_iter {
+    const char *p;
+    const char *end;
+    int count;
+};
+
+int ctr_propagation_extract(struct ctr_traceparent *tp, const char *header, size_t len);
+int ctr_propagation_inject(struct ctr_traceparent *tp, char *buf, size_t size);
+
+/* move the context between a traceparent and a span */
+int ctr_propagation_from_span(struct ctr_traceparent *tp, struct ctrace_span *span);
+int ctr_propagation_to_span(struct ctr_traceparent *tp, struct ctrace_span *span);
+
+/* tracestate */
+void ctr_tracestate_iter_init(struct ctr_tracestate_iter *it, const char *header, size_t len);
+int ctr_tracestate_next(struct ctr_tracestate_iter *it,
+                        const char **key, size_t *key_len,
+                        const char **value, size_t *value_len);
+int ctr_tracestate_get(const char *header, size_t len, const char *key,
+                       const char **value, size_t *value_len);
+
+#endif
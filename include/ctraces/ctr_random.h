@@ -23,5 +23,7 @@
 #include <ctraces/ctraces.h>
 
 ssize_t ctr_random_get(void *buf, size_t len);
+void ctr_random_fast_get(void *buf, size_t len);
+void ctr_random_reseed(void);
 
 #endif
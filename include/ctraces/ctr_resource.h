@@ -46,5 +46,7 @@ struct ctrace_resource_span *ctr_resource_span_create(struct ctrace *ctx);
 struct ctrace_resource *ctr_resource_span_get_resource(struct ctrace_resource_span *resource_span);
 int ctr_resource_span_set_schema_url(struct ctrace_resource_span *resource_span, char *url);
 void ctr_resource_span_destroy(struct ctrace_resource_span *resource_span);
+struct ctrace_resource_span *ctr_resource_span_copy(struct ctrace *ctx,
+                                                    struct ctrace_resource_span *from);
 
 #endif
@@ -0,0 +1,156 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef CTR_SAMPLING_H
+#define CTR_SAMPLING_H
+
+#include <ctraces/ctraces.h>
+
+/*
+ * Tail sampling
+ * -------------
+ * A tail sampler buffers the spans of successive contexts grouped by trace
+ * ID. A trace is decided once 'decision_wait' nanoseconds passed since its
+ * first span arrived, or earlier when more than 'max_traces' traces are
+ * buffered (oldest first). The policies are evaluated in the order they were
+ * added and the first one matching keeps the trace, traces matching no
+ * policy are dropped. Kept traces are returned as new contexts by
+ * ctr_tail_sampler_flush().
+ *
+ * Spans are moved, never copied: the input contexts must use heap allocation
+ * and spans without a trace ID are dropped.
+ */
+
+#define CTR_TAIL_SAMPLER_POLICY_ERROR       0   /* a span status is ERROR */
+#define CTR_TAIL_SAMPLER_POLICY_LATENCY     1   /* trace duration >= threshold */
+#define CTR_TAIL_SAMPLER_POLICY_ATTRIBUTE   2   /* span or resource attribute */
+#define CTR_TAIL_SAMPLER_POLICY_RATE_LIMIT  3   /* up to N traces per second */
+
+struct ctr_tail_sampler_policy {
+    int type;
+
+    /* latency */
+    uint64_t threshold;
+
+    /* attribute, a NULL value matches any value */
+    cfl_sds_t key;
+    cfl_sds_t value;
+
+    /* rate limit */
+    int rate;
+    uint64_t window;                /* current second */
+    int window_count;               /* traces kept in the current second */
+
+    struct cfl_list _head;          /* link to 'struct ctr_tail_sampler->policies' */
+};
+
+struct ctr_tail_sampler_stats {
+    uint64_t traces_kept;
+    uint64_t traces_dropped;
+    uint64_t spans_dropped;         /* spans without a trace ID */
+    int traces_pending;
+};
+
+/* maps buffered resource and scope spans to their copies in the output */
+struct ctr_tail_sampler_map {
+    void *from;
+    void *to;
+};
+
+struct ctr_tail_sampler {
+    uint64_t decision_wait;
+    size_t max_traces;
+    struct cfl_list policies;
+
+    struct ctrace *buffer;          /* pending spans, indexed by trace ID */
+    struct ctrace *out;             /* kept traces, NULL when empty */
+    int out_traces;
+
+    struct ctr_tail_sampler_map *map;
+    size_t map_count;
+    size_t map_size;
+
+    struct ctr_tail_sampler_stats stats;
+};
+
+struct ctr_tail_sampler *ctr_tail_sampler_create(uint64_t decision_wait, size_t max_traces);
+void ctr_tail_sampler_destroy(struct ctr_tail_sampler *ts);
+
+/* policies */
+int ctr_tail_sampler_policy_error(struct ctr_tail_sampler *ts);
+int ctr_tail_sampler_policy_latency(struct ctr_tail_sampler *ts, uint64_t threshold);
+int ctr_tail_sampler_policy_attribute(struct ctr_tail_sampler *ts, char *key, char *value);
+int ctr_tail_sampler_policy_rate_limit(struct ctr_tail_sampler *ts, int traces_per_second);
+
+/*
+ * Move the spans of 'ctx' into the sampler, 'ctx' is left empty and must
+ * still be released with ctr_destroy(). Times are in nanoseconds, zero means
+ * the current time.
+ */
+int ctr_tail_sampler_add(struct ctr_tail_sampler *ts, struct ctrace *ctx, uint64_t now);
+
+/*
+ * Decide the traces whose window expired. On return '*out' holds a context
+ * with the traces kept since the last flush, or NULL. Returns the number of
+ * traces in '*out', or -1 on error.
+ */
+int ctr_tail_sampler_flush(struct ctr_tail_sampler *ts, uint64_t now, struct ctrace **out);
+
+void ctr_tail_sampler_get_stats(struct ctr_tail_sampler *ts, struct ctr_tail_sampler_stats *stats);
+
+/*
+ * Head sampling
+ * -------------
+ * Consistent probability sampling as defined by OpenTelemetry: the last 56
+ * bits of the trace ID, or the 'rv' value of the 'ot' tracestate entry, are
+ * compared with a rejection threshold derived from the probability. Every
+ * sampler using the same or a lower probability takes the same decision for
+ * a trace.
+ *
+ * Once attached to a context, ctr_span_create() decides root spans, whose
+ * trace ID is generated for it, and child spans follow their parent. Spans
+ * continuing a remote trace must be created with
+ * ctr_span_create_with_traceparent(), they follow the sampled flag of the
+ * remote parent. An
+ * unsampled trace gets the no-op span of the context: setters accept it
+ * without allocating anything, events and links are not created (NULL, which
+ * their setters accept too) and ctr_span_is_recording() returns false. Sampled spans get the W3C sampled
+ * flag, root spans carry the threshold in their tracestate ('ot=th:...')
+ * and children inherit it.
+ */
+
+#define CTR_SAMPLER_RANDOMNESS_BITS   56
+
+struct ctr_sampler {
+    uint64_t threshold;             /* traces with a lower randomness are dropped */
+    char tracestate[24];            /* "ot=th:" and up to 14 hex digits */
+    int tracestate_len;
+};
+
+struct ctr_sampler *ctr_sampler_create(double probability);
+void ctr_sampler_destroy(struct ctr_sampler *sampler);
+
+/* sample the spans created in 'ctx', NULL detaches the current sampler */
+int ctr_sampler_attach(struct ctrace *ctx, struct ctr_sampler *sampler);
+
+/* returns CTR_TRUE if the trace is sampled, 'tracestate' can be NULL */
+int ctr_sampler_sample(struct ctr_sampler *sampler, const void *trace_id, size_t len,
+                       const char *tracestate, size_t tracestate_len);
+
+#endif
@@ -46,6 +46,8 @@ struct ctrace_scope_span {
 struct ctrace_scope_span *ctr_scope_span_create(struct ctrace_resource_span *resource_span);
 void ctr_scope_span_destroy(struct ctrace_scope_span *scope_span);
 int ctr_scope_span_set_schema_url(struct ctrace_scope_span *scope_span, char *url);
+struct ctrace_scope_span *ctr_scope_span_copy(struct ctrace_resource_span *resource_span,
+                                              struct ctrace_scope_span *from);
 void ctr_scope_span_set_instrumentation_scope(struct ctrace_scope_span *scope_span, struct ctrace_instrumentation_scope *ins_scope);
 
 /* instrumentation scope */
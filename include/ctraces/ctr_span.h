@@ -23,6 +23,8 @@
 #include <ctraces/ctraces.h>
 #include <ctraces/ctr_scope.h>
 
+struct ctr_traceparent;
+
 /*
  * OpenTelemetry Trace Protobuf defition
  * -------------------------------------
@@ -51,6 +53,7 @@ struct ctrace_span_event {
     uint64_t time_unix_nano;
 
     cfl_sds_t name;
+    int name_interned;             /* name is owned by the context table */
 
     /* event attributes */
     struct ctrace_attributes *attr;
@@ -60,6 +63,7 @@ struct ctrace_span_event {
 
     /* ---- INTERNAL --- */
     struct cfl_list _head;
+    struct ctrace_span *span;      /* parent span */
 };
 
 /* Span */
@@ -71,6 +75,7 @@ struct ctrace_span {
     int32_t flags;                    /* flags */
 
     cfl_sds_t name;                   /* user-name assigned */
+    int name_interned;                /* name is owned by the context table */
 
     int kind;                         /* span kind */
     uint64_t start_time_unix_nano;    /* start time */
@@ -101,14 +106,48 @@ struct ctrace_span {
     /* references from parent contexts */
     struct ctrace_scope_span *scope_span;
     struct ctrace *ctx;            /* parent ctrace context */
+
+    /* inline storage for the IDs, the pointers above are only set once assigned */
+    struct ctrace_id trace_id_data;
+    struct ctrace_id span_id_data;
+    struct ctrace_id parent_span_id_data;
+
+    /* ID index state (ctr_index.h) */
+    struct ctr_index_trace *index_trace;  /* trace the span is grouped in */
+    struct cfl_list _head_trace;          /* link to 'index_trace->spans' */
+    uint64_t index_hash;                  /* span ID hash, valid when indexed */
+    int indexed;
+
+    /* non-recording handle of an unsampled trace, see ctr_sampling.h */
+    int noop;
 };
 
 struct ctrace_span *ctr_span_create(struct ctrace *ctx, struct ctrace_scope_span *scope_span, cfl_sds_t name,
                                     struct ctrace_span *parent);
+struct ctrace_span *ctr_span_create_detached(struct ctrace *ctx,
+                                             struct ctrace_scope_span *scope_span,
+                                             cfl_sds_t name,
+                                             struct ctrace_span *parent);
+struct ctrace_span *ctr_span_create_with_traceparent(struct ctrace *ctx,
+                                                     struct ctrace_scope_span *scope_span,
+                                                     cfl_sds_t name,
+                                                     struct ctr_traceparent *tp);
+
+void ctr_span_clear_defaults(struct ctrace_span *span);
 
 void ctr_span_destroy(struct ctrace_span *span);
+int ctr_span_is_recording(struct ctrace_span *span);
+void ctr_span_move(struct ctrace_span *span, struct ctrace *ctx,
+                   struct ctrace_scope_span *scope_span);
+int ctr_span_names_adopt(struct ctrace_span *span, struct ctrace *ctx);
+int ctr_span_names_count(struct ctrace_span *span, struct ctrace *ctx);
+int ctr_span_names_create(struct ctrace_span *span, struct ctrace *ctx,
+                          cfl_sds_t *names, int *flags);
+void ctr_span_names_set(struct ctrace_span *span, cfl_sds_t *names, int *flags);
+void ctr_span_names_destroy(struct ctrace *ctx, cfl_sds_t *names, int *flags, size_t count);
 
 /* Span fields */
+int ctr_span_set_name(struct ctrace_span *span, char *name, size_t len);
 int ctr_span_set_status(struct ctrace_span *span, int code, char *message);
 void ctr_span_set_dropped_events_count(struct ctrace_span *span, uint32_t count);
 void ctr_span_set_dropped_links_count(struct ctrace_span *span, uint32_t count);
@@ -153,11 +192,12 @@ struct ctrace_span_event *ctr_span_event_add(struct ctrace_span *span, char *nam
 struct ctrace_span_event *ctr_span_event_add_ts(struct ctrace_span *span, char *name, uint64_t ts);
 int ctr_span_event_set_attributes(struct ctrace_span_event *event, struct ctrace_attributes *attr);
 void ctr_span_event_set_dropped_attributes_count(struct ctrace_span_event *event, uint32_t count);
+int ctr_span_event_set_name(struct ctrace_span_event *event, char *name, size_t len);
 void ctr_span_event_delete(struct ctrace_span_event *event);
 
 int ctr_span_event_set_attribute_string(struct ctrace_span_event *event, char *key, char *value);
 int ctr_span_event_set_attribute_bool(struct ctrace_span_event *event, char *key, int b);
-int ctr_span_event_set_attribute_int(struct ctrace_span_event *event, char *key, int value);
+int ctr_span_event_set_attribute_int64(struct ctrace_span_event *event, char *key, int64_t value);
 int ctr_span_event_set_attribute_double(struct ctrace_span_event *event, char *key, double value);
 int ctr_span_event_set_attribute_array(struct ctrace_span_event *event, char *key,
                                        struct cfl_array *value);
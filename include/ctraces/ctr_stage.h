@@ -0,0 +1,66 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef CTR_STAGE_H
+#define CTR_STAGE_H
+
+#include <ctraces/ctraces.h>
+
+/*
+ * Span staging buffers
+ * --------------------
+ * A ctrace context is not synchronized. To create spans from many threads
+ * every worker owns a staging buffer: its spans, events, links and strings
+ * live in a private context (and arena) so building them takes no lock.
+ *
+ * ctr_stage_flush() publishes the staged spans to the shared context through
+ * a lock-free list, after that the worker must not touch them anymore. The
+ * thread owning the context links them into the tree with
+ * ctr_stage_collect(), which must run before encoding or iterating spans.
+ *
+ * Resource and scope spans are shared and must be created before the workers
+ * start using them, the same applies to the head sampler: staged spans take
+ * their sampling decision from the sampler attached to the shared context and
+ * unsampled ones get its no-op span. Names of staged spans are copied, they
+ * are not interned (see ctr_intern.h).
+ */
+
+struct ctr_stage_batch {
+    struct cfl_list spans;          /* staged spans, linked by _head_global */
+    struct ctr_arena *arena;        /* arena owning them, NULL for heap */
+    struct ctr_stage_batch *next;
+};
+
+struct ctr_stage {
+    struct ctrace *ctx;             /* shared context */
+    struct ctrace local;            /* private context of the worker */
+};
+
+struct ctr_stage *ctr_stage_create(struct ctrace *ctx);
+void ctr_stage_destroy(struct ctr_stage *stage);
+
+struct ctrace_span *ctr_stage_span_create(struct ctr_stage *stage,
+                                          struct ctrace_scope_span *scope_span,
+                                          cfl_sds_t name,
+                                          struct ctrace_span *parent);
+
+int ctr_stage_flush(struct ctr_stage *stage);
+int ctr_stage_collect(struct ctrace *ctx);
+
+#endif
@@ -0,0 +1,132 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef CTR_WRITER_H
+#define CTR_WRITER_H
+
+#include <ctraces/ctraces.h>
+
+#include <stdio.h>
+
+/*
+ * Output sink shared by the encoders. A writer either grows a buffer
+ * or stages bytes in a fixed chunk that is flushed to a FILE, a file
+ * descriptor or a callback, so streaming output runs in bounded memory.
+ *
+ * Errors are sticky: after a failed allocation or write every call is a
+ * no-op and ctr_writer_flush() returns -1.
+ */
+
+#define CTR_WRITER_BUFFER       0
+#define CTR_WRITER_FILE         1
+#define CTR_WRITER_FD           2
+#define CTR_WRITER_CALLBACK     3
+
+/* staging size of the streaming writers */
+#define CTR_WRITER_CHUNK_SIZE   4096
+
+/* returns 0 once 'len' bytes were consumed, -1 to abort */
+typedef int (*ctr_writer_cb_t)(void *data, const char *buf, size_t len);
+
+struct ctr_writer {
+    int type;
+    int error;
+
+    /* cfl_sds_t in buffer mode, staging chunk otherwise */
+    char *buf;
+    size_t len;
+    size_t size;
+
+    FILE *fp;
+    int fd;
+    ctr_writer_cb_t cb;
+    void *cb_data;
+};
+
+struct ctr_writer *ctr_writer_buffer_create(size_t size);
+struct ctr_writer *ctr_writer_file_create(FILE *fp);
+struct ctr_writer *ctr_writer_fd_create(int fd);
+struct ctr_writer *ctr_writer_callback_create(ctr_writer_cb_t cb, void *data);
+void ctr_writer_destroy(struct ctr_writer *writer);
+
+/* streaming writers only: stage up to 'size' bytes before each flush */
+int ctr_writer_set_chunk_size(struct ctr_writer *writer, size_t size);
+
+/* hand the pending bytes to the sink, returns -1 if any write failed */
+int ctr_writer_flush(struct ctr_writer *writer);
+
+/*
+ * buffer mode only: the NUL terminated output, owned by the caller. The
+ * writer starts over with an empty buffer.
+ */
+cfl_sds_t ctr_writer_buffer_take(struct ctr_writer *writer);
+
+char *ctr_writer_reserve_slow(struct ctr_writer *writer, size_t len);
+void ctr_writer_write_slow(struct ctr_writer *writer, const char *buf, size_t len);
+
+/* room for 'len' contiguous bytes, published with ctr_writer_commit() */
+static inline char *ctr_writer_reserve(struct ctr_writer *writer, size_t len)
+{
+    if (writer->len + len <= writer->size) {
+        return writer->buf + writer->len;
+    }
+
+    return ctr_writer_reserve_slow(writer, len);
+}
+
+static inline void ctr_writer_commit(struct ctr_writer *writer, size_t len)
+{
+    writer->len += len;
+}
+
+static inline void ctr_writer_write(struct ctr_writer *writer, const char *buf, size_t len)
+{
+    if (writer->len + len <= writer->size) {
+        memcpy(writer->buf + writer->len, buf, len);
+        writer->len += len;
+        return;
+    }
+
+    ctr_writer_write_slow(writer, buf, len);
+}
+
+static inline void ctr_writer_char(struct ctr_writer *writer, char c)
+{
+    if (writer->len < writer->size) {
+        writer->buf[writer->len++] = c;
+        return;
+    }
+
+    ctr_writer_write_slow(writer, &c, 1);
+}
+
+#define ctr_writer_lit(writer, str)   ctr_writer_write(writer, str, sizeof(str) - 1)
+
+void ctr_writer_str(struct ctr_writer *writer, const char *str);
+void ctr_writer_pad(struct ctr_writer *writer, char c, size_t count);
+void ctr_writer_uint64(struct ctr_writer *writer, uint64_t val);
+void ctr_writer_int64(struct ctr_writer *writer, int64_t val);
+
+/* same digits as printf's %.17g */
+void ctr_writer_double(struct ctr_writer *writer, double val);
+
+/* lowercase hex of 'len' bytes */
+void ctr_writer_hex(struct ctr_writer *writer, const void *buf, size_t len);
+
+#endif
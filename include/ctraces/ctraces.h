@@ -34,12 +34,25 @@
 #include <stdlib.h>
 
 /* ctrace options creation keys */
-#define CTR_OPTS_TRACE_ID   0
+#define CTR_OPTS_TRACE_ID           0
+#define CTR_OPTS_ARENA              1   /* "on" / "off" */
+#define CTR_OPTS_ARENA_CHUNK_SIZE   2   /* bytes */
+#define CTR_OPTS_ID_INDEX           3   /* "on" / "off" */
+#define CTR_OPTS_INTERN             4   /* "on" / "off" */
 
-/* options is unused for now */
 struct ctrace_opts {
-    /* windows compiler: error C2016: C requires that a struct or union have at least one member */
-    int _make_windows_happy;
+    /*
+     * allocate spans, events, links, IDs and their strings from a per-context
+     * arena which is released at once by ctr_destroy().
+     */
+    int arena;
+    size_t arena_chunk_size;
+
+    /* maintain a trace/span ID index, see ctr_index.h */
+    int id_index;
+
+    /* share one copy of every span and event name, see ctr_intern.h */
+    int intern;
 };
 
 struct ctrace {
@@ -63,6 +76,22 @@ struct ctrace {
      */
     struct cfl_list span_list;
 
+    /* memory arena, NULL when objects are allocated from the heap */
+    struct ctr_arena *arena;
+
+    /* span batches flushed by staging buffers, pending ctr_stage_collect() */
+    struct ctr_stage_batch *staged;
+
+    /* trace/span ID index, NULL when disabled */
+    struct ctr_index *index;
+
+    /* head sampler and the handle returned for unsampled spans (ctr_sampling.h) */
+    struct ctr_sampler *sampler;
+    struct ctrace_span *noop_span;
+
+    /* span and event name table, NULL when disabled */
+    struct ctr_intern *intern;
+
     /* logging */
     int log_level;
     void (*log_cb)(void *, int, const char *, int, const char *);
@@ -78,7 +107,9 @@ void ctr_opts_exit(struct ctrace_opts *opts);
 
 /* headers that are needed in general */
 #include <ctraces/ctr_info.h>
+#include <ctraces/ctr_arena.h>
 #include <ctraces/ctr_id.h>
+#include <ctraces/ctr_base16.h>
 #include <ctraces/ctr_random.h>
 #include <ctraces/ctr_version.h>
 #include <ctraces/ctr_span.h>
@@ -87,14 +118,24 @@ void ctr_opts_exit(struct ctrace_opts *opts);
 #include <ctraces/ctr_attributes.h>
 #include <ctraces/ctr_log.h>
 #include <ctraces/ctr_resource.h>
+#include <ctraces/ctr_stage.h>
+#include <ctraces/ctr_merge.h>
+#include <ctraces/ctr_index.h>
+#include <ctraces/ctr_sampling.h>
+#include <ctraces/ctr_columns.h>
+#include <ctraces/ctr_intern.h>
+#include <ctraces/ctr_propagation.h>
+#include <ctraces/ctr_writer.h>
 
 /* encoders */
 #include <ctraces/ctr_encode_text.h>
+#include <ctraces/ctr_encode_json.h>
 #include <ctraces/ctr_encode_msgpack.h>
 #include <ctraces/ctr_encode_opentelemetry.h>
 
 /* decoders */
 #include <ctraces/ctr_decode_opentelemetry.h>
+#include <ctraces/ctr_decode_json.h>
 
 
 
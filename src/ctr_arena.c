@@ -0,0 +1,256 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <ctraces/ctraces.h>
+#include <ctraces/ctr_arena.h>
+
+#define ALIGN_UP(v, a)   (((v) + ((a) - 1)) & ~((size_t) (a) - 1))
+#define CHUNK_HDR_SIZE   ALIGN_UP(sizeof(struct ctr_arena_chunk), CTR_ARENA_ALIGNMENT)
+#define CHUNK_DATA(c)    ((char *) (c) + CHUNK_HDR_SIZE)
+
+static struct ctr_arena_chunk *chunk_create(struct ctr_arena *arena, size_t size)
+{
+    struct ctr_arena_chunk *chunk;
+
+    chunk = malloc(CHUNK_HDR_SIZE + size);
+    if (!chunk) {
+        ctr_errno();
+        return NULL;
+    }
+    chunk->size = size;
+    chunk->used = 0;
+    chunk->next = NULL;
+
+    arena->allocated += size;
+
+    return chunk;
+}
+
+/* reuse the first spare chunk large enough, or allocate a new one */
+static struct ctr_arena_chunk *chunk_get(struct ctr_arena *arena, size_t size)
+{
+    struct ctr_arena_chunk *chunk;
+    struct ctr_arena_chunk **prev;
+
+    prev = &arena->spare;
+    for (chunk = arena->spare; chunk; chunk = chunk->next) {
+        if (chunk->size >= size) {
+            *prev = chunk->next;
+            chunk->next = NULL;
+            return chunk;
+        }
+        prev = &chunk->next;
+    }
+
+    return chunk_create(arena, size);
+}
+
+static void chunk_list_destroy(struct ctr_arena_chunk *chunk)
+{
+    struct ctr_arena_chunk *next;
+
+    while (chunk) {
+        next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+struct ctr_arena *ctr_arena_create(size_t chunk_size)
+{
+    struct ctr_arena *arena;
+
+    if (chunk_size == 0) {
+        chunk_size = CTR_ARENA_CHUNK_SIZE_DEFAULT;
+    }
+
+    arena = calloc(1, sizeof(struct ctr_arena));
+    if (!arena) {
+        ctr_errno();
+        return NULL;
+    }
+    arena->chunk_size = ALIGN_UP(chunk_size, CTR_ARENA_ALIGNMENT);
+
+    arena->chunks = chunk_create(arena, arena->chunk_size);
+    if (!arena->chunks) {
+        free(arena);
+        return NULL;
+    }
+
+    return arena;
+}
+
+void ctr_arena_destroy(struct ctr_arena *arena)
+{
+    if (!arena) {
+        return;
+    }
+
+    chunk_list_destroy(arena->chunks);
+    chunk_list_destroy(arena->spare);
+
+    free(arena);
+}
+
+/*
+ * Rewind every chunk and keep it: the current one keeps serving and the
+ * others, including dedicated chunks, are reused by the next allocations.
+ */
+void ctr_arena_reset(struct ctr_arena *arena)
+{
+    struct ctr_arena_chunk *chunk;
+    struct ctr_arena_chunk *next;
+
+    chunk = arena->chunks->next;
+    while (chunk) {
+        next = chunk->next;
+        chunk->used = 0;
+        chunk->next = arena->spare;
+        arena->spare = chunk;
+        chunk = next;
+    }
+
+    arena->chunks->used = 0;
+    arena->chunks->next = NULL;
+}
+
+void ctr_arena_merge(struct ctr_arena *dst, struct ctr_arena *src)
+{
+    struct ctr_arena_chunk *tail;
+
+    /* the chunks are linked after the current one of 'dst' so it keeps serving */
+    tail = src->chunks;
+    while (tail->next) {
+        tail = tail->next;
+    }
+
+    tail->next = dst->chunks->next;
+    dst->chunks->next = src->chunks;
+    dst->allocated += src->allocated;
+
+    if (src->spare) {
+        tail = src->spare;
+        while (tail->next) {
+            tail = tail->next;
+        }
+        tail->next = dst->spare;
+        dst->spare = src->spare;
+    }
+
+    free(src);
+}
+
+void *ctr_arena_alloc(struct ctr_arena *arena, size_t size)
+{
+    void *ptr;
+    struct ctr_arena_chunk *chunk;
+
+    if (!arena) {
+        ptr = calloc(1, size);
+        if (!ptr) {
+            ctr_errno();
+        }
+        return ptr;
+    }
+
+    size = ALIGN_UP(size, CTR_ARENA_ALIGNMENT);
+    chunk = arena->chunks;
+
+    if (chunk->size - chunk->used < size) {
+        if (size > arena->chunk_size / 4) {
+            /*
+             * big allocations get a dedicated chunk which is linked after
+             * the current one, so the space left on the current chunk is
+             * not wasted.
+             */
+            chunk = chunk_get(arena, size);
+            if (!chunk) {
+                return NULL;
+            }
+            chunk->next = arena->chunks->next;
+            arena->chunks->next = chunk;
+        }
+        else {
+            chunk = chunk_get(arena, arena->chunk_size);
+            if (!chunk) {
+                return NULL;
+            }
+            chunk->next = arena->chunks;
+            arena->chunks = chunk;
+        }
+    }
+
+    ptr = CHUNK_DATA(chunk) + chunk->used;
+    chunk->used += size;
+
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+void ctr_arena_free(struct ctr_arena *arena, void *ptr)
+{
+    /* arena memory is released with the arena itself */
+    if (!arena) {
+        free(ptr);
+    }
+}
+
+cfl_sds_t ctr_arena_sds_create_len(struct ctr_arena *arena, const char *str, size_t len)
+{
+    struct cfl_sds *head;
+
+    if (!arena) {
+        return cfl_sds_create_len(str, len);
+    }
+
+    head = ctr_arena_alloc(arena, CFL_SDS_HEADER_SIZE + len + 1);
+    if (!head) {
+        return NULL;
+    }
+    head->len = len;
+    head->alloc = len;
+
+    if (str) {
+        memcpy(head->buf, str, len);
+    }
+    head->buf[len] = '\0';
+
+    return head->buf;
+}
+
+cfl_sds_t ctr_arena_sds_create(struct ctr_arena *arena, const char *str)
+{
+    size_t len;
+
+    if (str) {
+        len = strlen(str);
+    }
+    else {
+        len = 0;
+    }
+
+    return ctr_arena_sds_create_len(arena, str, len);
+}
+
+void ctr_arena_sds_destroy(struct ctr_arena *arena, cfl_sds_t str)
+{
+    if (!arena && str) {
+        cfl_sds_destroy(str);
+    }
+}
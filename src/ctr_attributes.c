@@ -86,3 +86,169 @@ int ctr_attributes_set_kvlist(struct ctrace_attributes *attr, char *key,
 {
     return cfl_kvlist_insert_kvlist(attr->kv, key, value);
 }
+
+/*
+ * Deep copy
+ * ---------
+ */
+
+static struct cfl_variant *variant_copy(struct cfl_variant *value);
+
+static struct cfl_array *array_copy(struct cfl_array *array)
+{
+    size_t i;
+    struct cfl_array *copy;
+    struct cfl_variant *entry;
+
+    copy = cfl_array_create(array->entry_count > 0 ? array->entry_count : 1);
+    if (!copy) {
+        return NULL;
+    }
+    cfl_array_resizable(copy, CFL_TRUE);
+
+    for (i = 0; i < array->entry_count; i++) {
+        entry = variant_copy(array->entries[i]);
+        if (!entry) {
+            cfl_array_destroy(copy);
+            return NULL;
+        }
+
+        if (cfl_array_append(copy, entry) != 0) {
+            cfl_variant_destroy(entry);
+            cfl_array_destroy(copy);
+            return NULL;
+        }
+    }
+
+    return copy;
+}
+
+static struct cfl_kvlist *kvlist_copy(struct cfl_kvlist *kvlist)
+{
+    struct cfl_list *head;
+    struct cfl_kvpair *pair;
+    struct cfl_kvlist *copy;
+    struct cfl_variant *value;
+
+    copy = cfl_kvlist_create();
+    if (!copy) {
+        return NULL;
+    }
+
+    cfl_list_foreach(head, &kvlist->list) {
+        pair = cfl_list_entry(head, struct cfl_kvpair, _head);
+
+        value = variant_copy(pair->val);
+        if (!value) {
+            cfl_kvlist_destroy(copy);
+            return NULL;
+        }
+
+        if (cfl_kvlist_insert_s(copy, pair->key, cfl_sds_len(pair->key), value) != 0) {
+            cfl_variant_destroy(value);
+            cfl_kvlist_destroy(copy);
+            return NULL;
+        }
+    }
+
+    return copy;
+}
+
+static struct cfl_variant *variant_copy(struct cfl_variant *value)
+{
+    struct cfl_array *array;
+    struct cfl_kvlist *kvlist;
+    struct cfl_variant *copy = NULL;
+
+    switch (value->type) {
+        case CFL_VARIANT_STRING:
+            copy = cfl_variant_create_from_string_s(value->data.as_string,
+                                                    cfl_sds_len(value->data.as_string),
+                                                    CFL_FALSE);
+            break;
+        case CFL_VARIANT_BYTES:
+            copy = cfl_variant_create_from_bytes(value->data.as_bytes,
+                                                 cfl_sds_len(value->data.as_bytes),
+                                                 CFL_FALSE);
+            break;
+        case CFL_VARIANT_REFERENCE:
+            copy = cfl_variant_create_from_reference(value->data.as_reference);
+            break;
+        case CFL_VARIANT_BOOL:
+            copy = cfl_variant_create_from_bool(value->data.as_bool);
+            break;
+        case CFL_VARIANT_INT:
+            copy = cfl_variant_create_from_int64(value->data.as_int64);
+            break;
+        case CFL_VARIANT_DOUBLE:
+            copy = cfl_variant_create_from_double(value->data.as_double);
+            break;
+        case CFL_VARIANT_ARRAY:
+            array = array_copy(value->data.as_array);
+            if (!array) {
+                return NULL;
+            }
+            copy = cfl_variant_create_from_array(array);
+            if (!copy) {
+                cfl_array_destroy(array);
+            }
+            break;
+        case CFL_VARIANT_KVLIST:
+            kvlist = kvlist_copy(value->data.as_kvlist);
+            if (!kvlist) {
+                return NULL;
+            }
+            copy = cfl_variant_create_from_kvlist(kvlist);
+            if (!copy) {
+                cfl_kvlist_destroy(kvlist);
+            }
+            break;
+        default:
+            /* the remaining types (unsigned integer, null) hold scalars */
+            copy = cfl_variant_create();
+            if (copy) {
+                copy->type = value->type;
+                copy->data = value->data;
+            }
+            break;
+    }
+
+    return copy;
+}
+
+struct ctrace_attributes *ctr_attributes_copy(struct ctrace_attributes *attr)
+{
+    struct ctrace_attributes *copy;
+
+    copy = malloc(sizeof(struct ctrace_attributes));
+    if (!copy) {
+        ctr_errno();
+        return NULL;
+    }
+
+    copy->kv = kvlist_copy(attr->kv);
+    if (!copy->kv) {
+        free(copy);
+        return NULL;
+    }
+
+    return copy;
+}
+
+/* insert a copy of a key/value pair of another attribute list */
+int ctr_attributes_copy_pair(struct ctrace_attributes *attr, struct cfl_kvpair *pair)
+{
+    struct cfl_variant *value;
+
+    value = variant_copy(pair->val);
+    if (!value) {
+        return -1;
+    }
+
+    if (cfl_kvlist_insert_s(attr->kv, pair->key, cfl_sds_len(pair->key), value) != 0) {
+        cfl_variant_destroy(value);
+        return -1;
+    }
+
+    return 0;
+}
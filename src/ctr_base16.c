@@ -0,0 +1,237 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <ctraces/ctr_base16.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CTR_BASE16_SSE2
+#include <emmintrin.h>
+#endif
+
+static const char hex_lower[] = "0123456789abcdef";
+
+/*
+ * hex digit values tagged with HEX_ANY_CASE, digits and lowercase letters
+ * also carry HEX_LOWER. Zero marks anything else.
+ */
+#define HEX_ANY_CASE   0x10
+#define HEX_LOWER      0x20
+
+static const unsigned char hex_values[256] = {
+    ['0'] = 0x30, ['1'] = 0x31, ['2'] = 0x32, ['3'] = 0x33, ['4'] = 0x34,
+    ['5'] = 0x35, ['6'] = 0x36, ['7'] = 0x37, ['8'] = 0x38, ['9'] = 0x39,
+    ['a'] = 0x3a, ['b'] = 0x3b, ['c'] = 0x3c, ['d'] = 0x3d, ['e'] = 0x3e,
+    ['f'] = 0x3f, ['A'] = 0x1a, ['B'] = 0x1b, ['C'] = 0x1c, ['D'] = 0x1d,
+    ['E'] = 0x1e, ['F'] = 0x1f
+};
+
+static void encode_scalar(const unsigned char *in, size_t len, char *out)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        out[i * 2] = hex_lower[in[i] >> 4];
+        out[i * 2 + 1] = hex_lower[in[i] & 0x0f];
+    }
+}
+
+static int decode_scalar(const char *hex, size_t len, unsigned char *out, int tag)
+{
+    size_t i;
+    unsigned char hi;
+    unsigned char lo;
+
+    for (i = 0; i < len / 2; i++) {
+        hi = hex_values[(unsigned char) hex[i * 2]];
+        lo = hex_values[(unsigned char) hex[i * 2 + 1]];
+
+        if (!(hi & lo & tag)) {
+            return -1;
+        }
+
+        out[i] = (unsigned char) (((hi & 0x0f) << 4) | (lo & 0x0f));
+    }
+
+    return 0;
+}
+
+#ifdef CTR_BASE16_SSE2
+
+/* nibbles (0-15) to lowercase ascii */
+static inline __m128i nibbles_to_hex(__m128i n)
+{
+    __m128i letters;
+
+    letters = _mm_and_si128(_mm_cmpgt_epi8(n, _mm_set1_epi8(9)),
+                            _mm_set1_epi8('a' - '0' - 10));
+
+    return _mm_add_epi8(_mm_add_epi8(n, _mm_set1_epi8('0')), letters);
+}
+
+/*
+ * ascii to nibbles, 'valid' gets 0xff on every lane holding a hex digit.
+ * 'fold' is 0x20 to accept upper case letters or zero for lowercase only.
+ */
+static inline __m128i hex_to_nibbles(__m128i c, __m128i fold, __m128i *valid)
+{
+    __m128i digit;
+    __m128i alpha;
+    __m128i digit_ok;
+    __m128i alpha_ok;
+
+    digit = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+    digit_ok = _mm_and_si128(_mm_cmpgt_epi8(digit, _mm_set1_epi8(-1)),
+                             _mm_cmplt_epi8(digit, _mm_set1_epi8(10)));
+
+    /* folding 0x20 maps 'A'-'F' to 'a'-'f' */
+    alpha = _mm_sub_epi8(_mm_or_si128(c, fold), _mm_set1_epi8('a'));
+    alpha_ok = _mm_and_si128(_mm_cmpgt_epi8(alpha, _mm_set1_epi8(-1)),
+                             _mm_cmplt_epi8(alpha, _mm_set1_epi8(6)));
+
+    *valid = _mm_or_si128(digit_ok, alpha_ok);
+
+    return _mm_or_si128(_mm_and_si128(digit_ok, digit),
+                        _mm_and_si128(alpha_ok,
+                                      _mm_add_epi8(alpha, _mm_set1_epi8(10))));
+}
+
+/* 16 nibbles in lanes (hi, lo, hi, lo...) to 8 bytes in the low 16-bit lanes */
+static inline __m128i join_nibbles(__m128i n)
+{
+    return _mm_and_si128(_mm_or_si128(_mm_slli_epi16(n, 4), _mm_srli_epi16(n, 8)),
+                         _mm_set1_epi16(0x00ff));
+}
+
+void ctr_base16_encode(const void *data, size_t len, char *out)
+{
+    __m128i v;
+    __m128i hi;
+    __m128i lo;
+    __m128i mask = _mm_set1_epi8(0x0f);
+    const unsigned char *in = data;
+
+    while (len >= 16) {
+        v = _mm_loadu_si128((const __m128i *) in);
+        hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+        lo = _mm_and_si128(v, mask);
+
+        _mm_storeu_si128((__m128i *) out, nibbles_to_hex(_mm_unpacklo_epi8(hi, lo)));
+        _mm_storeu_si128((__m128i *) (out + 16), nibbles_to_hex(_mm_unpackhi_epi8(hi, lo)));
+
+        in += 16;
+        out += 32;
+        len -= 16;
+    }
+
+    /* 8 bytes span IDs */
+    if (len >= 8) {
+        v = _mm_loadl_epi64((const __m128i *) in);
+        hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+        lo = _mm_and_si128(v, mask);
+
+        _mm_storeu_si128((__m128i *) out, nibbles_to_hex(_mm_unpacklo_epi8(hi, lo)));
+
+        in += 8;
+        out += 16;
+        len -= 8;
+    }
+
+    encode_scalar(in, len, out);
+}
+
+static int decode(const char *hex, size_t len, void *out, int lower)
+{
+    __m128i a;
+    __m128i b;
+    __m128i fold;
+    __m128i valid_a;
+    __m128i valid_b;
+    unsigned char *p = out;
+
+    if (len % 2 != 0) {
+        return -1;
+    }
+
+    fold = _mm_set1_epi8(lower ? 0 : 0x20);
+
+    while (len >= 32) {
+        a = hex_to_nibbles(_mm_loadu_si128((const __m128i *) hex), fold, &valid_a);
+        b = hex_to_nibbles(_mm_loadu_si128((const __m128i *) (hex + 16)), fold, &valid_b);
+
+        if (_mm_movemask_epi8(_mm_and_si128(valid_a, valid_b)) != 0xffff) {
+            return -1;
+        }
+
+        _mm_storeu_si128((__m128i *) p,
+                         _mm_packus_epi16(join_nibbles(a), join_nibbles(b)));
+
+        hex += 32;
+        p += 16;
+        len -= 32;
+    }
+
+    if (len >= 16) {
+        a = hex_to_nibbles(_mm_loadu_si128((const __m128i *) hex), fold, &valid_a);
+
+        if (_mm_movemask_epi8(valid_a) != 0xffff) {
+            return -1;
+        }
+
+        _mm_storel_epi64((__m128i *) p,
+                         _mm_packus_epi16(join_nibbles(a), _mm_setzero_si128()));
+
+        hex += 16;
+        p += 8;
+        len -= 16;
+    }
+
+    return decode_scalar(hex, len, p, lower ? HEX_LOWER : HEX_ANY_CASE);
+}
+
+#else
+
+void ctr_base16_encode(const void *data, size_t len, char *out)
+{
+    encode_scalar(data, len, out);
+}
+
+static int decode(const char *hex, size_t len, void *out, int lower)
+{
+    if (len % 2 != 0) {
+        return -1;
+    }
+
+    return decode_scalar(hex, len, out, lower ? HEX_LOWER : HEX_ANY_CASE);
+}
+
+#endif
+
+int ctr_base16_decode(const char *hex, size_t len, void *out)
+{
+    return decode(hex, len, out, 0);
+}
+
+int ctr_base16_decode_lower(const char *hex, size_t len, void *out)
+{
+    return decode(hex, len, out, 1);
+}
@@ -0,0 +1,1031 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <ctraces/ctraces.h>
+#include <ctraces/ctr_columns.h>
+
+#include <string.h>
+
+/*
+ * String dictionary
+ * -----------------
+ */
+
+static int dict_grow_slots(struct ctr_columns_dict *dict)
+{
+    uint32_t i;
+    uint32_t pos;
+    uint32_t size;
+    uint32_t *slots;
+    cfl_sds_t value;
+
+    size = dict->slots_size ? dict->slots_size * 2 : 64;
+    slots = calloc(size, sizeof(uint32_t));
+    if (!slots) {
+        ctr_errno();
+        return -1;
+    }
+
+    for (i = 0; i < dict->count; i++) {
+        value = dict->values[i];
+        pos = cfl_hash_64bits(value, cfl_sds_len(value)) & (size - 1);
+        while (slots[pos] != 0) {
+            pos = (pos + 1) & (size - 1);
+        }
+        slots[pos] = i + 1;
+    }
+
+    free(dict->slots);
+    dict->slots = slots;
+    dict->slots_size = size;
+
+    return 0;
+}
+
+/* returns the slot holding 'str' or the empty slot where it belongs */
+static uint32_t dict_find(struct ctr_columns_dict *dict, const char *str, size_t len)
+{
+    uint32_t pos;
+    cfl_sds_t value;
+
+    pos = cfl_hash_64bits(str, len) & (dict->slots_size - 1);
+    while (dict->slots[pos] != 0) {
+        value = dict->values[dict->slots[pos] - 1];
+        if (cfl_sds_len(value) == len && memcmp(value, str, len) == 0) {
+            break;
+        }
+        pos = (pos + 1) & (dict->slots_size - 1);
+    }
+
+    return pos;
+}
+
+static uint32_t dict_add(struct ctr_columns_dict *dict, const char *str, size_t len)
+{
+    uint32_t pos;
+    uint32_t size;
+    cfl_sds_t value;
+    cfl_sds_t *values;
+
+    /* keep the load factor under 1/2 */
+    if ((dict->count + 1) * 2 > dict->slots_size) {
+        if (dict_grow_slots(dict) != 0) {
+            return CTR_COLUMNS_NONE;
+        }
+    }
+
+    pos = dict_find(dict, str, len);
+    if (dict->slots[pos] != 0) {
+        return dict->slots[pos] - 1;
+    }
+
+    if (dict->count == dict->size) {
+        size = dict->size ? dict->size * 2 : 64;
+        values = realloc(dict->values, size * sizeof(cfl_sds_t));
+        if (!values) {
+            ctr_errno();
+            return CTR_COLUMNS_NONE;
+        }
+        dict->values = values;
+        dict->size = size;
+    }
+
+    value = cfl_sds_create_len(str, len);
+    if (!value) {
+        return CTR_COLUMNS_NONE;
+    }
+
+    dict->values[dict->count] = value;
+    dict->slots[pos] = dict->count + 1;
+
+    return dict->count++;
+}
+
+static void dict_destroy(struct ctr_columns_dict *dict)
+{
+    uint32_t i;
+
+    for (i = 0; i < dict->count; i++) {
+        cfl_sds_destroy(dict->values[i]);
+    }
+    free(dict->values);
+    free(dict->slots);
+}
+
+/* dictionary index of an optional string, -1 on error */
+static int string_add(struct ctr_columns *cols, cfl_sds_t str, uint32_t *out)
+{
+    if (!str) {
+        *out = CTR_COLUMNS_NONE;
+        return 0;
+    }
+
+    *out = dict_add(&cols->strings, str, cfl_sds_len(str));
+    if (*out == CTR_COLUMNS_NONE) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Same as string_add() for span and event names: an interned name is the
+ * same pointer for every span of the context, so its index is cached by
+ * address and the lookup skips hashing the content.
+ */
+static int name_add(struct ctr_columns *cols, cfl_sds_t name, int interned,
+                    uint32_t *out)
+{
+    size_t pos;
+    struct ctr_columns_dict *dict;
+
+    if (!name || !interned) {
+        return string_add(cols, name, out);
+    }
+
+    dict = &cols->strings;
+    pos = ((uintptr_t) name >> 4) & (CTR_COLUMNS_INTERN_CACHE - 1);
+    if (dict->interned[pos] == name) {
+        *out = dict->interned_index[pos];
+        return 0;
+    }
+
+    if (string_add(cols, name, out) != 0) {
+        return -1;
+    }
+
+    dict->interned[pos] = name;
+    dict->interned_index[pos] = *out;
+
+    return 0;
+}
+
+cfl_sds_t ctr_columns_string(struct ctr_columns *cols, uint32_t index)
+{
+    if (index >= cols->strings.count) {
+        return NULL;
+    }
+
+    return cols->strings.values[index];
+}
+
+uint32_t ctr_columns_string_lookup(struct ctr_columns *cols, char *str, size_t len)
+{
+    uint32_t pos;
+
+    if (cols->strings.count == 0) {
+        return CTR_COLUMNS_NONE;
+    }
+
+    pos = dict_find(&cols->strings, str, len);
+    if (cols->strings.slots[pos] == 0) {
+        return CTR_COLUMNS_NONE;
+    }
+
+    return cols->strings.slots[pos] - 1;
+}
+
+/*
+ * Attribute columns
+ * -----------------
+ */
+
+static int attr_type_supported(int type)
+{
+    return type == CFL_VARIANT_STRING || type == CFL_VARIANT_BOOL ||
+           type == CFL_VARIANT_INT || type == CFL_VARIANT_DOUBLE;
+}
+
+static struct ctr_columns_attr *attr_column_create(struct ctr_columns *cols,
+                                                   cfl_sds_t key, int type)
+{
+    size_t size;
+    struct ctr_columns_attr *attr;
+    struct ctr_columns_attr *attrs;
+
+    /* the capacity is the next power of two, starting at 8 */
+    size = 0;
+    if (cols->attr_count == 0) {
+        size = 8;
+    }
+    else if (cols->attr_count >= 8 && (cols->attr_count & (cols->attr_count - 1)) == 0) {
+        size = cols->attr_count * 2;
+    }
+
+    if (size > 0) {
+        attrs = realloc(cols->attrs, size * sizeof(struct ctr_columns_attr));
+        if (!attrs) {
+            ctr_errno();
+            return NULL;
+        }
+        cols->attrs = attrs;
+    }
+
+    attr = &cols->attrs[cols->attr_count];
+    memset(attr, 0, sizeof(struct ctr_columns_attr));
+    attr->type = type;
+
+    attr->key = cfl_sds_create_len(key, cfl_sds_len(key));
+    attr->valid = calloc(cols->rows, sizeof(uint8_t));
+
+    switch (type) {
+        case CFL_VARIANT_STRING:
+            attr->str = calloc(cols->rows, sizeof(uint32_t));
+            break;
+        case CFL_VARIANT_DOUBLE:
+            attr->f64 = calloc(cols->rows, sizeof(double));
+            break;
+        default:
+            attr->i64 = calloc(cols->rows, sizeof(int64_t));
+            break;
+    }
+
+    if (!attr->key || !attr->valid || (!attr->str && !attr->f64 && !attr->i64)) {
+        ctr_errno();
+        if (attr->key) {
+            cfl_sds_destroy(attr->key);
+        }
+        free(attr->valid);
+        free(attr->str);
+        free(attr->f64);
+        free(attr->i64);
+        return NULL;
+    }
+
+    cols->attr_count++;
+    return attr;
+}
+
+static int key_equal(cfl_sds_t a, const char *b, size_t len)
+{
+    return cfl_sds_len(a) == len && memcmp(a, b, len) == 0;
+}
+
+struct ctr_columns_attr *ctr_columns_attr_get(struct ctr_columns *cols, char *key)
+{
+    size_t i;
+    size_t len;
+
+    len = strlen(key);
+    for (i = 0; i < cols->attr_count; i++) {
+        if (key_equal(cols->attrs[i].key, key, len)) {
+            return &cols->attrs[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* spans usually set their attributes in the same order, 'hint' is the position */
+static struct ctr_columns_attr *attr_column_lookup(struct ctr_columns *cols,
+                                                   cfl_sds_t key, size_t hint)
+{
+    size_t i;
+    size_t len;
+
+    len = cfl_sds_len(key);
+    if (hint < cols->attr_count && key_equal(cols->attrs[hint].key, key, len)) {
+        return &cols->attrs[hint];
+    }
+
+    for (i = 0; i < cols->attr_count; i++) {
+        if (key_equal(cols->attrs[i].key, key, len)) {
+            return &cols->attrs[i];
+        }
+    }
+
+    return NULL;
+}
+
+static int attr_other_add(struct ctr_columns *cols, size_t row, struct cfl_kvpair *pair)
+{
+    if (!cols->attr_other[row]) {
+        cols->attr_other[row] = ctr_attributes_create();
+        if (!cols->attr_other[row]) {
+            return -1;
+        }
+    }
+
+    return ctr_attributes_copy_pair(cols->attr_other[row], pair);
+}
+
+static int span_attributes_add(struct ctr_columns *cols, size_t row,
+                               struct ctrace_attributes *attributes)
+{
+    size_t pos = 0;
+    uint32_t index;
+    struct cfl_list *head;
+    struct cfl_kvpair *pair;
+    struct cfl_variant *value;
+    struct ctr_columns_attr *attr;
+
+    if (!attributes) {
+        return 0;
+    }
+
+    cfl_list_foreach(head, &attributes->kv->list) {
+        pair = cfl_list_entry(head, struct cfl_kvpair, _head);
+        value = pair->val;
+
+        attr = NULL;
+        if (attr_type_supported(value->type)) {
+            attr = attr_column_lookup(cols, pair->key, pos);
+            if (!attr) {
+                attr = attr_column_create(cols, pair->key, value->type);
+                if (!attr) {
+                    return -1;
+                }
+            }
+        }
+        pos++;
+
+        /* a key seen twice in the same span keeps its first value in the column */
+        if (!attr || attr->type != value->type || attr->valid[row]) {
+            if (attr_other_add(cols, row, pair) != 0) {
+                return -1;
+            }
+            continue;
+        }
+
+        switch (value->type) {
+            case CFL_VARIANT_STRING:
+                index = dict_add(&cols->strings, value->data.as_string,
+                                 cfl_sds_len(value->data.as_string));
+                if (index == CTR_COLUMNS_NONE) {
+                    return -1;
+                }
+                attr->str[row] = index;
+                break;
+            case CFL_VARIANT_BOOL:
+                attr->i64[row] = value->data.as_bool;
+                break;
+            case CFL_VARIANT_INT:
+                attr->i64[row] = value->data.as_int64;
+                break;
+            case CFL_VARIANT_DOUBLE:
+                attr->f64[row] = value->data.as_double;
+                break;
+        }
+        attr->valid[row] = CTR_TRUE;
+    }
+
+    return 0;
+}
+
+/*
+ * Batch creation
+ * --------------
+ */
+
+/* copy an ID to a fixed size column entry, left zeroed when unset */
+static int id_copy(unsigned char *out, size_t size, struct ctrace_id *cid)
+{
+    if (!cid || ctr_id_get_len(cid) == 0) {
+        return 0;
+    }
+
+    if (ctr_id_get_len(cid) != size) {
+        return -1;
+    }
+
+    memcpy(out, ctr_id_get_buf(cid), size);
+    return 0;
+}
+
+static struct ctrace_attributes *attributes_copy(struct ctrace_attributes *attr)
+{
+    if (!attr || cfl_list_is_empty(&attr->kv->list)) {
+        return NULL;
+    }
+
+    return ctr_attributes_copy(attr);
+}
+
+static int columns_alloc(struct ctr_columns *cols, size_t events, size_t links)
+{
+    size_t rows;
+
+    rows = cols->rows;
+
+    cols->trace_id = calloc(rows, CTR_ID_OTEL_TRACE_SIZE);
+    cols->span_id = calloc(rows, CTR_ID_OTEL_SPAN_SIZE);
+    cols->parent_span_id = calloc(rows, CTR_ID_OTEL_SPAN_SIZE);
+    cols->start_time = calloc(rows, sizeof(uint64_t));
+    cols->end_time = calloc(rows, sizeof(uint64_t));
+    cols->name = calloc(rows, sizeof(uint32_t));
+    cols->trace_state = calloc(rows, sizeof(uint32_t));
+    cols->schema_url = calloc(rows, sizeof(uint32_t));
+    cols->flags = calloc(rows, sizeof(int32_t));
+    cols->kind = calloc(rows, sizeof(uint8_t));
+    cols->status_code = calloc(rows, sizeof(uint8_t));
+    cols->status_message = calloc(rows, sizeof(uint32_t));
+    cols->dropped_attr_count = calloc(rows, sizeof(uint32_t));
+    cols->dropped_events_count = calloc(rows, sizeof(uint32_t));
+    cols->dropped_links_count = calloc(rows, sizeof(uint32_t));
+    cols->scope = calloc(rows, sizeof(uint32_t));
+    cols->attr_other = calloc(rows, sizeof(struct ctrace_attributes *));
+
+    cols->events.offset = calloc(rows + 1, sizeof(uint32_t));
+    cols->events.time = calloc(events, sizeof(uint64_t));
+    cols->events.name = calloc(events, sizeof(uint32_t));
+    cols->events.dropped_attr_count = calloc(events, sizeof(uint32_t));
+    cols->events.attr = calloc(events, sizeof(struct ctrace_attributes *));
+
+    cols->links.offset = calloc(rows + 1, sizeof(uint32_t));
+    cols->links.trace_id = calloc(links, CTR_ID_OTEL_TRACE_SIZE);
+    cols->links.span_id = calloc(links, CTR_ID_OTEL_SPAN_SIZE);
+    cols->links.trace_state = calloc(links, sizeof(uint32_t));
+    cols->links.flags = calloc(links, sizeof(uint32_t));
+    cols->links.dropped_attr_count = calloc(links, sizeof(uint32_t));
+    cols->links.attr = calloc(links, sizeof(struct ctrace_attributes *));
+
+    /* calloc() may return NULL for empty tables, only fail when rows exist */
+    if (rows > 0 &&
+        (!cols->trace_id || !cols->span_id || !cols->parent_span_id ||
+         !cols->start_time || !cols->end_time || !cols->name ||
+         !cols->trace_state || !cols->schema_url || !cols->flags ||
+         !cols->kind || !cols->status_code || !cols->status_message ||
+         !cols->dropped_attr_count || !cols->dropped_events_count ||
+         !cols->dropped_links_count || !cols->scope || !cols->attr_other)) {
+        ctr_errno();
+        return -1;
+    }
+
+    if (!cols->events.offset || !cols->links.offset) {
+        ctr_errno();
+        return -1;
+    }
+
+    if (events > 0 &&
+        (!cols->events.time || !cols->events.name ||
+         !cols->events.dropped_attr_count || !cols->events.attr)) {
+        ctr_errno();
+        return -1;
+    }
+
+    if (links > 0 &&
+        (!cols->links.trace_id || !cols->links.span_id || !cols->links.trace_state ||
+         !cols->links.flags || !cols->links.dropped_attr_count || !cols->links.attr)) {
+        ctr_errno();
+        return -1;
+    }
+
+    return 0;
+}
+
+static int event_add(struct ctr_columns *cols, struct ctrace_span_event *event)
+{
+    size_t i;
+
+    i = cols->events.count;
+
+    cols->events.time[i] = event->time_unix_nano;
+    cols->events.dropped_attr_count[i] = event->dropped_attr_count;
+    if (name_add(cols, event->name, event->name_interned, &cols->events.name[i]) != 0) {
+        return -1;
+    }
+
+    cols->events.attr[i] = attributes_copy(event->attr);
+    if (!cols->events.attr[i] && event->attr &&
+        !cfl_list_is_empty(&event->attr->kv->list)) {
+        return -1;
+    }
+
+    cols->events.count++;
+    return 0;
+}
+
+static int link_add(struct ctr_columns *cols, struct ctrace_link *link)
+{
+    size_t i;
+
+    i = cols->links.count;
+
+    if (id_copy(cols->links.trace_id[i], CTR_ID_OTEL_TRACE_SIZE, link->trace_id) != 0 ||
+        id_copy(cols->links.span_id[i], CTR_ID_OTEL_SPAN_SIZE, link->span_id) != 0) {
+        return -1;
+    }
+
+    cols->links.flags[i] = link->flags;
+    cols->links.dropped_attr_count[i] = link->dropped_attr_count;
+    if (string_add(cols, link->trace_state, &cols->links.trace_state[i]) != 0) {
+        return -1;
+    }
+
+    cols->links.attr[i] = attributes_copy(link->attr);
+    if (!cols->links.attr[i] && link->attr &&
+        !cfl_list_is_empty(&link->attr->kv->list)) {
+        return -1;
+    }
+
+    cols->links.count++;
+    return 0;
+}
+
+static int span_add(struct ctr_columns *cols, size_t row, uint32_t scope,
+                    struct ctrace_span *span)
+{
+    struct cfl_list *head;
+    struct ctrace_link *link;
+    struct ctrace_span_event *event;
+
+    if (id_copy(cols->trace_id[row], CTR_ID_OTEL_TRACE_SIZE, span->trace_id) != 0 ||
+        id_copy(cols->span_id[row], CTR_ID_OTEL_SPAN_SIZE, span->span_id) != 0 ||
+        id_copy(cols->parent_span_id[row], CTR_ID_OTEL_SPAN_SIZE, span->parent_span_id) != 0) {
+        return -1;
+    }
+
+    cols->start_time[row] = span->start_time_unix_nano;
+    cols->end_time[row] = span->end_time_unix_nano;
+    cols->flags[row] = span->flags;
+    cols->kind[row] = span->kind;
+    cols->status_code[row] = span->status.code;
+    cols->dropped_attr_count[row] = span->dropped_attr_count;
+    cols->dropped_events_count[row] = span->dropped_events_count;
+    cols->dropped_links_count[row] = span->dropped_links_count;
+    cols->scope[row] = scope;
+
+    if (name_add(cols, span->name, span->name_interned, &cols->name[row]) != 0 ||
+        string_add(cols, span->trace_state, &cols->trace_state[row]) != 0 ||
+        string_add(cols, span->schema_url, &cols->schema_url[row]) != 0 ||
+        string_add(cols, span->status.message, &cols->status_message[row]) != 0) {
+        return -1;
+    }
+
+    if (span_attributes_add(cols, row, span->attr) != 0) {
+        return -1;
+    }
+
+    cols->events.offset[row] = cols->events.count;
+    cfl_list_foreach(head, &span->events) {
+        event = cfl_list_entry(head, struct ctrace_span_event, _head);
+        if (event_add(cols, event) != 0) {
+            return -1;
+        }
+    }
+    cols->events.offset[row + 1] = cols->events.count;
+
+    cols->links.offset[row] = cols->links.count;
+    cfl_list_foreach(head, &span->links) {
+        link = cfl_list_entry(head, struct ctrace_link, _head);
+        if (link_add(cols, link) != 0) {
+            return -1;
+        }
+    }
+    cols->links.offset[row + 1] = cols->links.count;
+
+    return 0;
+}
+
+struct ctr_columns *ctr_columns_create(struct ctrace *ctx)
+{
+    size_t row = 0;
+    size_t events = 0;
+    size_t links = 0;
+    uint32_t scope = 0;
+    struct cfl_list *head;
+    struct cfl_list *s_head;
+    struct cfl_list *span_head;
+    struct ctrace_span *span;
+    struct ctrace_scope_span *scope_span;
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_resource_span *meta_resource_span;
+    struct ctr_columns *cols;
+
+    cols = calloc(1, sizeof(struct ctr_columns));
+    if (!cols) {
+        ctr_errno();
+        return NULL;
+    }
+
+    /* size every table up front */
+    cfl_list_foreach(head, &ctx->resource_spans) {
+        resource_span = cfl_list_entry(head, struct ctrace_resource_span, _head);
+        cfl_list_foreach(s_head, &resource_span->scope_spans) {
+            scope_span = cfl_list_entry(s_head, struct ctrace_scope_span, _head);
+            cols->scope_count++;
+
+            cfl_list_foreach(span_head, &scope_span->spans) {
+                span = cfl_list_entry(span_head, struct ctrace_span, _head);
+                cols->rows++;
+                events += cfl_list_size(&span->events);
+                links += cfl_list_size(&span->links);
+            }
+        }
+    }
+
+    if (cols->rows >= CTR_COLUMNS_NONE || events >= CTR_COLUMNS_NONE ||
+        links >= CTR_COLUMNS_NONE) {
+        free(cols);
+        return NULL;
+    }
+
+    cols->meta = ctr_create(NULL);
+    if (!cols->meta) {
+        free(cols);
+        return NULL;
+    }
+
+    cols->scope_spans = calloc(cols->scope_count + 1, sizeof(struct ctrace_scope_span *));
+    if (!cols->scope_spans || columns_alloc(cols, events, links) != 0) {
+        ctr_errno();
+        ctr_columns_destroy(cols);
+        return NULL;
+    }
+
+    cfl_list_foreach(head, &ctx->resource_spans) {
+        resource_span = cfl_list_entry(head, struct ctrace_resource_span, _head);
+
+        meta_resource_span = ctr_resource_span_copy(cols->meta, resource_span);
+        if (!meta_resource_span) {
+            ctr_columns_destroy(cols);
+            return NULL;
+        }
+
+        cfl_list_foreach(s_head, &resource_span->scope_spans) {
+            scope_span = cfl_list_entry(s_head, struct ctrace_scope_span, _head);
+
+            cols->scope_spans[scope] = ctr_scope_span_copy(meta_resource_span, scope_span);
+            if (!cols->scope_spans[scope]) {
+                ctr_columns_destroy(cols);
+                return NULL;
+            }
+
+            cfl_list_foreach(span_head, &scope_span->spans) {
+                span = cfl_list_entry(span_head, struct ctrace_span, _head);
+                if (span_add(cols, row, scope, span) != 0) {
+                    ctr_columns_destroy(cols);
+                    return NULL;
+                }
+                row++;
+            }
+            scope++;
+        }
+    }
+
+    return cols;
+}
+
+void ctr_columns_destroy(struct ctr_columns *cols)
+{
+    size_t i;
+    struct ctr_columns_attr *attr;
+
+    free(cols->trace_id);
+    free(cols->span_id);
+    free(cols->parent_span_id);
+    free(cols->start_time);
+    free(cols->end_time);
+    free(cols->name);
+    free(cols->trace_state);
+    free(cols->schema_url);
+    free(cols->flags);
+    free(cols->kind);
+    free(cols->status_code);
+    free(cols->status_message);
+    free(cols->dropped_attr_count);
+    free(cols->dropped_events_count);
+    free(cols->dropped_links_count);
+    free(cols->scope);
+
+    for (i = 0; i < cols->attr_count; i++) {
+        attr = &cols->attrs[i];
+        cfl_sds_destroy(attr->key);
+        free(attr->valid);
+        free(attr->str);
+        free(attr->i64);
+        free(attr->f64);
+    }
+    free(cols->attrs);
+
+    if (cols->attr_other) {
+        for (i = 0; i < cols->rows; i++) {
+            if (cols->attr_other[i]) {
+                ctr_attributes_destroy(cols->attr_other[i]);
+            }
+        }
+        free(cols->attr_other);
+    }
+
+    if (cols->events.attr) {
+        for (i = 0; i < cols->events.count; i++) {
+            if (cols->events.attr[i]) {
+                ctr_attributes_destroy(cols->events.attr[i]);
+            }
+        }
+    }
+    free(cols->events.offset);
+    free(cols->events.time);
+    free(cols->events.name);
+    free(cols->events.dropped_attr_count);
+    free(cols->events.attr);
+
+    if (cols->links.attr) {
+        for (i = 0; i < cols->links.count; i++) {
+            if (cols->links.attr[i]) {
+                ctr_attributes_destroy(cols->links.attr[i]);
+            }
+        }
+    }
+    free(cols->links.offset);
+    free(cols->links.trace_id);
+    free(cols->links.span_id);
+    free(cols->links.trace_state);
+    free(cols->links.flags);
+    free(cols->links.dropped_attr_count);
+    free(cols->links.attr);
+
+    dict_destroy(&cols->strings);
+
+    free(cols->scope_spans);
+    if (cols->meta) {
+        ctr_destroy(cols->meta);
+    }
+    free(cols);
+}
+
+/*
+ * Conversion to a context
+ * -----------------------
+ */
+
+static int id_is_set(unsigned char *id, size_t size)
+{
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        if (id[i] != 0) {
+            return CTR_TRUE;
+        }
+    }
+
+    return CTR_FALSE;
+}
+
+static int span_attributes_set(struct ctr_columns *cols, size_t row,
+                               struct ctrace_span *span)
+{
+    int ret = 0;
+    size_t i;
+    struct cfl_list *head;
+    struct cfl_kvpair *pair;
+    struct ctr_columns_attr *attr;
+
+    for (i = 0; i < cols->attr_count && ret == 0; i++) {
+        attr = &cols->attrs[i];
+        if (!attr->valid[row]) {
+            continue;
+        }
+
+        switch (attr->type) {
+            case CFL_VARIANT_STRING:
+                ret = ctr_span_set_attribute_string(span, attr->key,
+                                                    cols->strings.values[attr->str[row]]);
+                break;
+            case CFL_VARIANT_BOOL:
+                ret = ctr_span_set_attribute_bool(span, attr->key, attr->i64[row]);
+                break;
+            case CFL_VARIANT_INT:
+                ret = ctr_span_set_attribute_int64(span, attr->key, attr->i64[row]);
+                break;
+            case CFL_VARIANT_DOUBLE:
+                ret = ctr_span_set_attribute_double(span, attr->key, attr->f64[row]);
+                break;
+        }
+    }
+
+    if (ret != 0 || !cols->attr_other[row]) {
+        return ret;
+    }
+
+    cfl_list_foreach(head, &cols->attr_other[row]->kv->list) {
+        pair = cfl_list_entry(head, struct cfl_kvpair, _head);
+        if (ctr_attributes_copy_pair(span->attr, pair) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int span_events_set(struct ctr_columns *cols, size_t row, struct ctrace_span *span)
+{
+    uint32_t i;
+    cfl_sds_t name;
+    struct ctrace_attributes *attr;
+    struct ctrace_span_event *event;
+
+    for (i = cols->events.offset[row]; i < cols->events.offset[row + 1]; i++) {
+        name = ctr_columns_string(cols, cols->events.name[i]);
+        event = ctr_span_event_add_ts(span, name ? name : "", cols->events.time[i]);
+        if (!event) {
+            return -1;
+        }
+        event->time_unix_nano = cols->events.time[i];
+        event->dropped_attr_count = cols->events.dropped_attr_count[i];
+
+        if (cols->events.attr[i]) {
+            attr = ctr_attributes_copy(cols->events.attr[i]);
+            if (!attr) {
+                return -1;
+            }
+            ctr_span_event_set_attributes(event, attr);
+        }
+    }
+
+    return 0;
+}
+
+static int span_links_set(struct ctr_columns *cols, size_t row, struct ctrace_span *span)
+{
+    uint32_t i;
+    void *trace_id;
+    void *span_id;
+    cfl_sds_t trace_state;
+    struct ctrace_attributes *attr;
+    struct ctrace_link *link;
+
+    for (i = cols->links.offset[row]; i < cols->links.offset[row + 1]; i++) {
+        trace_id = NULL;
+        if (id_is_set(cols->links.trace_id[i], CTR_ID_OTEL_TRACE_SIZE)) {
+            trace_id = cols->links.trace_id[i];
+        }
+
+        span_id = NULL;
+        if (id_is_set(cols->links.span_id[i], CTR_ID_OTEL_SPAN_SIZE)) {
+            span_id = cols->links.span_id[i];
+        }
+
+        link = ctr_link_create(span, trace_id, CTR_ID_OTEL_TRACE_SIZE,
+                               span_id, CTR_ID_OTEL_SPAN_SIZE);
+        if (!link) {
+            return -1;
+        }
+        ctr_link_set_flags(link, cols->links.flags[i]);
+        ctr_link_set_dropped_attr_count(link, cols->links.dropped_attr_count[i]);
+
+        trace_state = ctr_columns_string(cols, cols->links.trace_state[i]);
+        if (trace_state && ctr_link_set_trace_state(link, trace_state) != 0) {
+            return -1;
+        }
+
+        if (cols->links.attr[i]) {
+            attr = ctr_attributes_copy(cols->links.attr[i]);
+            if (!attr) {
+                return -1;
+            }
+            ctr_link_set_attributes(link, attr);
+        }
+    }
+
+    return 0;
+}
+
+static int span_set(struct ctr_columns *cols, size_t row, struct ctrace_span *span)
+{
+    cfl_sds_t str;
+
+    if (id_is_set(cols->trace_id[row], CTR_ID_OTEL_TRACE_SIZE) &&
+        ctr_span_set_trace_id(span, cols->trace_id[row], CTR_ID_OTEL_TRACE_SIZE) != 0) {
+        return -1;
+    }
+
+    if (id_is_set(cols->span_id[row], CTR_ID_OTEL_SPAN_SIZE) &&
+        ctr_span_set_span_id(span, cols->span_id[row], CTR_ID_OTEL_SPAN_SIZE) != 0) {
+        return -1;
+    }
+
+    if (id_is_set(cols->parent_span_id[row], CTR_ID_OTEL_SPAN_SIZE) &&
+        ctr_span_set_parent_span_id(span, cols->parent_span_id[row],
+                                    CTR_ID_OTEL_SPAN_SIZE) != 0) {
+        return -1;
+    }
+
+    span->start_time_unix_nano = cols->start_time[row];
+    span->end_time_unix_nano = cols->end_time[row];
+    span->flags = cols->flags[row];
+    span->kind = cols->kind[row];
+    span->dropped_attr_count = cols->dropped_attr_count[row];
+    span->dropped_events_count = cols->dropped_events_count[row];
+    span->dropped_links_count = cols->dropped_links_count[row];
+
+    str = ctr_columns_string(cols, cols->trace_state[row]);
+    if (str && ctr_span_set_trace_state(span, str, cfl_sds_len(str)) != 0) {
+        return -1;
+    }
+
+    str = ctr_columns_string(cols, cols->schema_url[row]);
+    if (str) {
+        ctr_span_set_schema_url(span, str);
+        if (!span->schema_url) {
+            return -1;
+        }
+    }
+
+    if (ctr_span_set_status(span, cols->status_code[row],
+                            ctr_columns_string(cols, cols->status_message[row])) != 0) {
+        return -1;
+    }
+
+    if (span_attributes_set(cols, row, span) != 0 ||
+        span_events_set(cols, row, span) != 0 ||
+        span_links_set(cols, row, span) != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+struct ctrace *ctr_columns_to_ctrace(struct ctr_columns *cols, uint8_t *selection)
+{
+    size_t i;
+    size_t j;
+    size_t row;
+    cfl_sds_t name;
+    struct ctrace *ctx;
+    struct ctrace_span *span;
+    struct ctrace_scope_span *from;
+    struct ctrace_scope_span **scope_spans;
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_resource_span **resource_spans;
+
+    ctx = ctr_create(NULL);
+    if (!ctx) {
+        return NULL;
+    }
+
+    /* output resource and scope spans, created when a row needs them */
+    scope_spans = calloc(cols->scope_count + 1, sizeof(struct ctrace_scope_span *));
+    resource_spans = calloc(cols->scope_count + 1, sizeof(struct ctrace_resource_span *));
+    if (!scope_spans || !resource_spans) {
+        ctr_errno();
+        goto error;
+    }
+
+    for (row = 0; row < cols->rows; row++) {
+        if (selection && !selection[row]) {
+            continue;
+        }
+
+        i = cols->scope[row];
+        if (!scope_spans[i]) {
+            from = cols->scope_spans[i];
+
+            resource_span = resource_spans[i];
+            if (!resource_span) {
+                resource_span = ctr_resource_span_copy(ctx, from->resource_span);
+                if (!resource_span) {
+                    goto error;
+                }
+
+                /* scopes sharing the resource span reuse the copy */
+                for (j = 0; j < cols->scope_count; j++) {
+                    if (cols->scope_spans[j]->resource_span == from->resource_span) {
+                        resource_spans[j] = resource_span;
+                    }
+                }
+            }
+
+            scope_spans[i] = ctr_scope_span_copy(resource_span, from);
+            if (!scope_spans[i]) {
+                goto error;
+            }
+        }
+
+        name = ctr_columns_string(cols, cols->name[row]);
+        span = ctr_span_create(ctx, scope_spans[i], name ? name : "", NULL);
+        if (!span) {
+            goto error;
+        }
+
+        if (span_set(cols, row, span) != 0) {
+            goto error;
+        }
+    }
+
+    free(scope_spans);
+    free(resource_spans);
+    return ctx;
+
+error:
+    free(scope_spans);
+    free(resource_spans);
+    ctr_destroy(ctx);
+    return NULL;
+}
@@ -0,0 +1,1816 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <ctraces/ctraces.h>
+#include <ctraces/ctr_decode_json.h>
+
+#include <math.h>
+
+/* lexer states */
+#define LEX_NONE                0
+#define LEX_STRING              1
+#define LEX_ESCAPE              2
+#define LEX_UNICODE             3
+#define LEX_NUMBER              4
+#define LEX_LITERAL             5
+
+/* what the syntax allows next */
+#define EXPECT_VALUE            0
+#define EXPECT_VALUE_OR_END     1   /* after '[' */
+#define EXPECT_KEY_OR_END       2   /* after '{' */
+#define EXPECT_KEY              3
+#define EXPECT_COLON            4
+#define EXPECT_COMMA_OR_END     5
+#define EXPECT_DONE             6
+
+/* scalar tokens */
+#define TOKEN_STRING            0
+#define TOKEN_NUMBER            1
+#define TOKEN_TRUE              2
+#define TOKEN_FALSE             3
+#define TOKEN_NULL              4
+
+/* OTLP messages, one frame per JSON object or array being decoded */
+#define FRAME_SKIP              0   /* unknown member, ignored */
+#define FRAME_REQUEST           1
+#define FRAME_RESOURCE_SPANS    2   /* [] */
+#define FRAME_RESOURCE_SPAN     3
+#define FRAME_RESOURCE          4
+#define FRAME_SCOPE_SPANS       5   /* [] */
+#define FRAME_SCOPE_SPAN        6
+#define FRAME_SCOPE             7
+#define FRAME_SPANS             8   /* [] */
+#define FRAME_SPAN              9
+#define FRAME_EVENTS            10  /* [] */
+#define FRAME_EVENT             11
+#define FRAME_LINKS             12  /* [] */
+#define FRAME_LINK              13
+#define FRAME_STATUS            14
+#define FRAME_KEY_VALUES        15  /* [] */
+#define FRAME_KEY_VALUE         16
+#define FRAME_ANY_VALUE         17
+#define FRAME_ARRAY_VALUE       18
+#define FRAME_VALUES            19  /* [] */
+#define FRAME_KVLIST_VALUE      20
+
+/* object members */
+#define FIELD_UNKNOWN           0
+#define FIELD_RESOURCE_SPANS    1
+#define FIELD_RESOURCE          2
+#define FIELD_SCOPE_SPANS       3
+#define FIELD_SCHEMA_URL        4
+#define FIELD_SCOPE             5
+#define FIELD_SPANS             6
+#define FIELD_NAME              7
+#define FIELD_VERSION           8
+#define FIELD_ATTRIBUTES        9
+#define FIELD_DROPPED_ATTR      10
+#define FIELD_TRACE_ID          11
+#define FIELD_SPAN_ID           12
+#define FIELD_TRACE_STATE       13
+#define FIELD_PARENT_SPAN_ID    14
+#define FIELD_FLAGS             15
+#define FIELD_KIND              16
+#define FIELD_START_TIME        17
+#define FIELD_END_TIME          18
+#define FIELD_EVENTS            19
+#define FIELD_DROPPED_EVENTS    20
+#define FIELD_LINKS             21
+#define FIELD_DROPPED_LINKS     22
+#define FIELD_STATUS            23
+#define FIELD_TIME              24
+#define FIELD_MESSAGE           25
+#define FIELD_CODE              26
+#define FIELD_KEY               27
+#define FIELD_VALUE             28
+#define FIELD_STRING_VALUE      29
+#define FIELD_BOOL_VALUE        30
+#define FIELD_INT_VALUE         31
+#define FIELD_DOUBLE_VALUE      32
+#define FIELD_ARRAY_VALUE       33
+#define FIELD_KVLIST_VALUE      34
+#define FIELD_BYTES_VALUE       35
+#define FIELD_VALUES            36
+
+/* IDs longer than this are rejected */
+#define JSON_ID_MAX_SIZE        64
+
+struct json_member {
+    int frame;
+    const char *name;
+    int field;
+};
+
+static const struct json_member json_members[] = {
+    {FRAME_REQUEST,       "resourceSpans",          FIELD_RESOURCE_SPANS},
+    {FRAME_REQUEST,       "resource_spans",         FIELD_RESOURCE_SPANS},
+
+    {FRAME_RESOURCE_SPAN, "resource",               FIELD_RESOURCE},
+    {FRAME_RESOURCE_SPAN, "scopeSpans",             FIELD_SCOPE_SPANS},
+    {FRAME_RESOURCE_SPAN, "scope_spans",            FIELD_SCOPE_SPANS},
+    {FRAME_RESOURCE_SPAN, "schemaUrl",              FIELD_SCHEMA_URL},
+    {FRAME_RESOURCE_SPAN, "schema_url",             FIELD_SCHEMA_URL},
+
+    {FRAME_RESOURCE,      "attributes",             FIELD_ATTRIBUTES},
+    {FRAME_RESOURCE,      "droppedAttributesCount", FIELD_DROPPED_ATTR},
+    {FRAME_RESOURCE,      "dropped_attributes_count", FIELD_DROPPED_ATTR},
+
+    {FRAME_SCOPE_SPAN,    "scope",                  FIELD_SCOPE},
+    {FRAME_SCOPE_SPAN,    "spans",                  FIELD_SPANS},
+    {FRAME_SCOPE_SPAN,    "schemaUrl",              FIELD_SCHEMA_URL},
+    {FRAME_SCOPE_SPAN,    "schema_url",             FIELD_SCHEMA_URL},
+
+    {FRAME_SCOPE,         "name",                   FIELD_NAME},
+    {FRAME_SCOPE,         "version",                FIELD_VERSION},
+    {FRAME_SCOPE,         "attributes",             FIELD_ATTRIBUTES},
+    {FRAME_SCOPE,         "droppedAttributesCount", FIELD_DROPPED_ATTR},
+    {FRAME_SCOPE,         "dropped_attributes_count", FIELD_DROPPED_ATTR},
+
+    {FRAME_SPAN,          "traceId",                FIELD_TRACE_ID},
+    {FRAME_SPAN,          "trace_id",               FIELD_TRACE_ID},
+    {FRAME_SPAN,          "spanId",                 FIELD_SPAN_ID},
+    {FRAME_SPAN,          "span_id",                FIELD_SPAN_ID},
+    {FRAME_SPAN,          "traceState",             FIELD_TRACE_STATE},
+    {FRAME_SPAN,          "trace_state",            FIELD_TRACE_STATE},
+    {FRAME_SPAN,          "parentSpanId",           FIELD_PARENT_SPAN_ID},
+    {FRAME_SPAN,          "parent_span_id",         FIELD_PARENT_SPAN_ID},
+    {FRAME_SPAN,          "flags",                  FIELD_FLAGS},
+    {FRAME_SPAN,          "name",                   FIELD_NAME},
+    {FRAME_SPAN,          "kind",                   FIELD_KIND},
+    {FRAME_SPAN,          "startTimeUnixNano",      FIELD_START_TIME},
+    {FRAME_SPAN,          "start_time_unix_nano",   FIELD_START_TIME},
+    {FRAME_SPAN,          "endTimeUnixNano",        FIELD_END_TIME},
+    {FRAME_SPAN,          "end_time_unix_nano",     FIELD_END_TIME},
+    {FRAME_SPAN,          "attributes",             FIELD_ATTRIBUTES},
+    {FRAME_SPAN,          "droppedAttributesCount", FIELD_DROPPED_ATTR},
+    {FRAME_SPAN,          "dropped_attributes_count", FIELD_DROPPED_ATTR},
+    {FRAME_SPAN,          "events",                 FIELD_EVENTS},
+    {FRAME_SPAN,          "droppedEventsCount",     FIELD_DROPPED_EVENTS},
+    {FRAME_SPAN,          "dropped_events_count",   FIELD_DROPPED_EVENTS},
+    {FRAME_SPAN,          "links",                  FIELD_LINKS},
+    {FRAME_SPAN,          "droppedLinksCount",      FIELD_DROPPED_LINKS},
+    {FRAME_SPAN,          "dropped_links_count",    FIELD_DROPPED_LINKS},
+    {FRAME_SPAN,          "status",                 FIELD_STATUS},
+
+    {FRAME_EVENT,         "timeUnixNano",           FIELD_TIME},
+    {FRAME_EVENT,         "time_unix_nano",         FIELD_TIME},
+    {FRAME_EVENT,         "name",                   FIELD_NAME},
+    {FRAME_EVENT,         "attributes",             FIELD_ATTRIBUTES},
+    {FRAME_EVENT,         "droppedAttributesCount", FIELD_DROPPED_ATTR},
+    {FRAME_EVENT,         "dropped_attributes_count", FIELD_DROPPED_ATTR},
+
+    {FRAME_LINK,          "traceId",                FIELD_TRACE_ID},
+    {FRAME_LINK,          "trace_id",               FIELD_TRACE_ID},
+    {FRAME_LINK,          "spanId",                 FIELD_SPAN_ID},
+    {FRAME_LINK,          "span_id",                FIELD_SPAN_ID},
+    {FRAME_LINK,          "traceState",             FIELD_TRACE_STATE},
+    {FRAME_LINK,          "trace_state",            FIELD_TRACE_STATE},
+    {FRAME_LINK,          "attributes",             FIELD_ATTRIBUTES},
+    {FRAME_LINK,          "droppedAttributesCount", FIELD_DROPPED_ATTR},
+    {FRAME_LINK,          "dropped_attributes_count", FIELD_DROPPED_ATTR},
+    {FRAME_LINK,          "flags",                  FIELD_FLAGS},
+
+    {FRAME_STATUS,        "message",                FIELD_MESSAGE},
+    {FRAME_STATUS,        "code",                   FIELD_CODE},
+
+    {FRAME_KEY_VALUE,     "key",                    FIELD_KEY},
+    {FRAME_KEY_VALUE,     "value",                  FIELD_VALUE},
+
+    {FRAME_ANY_VALUE,     "stringValue",            FIELD_STRING_VALUE},
+    {FRAME_ANY_VALUE,     "string_value",           FIELD_STRING_VALUE},
+    {FRAME_ANY_VALUE,     "boolValue",              FIELD_BOOL_VALUE},
+    {FRAME_ANY_VALUE,     "bool_value",             FIELD_BOOL_VALUE},
+    {FRAME_ANY_VALUE,     "intValue",               FIELD_INT_VALUE},
+    {FRAME_ANY_VALUE,     "int_value",              FIELD_INT_VALUE},
+    {FRAME_ANY_VALUE,     "doubleValue",            FIELD_DOUBLE_VALUE},
+    {FRAME_ANY_VALUE,     "double_value",           FIELD_DOUBLE_VALUE},
+    {FRAME_ANY_VALUE,     "arrayValue",             FIELD_ARRAY_VALUE},
+    {FRAME_ANY_VALUE,     "array_value",            FIELD_ARRAY_VALUE},
+    {FRAME_ANY_VALUE,     "kvlistValue",            FIELD_KVLIST_VALUE},
+    {FRAME_ANY_VALUE,     "kvlist_value",           FIELD_KVLIST_VALUE},
+    {FRAME_ANY_VALUE,     "bytesValue",             FIELD_BYTES_VALUE},
+    {FRAME_ANY_VALUE,     "bytes_value",            FIELD_BYTES_VALUE},
+
+    {FRAME_ARRAY_VALUE,   "values",                 FIELD_VALUES},
+    {FRAME_KVLIST_VALUE,  "values",                 FIELD_VALUES},
+
+    {0, NULL, 0}
+};
+
+/* base64 values of both the standard and the URL alphabets, 0xff otherwise */
+static const unsigned char json_base64_values[256] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x3e, 0xff, 0x3e, 0xff, 0x3f,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+    0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0x3f,
+    0xff, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x32, 0x33, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+};
+
+struct json_frame {
+    int type;
+    int field;                    /* member being decoded, from its key */
+    int is_array;
+    void *target;                 /* object filled by the frame */
+    cfl_sds_t key;                /* KeyValue key */
+    struct cfl_variant *value;    /* KeyValue and AnyValue result */
+};
+
+struct ctr_decode_json_stream {
+    struct ctrace_opts opts;
+    int has_opts;
+    int error;
+
+    /* context of the document being decoded, NULL between documents */
+    struct ctrace *ctx;
+
+    /* lexer */
+    int lex;
+    int expect;
+    int is_key;
+    char *tok;                    /* current string or number, NUL terminated */
+    size_t tok_len;
+    size_t tok_size;
+    const char *literal;
+    int literal_pos;
+    int literal_token;
+    int unicode_count;
+    char unicode[4];              /* hex digits of a \u escape */
+    uint32_t surrogate;           /* pending high surrogate of a \u pair */
+
+    struct json_frame frames[CTR_DECODE_JSON_MAX_DEPTH];
+    int depth;
+};
+
+static int token_reserve(struct ctr_decode_json_stream *dec, size_t len)
+{
+    size_t size;
+    char *tmp;
+
+    /* keep room for the terminator */
+    if (dec->tok_len + len + 1 <= dec->tok_size) {
+        return 0;
+    }
+
+    size = dec->tok_size ? dec->tok_size * 2 : 256;
+    while (size < dec->tok_len + len + 1) {
+        size *= 2;
+    }
+
+    tmp = realloc(dec->tok, size);
+    if (!tmp) {
+        ctr_errno();
+        return -1;
+    }
+    dec->tok = tmp;
+    dec->tok_size = size;
+
+    return 0;
+}
+
+static int token_append(struct ctr_decode_json_stream *dec, const char *buf, size_t len)
+{
+    if (token_reserve(dec, len) != 0) {
+        return -1;
+    }
+
+    memcpy(dec->tok + dec->tok_len, buf, len);
+    dec->tok_len += len;
+
+    return 0;
+}
+
+static int token_append_utf8(struct ctr_decode_json_stream *dec, uint32_t cp)
+{
+    char out[4];
+    size_t len;
+
+    if (cp < 0x80) {
+        out[0] = cp;
+        len = 1;
+    }
+    else if (cp < 0x800) {
+        out[0] = 0xc0 | (cp >> 6);
+        out[1] = 0x80 | (cp & 0x3f);
+        len = 2;
+    }
+    else if (cp < 0x10000) {
+        out[0] = 0xe0 | (cp >> 12);
+        out[1] = 0x80 | ((cp >> 6) & 0x3f);
+        out[2] = 0x80 | (cp & 0x3f);
+        len = 3;
+    }
+    else {
+        out[0] = 0xf0 | (cp >> 18);
+        out[1] = 0x80 | ((cp >> 12) & 0x3f);
+        out[2] = 0x80 | ((cp >> 6) & 0x3f);
+        out[3] = 0x80 | (cp & 0x3f);
+        len = 4;
+    }
+
+    return token_append(dec, out, len);
+}
+
+/*
+ * Value helpers
+ * -------------
+ */
+
+static int parse_uint64(const char *str, size_t len, uint64_t *out)
+{
+    size_t i;
+    uint64_t val = 0;
+    unsigned int digit;
+
+    if (len == 0) {
+        return -1;
+    }
+
+    for (i = 0; i < len; i++) {
+        digit = (unsigned char) str[i] - '0';
+        if (digit > 9) {
+            return -1;
+        }
+
+        if (val > (UINT64_MAX - digit) / 10) {
+            return -1;
+        }
+        val = val * 10 + digit;
+    }
+
+    *out = val;
+    return 0;
+}
+
+static int parse_int64(const char *str, size_t len, int64_t *out)
+{
+    uint64_t val;
+
+    if (len > 0 && str[0] == '-') {
+        if (parse_uint64(str + 1, len - 1, &val) != 0 ||
+            val > (uint64_t) INT64_MAX + 1) {
+            return -1;
+        }
+        *out = (int64_t) (0 - val);
+        return 0;
+    }
+
+    if (parse_uint64(str, len, &val) != 0 || val > INT64_MAX) {
+        return -1;
+    }
+    *out = (int64_t) val;
+
+    return 0;
+}
+
+/* 64-bit integers are strings in OTLP/JSON, numbers are accepted too */
+static int value_uint64(int token, const char *str, size_t len, uint64_t *out)
+{
+    if (token != TOKEN_STRING && token != TOKEN_NUMBER) {
+        return -1;
+    }
+
+    return parse_uint64(str, len, out);
+}
+
+static int value_uint32(int token, const char *str, size_t len, uint32_t *out)
+{
+    uint64_t val;
+
+    if (value_uint64(token, str, len, &val) != 0 || val > UINT32_MAX) {
+        return -1;
+    }
+
+    *out = (uint32_t) val;
+    return 0;
+}
+
+static int value_double(int token, char *str, size_t len, double *out)
+{
+    char *end;
+
+    if (token == TOKEN_STRING) {
+        if (strcmp(str, "NaN") == 0) {
+            *out = NAN;
+            return 0;
+        }
+        else if (strcmp(str, "Infinity") == 0) {
+            *out = INFINITY;
+            return 0;
+        }
+        else if (strcmp(str, "-Infinity") == 0) {
+            *out = -INFINITY;
+            return 0;
+        }
+    }
+    else if (token != TOKEN_NUMBER) {
+        return -1;
+    }
+
+    if (len == 0) {
+        return -1;
+    }
+
+    *out = strtod(str, &end);
+    if (end != str + len) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/* enums are integers or their proto names */
+static int value_enum(int token, const char *str, size_t len,
+                      const char **names, int count, int *out)
+{
+    int i;
+    int64_t val;
+
+    if (token == TOKEN_NUMBER) {
+        if (parse_int64(str, len, &val) != 0 || val < INT32_MIN || val > INT32_MAX) {
+            return -1;
+        }
+        *out = (int) val;
+        return 0;
+    }
+    else if (token != TOKEN_STRING) {
+        return -1;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (strcmp(str, names[i]) == 0) {
+            *out = i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+static const char *json_span_kinds[] = {
+    "SPAN_KIND_UNSPECIFIED",
+    "SPAN_KIND_INTERNAL",
+    "SPAN_KIND_SERVER",
+    "SPAN_KIND_CLIENT",
+    "SPAN_KIND_PRODUCER",
+    "SPAN_KIND_CONSUMER"
+};
+
+static const char *json_status_codes[] = {
+    "STATUS_CODE_UNSET",
+    "STATUS_CODE_OK",
+    "STATUS_CODE_ERROR"
+};
+
+/* hex ID into 'out' */
+static int value_id(int token, const char *str, size_t len,
+                    unsigned char *out, size_t *out_len)
+{
+    if (token != TOKEN_STRING || len / 2 > JSON_ID_MAX_SIZE) {
+        return -1;
+    }
+
+    if (ctr_base16_decode(str, len, out) != 0) {
+        return -1;
+    }
+
+    *out_len = len / 2;
+    return 0;
+}
+
+static int value_bytes(const char *str, size_t len, struct cfl_variant **out)
+{
+    size_t i;
+    size_t out_len = 0;
+    uint32_t acc = 0;
+    int bits = 0;
+    unsigned char v;
+    unsigned char *buf;
+
+    /* padding is optional */
+    while (len > 0 && str[len - 1] == '=') {
+        len--;
+    }
+
+    buf = malloc(len * 3 / 4 + 1);
+    if (!buf) {
+        ctr_errno();
+        return CTR_DECODE_JSON_ALLOCATION_ERROR;
+    }
+
+    for (i = 0; i < len; i++) {
+        v = json_base64_values[(unsigned char) str[i]];
+        if (v == 0xff) {
+            free(buf);
+            return CTR_DECODE_JSON_INVALID_PAYLOAD;
+        }
+
+        acc = (acc << 6) | v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            buf[out_len++] = (acc >> bits) & 0xff;
+        }
+    }
+
+    *out = cfl_variant_create_from_bytes((char *) buf, out_len, CFL_FALSE);
+    free(buf);
+
+    if (!*out) {
+        return CTR_DECODE_JSON_ALLOCATION_ERROR;
+    }
+
+    return CTR_DECODE_JSON_SUCCESS;
+}
+
+/*
+ * Frames
+ * ------
+ */
+
+static int member_lookup(int frame, const char *name, size_t len)
+{
+    const struct json_member *m;
+
+    for (m = json_members; m->name; m++) {
+        if (m->frame == frame && strncmp(m->name, name, len) == 0 &&
+            m->name[len] == '\0') {
+            return m->field;
+        }
+    }
+
+    return FIELD_UNKNOWN;
+}
+
+static struct json_frame *frame_push(struct ctr_decode_json_stream *dec, int type,
+                                     int is_array, void *target)
+{
+    struct json_frame *frame;
+
+    if (dec->depth >= CTR_DECODE_JSON_MAX_DEPTH) {
+        return NULL;
+    }
+
+    frame = &dec->frames[dec->depth++];
+    frame->type = type;
+    frame->field = FIELD_UNKNOWN;
+    frame->is_array = is_array;
+    frame->target = target;
+    frame->key = NULL;
+    frame->value = NULL;
+
+    return frame;
+}
+
+static void frame_release(struct json_frame *frame)
+{
+    if (frame->key) {
+        cfl_sds_destroy(frame->key);
+        frame->key = NULL;
+    }
+
+    if (frame->value) {
+        cfl_variant_destroy(frame->value);
+        frame->value = NULL;
+    }
+}
+
+/* replace the value of an AnyValue frame */
+static int any_value_set(struct json_frame *frame, struct cfl_variant *var)
+{
+    if (!var) {
+        return CTR_DECODE_JSON_ALLOCATION_ERROR;
+    }
+
+    if (frame->value) {
+        cfl_variant_destroy(frame->value);
+    }
+    frame->value = var;
+
+    return CTR_DECODE_JSON_SUCCESS;
+}
+
+static int link_begin(struct ctrace_span *span, struct ctrace_link **out)
+{
+    struct ctrace_link *link;
+
+    link = ctr_link_create(span, NULL, 0, NULL, 0);
+    if (!link) {
+        return CTR_DECODE_JSON_ALLOCATION_ERROR;
+    }
+
+    link->attr = ctr_attributes_create();
+    if (!link->attr) {
+        return CTR_DECODE_JSON_ALLOCATION_ERROR;
+    }
+
+    *out = link;
+    return CTR_DECODE_JSON_SUCCESS;
+}
+
+static int scope_begin(struct ctrace_scope_span *scope_span,
+                       struct ctrace_instrumentation_scope **out)
+{
+    struct ctrace_attributes *attr;
+    struct ctrace_instrumentation_scope *scope;
+
+    attr = ctr_attributes_create();
+    if (!attr) {
+        return CTR_DECODE_JSON_ALLOCATION_ERROR;
+    }
+
+    scope = ctr_instrumentation_scope_create("", "", 0, attr);
+    if (!scope) {
+        ctr_attributes_destroy(attr);
+        return CTR_DECODE_JSON_ALLOCATION_ERROR;
+    }
+    ctr_scope_span_set_instrumentation_scope(scope_span, scope);
+
+    *out = scope;
+    return CTR_DECODE_JSON_SUCCESS;
+}
+
+/* element of an array frame, every OTLP array holds objects */
+static int element_begin(struct ctr_decode_json_stream *dec, struct json_frame *parent,
+                         int *type, void **target)
+{
+    struct ctrace_span *span;
+    struct ctrace_span_event *event;
+
+    switch (parent->type) {
+        case FRAME_RESOURCE_SPANS:
+            *type = FRAME_RESOURCE_SPAN;
+            *target = ctr_resource_span_create(dec->ctx);
+            break;
+        case FRAME_SCOPE_SPANS:
+            *type = FRAME_SCOPE_SPAN;
+            *target = ctr_scope_span_create(parent->target);
+            break;
+        case FRAME_SPANS:
+            *type = FRAME_SPAN;
+            span = ctr_span_create(dec->ctx, parent->target, "", NULL);
+            if (span) {
+                /* absent fields are zero */
+                ctr_span_clear_defaults(span);
+            }
+            *target = span;
+            break;
+        case FRAME_EVENTS:
+            *type = FRAME_EVENT;
+            event = ctr_span_event_add_ts(parent->target, "", 1);
+            if (event) {
+                event->time_unix_nano = 0;
+            }
+            *target = event;
+            break;
+        case FRAME_LINKS:
+            *type = FRAME_LINK;
+            return link_begin(parent->target, (struct ctrace_link **) target);
+        case FRAME_KEY_VALUES:
+            *type = FRAME_KEY_VALUE;
+            *target = parent->target;
+            return CTR_DECODE_JSON_SUCCESS;
+        case FRAME_VALUES:
+            *type = FRAME_ANY_VALUE;
+            *target = parent->target;
+            return CTR_DECODE_JSON_SUCCESS;
+        default:
+            return CTR_DECODE_JSON_INVALID_PAYLOAD;
+    }
+
+    if (!*target) {
+        return CTR_DECODE_JSON_ALLOCATION_ERROR;
+    }
+
+    return CTR_DECODE_JSON_SUCCESS;
+}
+
+/* object or array value of a member, FRAME_SKIP when the member is unknown */
+static int member_begin(struct json_frame *parent, int is_array, int *type, void **target)
+{
+    int ret;
+    int expect_array = CTR_TRUE;
+    struct cfl_array *array;
+    struct cfl_kvlist *kvlist;
+    struct ctrace_span *span;
+    struct ctrace_resource *resource;
+    struct ctrace_span_event *event;
+    struct ctrace_link *link;
+    struct ctrace_instrumentation_scope *scope;
+
+    *type = FRAME_SKIP;
+    *target = NULL;
+
+    if (parent->field == FIELD_UNKNOWN) {
+        return CTR_DECODE_JSON_SUCCESS;
+    }
+
+    switch (parent->field) {
+        case FIELD_RESOURCE_SPANS:
+            *type = FRAME_RESOURCE_SPANS;
+            break;
+        case FIELD_SCOPE_SPANS:
+            *type = FRAME_SCOPE_SPANS;
+            *target = parent->target;
+            break;
+        case FIELD_SPANS:
+            *type = FRAME_SPANS;
+            *target = parent->target;
+            break;
+        case FIELD_EVENTS:
+            *type = FRAME_EVENTS;
+            *target = parent->target;
+            break;
+        case FIELD_LINKS:
+            *type = FRAME_LINKS;
+            *target = parent->target;
+            break;
+        case FIELD_ATTRIBUTES:
+            *type = FRAME_KEY_VALUES;
+            switch (parent->type) {
+                case FRAME_RESOURCE:
+                    resource = parent->target;
+                    *target = resource->attr->kv;
+                    break;
+                case FRAME_SCOPE:
+                    scope = parent->target;
+                    *target = scope->attr->kv;
+                    break;
+                case FRAME_SPAN:
+                    span = parent->target;
+                    *target = span->attr->kv;
+                    break;
+                case FRAME_EVENT:
+                    event = parent->target;
+                    *target = event->attr->kv;
+                    break;
+                case FRAME_LINK:
+                    link = parent->target;
+                    *target = link->attr->kv;
+                    break;
+            }
+            break;
+        case FIELD_VALUES:
+            if (parent->type == FRAME_ARRAY_VALUE) {
+                *type = FRAME_VALUES;
+            }
+            else {
+                *type = FRAME_KEY_VALUES;
+            }
+            *target = parent->target;
+            break;
+        default:
+            expect_array = CTR_FALSE;
+            break;
+    }
+
+    if (expect_array) {
+        return is_array ? CTR_DECODE_JSON_SUCCESS : CTR_DECODE_JSON_INVALID_PAYLOAD;
+    }
+
+    if (is_array) {
+        return CTR_DECODE_JSON_INVALID_PAYLOAD;
+    }
+
+    switch (parent->field) {
+        case FIELD_RESOURCE:
+            *type = FRAME_RESOURCE;
+            *target = ((struct ctrace_resource_span *) parent->target)->resource;
+            break;
+        case FIELD_SCOPE:
+            *type = FRAME_SCOPE;
+            ret = scope_begin(parent->target, &scope);
+            if (ret != CTR_DECODE_JSON_SUCCESS) {
+                return ret;
+            }
+            *target = scope;
+            break;
+        case FIELD_STATUS:
+            *type = FRAME_STATUS;
+            *target = parent->target;
+            break;
+        case FIELD_VALUE:
+            *type = FRAME_ANY_VALUE;
+            break;
+        case FIELD_ARRAY_VALUE:
+            array = cfl_array_create(8);
+            if (!array) {
+                return CTR_DECODE_JSON_ALLOCATION_ERROR;
+            }
+            cfl_array_resizable(array, CFL_TRUE);
+
+            ret = any_value_set(parent, cfl_variant_create_from_array(array));
+            if (ret != CTR_DECODE_JSON_SUCCESS) {
+                cfl_array_destroy(array);
+                return ret;
+            }
+            *type = FRAME_ARRAY_VALUE;
+            *target = array;
+            break;
+        case FIELD_KVLIST_VALUE:
+            kvlist = cfl_kvlist_create();
+            if (!kvlist) {
+                return CTR_DECODE_JSON_ALLOCATION_ERROR;
+            }
+
+            ret = any_value_set(parent, cfl_variant_create_from_kvlist(kvlist));
+            if (ret != CTR_DECODE_JSON_SUCCESS) {
+                cfl_kvlist_destroy(kvlist);
+                return ret;
+            }
+            *type = FRAME_KVLIST_VALUE;
+            *target = kvlist;
+            break;
+        default:
+            /* scalar member */
+            return CTR_DECODE_JSON_INVALID_PAYLOAD;
+    }
+
+    return CTR_DECODE_JSON_SUCCESS;
+}
+
+static int on_begin(struct ctr_decode_json_stream *dec, int is_array)
+{
+    int ret;
+    int type;
+    void *target = NULL;
+    struct json_frame *parent;
+
+    if (dec->depth == 0) {
+        if (is_array) {
+            return CTR_DECODE_JSON_INVALID_PAYLOAD;
+        }
+
+        dec->ctx = ctr_create(dec->has_opts ? &dec->opts : NULL);
+        if (!dec->ctx) {
+            return CTR_DECODE_JSON_ALLOCATION_ERROR;
+        }
+        type = FRAME_REQUEST;
+    }
+    else {
+        parent = &dec->frames[dec->depth - 1];
+
+        if (parent->type == FRAME_SKIP) {
+            type = FRAME_SKIP;
+        }
+        else if (parent->is_array) {
+            if (is_array) {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+            ret = element_begin(dec, parent, &type, &target);
+            if (ret != CTR_DECODE_JSON_SUCCESS) {
+                return ret;
+            }
+        }
+        else {
+            ret = member_begin(parent, is_array, &type, &target);
+            if (ret != CTR_DECODE_JSON_SUCCESS) {
+                return ret;
+            }
+        }
+    }
+
+    if (!frame_push(dec, type, is_array, target)) {
+        return CTR_DECODE_JSON_INVALID_PAYLOAD;
+    }
+
+    return CTR_DECODE_JSON_SUCCESS;
+}
+
+static int on_end(struct ctr_decode_json_stream *dec)
+{
+    int ret = CTR_DECODE_JSON_SUCCESS;
+    struct json_frame *frame;
+    struct json_frame *parent = NULL;
+
+    frame = &dec->frames[--dec->depth];
+    if (dec->depth > 0) {
+        parent = &dec->frames[dec->depth - 1];
+    }
+
+    if (frame->type == FRAME_KEY_VALUE && frame->key && frame->value) {
+        if (cfl_kvlist_insert_s(frame->target, frame->key, cfl_sds_len(frame->key),
+                                frame->value) != 0) {
+            ret = CTR_DECODE_JSON_ALLOCATION_ERROR;
+        }
+        else {
+            frame->value = NULL;
+        }
+    }
+    else if (frame->type == FRAME_ANY_VALUE && frame->value) {
+        /* an empty AnyValue is dropped */
+        if (parent->type == FRAME_KEY_VALUE) {
+            if (parent->value) {
+                cfl_variant_destroy(parent->value);
+            }
+            parent->value = frame->value;
+            frame->value = NULL;
+        }
+        else if (cfl_array_append(frame->target, frame->value) != 0) {
+            ret = CTR_DECODE_JSON_ALLOCATION_ERROR;
+        }
+        else {
+            frame->value = NULL;
+        }
+    }
+
+    frame_release(frame);
+
+    return ret;
+}
+
+static int on_key(struct ctr_decode_json_stream *dec)
+{
+    struct json_frame *frame;
+
+    frame = &dec->frames[dec->depth - 1];
+    if (frame->type != FRAME_SKIP) {
+        frame->field = member_lookup(frame->type, dec->tok, dec->tok_len);
+    }
+
+    return CTR_DECODE_JSON_SUCCESS;
+}
+
+static int span_member(struct json_frame *frame, int token, char *str, size_t len)
+{
+    int ret = 0;
+    int kind;
+    size_t id_len;
+    uint32_t u32;
+    unsigned char id[JSON_ID_MAX_SIZE];
+    struct ctrace_span *span;
+
+    span = frame->target;
+
+    switch (frame->field) {
+        case FIELD_TRACE_ID:
+        case FIELD_SPAN_ID:
+        case FIELD_PARENT_SPAN_ID:
+            if (token == TOKEN_STRING && len == 0) {
+                break;
+            }
+            if (value_id(token, str, len, id, &id_len) != 0) {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+
+            if (frame->field == FIELD_TRACE_ID) {
+                ret = ctr_span_set_trace_id(span, id, id_len);
+            }
+            else if (frame->field == FIELD_SPAN_ID) {
+                ret = ctr_span_set_span_id(span, id, id_len);
+            }
+            else {
+                ret = ctr_span_set_parent_span_id(span, id, id_len);
+            }
+            break;
+        case FIELD_TRACE_STATE:
+            if (token != TOKEN_STRING) {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+            ret = ctr_span_set_trace_state(span, str, len);
+            break;
+        case FIELD_NAME:
+            if (token != TOKEN_STRING) {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+            ret = ctr_span_set_name(span, str, len);
+            break;
+        case FIELD_FLAGS:
+            if (value_uint32(token, str, len, &u32) != 0) {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+            span->flags = (int32_t) u32;
+            break;
+        case FIELD_KIND:
+            if (value_enum(token, str, len, json_span_kinds,
+                           sizeof(json_span_kinds) / sizeof(char *), &kind) != 0) {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+            span->kind = kind;
+            break;
+        case FIELD_START_TIME:
+            if (value_uint64(token, str, len, &span->start_time_unix_nano) != 0) {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+            break;
+        case FIELD_END_TIME:
+            if (value_uint64(token, str, len, &span->end_time_unix_nano) != 0) {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+            break;
+        case FIELD_DROPPED_ATTR:
+            if (value_uint32(token, str, len, &span->dropped_attr_count) != 0) {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+            break;
+        case FIELD_DROPPED_EVENTS:
+            if (value_uint32(token, str, len, &span->dropped_events_count) != 0) {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+            break;
+        case FIELD_DROPPED_LINKS:
+            if (value_uint32(token, str, len, &span->dropped_links_count) != 0) {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+            break;
+        case FIELD_UNKNOWN:
+            break;
+        default:
+            return CTR_DECODE_JSON_INVALID_PAYLOAD;
+    }
+
+    if (ret != 0) {
+        return CTR_DECODE_JSON_ALLOCATION_ERROR;
+    }
+
+    return CTR_DECODE_JSON_SUCCESS;
+}
+
+static int link_member(struct json_frame *frame, int token, char *str, size_t len)
+{
+    int ret = 0;
+    size_t id_len;
+    unsigned char id[JSON_ID_MAX_SIZE];
+    struct ctrace_link *link;
+
+    link = frame->target;
+
+    switch (frame->field) {
+        case FIELD_TRACE_ID:
+        case FIELD_SPAN_ID:
+            if (token == TOKEN_STRING && len == 0) {
+                break;
+            }
+            if (value_id(token, str, len, id, &id_len) != 0) {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+
+            if (frame->field == FIELD_TRACE_ID) {
+                ret = ctr_link_set_trace_id(link, id, id_len);
+            }
+            else {
+                ret = ctr_link_set_span_id(link, id, id_len);
+            }
+            break;
+        case FIELD_TRACE_STATE:
+            if (token != TOKEN_STRING) {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+            ret = ctr_link_set_trace_state(link, str);
+            break;
+        case FIELD_DROPPED_ATTR:
+            if (value_uint32(token, str, len, &link->dropped_attr_count) != 0) {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+            break;
+        case FIELD_FLAGS:
+            if (value_uint32(token, str, len, &link->flags) != 0) {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+            break;
+        case FIELD_UNKNOWN:
+            break;
+        default:
+            return CTR_DECODE_JSON_INVALID_PAYLOAD;
+    }
+
+    if (ret != 0) {
+        return CTR_DECODE_JSON_ALLOCATION_ERROR;
+    }
+
+    return CTR_DECODE_JSON_SUCCESS;
+}
+
+static int any_value_member(struct json_frame *frame, int token, char *str, size_t len)
+{
+    int ret;
+    double d;
+    int64_t i64;
+    struct cfl_variant *var;
+
+    switch (frame->field) {
+        case FIELD_STRING_VALUE:
+            if (token != TOKEN_STRING) {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+            return any_value_set(frame, cfl_variant_create_from_string_s(str, len,
+                                                                         CFL_FALSE));
+        case FIELD_BOOL_VALUE:
+            if (token != TOKEN_TRUE && token != TOKEN_FALSE) {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+            return any_value_set(frame, cfl_variant_create_from_bool(token == TOKEN_TRUE));
+        case FIELD_INT_VALUE:
+            if ((token != TOKEN_STRING && token != TOKEN_NUMBER) ||
+                parse_int64(str, len, &i64) != 0) {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+            return any_value_set(frame, cfl_variant_create_from_int64(i64));
+        case FIELD_DOUBLE_VALUE:
+            if (value_double(token, str, len, &d) != 0) {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+            return any_value_set(frame, cfl_variant_create_from_double(d));
+        case FIELD_BYTES_VALUE:
+            if (token != TOKEN_STRING) {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+            ret = value_bytes(str, len, &var);
+            if (ret != CTR_DECODE_JSON_SUCCESS) {
+                return ret;
+            }
+            return any_value_set(frame, var);
+        case FIELD_UNKNOWN:
+            return CTR_DECODE_JSON_SUCCESS;
+    }
+
+    return CTR_DECODE_JSON_INVALID_PAYLOAD;
+}
+
+static int on_scalar(struct ctr_decode_json_stream *dec, int token, char *str, size_t len)
+{
+    int ret = 0;
+    int code;
+    struct json_frame *frame;
+    struct ctrace_span *span;
+    struct ctrace_span_event *event;
+    struct ctrace_instrumentation_scope *scope;
+    cfl_sds_t tmp;
+
+    /* the document must be an object */
+    if (dec->depth == 0) {
+        return CTR_DECODE_JSON_INVALID_PAYLOAD;
+    }
+
+    frame = &dec->frames[dec->depth - 1];
+    if (frame->type == FRAME_SKIP) {
+        return CTR_DECODE_JSON_SUCCESS;
+    }
+
+    if (frame->is_array) {
+        return CTR_DECODE_JSON_INVALID_PAYLOAD;
+    }
+
+    /* null is the same as an absent member */
+    if (token == TOKEN_NULL || frame->field == FIELD_UNKNOWN) {
+        return CTR_DECODE_JSON_SUCCESS;
+    }
+
+    switch (frame->type) {
+        case FRAME_SPAN:
+            return span_member(frame, token, str, len);
+        case FRAME_LINK:
+            return link_member(frame, token, str, len);
+        case FRAME_ANY_VALUE:
+            return any_value_member(frame, token, str, len);
+        case FRAME_RESOURCE_SPAN:
+            if (frame->field != FIELD_SCHEMA_URL || token != TOKEN_STRING) {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+            ret = ctr_resource_span_set_schema_url(frame->target, str);
+            break;
+        case FRAME_SCOPE_SPAN:
+            if (frame->field != FIELD_SCHEMA_URL || token != TOKEN_STRING) {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+            ret = ctr_scope_span_set_schema_url(frame->target, str);
+            break;
+        case FRAME_RESOURCE:
+            if (frame->field != FIELD_DROPPED_ATTR ||
+                value_uint32(token, str, len,
+                             &((struct ctrace_resource *) frame->target)->dropped_attr_count) != 0) {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+            break;
+        case FRAME_SCOPE:
+            scope = frame->target;
+            if (frame->field == FIELD_DROPPED_ATTR) {
+                if (value_uint32(token, str, len, &scope->dropped_attr_count) != 0) {
+                    return CTR_DECODE_JSON_INVALID_PAYLOAD;
+                }
+                break;
+            }
+
+            if (token != TOKEN_STRING ||
+                (frame->field != FIELD_NAME && frame->field != FIELD_VERSION)) {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+
+            tmp = cfl_sds_create_len(str, len);
+            if (!tmp) {
+                return CTR_DECODE_JSON_ALLOCATION_ERROR;
+            }
+
+            if (frame->field == FIELD_NAME) {
+                cfl_sds_destroy(scope->name);
+                scope->name = tmp;
+            }
+            else {
+                cfl_sds_destroy(scope->version);
+                scope->version = tmp;
+            }
+            break;
+        case FRAME_EVENT:
+            event = frame->target;
+            if (frame->field == FIELD_TIME) {
+                if (value_uint64(token, str, len, &event->time_unix_nano) != 0) {
+                    return CTR_DECODE_JSON_INVALID_PAYLOAD;
+                }
+            }
+            else if (frame->field == FIELD_NAME && token == TOKEN_STRING) {
+                ret = ctr_span_event_set_name(event, str, len);
+            }
+            else if (frame->field == FIELD_DROPPED_ATTR) {
+                if (value_uint32(token, str, len, &event->dropped_attr_count) != 0) {
+                    return CTR_DECODE_JSON_INVALID_PAYLOAD;
+                }
+            }
+            else {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+            break;
+        case FRAME_STATUS:
+            span = frame->target;
+            if (frame->field == FIELD_MESSAGE && token == TOKEN_STRING) {
+                ret = ctr_span_set_status(span, span->status.code, str);
+            }
+            else if (frame->field == FIELD_CODE) {
+                if (value_enum(token, str, len, json_status_codes,
+                               sizeof(json_status_codes) / sizeof(char *), &code) != 0) {
+                    return CTR_DECODE_JSON_INVALID_PAYLOAD;
+                }
+                span->status.code = code;
+            }
+            else {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+            break;
+        case FRAME_KEY_VALUE:
+            if (frame->field != FIELD_KEY || token != TOKEN_STRING) {
+                return CTR_DECODE_JSON_INVALID_PAYLOAD;
+            }
+
+            tmp = cfl_sds_create_len(str, len);
+            if (!tmp) {
+                return CTR_DECODE_JSON_ALLOCATION_ERROR;
+            }
+            if (frame->key) {
+                cfl_sds_destroy(frame->key);
+            }
+            frame->key = tmp;
+            break;
+        default:
+            return CTR_DECODE_JSON_INVALID_PAYLOAD;
+    }
+
+    if (ret != 0) {
+        return CTR_DECODE_JSON_ALLOCATION_ERROR;
+    }
+
+    return CTR_DECODE_JSON_SUCCESS;
+}
+
+/*
+ * Tokenizer
+ * ---------
+ */
+
+/* -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)? */
+static int number_valid(const char *str, size_t len)
+{
+    size_t i = 0;
+    size_t start;
+
+    if (i < len && str[i] == '-') {
+        i++;
+    }
+
+    if (i < len && str[i] == '0') {
+        i++;
+    }
+    else {
+        start = i;
+        while (i < len && str[i] >= '0' && str[i] <= '9') {
+            i++;
+        }
+        if (i == start) {
+            return CTR_FALSE;
+        }
+    }
+
+    if (i < len && str[i] == '.') {
+        start = ++i;
+        while (i < len && str[i] >= '0' && str[i] <= '9') {
+            i++;
+        }
+        if (i == start) {
+            return CTR_FALSE;
+        }
+    }
+
+    if (i < len && (str[i] == 'e' || str[i] == 'E')) {
+        i++;
+        if (i < len && (str[i] == '+' || str[i] == '-')) {
+            i++;
+        }
+        start = i;
+        while (i < len && str[i] >= '0' && str[i] <= '9') {
+            i++;
+        }
+        if (i == start) {
+            return CTR_FALSE;
+        }
+    }
+
+    return i == len;
+}
+
+static void after_value(struct ctr_decode_json_stream *dec)
+{
+    if (dec->depth == 0) {
+        dec->expect = EXPECT_DONE;
+    }
+    else {
+        dec->expect = EXPECT_COMMA_OR_END;
+    }
+}
+
+static int scalar_end(struct ctr_decode_json_stream *dec, int token)
+{
+    int ret;
+
+    dec->tok[dec->tok_len] = '\0';
+
+    ret = on_scalar(dec, token, dec->tok, dec->tok_len);
+    if (ret != CTR_DECODE_JSON_SUCCESS) {
+        return ret;
+    }
+
+    after_value(dec);
+    return CTR_DECODE_JSON_SUCCESS;
+}
+
+static int string_end(struct ctr_decode_json_stream *dec)
+{
+    int ret;
+
+    if (dec->surrogate) {
+        return CTR_DECODE_JSON_CORRUPTED_DATA;
+    }
+
+    dec->lex = LEX_NONE;
+
+    if (!dec->is_key) {
+        return scalar_end(dec, TOKEN_STRING);
+    }
+
+    dec->tok[dec->tok_len] = '\0';
+
+    ret = on_key(dec);
+    dec->expect = EXPECT_COLON;
+
+    return ret;
+}
+
+static int unicode_end(struct ctr_decode_json_stream *dec)
+{
+    uint32_t cp;
+    unsigned char bytes[2];
+
+    if (ctr_base16_decode(dec->unicode, sizeof(dec->unicode), bytes) != 0) {
+        return CTR_DECODE_JSON_CORRUPTED_DATA;
+    }
+    cp = (bytes[0] << 8) | bytes[1];
+
+    if (dec->surrogate) {
+        if (cp < 0xdc00 || cp > 0xdfff) {
+            return CTR_DECODE_JSON_CORRUPTED_DATA;
+        }
+        cp = 0x10000 + ((dec->surrogate - 0xd800) << 10) + (cp - 0xdc00);
+        dec->surrogate = 0;
+    }
+    else if (cp >= 0xd800 && cp <= 0xdbff) {
+        /* the low half must follow as another escape */
+        dec->surrogate = cp;
+        return CTR_DECODE_JSON_SUCCESS;
+    }
+    else if (cp >= 0xdc00 && cp <= 0xdfff) {
+        return CTR_DECODE_JSON_CORRUPTED_DATA;
+    }
+
+    if (token_append_utf8(dec, cp) != 0) {
+        return CTR_DECODE_JSON_ALLOCATION_ERROR;
+    }
+
+    return CTR_DECODE_JSON_SUCCESS;
+}
+
+static int escape_char(char c)
+{
+    switch (c) {
+        case '"':
+            return '"';
+        case '\\':
+            return '\\';
+        case '/':
+            return '/';
+        case 'b':
+            return '\b';
+        case 'f':
+            return '\f';
+        case 'n':
+            return '\n';
+        case 'r':
+            return '\r';
+        case 't':
+            return '\t';
+    }
+
+    return -1;
+}
+
+static int structural(struct ctr_decode_json_stream *dec, char c)
+{
+    int ret;
+    int expect;
+    int is_array;
+    struct json_frame *frame;
+
+    expect = dec->expect;
+
+    switch (c) {
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+            return CTR_DECODE_JSON_SUCCESS;
+        case '{':
+        case '[':
+            if (expect != EXPECT_VALUE && expect != EXPECT_VALUE_OR_END) {
+                return CTR_DECODE_JSON_CORRUPTED_DATA;
+            }
+
+            is_array = (c == '[');
+            ret = on_begin(dec, is_array);
+            if (ret != CTR_DECODE_JSON_SUCCESS) {
+                return ret;
+            }
+            dec->expect = is_array ? EXPECT_VALUE_OR_END : EXPECT_KEY_OR_END;
+            return CTR_DECODE_JSON_SUCCESS;
+        case '}':
+        case ']':
+            if (dec->depth == 0) {
+                return CTR_DECODE_JSON_CORRUPTED_DATA;
+            }
+
+            frame = &dec->frames[dec->depth - 1];
+            is_array = (c == ']');
+            if (frame->is_array != is_array) {
+                return CTR_DECODE_JSON_CORRUPTED_DATA;
+            }
+
+            if (expect != EXPECT_COMMA_OR_END &&
+                expect != (is_array ? EXPECT_VALUE_OR_END : EXPECT_KEY_OR_END)) {
+                return CTR_DECODE_JSON_CORRUPTED_DATA;
+            }
+
+            ret = on_end(dec);
+            if (ret != CTR_DECODE_JSON_SUCCESS) {
+                return ret;
+            }
+            after_value(dec);
+            return CTR_DECODE_JSON_SUCCESS;
+        case ':':
+            if (expect != EXPECT_COLON) {
+                return CTR_DECODE_JSON_CORRUPTED_DATA;
+            }
+            dec->expect = EXPECT_VALUE;
+            return CTR_DECODE_JSON_SUCCESS;
+        case ',':
+            if (expect != EXPECT_COMMA_OR_END) {
+                return CTR_DECODE_JSON_CORRUPTED_DATA;
+            }
+            frame = &dec->frames[dec->depth - 1];
+            dec->expect = frame->is_array ? EXPECT_VALUE : EXPECT_KEY;
+            return CTR_DECODE_JSON_SUCCESS;
+        case '"':
+            if (expect == EXPECT_KEY || expect == EXPECT_KEY_OR_END) {
+                dec->is_key = CTR_TRUE;
+            }
+            else if (expect == EXPECT_VALUE || expect == EXPECT_VALUE_OR_END) {
+                dec->is_key = CTR_FALSE;
+            }
+            else {
+                return CTR_DECODE_JSON_CORRUPTED_DATA;
+            }
+            dec->lex = LEX_STRING;
+            dec->tok_len = 0;
+            return CTR_DECODE_JSON_SUCCESS;
+    }
+
+    if (expect != EXPECT_VALUE && expect != EXPECT_VALUE_OR_END) {
+        return CTR_DECODE_JSON_CORRUPTED_DATA;
+    }
+
+    if (c == '-' || (c >= '0' && c <= '9')) {
+        dec->lex = LEX_NUMBER;
+        dec->tok_len = 0;
+        if (token_append(dec, &c, 1) != 0) {
+            return CTR_DECODE_JSON_ALLOCATION_ERROR;
+        }
+        return CTR_DECODE_JSON_SUCCESS;
+    }
+
+    if (c == 't') {
+        dec->literal = "true";
+        dec->literal_token = TOKEN_TRUE;
+    }
+    else if (c == 'f') {
+        dec->literal = "false";
+        dec->literal_token = TOKEN_FALSE;
+    }
+    else if (c == 'n') {
+        dec->literal = "null";
+        dec->literal_token = TOKEN_NULL;
+    }
+    else {
+        return CTR_DECODE_JSON_CORRUPTED_DATA;
+    }
+
+    dec->lex = LEX_LITERAL;
+    dec->literal_pos = 1;
+
+    return CTR_DECODE_JSON_SUCCESS;
+}
+
+/* consume bytes until the buffer ends or a document is complete */
+static int json_feed(struct ctr_decode_json_stream *dec, const char *buf, size_t len,
+                     size_t *consumed)
+{
+    int ret = CTR_DECODE_JSON_SUCCESS;
+    int esc;
+    size_t i;
+    size_t start;
+    unsigned char c;
+
+    for (i = 0; i < len && ret == CTR_DECODE_JSON_SUCCESS; i++) {
+        c = buf[i];
+
+        switch (dec->lex) {
+            case LEX_STRING:
+                /* copy the run up to the next quote, escape or control byte */
+                start = i;
+                while (i < len && buf[i] != '"' && buf[i] != '\\' &&
+                       (unsigned char) buf[i] >= 0x20) {
+                    i++;
+                }
+
+                if (i > start) {
+                    if (dec->surrogate) {
+                        ret = CTR_DECODE_JSON_CORRUPTED_DATA;
+                        break;
+                    }
+                    if (token_append(dec, buf + start, i - start) != 0) {
+                        ret = CTR_DECODE_JSON_ALLOCATION_ERROR;
+                        break;
+                    }
+                }
+
+                if (i == len) {
+                    break;
+                }
+
+                if (buf[i] == '"') {
+                    ret = string_end(dec);
+                }
+                else if (buf[i] == '\\') {
+                    dec->lex = LEX_ESCAPE;
+                }
+                else {
+                    ret = CTR_DECODE_JSON_CORRUPTED_DATA;
+                }
+                break;
+            case LEX_ESCAPE:
+                if (c == 'u') {
+                    dec->lex = LEX_UNICODE;
+                    dec->unicode_count = 0;
+                    break;
+                }
+
+                esc = escape_char(c);
+                if (esc < 0 || dec->surrogate) {
+                    ret = CTR_DECODE_JSON_CORRUPTED_DATA;
+                    break;
+                }
+
+                c = esc;
+                if (token_append(dec, (char *) &c, 1) != 0) {
+                    ret = CTR_DECODE_JSON_ALLOCATION_ERROR;
+                    break;
+                }
+                dec->lex = LEX_STRING;
+                break;
+            case LEX_UNICODE:
+                dec->unicode[dec->unicode_count++] = c;
+                if (dec->unicode_count == 4) {
+                    dec->lex = LEX_STRING;
+                    ret = unicode_end(dec);
+                }
+                break;
+            case LEX_LITERAL:
+                if (c != dec->literal[dec->literal_pos]) {
+                    ret = CTR_DECODE_JSON_CORRUPTED_DATA;
+                    break;
+                }
+
+                if (dec->literal[++dec->literal_pos] == '\0') {
+                    dec->lex = LEX_NONE;
+                    dec->tok_len = 0;
+                    ret = scalar_end(dec, dec->literal_token);
+                }
+                break;
+            case LEX_NUMBER:
+                if ((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' ||
+                    c == '+' || c == '-') {
+                    if (token_append(dec, (char *) &c, 1) != 0) {
+                        ret = CTR_DECODE_JSON_ALLOCATION_ERROR;
+                    }
+                    break;
+                }
+
+                /* the byte ending the number is parsed as structure */
+                dec->lex = LEX_NONE;
+                if (!number_valid(dec->tok, dec->tok_len)) {
+                    ret = CTR_DECODE_JSON_CORRUPTED_DATA;
+                    break;
+                }
+
+                ret = scalar_end(dec, TOKEN_NUMBER);
+                if (ret != CTR_DECODE_JSON_SUCCESS) {
+                    break;
+                }
+                ret = structural(dec, c);
+                break;
+            default:
+                ret = structural(dec, c);
+                break;
+        }
+
+        if (ret == CTR_DECODE_JSON_SUCCESS && dec->expect == EXPECT_DONE) {
+            *consumed = i + 1;
+            return CTR_DECODE_JSON_SUCCESS;
+        }
+    }
+
+    if (ret != CTR_DECODE_JSON_SUCCESS) {
+        return ret;
+    }
+
+    *consumed = len;
+    return CTR_DECODE_JSON_INSUFFICIENT_DATA;
+}
+
+static void stream_reset(struct ctr_decode_json_stream *dec)
+{
+    while (dec->depth > 0) {
+        frame_release(&dec->frames[--dec->depth]);
+    }
+
+    if (dec->ctx) {
+        ctr_destroy(dec->ctx);
+        dec->ctx = NULL;
+    }
+
+    dec->lex = LEX_NONE;
+    dec->expect = EXPECT_VALUE;
+    dec->tok_len = 0;
+    dec->surrogate = 0;
+}
+
+struct ctr_decode_json_stream *ctr_decode_json_stream_create(struct ctrace_opts *opts)
+{
+    struct ctr_decode_json_stream *dec;
+
+    dec = calloc(1, sizeof(struct ctr_decode_json_stream));
+    if (!dec) {
+        ctr_errno();
+        return NULL;
+    }
+
+    if (opts) {
+        dec->opts = *opts;
+        dec->has_opts = CTR_TRUE;
+    }
+
+    /* empty tokens still get their terminator */
+    if (token_reserve(dec, 0) != 0) {
+        free(dec);
+        return NULL;
+    }
+
+    stream_reset(dec);
+
+    return dec;
+}
+
+void ctr_decode_json_stream_destroy(struct ctr_decode_json_stream *stream)
+{
+    stream_reset(stream);
+    free(stream->tok);
+    free(stream);
+}
+
+int ctr_decode_json_stream_next(struct ctr_decode_json_stream *stream,
+                                struct ctrace **out_context,
+                                char *in_buf, size_t in_size, size_t *offset)
+{
+    int ret;
+    size_t consumed = 0;
+
+    if (!stream || !out_context || !offset || *offset > in_size) {
+        return CTR_DECODE_JSON_INVALID_ARGUMENT;
+    }
+
+    if (stream->error) {
+        return stream->error;
+    }
+
+    ret = json_feed(stream, in_buf + *offset, in_size - *offset, &consumed);
+    *offset += consumed;
+
+    if (ret == CTR_DECODE_JSON_SUCCESS) {
+        *out_context = stream->ctx;
+        stream->ctx = NULL;
+        stream_reset(stream);
+    }
+    else if (ret != CTR_DECODE_JSON_INSUFFICIENT_DATA) {
+        stream->error = ret;
+    }
+
+    return ret;
+}
+
+int ctr_decode_json_create_with_opts(struct ctrace **out_context, struct ctrace_opts *opts,
+                                     char *in_buf, size_t in_size, size_t *offset)
+{
+    int ret;
+    size_t consumed = 0;
+    struct ctr_decode_json_stream *dec;
+
+    if (!out_context || !offset || *offset > in_size) {
+        return CTR_DECODE_JSON_INVALID_ARGUMENT;
+    }
+
+    dec = ctr_decode_json_stream_create(opts);
+    if (!dec) {
+        return CTR_DECODE_JSON_ALLOCATION_ERROR;
+    }
+
+    ret = json_feed(dec, in_buf + *offset, in_size - *offset, &consumed);
+    if (ret == CTR_DECODE_JSON_SUCCESS) {
+        *offset += consumed;
+        *out_context = dec->ctx;
+        dec->ctx = NULL;
+    }
+
+    ctr_decode_json_stream_destroy(dec);
+
+    return ret;
+}
+
+int ctr_decode_json_create(struct ctrace **out_context, char *in_buf, size_t in_size,
+                           size_t *offset)
+{
+    return ctr_decode_json_create_with_opts(out_context, NULL, in_buf, in_size, offset);
+}
+
+void ctr_decode_json_destroy(struct ctrace *context)
+{
+    ctr_destroy(context);
+}
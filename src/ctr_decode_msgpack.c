@@ -179,14 +179,24 @@ static int unpack_scope_span_instrumentation_scope(mpack_reader_t *reader, size_
 static int unpack_event_name(mpack_reader_t *reader, size_t index, void *ctx)
 {
     struct ctr_msgpack_decode_context *context = ctx;
+    const char                        *value;
+    size_t                             length;
+    int                                result;
 
-    if (context->event->name != NULL) {
-        cfl_sds_destroy(context->event->name);
+    result = ctr_mpack_consume_string_or_nil_tag_inplace(reader, &value, &length);
 
-        context->event->name = NULL;
+    if (result != CTR_MPACK_SUCCESS) {
+        return result;
     }
 
-    return ctr_mpack_consume_string_or_nil_tag(reader, &context->event->name);
+    /* read in place, the name is interned or copied by the context */
+    result = ctr_span_event_set_name(context->event, (char *) value, length);
+
+    if (result != 0) {
+        return CTR_DECODE_MSGPACK_ALLOCATION_ERROR;
+    }
+
+    return CTR_MPACK_SUCCESS;
 }
 
 static int unpack_event_time_unix_nano(mpack_reader_t *reader, size_t index, void *ctx)
@@ -253,15 +263,23 @@ static int unpack_event(mpack_reader_t *reader, size_t index, void *ctx)
 static int unpack_link_trace_id(mpack_reader_t *reader, size_t index, void *ctx)
 {
     struct ctr_msgpack_decode_context *context = ctx;
+    struct ctrace_id                   decoded_id;
     int                                result;
     cfl_sds_t                          value;
 
     result = ctr_mpack_consume_string_or_nil_tag(reader, &value);
 
     if (result == CTR_MPACK_SUCCESS && value != NULL) {
-        context->link->trace_id = ctr_id_from_base16(value);
+        ctr_id_init(&decoded_id, NULL);
+
+        if (ctr_id_set_base16(&decoded_id, value, cfl_sds_len(value)) == 0) {
+            ctr_link_set_trace_id(context->link,
+                                  ctr_id_get_buf(&decoded_id),
+                                  ctr_id_get_len(&decoded_id));
 
-        if (context->link->trace_id == NULL) {
+            ctr_id_reset(&decoded_id);
+        }
+        else {
             result = CTR_MPACK_CORRUPT_INPUT_DATA_ERROR;
         }
 
@@ -274,15 +292,23 @@ static int unpack_link_trace_id(mpack_reader_t *reader, size_t index, void *ctx)
 static int unpack_link_span_id(mpack_reader_t *reader, size_t index, void *ctx)
 {
     struct ctr_msgpack_decode_context *context = ctx;
+    struct ctrace_id                   decoded_id;
     int                                result;
     cfl_sds_t                          value;
 
     result = ctr_mpack_consume_string_or_nil_tag(reader, &value);
 
     if (result == CTR_MPACK_SUCCESS && value != NULL) {
-        context->link->span_id = ctr_id_from_base16(value);
+        ctr_id_init(&decoded_id, NULL);
 
-        if (context->link->span_id == NULL) {
+        if (ctr_id_set_base16(&decoded_id, value, cfl_sds_len(value)) == 0) {
+            ctr_link_set_span_id(context->link,
+                                 ctr_id_get_buf(&decoded_id),
+                                 ctr_id_get_len(&decoded_id));
+
+            ctr_id_reset(&decoded_id);
+        }
+        else {
             result = CTR_MPACK_CORRUPT_INPUT_DATA_ERROR;
         }
 
@@ -296,7 +322,14 @@ static int unpack_link_trace_state(mpack_reader_t *reader, size_t index, void *c
 {
     struct ctr_msgpack_decode_context *context = ctx;
 
-    return ctr_mpack_consume_string_or_nil_tag(reader, &context->link->trace_state);
+    if (context->link->trace_state != NULL) {
+        ctr_arena_sds_destroy(context->trace->arena, context->link->trace_state);
+
+        context->link->trace_state = NULL;
+    }
+
+    return ctr_mpack_consume_string_or_nil_tag_arena(reader, context->trace->arena,
+                                                     &context->link->trace_state);
 }
 
 static int unpack_link_dropped_attributes_count(mpack_reader_t *reader, size_t index, void *ctx)
@@ -366,19 +399,19 @@ static int unpack_link(mpack_reader_t *reader, size_t index, void *ctx)
 static int unpack_span_trace_id(mpack_reader_t *reader, size_t index, void *ctx)
 {
     struct ctr_msgpack_decode_context *context = ctx;
-    struct ctrace_id                  *decoded_id;
+    struct ctrace_id                   decoded_id;
     int                                result;
     cfl_sds_t                          value;
 
     result = ctr_mpack_consume_string_or_nil_tag(reader, &value);
 
     if (result == CTR_MPACK_SUCCESS && value != NULL) {
-        decoded_id = ctr_id_from_base16(value);
+        ctr_id_init(&decoded_id, NULL);
 
-        if (decoded_id != NULL) {
-            ctr_span_set_trace_id_with_cid(context->span, decoded_id);
+        if (ctr_id_set_base16(&decoded_id, value, cfl_sds_len(value)) == 0) {
+            ctr_span_set_trace_id_with_cid(context->span, &decoded_id);
 
-            ctr_id_destroy(decoded_id);
+            ctr_id_reset(&decoded_id);
         }
         else {
             result = CTR_MPACK_CORRUPT_INPUT_DATA_ERROR;
@@ -393,19 +426,19 @@ static int unpack_span_trace_id(mpack_reader_t *reader, size_t index, void *ctx)
 static int unpack_span_span_id(mpack_reader_t *reader, size_t index, void *ctx)
 {
     struct ctr_msgpack_decode_context *context = ctx;
-    struct ctrace_id                  *decoded_id;
+    struct ctrace_id                   decoded_id;
     int                                result;
     cfl_sds_t                          value;
 
     result = ctr_mpack_consume_string_or_nil_tag(reader, &value);
 
     if (result == CTR_MPACK_SUCCESS && value != NULL) {
-        decoded_id = ctr_id_from_base16(value);
+        ctr_id_init(&decoded_id, NULL);
 
-        if (decoded_id != NULL) {
-            ctr_span_set_span_id_with_cid(context->span, decoded_id);
+        if (ctr_id_set_base16(&decoded_id, value, cfl_sds_len(value)) == 0) {
+            ctr_span_set_span_id_with_cid(context->span, &decoded_id);
 
-            ctr_id_destroy(decoded_id);
+            ctr_id_reset(&decoded_id);
         }
         else {
             result = CTR_MPACK_CORRUPT_INPUT_DATA_ERROR;
@@ -420,19 +453,19 @@ static int unpack_span_span_id(mpack_reader_t *reader, size_t index, void *ctx)
 static int unpack_span_parent_span_id(mpack_reader_t *reader, size_t index, void *ctx)
 {
     struct ctr_msgpack_decode_context *context = ctx;
-    struct ctrace_id                  *decoded_id;
+    struct ctrace_id                   decoded_id;
     int                                result;
     cfl_sds_t                          value;
 
     result = ctr_mpack_consume_string_or_nil_tag(reader, &value);
 
     if (result == CTR_MPACK_SUCCESS && value != NULL) {
-        decoded_id = ctr_id_from_base16(value);
+        ctr_id_init(&decoded_id, NULL);
 
-        if (decoded_id != NULL) {
-            ctr_span_set_parent_span_id_with_cid(context->span, decoded_id);
+        if (ctr_id_set_base16(&decoded_id, value, cfl_sds_len(value)) == 0) {
+            ctr_span_set_parent_span_id_with_cid(context->span, &decoded_id);
 
-            ctr_id_destroy(decoded_id);
+            ctr_id_reset(&decoded_id);
         }
         else {
             result = CTR_MPACK_CORRUPT_INPUT_DATA_ERROR;
@@ -449,25 +482,36 @@ static int unpack_span_trace_state(mpack_reader_t *reader, size_t index, void *c
     struct ctr_msgpack_decode_context *context = ctx;
 
     if (context->span->trace_state != NULL) {
-        cfl_sds_destroy(context->span->trace_state);
+        ctr_arena_sds_destroy(context->trace->arena, context->span->trace_state);
 
         context->span->trace_state = NULL;
     }
 
-    return ctr_mpack_consume_string_or_nil_tag(reader, &context->span->trace_state);
+    return ctr_mpack_consume_string_or_nil_tag_arena(reader, context->trace->arena,
+                                                     &context->span->trace_state);
 }
 
 static int unpack_span_name(mpack_reader_t *reader, size_t index, void *ctx)
 {
     struct ctr_msgpack_decode_context *context = ctx;
+    const char                        *value;
+    size_t                             length;
+    int                                result;
+
+    result = ctr_mpack_consume_string_or_nil_tag_inplace(reader, &value, &length);
+
+    if (result != CTR_MPACK_SUCCESS) {
+        return result;
+    }
 
-    if (context->span->name != NULL) {
-        cfl_sds_destroy(context->span->name);
+    /* read in place, the name is interned or copied by the context */
+    result = ctr_span_set_name(context->span, (char *) value, length);
 
-        context->span->name = NULL;
+    if (result != 0) {
+        return CTR_DECODE_MSGPACK_ALLOCATION_ERROR;
     }
 
-    return ctr_mpack_consume_string_or_nil_tag(reader, &context->span->name);
+    return CTR_MPACK_SUCCESS;
 }
 
 static int unpack_span_kind(mpack_reader_t *reader, size_t index, void *ctx)
@@ -558,7 +602,14 @@ static int unpack_span_status_message(mpack_reader_t *reader, size_t index, void
 {
     struct ctr_msgpack_decode_context *context = ctx;
 
-    return ctr_mpack_consume_string_or_nil_tag(reader, &context->span->status.message);
+    if (context->span->status.message != NULL) {
+        ctr_arena_sds_destroy(context->trace->arena, context->span->status.message);
+
+        context->span->status.message = NULL;
+    }
+
+    return ctr_mpack_consume_string_or_nil_tag_arena(reader, context->trace->arena,
+                                                     &context->span->status.message);
 }
 
 static int unpack_span_status(mpack_reader_t *reader, size_t index, void *ctx)
@@ -577,7 +628,14 @@ static int unpack_span_schema_url(mpack_reader_t *reader, size_t index, void *ct
 {
     struct ctr_msgpack_decode_context *context = ctx;
 
-    return ctr_mpack_consume_string_or_nil_tag(reader, &context->span->schema_url);
+    if (context->span->schema_url != NULL) {
+        ctr_arena_sds_destroy(context->trace->arena, context->span->schema_url);
+
+        context->span->schema_url = NULL;
+    }
+
+    return ctr_mpack_consume_string_or_nil_tag_arena(reader, context->trace->arena,
+                                                     &context->span->schema_url);
 }
 
 static int unpack_span(mpack_reader_t *reader, size_t index, void *ctx)
@@ -727,6 +785,12 @@ static int unpack_context(mpack_reader_t *reader, struct ctr_msgpack_decode_cont
 }
 
 int ctr_decode_msgpack_create(struct ctrace **out_context, char *in_buf, size_t in_size, size_t *offset)
+{
+    return ctr_decode_msgpack_create_with_opts(out_context, NULL, in_buf, in_size, offset);
+}
+
+int ctr_decode_msgpack_create_with_opts(struct ctrace **out_context, struct ctrace_opts *opts,
+                                        char *in_buf, size_t in_size, size_t *offset)
 {
     size_t                            remainder;
     struct ctr_msgpack_decode_context context;
@@ -735,7 +799,7 @@ int ctr_decode_msgpack_create(struct ctrace **out_context, char *in_buf, size_t
 
     memset(&context, 0, sizeof(context));
 
-    context.trace = ctr_create(NULL);
+    context.trace = ctr_create(opts);
 
     if (context.trace == NULL) {
         return -1;
@@ -770,3 +834,359 @@ void ctr_decode_msgpack_destroy(struct ctrace *context)
         ctr_destroy(context);
     }
 }
+
+/* Stream decoder */
+
+struct ctr_decode_msgpack_stream {
+    int                flags;
+    int                has_opts;
+    struct ctrace_opts opts;
+
+    /* context receiving every object when merging */
+    struct ctrace     *merged;
+
+    /* buffer the reader is bound to and absolute offset of its cursor */
+    char              *buf;
+    size_t             size;
+    size_t             position;
+    int                reader_ready;
+    mpack_reader_t     reader;
+};
+
+static uint64_t read_be(const unsigned char *p, size_t bytes)
+{
+    size_t   index;
+    uint64_t value;
+
+    value = 0;
+
+    for (index = 0 ; index < bytes ; index++) {
+        value = (value << 8) | p[index];
+    }
+
+    return value;
+}
+
+/*
+ * Walk the msgpack headers at the start of buf without decoding them to find
+ * the length of the first complete object. A missing tail returns
+ * CTR_DECODE_MSGPACK_INSUFFICIENT_DATA so truncation is not mistaken for
+ * corruption, which the mpack data reader cannot tell apart.
+ */
+static int msgpack_object_length(const unsigned char *buf, size_t size, size_t *length)
+{
+    size_t        offset;
+    size_t        header;
+    uint64_t      payload;
+    uint64_t      pending;
+    unsigned char type;
+
+    offset = 0;
+    pending = 1;
+
+    while (pending > 0) {
+        if (offset >= size) {
+            return CTR_DECODE_MSGPACK_INSUFFICIENT_DATA;
+        }
+
+        type = buf[offset];
+        header = 1;
+        payload = 0;
+        pending--;
+
+        if (type <= 0x7f || type >= 0xe0) {
+            /* fixint */
+        }
+        else if (type <= 0x8f) {
+            pending += 2 * (uint64_t) (type & 0x0f);
+        }
+        else if (type <= 0x9f) {
+            pending += type & 0x0f;
+        }
+        else if (type <= 0xbf) {
+            payload = type & 0x1f;
+        }
+        else {
+            switch (type) {
+                case 0xc0: /* nil */
+                case 0xc2: /* false */
+                case 0xc3: /* true */
+                    break;
+                case 0xc4: /* bin 8 */
+                case 0xd9: /* str 8 */
+                    header = 2;
+                    break;
+                case 0xc5: /* bin 16 */
+                case 0xda: /* str 16 */
+                    header = 3;
+                    break;
+                case 0xc6: /* bin 32 */
+                case 0xdb: /* str 32 */
+                    header = 5;
+                    break;
+                case 0xc7: /* ext 8 */
+                    header = 3;
+                    break;
+                case 0xc8: /* ext 16 */
+                    header = 4;
+                    break;
+                case 0xc9: /* ext 32 */
+                    header = 6;
+                    break;
+                case 0xca: /* float 32 */
+                    payload = 4;
+                    break;
+                case 0xcb: /* float 64 */
+                    payload = 8;
+                    break;
+                case 0xcc: /* uint 8 */
+                case 0xd0: /* int 8 */
+                    payload = 1;
+                    break;
+                case 0xcd: /* uint 16 */
+                case 0xd1: /* int 16 */
+                    payload = 2;
+                    break;
+                case 0xce: /* uint 32 */
+                case 0xd2: /* int 32 */
+                    payload = 4;
+                    break;
+                case 0xcf: /* uint 64 */
+                case 0xd3: /* int 64 */
+                    payload = 8;
+                    break;
+                case 0xd4: /* fixext 1 */
+                    payload = 2;
+                    break;
+                case 0xd5: /* fixext 2 */
+                    payload = 3;
+                    break;
+                case 0xd6: /* fixext 4 */
+                    payload = 5;
+                    break;
+                case 0xd7: /* fixext 8 */
+                    payload = 9;
+                    break;
+                case 0xd8: /* fixext 16 */
+                    payload = 17;
+                    break;
+                case 0xdc: /* array 16 */
+                case 0xde: /* map 16 */
+                    header = 3;
+                    break;
+                case 0xdd: /* array 32 */
+                case 0xdf: /* map 32 */
+                    header = 5;
+                    break;
+                default:
+                    /* 0xc1 is never used */
+                    return CTR_MPACK_CORRUPT_INPUT_DATA_ERROR;
+            }
+
+            if (size - offset < header) {
+                return CTR_DECODE_MSGPACK_INSUFFICIENT_DATA;
+            }
+
+            switch (type) {
+                case 0xc4:
+                case 0xc5:
+                case 0xc6:
+                case 0xd9:
+                case 0xda:
+                case 0xdb:
+                    payload = read_be(&buf[offset + 1], header - 1);
+                    break;
+                case 0xc7:
+                case 0xc8:
+                case 0xc9:
+                    /* the type byte is part of the header */
+                    payload = read_be(&buf[offset + 1], header - 2);
+                    break;
+                case 0xdc:
+                case 0xdd:
+                    pending += read_be(&buf[offset + 1], header - 1);
+                    break;
+                case 0xde:
+                case 0xdf:
+                    pending += 2 * read_be(&buf[offset + 1], header - 1);
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        if (size - offset - header < payload) {
+            return CTR_DECODE_MSGPACK_INSUFFICIENT_DATA;
+        }
+
+        offset += header + payload;
+    }
+
+    *length = offset;
+
+    return CTR_DECODE_MSGPACK_SUCCESS;
+}
+
+/* drop the resource spans appended after 'last' by a failed merge */
+static void stream_rollback(struct ctrace *ctx, struct cfl_list *last)
+{
+    struct ctrace_resource_span *resource_span;
+
+    while (ctx->resource_spans.prev != last) {
+        resource_span = cfl_list_entry(ctx->resource_spans.prev,
+                                       struct ctrace_resource_span, _head);
+        cfl_list_del(&resource_span->_head);
+        ctr_resource_span_destroy(resource_span);
+    }
+}
+
+struct ctr_decode_msgpack_stream *ctr_decode_msgpack_stream_create(struct ctrace_opts *opts,
+                                                                   int flags)
+{
+    struct ctr_decode_msgpack_stream *stream;
+
+    stream = calloc(1, sizeof(struct ctr_decode_msgpack_stream));
+    if (!stream) {
+        ctr_errno();
+        return NULL;
+    }
+
+    stream->flags = flags;
+
+    if (opts) {
+        stream->opts = *opts;
+        stream->has_opts = CTR_TRUE;
+    }
+
+    return stream;
+}
+
+void ctr_decode_msgpack_stream_destroy(struct ctr_decode_msgpack_stream *stream)
+{
+    if (!stream) {
+        return;
+    }
+
+    if (stream->reader_ready) {
+        mpack_reader_destroy(&stream->reader);
+    }
+
+    if (stream->merged) {
+        ctr_destroy(stream->merged);
+    }
+
+    free(stream);
+}
+
+/*
+ * Decode the object found at *offset. On success *offset is moved past it and,
+ * unless the stream merges, *out_context receives a new context. When merging
+ * a failed object leaves the merged context as it was before the call.
+ */
+int ctr_decode_msgpack_stream_next(struct ctr_decode_msgpack_stream *stream,
+                                   struct ctrace **out_context,
+                                   char *in_buf, size_t in_size, size_t *offset)
+{
+    int                               merge;
+    int                               result;
+    size_t                            length;
+    struct cfl_list                  *last;
+    struct ctr_msgpack_decode_context context;
+
+    if (out_context) {
+        *out_context = NULL;
+    }
+
+    merge = stream && (stream->flags & CTR_DECODE_MSGPACK_STREAM_MERGE);
+
+    if (!stream || !in_buf || !offset || *offset > in_size ||
+        (!merge && !out_context)) {
+        return CTR_DECODE_MSGPACK_INVALID_ARGUMENT_ERROR;
+    }
+
+    result = msgpack_object_length((unsigned char *) &in_buf[*offset],
+                                   in_size - *offset, &length);
+    if (result != CTR_DECODE_MSGPACK_SUCCESS) {
+        return result;
+    }
+
+    /* the reader only needs to be set up again when the buffer changed */
+    if (!stream->reader_ready || stream->buf != in_buf ||
+        stream->size != in_size || stream->position != *offset) {
+        if (stream->reader_ready) {
+            mpack_reader_destroy(&stream->reader);
+        }
+
+        mpack_reader_init_data(&stream->reader, &in_buf[*offset], in_size - *offset);
+
+        stream->buf = in_buf;
+        stream->size = in_size;
+        stream->position = *offset;
+        stream->reader_ready = CTR_TRUE;
+    }
+
+    memset(&context, 0, sizeof(context));
+
+    last = NULL;
+
+    if (merge) {
+        if (!stream->merged) {
+            stream->merged = ctr_create(stream->has_opts ? &stream->opts : NULL);
+
+            if (!stream->merged) {
+                return CTR_DECODE_MSGPACK_ALLOCATION_ERROR;
+            }
+        }
+
+        context.trace = stream->merged;
+        last = stream->merged->resource_spans.prev;
+    }
+    else {
+        context.trace = ctr_create(stream->has_opts ? &stream->opts : NULL);
+
+        if (!context.trace) {
+            return CTR_DECODE_MSGPACK_ALLOCATION_ERROR;
+        }
+    }
+
+    result = unpack_context(&stream->reader, &context);
+
+    if (result != CTR_DECODE_MSGPACK_SUCCESS) {
+        /* the reader is left in an error state */
+        mpack_reader_destroy(&stream->reader);
+        stream->reader_ready = CTR_FALSE;
+
+        if (merge) {
+            stream_rollback(stream->merged, last);
+        }
+        else {
+            ctr_destroy(context.trace);
+        }
+
+        return result;
+    }
+
+    *offset += length;
+    stream->position = *offset;
+
+    if (!merge) {
+        *out_context = context.trace;
+    }
+
+    return CTR_DECODE_MSGPACK_SUCCESS;
+}
+
+/* hand over the merged context, the stream starts a new one on the next object */
+struct ctrace *ctr_decode_msgpack_stream_take(struct ctr_decode_msgpack_stream *stream)
+{
+    struct ctrace *ctx;
+
+    if (!stream) {
+        return NULL;
+    }
+
+    ctx = stream->merged;
+    stream->merged = NULL;
+
+    return ctx;
+}
@@ -20,6 +20,7 @@
 #include <ctraces/ctraces.h>
 #include <cfl/cfl_array.h>
 #include <fluent-otel-proto/fluent-otel.h>
+#include <ctraces/ctr_otlp_wire.h>
 
 static int convert_any_value(struct opentelemetry_decode_value *ctr_val,
                              opentelemetry_decode_value_type value_type, char *key,
@@ -515,9 +516,83 @@ void ctr_span_set_links(struct ctrace_span *ctr_span, size_t n_links,
 
 }
 
-int ctr_decode_opentelemetry_create(struct ctrace **out_ctr,
-                                    char *in_buf,
-                                    size_t in_size, size_t *offset)
+/*
+ * Decode scratch context
+ * ----------------------
+ * The protobuf-c tree unpacked by ctr_decode_opentelemetry_create() only lives
+ * until its content is copied into the CTraces context, a scratch context
+ * serves those allocations from an arena that is reset after every call.
+ */
+struct ctr_decode_opentelemetry_scratch {
+    struct ctr_arena *arena;
+    ProtobufCAllocator allocator;
+};
+
+static void *scratch_alloc(void *allocator_data, size_t size)
+{
+    return ctr_arena_alloc(allocator_data, size);
+}
+
+static void scratch_free(void *allocator_data, void *pointer)
+{
+    /* memory is released when the scratch arena is reset */
+    (void) allocator_data;
+    (void) pointer;
+}
+
+struct ctr_decode_opentelemetry_scratch *ctr_decode_opentelemetry_scratch_create(size_t chunk_size)
+{
+    struct ctr_decode_opentelemetry_scratch *scratch;
+
+    scratch = calloc(1, sizeof(struct ctr_decode_opentelemetry_scratch));
+    if (!scratch) {
+        ctr_errno();
+        return NULL;
+    }
+
+    scratch->arena = ctr_arena_create(chunk_size);
+    if (!scratch->arena) {
+        free(scratch);
+        return NULL;
+    }
+
+    scratch->allocator.alloc = scratch_alloc;
+    scratch->allocator.free = scratch_free;
+    scratch->allocator.allocator_data = scratch->arena;
+
+    return scratch;
+}
+
+void ctr_decode_opentelemetry_scratch_destroy(struct ctr_decode_opentelemetry_scratch *scratch)
+{
+    if (!scratch) {
+        return;
+    }
+
+    ctr_arena_destroy(scratch->arena);
+    free(scratch);
+}
+
+size_t ctr_decode_opentelemetry_scratch_size(struct ctr_decode_opentelemetry_scratch *scratch)
+{
+    return scratch->arena->allocated;
+}
+
+static void destroy_service_request(Opentelemetry__Proto__Collector__Trace__V1__ExportTraceServiceRequest *req,
+                                    struct ctr_decode_opentelemetry_scratch *scratch)
+{
+    if (scratch) {
+        ctr_arena_reset(scratch->arena);
+        return;
+    }
+
+    opentelemetry__proto__collector__trace__v1__export_trace_service_request__free_unpacked(req, NULL);
+}
+
+int ctr_decode_opentelemetry_create_with_scratch(struct ctrace **out_ctr,
+                                                 struct ctr_decode_opentelemetry_scratch *scratch,
+                                                 char *in_buf,
+                                                 size_t in_size, size_t *offset)
 {
     size_t resource_span_index;
     size_t scope_span_index;
@@ -532,15 +607,23 @@ int ctr_decode_opentelemetry_create(struct ctrace **out_ctr,
     Opentelemetry__Proto__Trace__V1__ResourceSpans *otel_resource_span;
     Opentelemetry__Proto__Trace__V1__ScopeSpans *otel_scope_span;
     Opentelemetry__Proto__Trace__V1__Span *otel_span;
+    ProtobufCAllocator *allocator = NULL;
 
     if (*offset >= in_size) {
         return CTR_DECODE_OPENTELEMETRY_INSUFFICIENT_DATA;
     }
 
-    service_request = opentelemetry__proto__collector__trace__v1__export_trace_service_request__unpack(NULL,
+    if (scratch) {
+        allocator = &scratch->allocator;
+    }
+
+    service_request = opentelemetry__proto__collector__trace__v1__export_trace_service_request__unpack(allocator,
                                                                                                       in_size - *offset,
                                                                                                       (unsigned char *) &in_buf[*offset]);
     if (service_request == NULL) {
+        if (scratch) {
+            ctr_arena_reset(scratch->arena);
+        }
         return CTR_DECODE_OPENTELEMETRY_CORRUPTED_DATA;
     }
 
@@ -549,7 +632,7 @@ int ctr_decode_opentelemetry_create(struct ctrace **out_ctr,
     for (resource_span_index = 0; resource_span_index < service_request->n_resource_spans; resource_span_index++) {
         otel_resource_span = service_request->resource_spans[resource_span_index];
         if (otel_resource_span == NULL || otel_resource_span->resource == NULL) {
-            opentelemetry__proto__collector__trace__v1__export_trace_service_request__free_unpacked(service_request, NULL);
+            destroy_service_request(service_request, scratch);
             ctr_destroy(ctr);
             return CTR_DECODE_OPENTELEMETRY_INVALID_PAYLOAD;
         }
@@ -568,7 +651,7 @@ int ctr_decode_opentelemetry_create(struct ctrace **out_ctr,
             otel_scope_span = otel_resource_span->scope_spans[scope_span_index];
 
             if (otel_scope_span == NULL) {
-                opentelemetry__proto__collector__trace__v1__export_trace_service_request__free_unpacked(service_request, NULL);
+                destroy_service_request(service_request, scratch);
                 ctr_destroy(ctr);
 
                 return CTR_DECODE_OPENTELEMETRY_INVALID_PAYLOAD;
@@ -577,7 +660,7 @@ int ctr_decode_opentelemetry_create(struct ctrace **out_ctr,
             scope_span = ctr_scope_span_create(resource_span);
 
             if (scope_span == NULL) {
-                opentelemetry__proto__collector__trace__v1__export_trace_service_request__free_unpacked(service_request, NULL);
+                destroy_service_request(service_request, scratch);
                 ctr_destroy(ctr);
 
                 return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
@@ -593,7 +676,7 @@ int ctr_decode_opentelemetry_create(struct ctrace **out_ctr,
                 otel_span = otel_scope_span->spans[span_index];
 
                 if (otel_span == NULL) {
-                    opentelemetry__proto__collector__trace__v1__export_trace_service_request__free_unpacked(service_request, NULL);
+                    destroy_service_request(service_request, scratch);
                     ctr_destroy(ctr);
 
                     return CTR_DECODE_OPENTELEMETRY_INVALID_PAYLOAD;
@@ -602,7 +685,7 @@ int ctr_decode_opentelemetry_create(struct ctrace **out_ctr,
                 span = ctr_span_create(ctr, scope_span, otel_span->name, NULL);
 
                 if (span == NULL) {
-                    opentelemetry__proto__collector__trace__v1__export_trace_service_request__free_unpacked(service_request, NULL);
+                    destroy_service_request(service_request, scratch);
                     ctr_destroy(ctr);
 
                     return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
@@ -639,13 +722,1073 @@ int ctr_decode_opentelemetry_create(struct ctrace **out_ctr,
 
     *offset += opentelemetry__proto__collector__trace__v1__export_trace_service_request__get_packed_size(service_request);
 
-    opentelemetry__proto__collector__trace__v1__export_trace_service_request__free_unpacked(service_request, NULL);
+    destroy_service_request(service_request, scratch);
 
     *out_ctr = ctr;
 
     return CTR_DECODE_OPENTELEMETRY_SUCCESS;
 }
 
+int ctr_decode_opentelemetry_create(struct ctrace **out_ctr,
+                                    char *in_buf,
+                                    size_t in_size, size_t *offset)
+{
+    return ctr_decode_opentelemetry_create_with_scratch(out_ctr, NULL, in_buf, in_size, offset);
+}
+
+/*
+ * Direct decoder
+ * --------------
+ * Walk the protobuf wire format of an ExportTraceServiceRequest and populate
+ * the context while reading, without unpacking a protobuf-c object tree
+ * first. Strings and bytes are copied once, straight from the input buffer
+ * into their final cfl_sds_t (or arena) storage.
+ */
+
+/* nesting limit for array and kvlist values */
+#define DIRECT_MAX_DEPTH     64
+
+struct wire_reader {
+    unsigned char *p;
+    unsigned char *end;
+};
+
+static int wire_read_varint(struct wire_reader *r, uint64_t *out)
+{
+    int shift = 0;
+    uint64_t value = 0;
+
+    while (r->p < r->end && shift < 64) {
+        value |= (uint64_t) (*r->p & 0x7f) << shift;
+        if ((*r->p++ & 0x80) == 0) {
+            *out = value;
+            return 0;
+        }
+        shift += 7;
+    }
+
+    return -1;
+}
+
+static int wire_read_fixed(struct wire_reader *r, size_t size, uint64_t *out)
+{
+    size_t i;
+    uint64_t value = 0;
+
+    if ((size_t) (r->end - r->p) < size) {
+        return -1;
+    }
+
+    for (i = 0; i < size; i++) {
+        value |= (uint64_t) r->p[i] << (i * 8);
+    }
+    r->p += size;
+
+    *out = value;
+    return 0;
+}
+
+/* read a length delimited field, 'sub' covers its payload */
+static int wire_read_len(struct wire_reader *r, struct wire_reader *sub)
+{
+    uint64_t len;
+
+    if (wire_read_varint(r, &len) != 0 || len > (uint64_t) (r->end - r->p)) {
+        return -1;
+    }
+
+    sub->p = r->p;
+    sub->end = r->p + len;
+    r->p += len;
+
+    return 0;
+}
+
+static int wire_read_tag(struct wire_reader *r, int *field, int *type)
+{
+    uint64_t tag;
+
+    if (wire_read_varint(r, &tag) != 0 || (tag >> 3) == 0 || (tag >> 3) > INT32_MAX) {
+        return -1;
+    }
+
+    *field = (int) (tag >> 3);
+    *type = (int) (tag & 0x07);
+
+    return 0;
+}
+
+/* read the value of a field whose content is not needed */
+static int wire_skip(struct wire_reader *r, int type)
+{
+    uint64_t value;
+    struct wire_reader sub;
+
+    switch (type) {
+        case CTR_OTLP_WIRE_VARINT:
+            return wire_read_varint(r, &value);
+        case CTR_OTLP_WIRE_FIXED64:
+            return wire_read_fixed(r, 8, &value);
+        case CTR_OTLP_WIRE_LEN:
+            return wire_read_len(r, &sub);
+        case CTR_OTLP_WIRE_FIXED32:
+            return wire_read_fixed(r, 4, &value);
+    }
+
+    return -1;
+}
+
+/*
+ * Read the value of a known field, the wire type must match the expected one
+ * or the payload is considered corrupted.
+ */
+static int wire_read_uint(struct wire_reader *r, int type, uint64_t *out)
+{
+    switch (type) {
+        case CTR_OTLP_WIRE_VARINT:
+            return wire_read_varint(r, out);
+        case CTR_OTLP_WIRE_FIXED64:
+            return wire_read_fixed(r, 8, out);
+        case CTR_OTLP_WIRE_FIXED32:
+            return wire_read_fixed(r, 4, out);
+    }
+
+    return -1;
+}
+
+static int wire_read_bytes(struct wire_reader *r, int type, struct wire_reader *sub)
+{
+    if (type != CTR_OTLP_WIRE_LEN) {
+        return -1;
+    }
+
+    return wire_read_len(r, sub);
+}
+
+static inline size_t wire_len(struct wire_reader *r)
+{
+    return r->end - r->p;
+}
+
+/*
+ * Read the next field of a message made only of length delimited fields,
+ * other wire types are skipped and reported with 'field' set to zero.
+ */
+static int direct_field(struct wire_reader *r, int *field, struct wire_reader *sub)
+{
+    int type;
+
+    if (wire_read_tag(r, field, &type) != 0) {
+        return CTR_DECODE_OPENTELEMETRY_CORRUPTED_DATA;
+    }
+
+    if (type != CTR_OTLP_WIRE_LEN) {
+        *field = 0;
+        if (wire_skip(r, type) != 0) {
+            return CTR_DECODE_OPENTELEMETRY_CORRUPTED_DATA;
+        }
+        return CTR_DECODE_OPENTELEMETRY_SUCCESS;
+    }
+
+    if (wire_read_len(r, sub) != 0) {
+        return CTR_DECODE_OPENTELEMETRY_CORRUPTED_DATA;
+    }
+
+    return CTR_DECODE_OPENTELEMETRY_SUCCESS;
+}
+
+static int direct_key_value(struct wire_reader *r, struct cfl_kvlist *kvlist, int depth);
+
+static int direct_any_value(struct wire_reader *r, struct cfl_variant **out, int depth);
+
+static int direct_array_value(struct wire_reader *r, struct cfl_variant **out, int depth)
+{
+    int ret;
+    int type;
+    int field;
+    size_t count = 0;
+    struct wire_reader scan;
+    struct wire_reader sub;
+    struct cfl_array *array;
+    struct cfl_variant *entry;
+
+    /* arrays are not resizable by default, count the entries first */
+    scan = *r;
+    while (scan.p < scan.end) {
+        if (wire_read_tag(&scan, &field, &type) != 0 || wire_skip(&scan, type) != 0) {
+            return CTR_DECODE_OPENTELEMETRY_CORRUPTED_DATA;
+        }
+
+        if (field == CTR_OTLP_LIST_VALUES) {
+            count++;
+        }
+    }
+
+    array = cfl_array_create(count);
+    if (!array) {
+        return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+    }
+
+    while (r->p < r->end) {
+        ret = direct_field(r, &field, &sub);
+        if (ret != CTR_DECODE_OPENTELEMETRY_SUCCESS) {
+            cfl_array_destroy(array);
+            return ret;
+        }
+
+        if (field != CTR_OTLP_LIST_VALUES) {
+            continue;
+        }
+
+        entry = NULL;
+        ret = direct_any_value(&sub, &entry, depth + 1);
+        if (ret != CTR_DECODE_OPENTELEMETRY_SUCCESS) {
+            if (entry) {
+                cfl_variant_destroy(entry);
+            }
+            cfl_array_destroy(array);
+            return ret;
+        }
+
+        if (entry == NULL) {
+            continue;
+        }
+
+        if (cfl_array_append(array, entry) != 0) {
+            cfl_variant_destroy(entry);
+            cfl_array_destroy(array);
+            return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+        }
+    }
+
+    *out = cfl_variant_create_from_array(array);
+    if (!*out) {
+        cfl_array_destroy(array);
+        return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+    }
+
+    return CTR_DECODE_OPENTELEMETRY_SUCCESS;
+}
+
+static int direct_kvlist_value(struct wire_reader *r, struct cfl_variant **out, int depth)
+{
+    int ret;
+    int field;
+    struct wire_reader sub;
+    struct cfl_kvlist *kvlist;
+
+    kvlist = cfl_kvlist_create();
+    if (!kvlist) {
+        return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+    }
+
+    while (r->p < r->end) {
+        ret = direct_field(r, &field, &sub);
+        if (ret == CTR_DECODE_OPENTELEMETRY_SUCCESS && field == CTR_OTLP_LIST_VALUES) {
+            ret = direct_key_value(&sub, kvlist, depth + 1);
+        }
+
+        if (ret != CTR_DECODE_OPENTELEMETRY_SUCCESS) {
+            cfl_kvlist_destroy(kvlist);
+            return ret;
+        }
+    }
+
+    *out = cfl_variant_create_from_kvlist(kvlist);
+    if (!*out) {
+        cfl_kvlist_destroy(kvlist);
+        return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+    }
+
+    return CTR_DECODE_OPENTELEMETRY_SUCCESS;
+}
+
+/*
+ * Decode an AnyValue into a new variant. If the message does not carry a
+ * value known by CTraces, 'out' is left untouched. On error the caller owns
+ * any variant already stored in 'out'.
+ */
+static int direct_any_value(struct wire_reader *r, struct cfl_variant **out, int depth)
+{
+    int ret;
+    int type;
+    int field;
+    double d;
+    uint64_t value;
+    struct wire_reader sub;
+    struct cfl_variant *var;
+
+    if (depth > DIRECT_MAX_DEPTH) {
+        return CTR_DECODE_OPENTELEMETRY_INVALID_PAYLOAD;
+    }
+
+    while (r->p < r->end) {
+        if (wire_read_tag(r, &field, &type) != 0) {
+            return CTR_DECODE_OPENTELEMETRY_CORRUPTED_DATA;
+        }
+
+        var = NULL;
+        ret = 0;
+
+        switch (field) {
+            case CTR_OTLP_ANY_VALUE_STRING:
+                ret = wire_read_bytes(r, type, &sub);
+                if (ret == 0) {
+                    var = cfl_variant_create_from_string_s((char *) sub.p, wire_len(&sub),
+                                                           CFL_FALSE);
+                }
+                break;
+            case CTR_OTLP_ANY_VALUE_BOOL:
+                ret = wire_read_uint(r, type, &value);
+                if (ret == 0) {
+                    var = cfl_variant_create_from_bool(value ? CFL_TRUE : CFL_FALSE);
+                }
+                break;
+            case CTR_OTLP_ANY_VALUE_INT:
+                ret = wire_read_uint(r, type, &value);
+                if (ret == 0) {
+                    var = cfl_variant_create_from_int64((int64_t) value);
+                }
+                break;
+            case CTR_OTLP_ANY_VALUE_DOUBLE:
+                ret = wire_read_uint(r, type, &value);
+                if (ret == 0) {
+                    memcpy(&d, &value, sizeof(d));
+                    var = cfl_variant_create_from_double(d);
+                }
+                break;
+            case CTR_OTLP_ANY_VALUE_BYTES:
+                ret = wire_read_bytes(r, type, &sub);
+                if (ret == 0) {
+                    var = cfl_variant_create_from_bytes((char *) sub.p, wire_len(&sub),
+                                                        CFL_FALSE);
+                }
+                break;
+            case CTR_OTLP_ANY_VALUE_ARRAY:
+            case CTR_OTLP_ANY_VALUE_KVLIST:
+                if (wire_read_bytes(r, type, &sub) != 0) {
+                    return CTR_DECODE_OPENTELEMETRY_CORRUPTED_DATA;
+                }
+
+                if (field == CTR_OTLP_ANY_VALUE_ARRAY) {
+                    ret = direct_array_value(&sub, &var, depth);
+                }
+                else {
+                    ret = direct_kvlist_value(&sub, &var, depth);
+                }
+
+                if (ret != CTR_DECODE_OPENTELEMETRY_SUCCESS) {
+                    return ret;
+                }
+                break;
+            default:
+                /* unknown members, e.g: string_value_strindex from profiles */
+                if (wire_skip(r, type) != 0) {
+                    return CTR_DECODE_OPENTELEMETRY_CORRUPTED_DATA;
+                }
+                continue;
+        }
+
+        if (ret != 0) {
+            return CTR_DECODE_OPENTELEMETRY_CORRUPTED_DATA;
+        }
+
+        if (var == NULL) {
+            return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+        }
+
+        /* the last member of a oneof wins */
+        if (*out) {
+            cfl_variant_destroy(*out);
+        }
+        *out = var;
+    }
+
+    return CTR_DECODE_OPENTELEMETRY_SUCCESS;
+}
+
+static int direct_key_value(struct wire_reader *r, struct cfl_kvlist *kvlist, int depth)
+{
+    int ret;
+    int type;
+    int field;
+    int has_value = CTR_FALSE;
+    struct wire_reader key = {0};
+    struct wire_reader value = {0};
+    struct cfl_variant *var = NULL;
+
+    while (r->p < r->end) {
+        if (wire_read_tag(r, &field, &type) != 0) {
+            return CTR_DECODE_OPENTELEMETRY_CORRUPTED_DATA;
+        }
+
+        if (field == CTR_OTLP_KEY_VALUE_KEY) {
+            ret = wire_read_bytes(r, type, &key);
+        }
+        else if (field == CTR_OTLP_KEY_VALUE_VALUE) {
+            ret = wire_read_bytes(r, type, &value);
+            has_value = CTR_TRUE;
+        }
+        else {
+            ret = wire_skip(r, type);
+        }
+
+        if (ret != 0) {
+            return CTR_DECODE_OPENTELEMETRY_CORRUPTED_DATA;
+        }
+    }
+
+    if (!has_value) {
+        return CTR_DECODE_OPENTELEMETRY_SUCCESS;
+    }
+
+    ret = direct_any_value(&value, &var, depth);
+    if (ret != CTR_DECODE_OPENTELEMETRY_SUCCESS) {
+        if (var) {
+            cfl_variant_destroy(var);
+        }
+        return ret;
+    }
+
+    if (var == NULL) {
+        return CTR_DECODE_OPENTELEMETRY_SUCCESS;
+    }
+
+    ret = cfl_kvlist_insert_s(kvlist, key.p ? (char *) key.p : "", wire_len(&key), var);
+    if (ret != 0) {
+        cfl_variant_destroy(var);
+        return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+    }
+
+    return CTR_DECODE_OPENTELEMETRY_SUCCESS;
+}
+
+/* decode one entry of a repeated KeyValue field into the attributes */
+static int direct_attribute(struct wire_reader *r, int type,
+                            struct ctrace_attributes *attr)
+{
+    struct wire_reader sub;
+
+    if (wire_read_bytes(r, type, &sub) != 0) {
+        return CTR_DECODE_OPENTELEMETRY_CORRUPTED_DATA;
+    }
+
+    return direct_key_value(&sub, attr->kv, 0);
+}
+
+static int direct_resource(struct wire_reader *r, struct ctrace_resource *resource)
+{
+    int ret;
+    int type;
+    int field;
+    uint64_t value;
+
+    while (r->p < r->end) {
+        if (wire_read_tag(r, &field, &type) != 0) {
+            return CTR_DECODE_OPENTELEMETRY_CORRUPTED_DATA;
+        }
+
+        switch (field) {
+            case CTR_OTLP_RESOURCE_ATTRIBUTES:
+                ret = direct_attribute(r, type, resource->attr);
+                if (ret != CTR_DECODE_OPENTELEMETRY_SUCCESS) {
+                    return ret;
+                }
+                continue;
+            case CTR_OTLP_RESOURCE_DROPPED_ATTRIBUTES:
+                ret = wire_read_uint(r, type, &value);
+                resource->dropped_attr_count = (uint32_t) value;
+                break;
+            default:
+                ret = wire_skip(r, type);
+                break;
+        }
+
+        if (ret != 0) {
+            return CTR_DECODE_OPENTELEMETRY_CORRUPTED_DATA;
+        }
+    }
+
+    return CTR_DECODE_OPENTELEMETRY_SUCCESS;
+}
+
+static int direct_instrumentation_scope(struct wire_reader *r,
+                                        struct ctrace_scope_span *scope_span)
+{
+    int ret;
+    int type;
+    int field;
+    uint64_t value;
+    struct wire_reader sub;
+    struct ctrace_attributes *attr;
+    struct ctrace_instrumentation_scope *scope;
+
+    attr = ctr_attributes_create();
+    if (!attr) {
+        return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+    }
+
+    scope = ctr_instrumentation_scope_create("", "", 0, attr);
+    if (!scope) {
+        ctr_attributes_destroy(attr);
+        return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+    }
+    ctr_scope_span_set_instrumentation_scope(scope_span, scope);
+
+    while (r->p < r->end) {
+        if (wire_read_tag(r, &field, &type) != 0) {
+            return CTR_DECODE_OPENTELEMETRY_CORRUPTED_DATA;
+        }
+
+        switch (field) {
+            case CTR_OTLP_SCOPE_NAME:
+            case CTR_OTLP_SCOPE_VERSION:
+                ret = wire_read_bytes(r, type, &sub);
+                if (ret != 0) {
+                    break;
+                }
+
+                if (field == CTR_OTLP_SCOPE_NAME) {
+                    cfl_sds_destroy(scope->name);
+                    scope->name = cfl_sds_create_len((char *) sub.p, wire_len(&sub));
+                }
+                else {
+                    cfl_sds_destroy(scope->version);
+                    scope->version = cfl_sds_create_len((char *) sub.p, wire_len(&sub));
+                }
+
+                if (!scope->name || !scope->version) {
+                    return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+                }
+                break;
+            case CTR_OTLP_SCOPE_ATTRIBUTES:
+                ret = direct_attribute(r, type, scope->attr);
+                if (ret != CTR_DECODE_OPENTELEMETRY_SUCCESS) {
+                    return ret;
+                }
+                continue;
+            case CTR_OTLP_SCOPE_DROPPED_ATTRIBUTES:
+                ret = wire_read_uint(r, type, &value);
+                scope->dropped_attr_count = (uint32_t) value;
+                break;
+            default:
+                ret = wire_skip(r, type);
+                break;
+        }
+
+        if (ret != 0) {
+            return CTR_DECODE_OPENTELEMETRY_CORRUPTED_DATA;
+        }
+    }
+
+    return CTR_DECODE_OPENTELEMETRY_SUCCESS;
+}
+
+static int direct_status(struct wire_reader *r, struct ctrace_span *span)
+{
+    int ret;
+    int type;
+    int field;
+    uint64_t value;
+    struct wire_reader message = {0};
+    struct ctr_arena *arena;
+
+    arena = span->ctx->arena;
+
+    if (ctr_span_set_status(span, CTRACE_SPAN_STATUS_CODE_UNSET, NULL) != 0) {
+        return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+    }
+
+    while (r->p < r->end) {
+        if (wire_read_tag(r, &field, &type) != 0) {
+            return CTR_DECODE_OPENTELEMETRY_CORRUPTED_DATA;
+        }
+
+        switch (field) {
+            case CTR_OTLP_STATUS_MESSAGE:
+                ret = wire_read_bytes(r, type, &message);
+                break;
+            case CTR_OTLP_STATUS_CODE:
+                ret = wire_read_uint(r, type, &value);
+                span->status.code = (int32_t) value;
+                break;
+            default:
+                ret = wire_skip(r, type);
+                break;
+        }
+
+        if (ret != 0) {
+            return CTR_DECODE_OPENTELEMETRY_CORRUPTED_DATA;
+        }
+    }
+
+    span->status.message = ctr_arena_sds_create_len(arena, (char *) message.p,
+                                                    wire_len(&message));
+    if (!span->status.message) {
+        return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+    }
+
+    return CTR_DECODE_OPENTELEMETRY_SUCCESS;
+}
+
+static int direct_event(struct wire_reader *r, struct ctrace_span *span)
+{
+    int ret;
+    int type;
+    int field;
+    uint64_t value;
+    struct wire_reader sub;
+    struct ctrace_span_event *event;
+
+    event = ctr_span_event_add_ts(span, "", 1);
+    if (!event) {
+        return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+    }
+    event->time_unix_nano = 0;
+
+    if (!event->attr) {
+        return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+    }
+
+    while (r->p < r->end) {
+        if (wire_read_tag(r, &field, &type) != 0) {
+            return CTR_DECODE_OPENTELEMETRY_CORRUPTED_DATA;
+        }
+
+        switch (field) {
+            case CTR_OTLP_EVENT_TIME:
+                ret = wire_read_uint(r, type, &value);
+                event->time_unix_nano = value;
+                break;
+            case CTR_OTLP_EVENT_NAME:
+                ret = wire_read_bytes(r, type, &sub);
+                if (ret != 0) {
+                    break;
+                }
+
+                if (ctr_span_event_set_name(event, (char *) sub.p, wire_len(&sub)) != 0) {
+                    return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+                }
+                break;
+            case CTR_OTLP_EVENT_ATTRIBUTES:
+                ret = direct_attribute(r, type, event->attr);
+                if (ret != CTR_DECODE_OPENTELEMETRY_SUCCESS) {
+                    return ret;
+                }
+                continue;
+            case CTR_OTLP_EVENT_DROPPED_ATTRIBUTES:
+                ret = wire_read_uint(r, type, &value);
+                event->dropped_attr_count = (uint32_t) value;
+                break;
+            default:
+                ret = wire_skip(r, type);
+                break;
+        }
+
+        if (ret != 0) {
+            return CTR_DECODE_OPENTELEMETRY_CORRUPTED_DATA;
+        }
+    }
+
+    return CTR_DECODE_OPENTELEMETRY_SUCCESS;
+}
+
+/* set an ID into its inline storage, an empty one clears it */
+static int direct_id(struct ctrace_id **ref, struct ctrace_id *data, struct wire_reader *sub)
+{
+    if (wire_len(sub) == 0) {
+        if (*ref) {
+            ctr_id_destroy(*ref);
+            *ref = NULL;
+        }
+        return CTR_DECODE_OPENTELEMETRY_SUCCESS;
+    }
+
+    if (ctr_id_assign(ref, data, sub->p, wire_len(sub)) != 0) {
+        return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+    }
+
+    return CTR_DECODE_OPENTELEMETRY_SUCCESS;
+}
+
+static int direct_link(struct wire_reader *r, struct ctrace_span *span)
+{
+    int ret;
+    int type;
+    int field;
+    uint64_t value;
+    struct wire_reader sub;
+    struct ctr_arena *arena;
+    struct ctrace_link *link;
+
+    arena = span->ctx->arena;
+
+    link = ctr_link_create(span, NULL, 0, NULL, 0);
+    if (!link) {
+        return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+    }
+
+    link->attr = ctr_attributes_create();
+    if (!link->attr) {
+        return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+    }
+
+    while (r->p < r->end) {
+        if (wire_read_tag(r, &field, &type) != 0) {
+            return CTR_DECODE_OPENTELEMETRY_CORRUPTED_DATA;
+        }
+
+        switch (field) {
+            case CTR_OTLP_LINK_TRACE_ID:
+            case CTR_OTLP_LINK_SPAN_ID:
+                ret = wire_read_bytes(r, type, &sub);
+                if (ret != 0) {
+                    break;
+                }
+
+                if (field == CTR_OTLP_LINK_TRACE_ID) {
+                    ret = direct_id(&link->trace_id, &link->trace_id_data, &sub);
+                }
+                else {
+                    ret = direct_id(&link->span_id, &link->span_id_data, &sub);
+                }
+
+                if (ret != CTR_DECODE_OPENTELEMETRY_SUCCESS) {
+                    return ret;
+                }
+                break;
+            case CTR_OTLP_LINK_TRACE_STATE:
+                ret = wire_read_bytes(r, type, &sub);
+                if (ret != 0) {
+                    break;
+                }
+
+                if (link->trace_state) {
+                    ctr_arena_sds_destroy(arena, link->trace_state);
+                }
+                link->trace_state = ctr_arena_sds_create_len(arena, (char *) sub.p,
+                                                             wire_len(&sub));
+                if (!link->trace_state) {
+                    return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+                }
+                break;
+            case CTR_OTLP_LINK_ATTRIBUTES:
+                ret = direct_attribute(r, type, link->attr);
+                if (ret != CTR_DECODE_OPENTELEMETRY_SUCCESS) {
+                    return ret;
+                }
+                continue;
+            case CTR_OTLP_LINK_DROPPED_ATTRIBUTES:
+                ret = wire_read_uint(r, type, &value);
+                link->dropped_attr_count = (uint32_t) value;
+                break;
+            case CTR_OTLP_LINK_FLAGS:
+                ret = wire_read_uint(r, type, &value);
+                link->flags = (uint32_t) value;
+                break;
+            default:
+                ret = wire_skip(r, type);
+                break;
+        }
+
+        if (ret != 0) {
+            return CTR_DECODE_OPENTELEMETRY_CORRUPTED_DATA;
+        }
+    }
+
+    return CTR_DECODE_OPENTELEMETRY_SUCCESS;
+}
+
+static int direct_span(struct wire_reader *r, struct ctrace *ctx,
+                       struct ctrace_scope_span *scope_span)
+{
+    int ret;
+    int type;
+    int field;
+    uint64_t value;
+    struct wire_reader sub;
+    struct ctrace_span *span;
+
+    span = ctr_span_create(ctx, scope_span, "", NULL);
+    if (!span) {
+        return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+    }
+
+    /* absent fields are zero */
+    ctr_span_clear_defaults(span);
+
+    while (r->p < r->end) {
+        if (wire_read_tag(r, &field, &type) != 0) {
+            return CTR_DECODE_OPENTELEMETRY_CORRUPTED_DATA;
+        }
+
+        switch (field) {
+            case CTR_OTLP_SPAN_TRACE_ID:
+            case CTR_OTLP_SPAN_SPAN_ID:
+            case CTR_OTLP_SPAN_PARENT_SPAN_ID:
+                ret = wire_read_bytes(r, type, &sub);
+                if (ret != 0) {
+                    break;
+                }
+
+                if (field == CTR_OTLP_SPAN_TRACE_ID) {
+                    ret = direct_id(&span->trace_id, &span->trace_id_data, &sub);
+                }
+                else if (field == CTR_OTLP_SPAN_SPAN_ID) {
+                    ret = direct_id(&span->span_id, &span->span_id_data, &sub);
+                }
+                else {
+                    ret = direct_id(&span->parent_span_id, &span->parent_span_id_data, &sub);
+                }
+
+                if (ret != CTR_DECODE_OPENTELEMETRY_SUCCESS) {
+                    return ret;
+                }
+                break;
+            case CTR_OTLP_SPAN_TRACE_STATE:
+                ret = wire_read_bytes(r, type, &sub);
+                if (ret == 0 && wire_len(&sub) > 0 &&
+                    ctr_span_set_trace_state(span, (char *) sub.p, wire_len(&sub)) != 0) {
+                    return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+                }
+                break;
+            case CTR_OTLP_SPAN_NAME:
+                ret = wire_read_bytes(r, type, &sub);
+                if (ret != 0) {
+                    break;
+                }
+
+                if (ctr_span_set_name(span, (char *) sub.p, wire_len(&sub)) != 0) {
+                    return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+                }
+                break;
+            case CTR_OTLP_SPAN_KIND:
+                ret = wire_read_uint(r, type, &value);
+                ctr_span_kind_set(span, (int32_t) value);
+                break;
+            case CTR_OTLP_SPAN_START_TIME:
+                ret = wire_read_uint(r, type, &value);
+                span->start_time_unix_nano = value;
+                break;
+            case CTR_OTLP_SPAN_END_TIME:
+                ret = wire_read_uint(r, type, &value);
+                span->end_time_unix_nano = value;
+                break;
+            case CTR_OTLP_SPAN_ATTRIBUTES:
+                ret = direct_attribute(r, type, span->attr);
+                if (ret != CTR_DECODE_OPENTELEMETRY_SUCCESS) {
+                    return ret;
+                }
+                continue;
+            case CTR_OTLP_SPAN_DROPPED_ATTRIBUTES:
+                ret = wire_read_uint(r, type, &value);
+                span->dropped_attr_count = (uint32_t) value;
+                break;
+            case CTR_OTLP_SPAN_DROPPED_EVENTS:
+                ret = wire_read_uint(r, type, &value);
+                span->dropped_events_count = (uint32_t) value;
+                break;
+            case CTR_OTLP_SPAN_DROPPED_LINKS:
+                ret = wire_read_uint(r, type, &value);
+                span->dropped_links_count = (uint32_t) value;
+                break;
+            case CTR_OTLP_SPAN_FLAGS:
+                ret = wire_read_uint(r, type, &value);
+                span->flags = (uint32_t) value;
+                break;
+            case CTR_OTLP_SPAN_EVENTS:
+            case CTR_OTLP_SPAN_LINKS:
+            case CTR_OTLP_SPAN_STATUS:
+                if (wire_read_bytes(r, type, &sub) != 0) {
+                    return CTR_DECODE_OPENTELEMETRY_CORRUPTED_DATA;
+                }
+
+                if (field == CTR_OTLP_SPAN_EVENTS) {
+                    ret = direct_event(&sub, span);
+                }
+                else if (field == CTR_OTLP_SPAN_LINKS) {
+                    ret = direct_link(&sub, span);
+                }
+                else {
+                    ret = direct_status(&sub, span);
+                }
+
+                if (ret != CTR_DECODE_OPENTELEMETRY_SUCCESS) {
+                    return ret;
+                }
+                break;
+            default:
+                ret = wire_skip(r, type);
+                break;
+        }
+
+        if (ret != 0) {
+            return CTR_DECODE_OPENTELEMETRY_CORRUPTED_DATA;
+        }
+    }
+
+    /* the IDs were set in place */
+    if (ctr_index_span_update(span) != 0) {
+        return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+    }
+
+    return CTR_DECODE_OPENTELEMETRY_SUCCESS;
+}
+
+static int direct_scope_span(struct wire_reader *r, struct ctrace *ctx,
+                             struct ctrace_resource_span *resource_span)
+{
+    int ret;
+    int field;
+    struct wire_reader sub;
+    struct wire_reader schema_url = {0};
+    struct ctrace_scope_span *scope_span;
+
+    scope_span = ctr_scope_span_create(resource_span);
+    if (!scope_span) {
+        return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+    }
+
+    while (r->p < r->end) {
+        ret = direct_field(r, &field, &sub);
+        if (ret != CTR_DECODE_OPENTELEMETRY_SUCCESS) {
+            return ret;
+        }
+
+        switch (field) {
+            case CTR_OTLP_SCOPE_SPANS_SCOPE:
+                ret = direct_instrumentation_scope(&sub, scope_span);
+                break;
+            case CTR_OTLP_SCOPE_SPANS_SPANS:
+                ret = direct_span(&sub, ctx, scope_span);
+                break;
+            case CTR_OTLP_SCOPE_SPANS_SCHEMA_URL:
+                schema_url = sub;
+                ret = CTR_DECODE_OPENTELEMETRY_SUCCESS;
+                break;
+            default:
+                ret = CTR_DECODE_OPENTELEMETRY_SUCCESS;
+                break;
+        }
+
+        if (ret != CTR_DECODE_OPENTELEMETRY_SUCCESS) {
+            return ret;
+        }
+    }
+
+    scope_span->schema_url = cfl_sds_create_len((char *) schema_url.p, wire_len(&schema_url));
+    if (!scope_span->schema_url) {
+        return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+    }
+
+    return CTR_DECODE_OPENTELEMETRY_SUCCESS;
+}
+
+static int direct_resource_span(struct wire_reader *r, struct ctrace *ctx)
+{
+    int ret;
+    int field;
+    int has_resource = CTR_FALSE;
+    struct wire_reader sub;
+    struct wire_reader schema_url = {0};
+    struct ctrace_resource_span *resource_span;
+
+    resource_span = ctr_resource_span_create(ctx);
+    if (!resource_span) {
+        return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+    }
+
+    while (r->p < r->end) {
+        ret = direct_field(r, &field, &sub);
+        if (ret != CTR_DECODE_OPENTELEMETRY_SUCCESS) {
+            return ret;
+        }
+
+        switch (field) {
+            case CTR_OTLP_RESOURCE_SPANS_RESOURCE:
+                ret = direct_resource(&sub, resource_span->resource);
+                has_resource = CTR_TRUE;
+                break;
+            case CTR_OTLP_RESOURCE_SPANS_SCOPE_SPANS:
+                ret = direct_scope_span(&sub, ctx, resource_span);
+                break;
+            case CTR_OTLP_RESOURCE_SPANS_SCHEMA_URL:
+                schema_url = sub;
+                ret = CTR_DECODE_OPENTELEMETRY_SUCCESS;
+                break;
+            default:
+                ret = CTR_DECODE_OPENTELEMETRY_SUCCESS;
+                break;
+        }
+
+        if (ret != CTR_DECODE_OPENTELEMETRY_SUCCESS) {
+            return ret;
+        }
+    }
+
+    if (!has_resource) {
+        return CTR_DECODE_OPENTELEMETRY_INVALID_PAYLOAD;
+    }
+
+    resource_span->schema_url = cfl_sds_create_len((char *) schema_url.p,
+                                                   wire_len(&schema_url));
+    if (!resource_span->schema_url) {
+        return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+    }
+
+    return CTR_DECODE_OPENTELEMETRY_SUCCESS;
+}
+
+int ctr_decode_opentelemetry_direct_create_with_opts(struct ctrace **out_ctr,
+                                                     struct ctrace_opts *opts,
+                                                     char *in_buf,
+                                                     size_t in_size, size_t *offset)
+{
+    int ret;
+    int field;
+    struct ctrace *ctr;
+    struct wire_reader r;
+    struct wire_reader sub;
+
+    if (*offset >= in_size) {
+        return CTR_DECODE_OPENTELEMETRY_INSUFFICIENT_DATA;
+    }
+
+    ctr = ctr_create(opts);
+    if (!ctr) {
+        return CTR_DECODE_OPENTELEMETRY_ALLOCATION_ERROR;
+    }
+
+    r.p = (unsigned char *) &in_buf[*offset];
+    r.end = (unsigned char *) &in_buf[in_size];
+
+    while (r.p < r.end) {
+        ret = direct_field(&r, &field, &sub);
+        if (ret == CTR_DECODE_OPENTELEMETRY_SUCCESS &&
+            field == CTR_OTLP_REQUEST_RESOURCE_SPANS) {
+            ret = direct_resource_span(&sub, ctr);
+        }
+
+        if (ret != CTR_DECODE_OPENTELEMETRY_SUCCESS) {
+            ctr_destroy(ctr);
+            return ret;
+        }
+    }
+
+    /* a protobuf message has no framing, the whole buffer is consumed */
+    *offset = in_size;
+    *out_ctr = ctr;
+
+    return CTR_DECODE_OPENTELEMETRY_SUCCESS;
+}
+
+int ctr_decode_opentelemetry_direct_create(struct ctrace **out_ctr, char *in_buf,
+                                           size_t in_size, size_t *offset)
+{
+    return ctr_decode_opentelemetry_direct_create_with_opts(out_ctr, NULL,
+                                                            in_buf, in_size, offset);
+}
+
 void ctr_decode_opentelemetry_destroy(struct ctrace *ctr)
 {
     ctr_destroy(ctr);
@@ -0,0 +1,613 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <ctraces/ctraces.h>
+#include <ctraces/ctr_encode_json.h>
+#include <ctraces/ctr_writer.h>
+
+#include <math.h>
+
+/*
+ * The document is written in one pass into a ctr_writer, errors are sticky
+ * and reported when the writer is flushed at the end.
+ */
+
+/* escape of every byte: 0 to copy it as is, 'u' for \u00XX */
+static const char json_escape[256] = {
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    0, 0, '"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\\', 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+static const char json_hex[] = "0123456789abcdef";
+
+static const char json_base64[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* 64-bit integers are JSON strings in the protobuf mapping */
+static void json_uint_quoted(struct ctr_writer *w, uint64_t val)
+{
+    ctr_writer_char(w, '"');
+    ctr_writer_uint64(w, val);
+    ctr_writer_char(w, '"');
+}
+
+static void json_double(struct ctr_writer *w, double val)
+{
+    if (isnan(val)) {
+        ctr_writer_lit(w, "\"NaN\"");
+    }
+    else if (isinf(val)) {
+        if (val > 0) {
+            ctr_writer_lit(w, "\"Infinity\"");
+        }
+        else {
+            ctr_writer_lit(w, "\"-Infinity\"");
+        }
+    }
+    else {
+        ctr_writer_double(w, val);
+    }
+}
+
+static void json_string(struct ctr_writer *w, const char *str, size_t len)
+{
+    size_t i;
+    size_t start;
+    unsigned char c;
+    char esc;
+    char *p;
+
+    ctr_writer_char(w, '"');
+
+    start = 0;
+    for (i = 0; i < len; i++) {
+        c = str[i];
+        esc = json_escape[c];
+        if (!esc) {
+            continue;
+        }
+
+        ctr_writer_write(w, str + start, i - start);
+        start = i + 1;
+
+        if (esc != 'u') {
+            p = ctr_writer_reserve(w, 2);
+            if (p) {
+                p[0] = '\\';
+                p[1] = esc;
+                ctr_writer_commit(w, 2);
+            }
+            continue;
+        }
+
+        p = ctr_writer_reserve(w, 6);
+        if (p) {
+            memcpy(p, "\\u00", 4);
+            p[4] = json_hex[c >> 4];
+            p[5] = json_hex[c & 0xf];
+            ctr_writer_commit(w, 6);
+        }
+    }
+
+    ctr_writer_write(w, str + start, len - start);
+    ctr_writer_char(w, '"');
+}
+
+static void json_sds(struct ctr_writer *w, cfl_sds_t str)
+{
+    json_string(w, str, cfl_sds_len(str));
+}
+
+/* trace and span IDs are lowercase hex strings in OTLP/JSON */
+static void json_id(struct ctr_writer *w, struct ctrace_id *cid)
+{
+    ctr_writer_char(w, '"');
+    ctr_writer_hex(w, ctr_id_get_buf(cid), ctr_id_get_len(cid));
+    ctr_writer_char(w, '"');
+}
+
+static void json_base64_string(struct ctr_writer *w, const unsigned char *data, size_t len)
+{
+    size_t i;
+    size_t end;
+    size_t out;
+    uint32_t n;
+    char *p;
+
+    ctr_writer_char(w, '"');
+
+    /* blocks of 3 input bytes, at most one writer chunk at a time */
+    i = 0;
+    while (i + 2 < len) {
+        end = len - (len - i) % 3;
+        if (end - i > CTR_WRITER_CHUNK_SIZE / 4 * 3) {
+            end = i + CTR_WRITER_CHUNK_SIZE / 4 * 3;
+        }
+
+        out = (end - i) / 3 * 4;
+        p = ctr_writer_reserve(w, out);
+        if (!p) {
+            return;
+        }
+
+        for (; i < end; i += 3) {
+            n = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+            *p++ = json_base64[(n >> 18) & 0x3f];
+            *p++ = json_base64[(n >> 12) & 0x3f];
+            *p++ = json_base64[(n >> 6) & 0x3f];
+            *p++ = json_base64[n & 0x3f];
+        }
+        ctr_writer_commit(w, out);
+    }
+
+    p = ctr_writer_reserve(w, 5);
+    if (!p) {
+        return;
+    }
+
+    if (i < len) {
+        n = data[i] << 16;
+        if (i + 1 < len) {
+            n |= data[i + 1] << 8;
+        }
+
+        *p++ = json_base64[(n >> 18) & 0x3f];
+        *p++ = json_base64[(n >> 12) & 0x3f];
+        *p++ = (i + 1 < len) ? json_base64[(n >> 6) & 0x3f] : '=';
+        *p++ = '=';
+        ctr_writer_commit(w, 4);
+    }
+
+    *p = '"';
+    ctr_writer_commit(w, 1);
+}
+
+/* object member name, preceded by a comma unless it is the first one */
+static void json_key(struct ctr_writer *w, int *first, const char *key, size_t len)
+{
+    char *p;
+
+    p = ctr_writer_reserve(w, len + 4);
+    if (!p) {
+        return;
+    }
+
+    if (*first) {
+        *first = CTR_FALSE;
+    }
+    else {
+        *p++ = ',';
+        ctr_writer_commit(w, 1);
+    }
+
+    *p++ = '"';
+    memcpy(p, key, len);
+    p[len] = '"';
+    p[len + 1] = ':';
+    ctr_writer_commit(w, len + 3);
+}
+
+#define json_member(w, first, key)   json_key(w, first, key, sizeof(key) - 1)
+
+static void format_kvlist(struct ctr_writer *w, struct cfl_kvlist *kv);
+
+static void format_any_value(struct ctr_writer *w, struct cfl_variant *v)
+{
+    size_t i;
+    struct cfl_array *array;
+
+    switch (v->type) {
+        case CFL_VARIANT_STRING:
+            ctr_writer_lit(w, "{\"stringValue\":");
+            json_sds(w, v->data.as_string);
+            break;
+        case CFL_VARIANT_BOOL:
+            if (v->data.as_bool) {
+                ctr_writer_lit(w, "{\"boolValue\":true");
+            }
+            else {
+                ctr_writer_lit(w, "{\"boolValue\":false");
+            }
+            break;
+        case CFL_VARIANT_INT:
+            ctr_writer_lit(w, "{\"intValue\":\"");
+            ctr_writer_int64(w, v->data.as_int64);
+            ctr_writer_char(w, '"');
+            break;
+        case CFL_VARIANT_UINT:
+            ctr_writer_lit(w, "{\"intValue\":");
+            json_uint_quoted(w, v->data.as_uint64);
+            break;
+        case CFL_VARIANT_DOUBLE:
+            ctr_writer_lit(w, "{\"doubleValue\":");
+            json_double(w, v->data.as_double);
+            break;
+        case CFL_VARIANT_BYTES:
+            ctr_writer_lit(w, "{\"bytesValue\":");
+            json_base64_string(w, (unsigned char *) v->data.as_bytes,
+                               cfl_sds_len(v->data.as_bytes));
+            break;
+        case CFL_VARIANT_ARRAY:
+            array = v->data.as_array;
+            ctr_writer_lit(w, "{\"arrayValue\":{\"values\":[");
+            for (i = 0; i < array->entry_count; i++) {
+                if (i > 0) {
+                    ctr_writer_char(w, ',');
+                }
+                format_any_value(w, array->entries[i]);
+            }
+            ctr_writer_lit(w, "]}");
+            break;
+        case CFL_VARIANT_KVLIST:
+            ctr_writer_lit(w, "{\"kvlistValue\":{\"values\":");
+            format_kvlist(w, v->data.as_kvlist);
+            ctr_writer_char(w, '}');
+            break;
+        default:
+            /* values without an OTLP representation are left empty */
+            ctr_writer_char(w, '{');
+            break;
+    }
+
+    ctr_writer_char(w, '}');
+}
+
+static void format_kvlist(struct ctr_writer *w, struct cfl_kvlist *kv)
+{
+    int first = CTR_TRUE;
+    struct cfl_list *head;
+    struct cfl_kvpair *pair;
+
+    ctr_writer_char(w, '[');
+
+    cfl_list_foreach(head, &kv->list) {
+        pair = cfl_list_entry(head, struct cfl_kvpair, _head);
+
+        if (!first) {
+            ctr_writer_char(w, ',');
+        }
+        first = CTR_FALSE;
+
+        ctr_writer_lit(w, "{\"key\":");
+        json_sds(w, pair->key);
+        ctr_writer_lit(w, ",\"value\":");
+        format_any_value(w, pair->val);
+        ctr_writer_char(w, '}');
+    }
+
+    ctr_writer_char(w, ']');
+}
+
+/* 'attributes' and 'droppedAttributesCount' members, omitted when empty */
+static void format_attributes(struct ctr_writer *w, int *first,
+                              struct ctrace_attributes *attr, uint32_t dropped)
+{
+    if (attr && ctr_attributes_count(attr) > 0) {
+        json_member(w, first, "attributes");
+        format_kvlist(w, attr->kv);
+    }
+
+    if (dropped > 0) {
+        json_member(w, first, "droppedAttributesCount");
+        ctr_writer_uint64(w, dropped);
+    }
+}
+
+static void format_event(struct ctr_writer *w, struct ctrace_span_event *event)
+{
+    int first = CTR_TRUE;
+
+    ctr_writer_char(w, '{');
+
+    json_member(w, &first, "timeUnixNano");
+    json_uint_quoted(w, event->time_unix_nano);
+
+    if (event->name) {
+        json_member(w, &first, "name");
+        json_sds(w, event->name);
+    }
+
+    format_attributes(w, &first, event->attr, event->dropped_attr_count);
+
+    ctr_writer_char(w, '}');
+}
+
+static void format_link(struct ctr_writer *w, struct ctrace_link *link)
+{
+    int first = CTR_TRUE;
+
+    ctr_writer_char(w, '{');
+
+    if (link->trace_id) {
+        json_member(w, &first, "traceId");
+        json_id(w, link->trace_id);
+    }
+
+    if (link->span_id) {
+        json_member(w, &first, "spanId");
+        json_id(w, link->span_id);
+    }
+
+    if (link->trace_state) {
+        json_member(w, &first, "traceState");
+        json_sds(w, link->trace_state);
+    }
+
+    format_attributes(w, &first, link->attr, link->dropped_attr_count);
+
+    if (link->flags) {
+        json_member(w, &first, "flags");
+        ctr_writer_uint64(w, link->flags);
+    }
+
+    ctr_writer_char(w, '}');
+}
+
+static void format_span(struct ctr_writer *w, struct ctrace_span *span)
+{
+    int first = CTR_TRUE;
+    int count;
+    struct cfl_list *head;
+    struct ctrace_span_event *event;
+    struct ctrace_link *link;
+
+    ctr_writer_char(w, '{');
+
+    if (span->trace_id) {
+        json_member(w, &first, "traceId");
+        json_id(w, span->trace_id);
+    }
+
+    if (span->span_id) {
+        json_member(w, &first, "spanId");
+        json_id(w, span->span_id);
+    }
+
+    if (span->trace_state) {
+        json_member(w, &first, "traceState");
+        json_sds(w, span->trace_state);
+    }
+
+    if (span->parent_span_id) {
+        json_member(w, &first, "parentSpanId");
+        json_id(w, span->parent_span_id);
+    }
+
+    if (span->flags) {
+        json_member(w, &first, "flags");
+        ctr_writer_uint64(w, (uint32_t) span->flags);
+    }
+
+    if (span->name) {
+        json_member(w, &first, "name");
+        json_sds(w, span->name);
+    }
+
+    /* the span kinds and status codes share the OTLP enum values */
+    json_member(w, &first, "kind");
+    ctr_writer_int64(w, span->kind);
+
+    json_member(w, &first, "startTimeUnixNano");
+    json_uint_quoted(w, span->start_time_unix_nano);
+
+    json_member(w, &first, "endTimeUnixNano");
+    json_uint_quoted(w, span->end_time_unix_nano);
+
+    format_attributes(w, &first, span->attr, span->dropped_attr_count);
+
+    if (!cfl_list_is_empty(&span->events)) {
+        json_member(w, &first, "events");
+        ctr_writer_char(w, '[');
+        count = 0;
+        cfl_list_foreach(head, &span->events) {
+            event = cfl_list_entry(head, struct ctrace_span_event, _head);
+            if (count++ > 0) {
+                ctr_writer_char(w, ',');
+            }
+            format_event(w, event);
+        }
+        ctr_writer_char(w, ']');
+    }
+
+    if (span->dropped_events_count > 0) {
+        json_member(w, &first, "droppedEventsCount");
+        ctr_writer_uint64(w, span->dropped_events_count);
+    }
+
+    if (!cfl_list_is_empty(&span->links)) {
+        json_member(w, &first, "links");
+        ctr_writer_char(w, '[');
+        count = 0;
+        cfl_list_foreach(head, &span->links) {
+            link = cfl_list_entry(head, struct ctrace_link, _head);
+            if (count++ > 0) {
+                ctr_writer_char(w, ',');
+            }
+            format_link(w, link);
+        }
+        ctr_writer_char(w, ']');
+    }
+
+    if (span->dropped_links_count > 0) {
+        json_member(w, &first, "droppedLinksCount");
+        ctr_writer_uint64(w, span->dropped_links_count);
+    }
+
+    json_member(w, &first, "status");
+    ctr_writer_char(w, '{');
+    if (span->status.message) {
+        ctr_writer_lit(w, "\"message\":");
+        json_sds(w, span->status.message);
+        ctr_writer_char(w, ',');
+    }
+    ctr_writer_lit(w, "\"code\":");
+    ctr_writer_int64(w, span->status.code);
+    ctr_writer_char(w, '}');
+
+    ctr_writer_char(w, '}');
+}
+
+static void format_scope(struct ctr_writer *w, struct ctrace_instrumentation_scope *scope)
+{
+    int first = CTR_TRUE;
+
+    ctr_writer_char(w, '{');
+
+    if (scope->name) {
+        json_member(w, &first, "name");
+        json_sds(w, scope->name);
+    }
+
+    if (scope->version) {
+        json_member(w, &first, "version");
+        json_sds(w, scope->version);
+    }
+
+    format_attributes(w, &first, scope->attr, scope->dropped_attr_count);
+
+    ctr_writer_char(w, '}');
+}
+
+static void format_scope_span(struct ctr_writer *w, struct ctrace_scope_span *scope_span)
+{
+    int first = CTR_TRUE;
+    int count = 0;
+    struct cfl_list *head;
+    struct ctrace_span *span;
+
+    ctr_writer_char(w, '{');
+
+    if (scope_span->instrumentation_scope) {
+        json_member(w, &first, "scope");
+        format_scope(w, scope_span->instrumentation_scope);
+    }
+
+    json_member(w, &first, "spans");
+    ctr_writer_char(w, '[');
+    cfl_list_foreach(head, &scope_span->spans) {
+        span = cfl_list_entry(head, struct ctrace_span, _head);
+        if (count++ > 0) {
+            ctr_writer_char(w, ',');
+        }
+        format_span(w, span);
+    }
+    ctr_writer_char(w, ']');
+
+    if (scope_span->schema_url) {
+        json_member(w, &first, "schemaUrl");
+        json_sds(w, scope_span->schema_url);
+    }
+
+    ctr_writer_char(w, '}');
+}
+
+static void format_resource_span(struct ctr_writer *w,
+                                 struct ctrace_resource_span *resource_span)
+{
+    int first = CTR_TRUE;
+    int count = 0;
+    int r_first = CTR_TRUE;
+    struct cfl_list *head;
+    struct ctrace_resource *resource;
+    struct ctrace_scope_span *scope_span;
+
+    ctr_writer_char(w, '{');
+
+    resource = resource_span->resource;
+    if (resource) {
+        json_member(w, &first, "resource");
+        ctr_writer_char(w, '{');
+        format_attributes(w, &r_first, resource->attr, resource->dropped_attr_count);
+        ctr_writer_char(w, '}');
+    }
+
+    json_member(w, &first, "scopeSpans");
+    ctr_writer_char(w, '[');
+    cfl_list_foreach(head, &resource_span->scope_spans) {
+        scope_span = cfl_list_entry(head, struct ctrace_scope_span, _head);
+        if (count++ > 0) {
+            ctr_writer_char(w, ',');
+        }
+        format_scope_span(w, scope_span);
+    }
+    ctr_writer_char(w, ']');
+
+    if (resource_span->schema_url) {
+        json_member(w, &first, "schemaUrl");
+        json_sds(w, resource_span->schema_url);
+    }
+
+    ctr_writer_char(w, '}');
+}
+
+int ctr_encode_json_write(struct ctrace *ctx, struct ctr_writer *writer)
+{
+    int count = 0;
+    struct cfl_list *head;
+    struct ctrace_resource_span *resource_span;
+
+    ctr_writer_lit(writer, "{\"resourceSpans\":[");
+    cfl_list_foreach(head, &ctx->resource_spans) {
+        resource_span = cfl_list_entry(head, struct ctrace_resource_span, _head);
+        if (count++ > 0) {
+            ctr_writer_char(writer, ',');
+        }
+        format_resource_span(writer, resource_span);
+    }
+    ctr_writer_lit(writer, "]}");
+
+    return ctr_writer_flush(writer);
+}
+
+cfl_sds_t ctr_encode_json_create(struct ctrace *ctx)
+{
+    cfl_sds_t buf = NULL;
+    struct ctr_writer *writer;
+
+    writer = ctr_writer_buffer_create(4096);
+    if (!writer) {
+        return NULL;
+    }
+
+    if (ctr_encode_json_write(ctx, writer) == 0) {
+        buf = ctr_writer_buffer_take(writer);
+    }
+    ctr_writer_destroy(writer);
+
+    return buf;
+}
+
+void ctr_encode_json_destroy(cfl_sds_t json)
+{
+    cfl_sds_destroy(json);
+}
@@ -18,6 +18,7 @@
  */
 
 #include <ctraces/ctraces.h>
+#include <ctraces/ctr_base16.h>
 
 /* local declarations */
 static void pack_variant(mpack_writer_t *writer, struct cfl_variant *variant);
@@ -181,28 +182,33 @@ static void pack_instrumentation_scope(mpack_writer_t *writer, struct ctrace_ins
 
 static void pack_id(mpack_writer_t *writer, struct ctrace_id *id)
 {
-    cfl_sds_t encoded_id;
+    size_t         len;
+    size_t         chunk;
+    unsigned char *buf;
+    char           hex[64];
 
+    if (id == NULL || ctr_id_get_len(id) == 0) {
+        mpack_write_nil(writer);
+        return;
+    }
 
-    if (id) {
-        encoded_id = ctr_id_to_lower_base16(id);
+    len = ctr_id_get_len(id);
+    buf = ctr_id_get_buf(id);
 
-        if (encoded_id != NULL) {
-            mpack_write_cstr(writer, encoded_id);
+    /* hex digits are written straight to the writer, long IDs in chunks */
+    mpack_start_str(writer, len * 2);
 
-            cfl_sds_destroy(encoded_id);
-        }
-        else {
-            /* we should be able to report this but at the moment
-             * we are not.
-             */
+    while (len > 0) {
+        chunk = len < sizeof(hex) / 2 ? len : sizeof(hex) / 2;
 
-            mpack_write_nil(writer);
-        }
-    }
-    else {
-        mpack_write_nil(writer);
+        ctr_base16_encode(buf, chunk, hex);
+        mpack_write_bytes(writer, hex, chunk * 2);
+
+        buf += chunk;
+        len -= chunk;
     }
+
+    mpack_finish_str(writer);
 }
 
 static void pack_events(mpack_writer_t *writer, struct cfl_list *events)
@@ -467,77 +473,83 @@ static void pack_scope_spans(mpack_writer_t *writer, struct cfl_list *scope_span
     mpack_finish_array(writer);
 }
 
-int ctr_encode_msgpack_create(struct ctrace *ctx,  char **out_buf, size_t *out_size)
+static void pack_context(mpack_writer_t *writer, struct ctrace *ctx)
 {
     int count;
-    char *data;
-    size_t size;
-    mpack_writer_t writer;
     struct cfl_list *head;
     struct ctrace_resource_span *resource_span;
     struct ctrace_resource *resource;
 
-    if (ctx == NULL) {
-        return -1;
-    }
-
-    mpack_writer_init_growable(&writer, &data, &size);
-
     /* root map */
-    mpack_start_map(&writer, 1);
+    mpack_start_map(writer, 1);
 
     /* resourceSpan */
-    mpack_write_cstr(&writer, "resourceSpans");
+    mpack_write_cstr(writer, "resourceSpans");
 
     /* array */
     count = cfl_list_size(&ctx->resource_spans);
-    mpack_start_array(&writer, count);
+    mpack_start_array(writer, count);
 
     cfl_list_foreach(head, &ctx->resource_spans) {
         resource_span = cfl_list_entry(head, struct ctrace_resource_span, _head);
 
         /* resourceSpans is an array of maps, each maps containers a 'resource', 'schema_url' and 'scopeSpans' entry */
-        mpack_start_map(&writer, 3);
+        mpack_start_map(writer, 3);
 
         /* resource key */
         resource = resource_span->resource;
-        mpack_write_cstr(&writer, "resource");
+        mpack_write_cstr(writer, "resource");
 
         /* resource val */
-        mpack_start_map(&writer, 2);
+        mpack_start_map(writer, 2);
 
         /* resource[0]: attributes */
-        mpack_write_cstr(&writer, "attributes");
+        mpack_write_cstr(writer, "attributes");
         if (resource->attr) {
-            pack_attributes(&writer, resource->attr);
+            pack_attributes(writer, resource->attr);
         }
         else {
-            mpack_write_nil(&writer);
+            mpack_write_nil(writer);
         }
 
         /* resource[1]: dropped_attributes_count */
-        mpack_write_cstr(&writer, "dropped_attributes_count");
-        mpack_write_u32(&writer, resource->dropped_attr_count);
+        mpack_write_cstr(writer, "dropped_attributes_count");
+        mpack_write_u32(writer, resource->dropped_attr_count);
 
-        mpack_finish_map(&writer);
+        mpack_finish_map(writer);
 
         /* schema_url */
-        mpack_write_cstr(&writer, "schema_url");
+        mpack_write_cstr(writer, "schema_url");
         if (resource_span->schema_url) {
-            mpack_write_str(&writer, resource_span->schema_url, cfl_sds_len(resource_span->schema_url));
+            mpack_write_str(writer, resource_span->schema_url, cfl_sds_len(resource_span->schema_url));
         }
         else {
-            mpack_write_nil(&writer);
+            mpack_write_nil(writer);
         }
 
         /* scopeSpans */
-        pack_scope_spans(&writer, &resource_span->scope_spans);
+        pack_scope_spans(writer, &resource_span->scope_spans);
+
+        mpack_finish_map(writer); /* !resourceSpans map value */
+    }
+
+    mpack_finish_array(writer);
+    mpack_finish_map(writer);
+}
+
+int ctr_encode_msgpack_create(struct ctrace *ctx,  char **out_buf, size_t *out_size)
+{
+    char *data;
+    size_t size;
+    mpack_writer_t writer;
 
-        mpack_finish_map(&writer); /* !resourceSpans map value */
+    if (ctx == NULL) {
+        return -1;
     }
 
-    mpack_finish_array(&writer);
-    mpack_finish_map(&writer);
+    mpack_writer_init_growable(&writer, &data, &size);
+
+    pack_context(&writer, ctx);
 
     if (mpack_writer_destroy(&writer) != mpack_ok) {
         fprintf(stderr, "An error occurred encoding the data!\n");
@@ -550,6 +562,73 @@ int ctr_encode_msgpack_create(struct ctrace *ctx,  char **out_buf, size_t *out_s
     return 0;
 }
 
+/* flush callback used by the sizing pass: count the bytes and drop them */
+static void count_flush(mpack_writer_t *writer, const char *buffer, size_t count)
+{
+    size_t *total;
+
+    (void) buffer;
+
+    total = mpack_writer_context(writer);
+    *total += count;
+}
+
+/*
+ * Return the exact number of bytes ctr_encode_msgpack_create() would produce
+ * for the context, or -1 on error. The data is encoded into a small stack
+ * buffer that is discarded on every flush, nothing is allocated.
+ */
+ssize_t ctr_encode_msgpack_size(struct ctrace *ctx)
+{
+    char buf[MPACK_BUFFER_SIZE];
+    size_t total = 0;
+    mpack_writer_t writer;
+
+    if (ctx == NULL) {
+        return -1;
+    }
+
+    mpack_writer_init(&writer, buf, sizeof(buf));
+    mpack_writer_set_context(&writer, &total);
+    mpack_writer_set_flush(&writer, count_flush);
+
+    pack_context(&writer, ctx);
+
+    /* flushes the remaining bytes */
+    if (mpack_writer_destroy(&writer) != mpack_ok) {
+        return -1;
+    }
+
+    return total;
+}
+
+/*
+ * Encode the context into a caller provided buffer. On success the number of
+ * bytes written is stored in 'out_size'. If the buffer is too small -1 is
+ * returned, use ctr_encode_msgpack_size() to get the required size first.
+ */
+int ctr_encode_msgpack_to_buffer(struct ctrace *ctx, char *buf, size_t size,
+                                 size_t *out_size)
+{
+    mpack_writer_t writer;
+
+    if (ctx == NULL || buf == NULL) {
+        return -1;
+    }
+
+    mpack_writer_init(&writer, buf, size);
+
+    pack_context(&writer, ctx);
+
+    *out_size = mpack_writer_buffer_used(&writer);
+
+    if (mpack_writer_destroy(&writer) != mpack_ok) {
+        return -1;
+    }
+
+    return 0;
+}
+
 void ctr_encode_msgpack_destroy(char *buf)
 {
     free(buf);
@@ -19,6 +19,7 @@
 
 #include <ctraces/ctraces.h>
 #include <fluent-otel-proto/fluent-otel.h>
+#include <ctraces/ctr_otlp_wire.h>
 
 static void destroy_scope_spans(Opentelemetry__Proto__Trace__V1__ScopeSpans **scope_spans,
                          size_t count);
@@ -1340,6 +1341,102 @@ cfl_sds_t ctr_encode_opentelemetry_create(struct ctrace *ctr)
     return buf;
 }
 
+cfl_sds_t ctr_encode_opentelemetry_direct_create(struct ctrace *ctr)
+{
+    int ret;
+    ssize_t len;
+    cfl_sds_t buf;
+    struct ctr_otlp_wire wire;
+
+    ctr_otlp_wire_init(&wire);
+
+    len = ctr_otlp_wire_size_request(&wire, ctr);
+    if (len < 0) {
+        ctr_otlp_wire_exit(&wire);
+        return NULL;
+    }
+
+    buf = cfl_sds_create_size(len);
+    if (!buf) {
+        ctr_otlp_wire_exit(&wire);
+        return NULL;
+    }
+
+    ctr_otlp_wire_set_buffer(&wire, buf, len);
+    ret = ctr_otlp_wire_write_request(&wire, ctr);
+    if (ret != 0 || wire.buf_len != (size_t) len) {
+        ctr_otlp_wire_exit(&wire);
+        cfl_sds_destroy(buf);
+        return NULL;
+    }
+    cfl_sds_set_len(buf, len);
+
+    ctr_otlp_wire_exit(&wire);
+
+    return buf;
+}
+
+int ctr_encode_opentelemetry_split(struct ctrace *ctr, size_t max_size,
+                                   ctr_encode_opentelemetry_chunk_fn_t cb, void *data)
+{
+    int ret;
+    struct ctr_otlp_wire wire;
+
+    if (!ctr || !cb || max_size == 0) {
+        return -1;
+    }
+
+    ctr_otlp_wire_init(&wire);
+    ret = ctr_otlp_wire_split_request(&wire, ctr, max_size, cb, data);
+    ctr_otlp_wire_exit(&wire);
+
+    return ret;
+}
+
+int ctr_encode_opentelemetry_write(struct ctrace *ctr, struct ctr_writer *writer)
+{
+    int ret;
+    struct ctr_otlp_wire wire;
+
+    if (!ctr || !writer) {
+        return -1;
+    }
+
+    ctr_otlp_wire_init(&wire);
+    ret = ctr_otlp_wire_stream_request(&wire, ctr, writer);
+    ctr_otlp_wire_exit(&wire);
+
+    return ret;
+}
+
+int ctr_encode_opentelemetry_stream(struct ctrace *ctr, size_t chunk_size,
+                                    ctr_writer_cb_t cb, void *data)
+{
+    int ret;
+    struct ctr_writer *writer;
+
+    if (!ctr || !cb) {
+        return -1;
+    }
+
+    if (chunk_size == 0) {
+        chunk_size = CTR_ENCODE_OPENTELEMETRY_CHUNK_SIZE;
+    }
+
+    writer = ctr_writer_callback_create(cb, data);
+    if (!writer) {
+        return -1;
+    }
+
+    ret = ctr_writer_set_chunk_size(writer, chunk_size);
+    if (ret == 0) {
+        ret = ctr_encode_opentelemetry_write(ctr, writer);
+    }
+    ctr_writer_destroy(writer);
+
+    return ret;
+}
+
 void ctr_encode_opentelemetry_destroy(cfl_sds_t text)
 {
     cfl_sds_destroy(text);
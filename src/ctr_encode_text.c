@@ -18,382 +18,359 @@
  */
 
 #include <ctraces/ctraces.h>
+#include <ctraces/ctr_writer.h>
 
-static inline void sds_cat_safe(cfl_sds_t *buf, char *str)
+/* unset strings print as printf's "%s" did */
+static void format_sds(struct ctr_writer *w, cfl_sds_t str)
 {
-    int len;
+    if (!str) {
+        ctr_writer_lit(w, "(null)");
+        return;
+    }
 
-    len = strlen(str);
-    cfl_sds_cat_safe(buf, str, len);
+    ctr_writer_write(w, str, cfl_sds_len(str));
 }
 
-static void format_string(cfl_sds_t *buf, cfl_sds_t val, int level)
-{
-    char tmp[1024];
+/* indentation followed by a literal label */
+#define format_label(w, off, str)               \
+    do {                                        \
+        ctr_writer_pad(w, ' ', off);            \
+        ctr_writer_lit(w, str);                 \
+    } while (0)
 
-    snprintf(tmp, sizeof(tmp) - 1, "'%s'", val);
-    sds_cat_safe(buf, tmp);
+static void format_string(struct ctr_writer *w, cfl_sds_t val, int level)
+{
+    ctr_writer_char(w, '\'');
+    format_sds(w, val);
+    ctr_writer_char(w, '\'');
 }
 
-static void format_int64(cfl_sds_t *buf, int64_t val, int level)
+static void format_int64(struct ctr_writer *w, int64_t val, int level)
 {
-    char tmp[1024];
-
-    snprintf(tmp, sizeof(tmp) - 1, "%" PRIi64, val);
-    sds_cat_safe(buf, tmp);
+    ctr_writer_int64(w, val);
 }
 
-static void format_double(cfl_sds_t *buf, double val, int level)
+static void format_double(struct ctr_writer *w, double val, int level)
 {
-    char tmp[1024];
-
-    snprintf(tmp, sizeof(tmp) - 1, "%.17g", val);
-    sds_cat_safe(buf, tmp);
+    ctr_writer_double(w, val);
 }
 
-static void format_bool(cfl_sds_t *buf, int val, int level)
+static void format_bool(struct ctr_writer *w, int val, int level)
 {
     if (val) {
-        sds_cat_safe(buf, "true");
+        ctr_writer_lit(w, "true");
     }
     else {
-        sds_cat_safe(buf, "false");
+        ctr_writer_lit(w, "false");
     }
 }
 
-static void format_array(cfl_sds_t *buf, struct cfl_array *array, int level)
+static void format_array(struct ctr_writer *w, struct cfl_array *array, int level)
 {
-    int i;
+    size_t i;
     int off = level + 4;
-    char tmp[128];
     struct cfl_variant *v;
 
-    sds_cat_safe(buf, "[\n");
-
-    snprintf(tmp, sizeof(tmp) - 1, "%*s", off, "");
+    ctr_writer_lit(w, "[\n");
 
     for (i = 0; i < array->entry_count; i++) {
         v = array->entries[i];
 
-        sds_cat_safe(buf, tmp);
+        ctr_writer_pad(w, ' ', off);
 
         if (v->type == CFL_VARIANT_STRING) {
-            format_string(buf, v->data.as_string, off);
+            format_string(w, v->data.as_string, off);
         }
         else if (v->type == CFL_VARIANT_BOOL) {
-            format_bool(buf, v->data.as_bool, off);
+            format_bool(w, v->data.as_bool, off);
         }
         else if (v->type == CFL_VARIANT_INT) {
-            format_int64(buf, v->data.as_int64, off);
+            format_int64(w, v->data.as_int64, off);
         }
         else if (v->type == CFL_VARIANT_DOUBLE) {
-            format_double(buf, v->data.as_double, off);
+            format_double(w, v->data.as_double, off);
         }
         else if (v->type == CFL_VARIANT_ARRAY) {
-            format_array(buf, v->data.as_array, off);
+            format_array(w, v->data.as_array, off);
         }
 
         if (i + 1 < array->entry_count) {
-            sds_cat_safe(buf, ",\n");
+            ctr_writer_lit(w, ",\n");
         }
     }
 
-    off = level;
-    snprintf(tmp, sizeof(tmp) - 1, "\n%*s]", off, "");
-    sds_cat_safe(buf, tmp);
+    ctr_writer_char(w, '\n');
+    format_label(w, level, "]");
 }
 
-static void format_attributes(cfl_sds_t *buf, struct cfl_kvlist *kv, int level)
+static void format_attributes(struct ctr_writer *w, struct cfl_kvlist *kv, int level)
 {
     int off = level + 4;
-    char tmp[1024];
     struct cfl_list *head;
     struct cfl_kvpair *p;
     struct cfl_variant *v;
 
-    sds_cat_safe(buf, "\n");
+    ctr_writer_char(w, '\n');
 
     cfl_list_foreach(head, &kv->list) {
         p = cfl_list_entry(head, struct cfl_kvpair, _head);
 
         /* key */
-        snprintf(tmp, sizeof(tmp) - 1, "%*s- %s: ", off, "", p->key);
-        sds_cat_safe(buf, tmp);
+        format_label(w, off, "- ");
+        format_sds(w, p->key);
+        ctr_writer_lit(w, ": ");
 
         /* value */
         v = p->val;
         if (v->type == CFL_VARIANT_STRING) {
-            format_string(buf, v->data.as_string, off);
+            format_string(w, v->data.as_string, off);
         }
         else if (v->type == CFL_VARIANT_BOOL) {
-            format_bool(buf, v->data.as_bool, off);
+            format_bool(w, v->data.as_bool, off);
         }
         else if (v->type == CFL_VARIANT_INT) {
-            format_int64(buf, v->data.as_int64, off);
+            format_int64(w, v->data.as_int64, off);
         }
         else if (v->type == CFL_VARIANT_DOUBLE) {
-            format_double(buf, v->data.as_double, off);
+            format_double(w, v->data.as_double, off);
         }
         else if (v->type == CFL_VARIANT_ARRAY) {
-            format_array(buf, v->data.as_array, off);
+            format_array(w, v->data.as_array, off);
         }
         else if (v->type == CFL_VARIANT_KVLIST) {
-            format_attributes(buf, v->data.as_kvlist, off);
+            format_attributes(w, v->data.as_kvlist, off);
         }
 
-        sds_cat_safe(buf, "\n");
+        ctr_writer_char(w, '\n');
     }
 }
 
-static void format_event(cfl_sds_t *buf, struct ctrace_span_event *event, int level)
+static void format_event(struct ctr_writer *w, struct ctrace_span_event *event, int level)
 {
     int off = level + 4;
-    char tmp[1024];
 
-    sds_cat_safe(buf, "\n");
+    ctr_writer_char(w, '\n');
 
-    snprintf(tmp, sizeof(tmp) - 1, "%*s- name: %s\n", off, "", event->name);
-    sds_cat_safe(buf, tmp);
+    format_label(w, off, "- name: ");
+    format_sds(w, event->name);
+    ctr_writer_char(w, '\n');
     off += 4;
 
-    snprintf(tmp, sizeof(tmp) - 1, "%*s- timestamp               : %" PRIu64 "\n", off, "", event->time_unix_nano);
-    sds_cat_safe(buf, tmp);
+    format_label(w, off, "- timestamp               : ");
+    ctr_writer_uint64(w, event->time_unix_nano);
+    ctr_writer_char(w, '\n');
 
-    snprintf(tmp, sizeof(tmp) - 1, "%*s- dropped_attributes_count: %" PRIu32 "\n", off, "", event->dropped_attr_count);
-    sds_cat_safe(buf, tmp);
+    format_label(w, off, "- dropped_attributes_count: ");
+    ctr_writer_uint64(w, event->dropped_attr_count);
+    ctr_writer_char(w, '\n');
 
     if (ctr_attributes_count(event->attr) > 0) {
-
-        snprintf(tmp, sizeof(tmp) - 1, "%*s- attributes:", off, "");
-        sds_cat_safe(buf, tmp);
-
-        format_attributes(buf, event->attr->kv, off);
+        format_label(w, off, "- attributes:");
+        format_attributes(w, event->attr->kv, off);
     }
     else {
-        snprintf(tmp, sizeof(tmp) - 1, "%*s- attributes: none\n", off, "");
-        sds_cat_safe(buf, tmp);
+        format_label(w, off, "- attributes: none\n");
     }
+}
 
+/* hex representation of an ID, or 'def' if the ID is not set */
+static void format_id(struct ctr_writer *w, struct ctrace_id *cid, char *def)
+{
+    if (!cid) {
+        ctr_writer_str(w, def);
+    }
+    else {
+        ctr_writer_hex(w, ctr_id_get_buf(cid), ctr_id_get_len(cid));
+    }
+    ctr_writer_char(w, '\n');
 }
 
-static void format_span(cfl_sds_t *buf, struct ctrace *ctx, int id, struct ctrace_span *span, int level)
+static void format_span(struct ctr_writer *w, struct ctrace *ctx, int id,
+                        struct ctrace_span *span, int level)
 {
     int min;
     int off = 1 + (level * 4);
-    char tmp[1024];
-    cfl_sds_t id_hex;
     struct ctrace_span_event *event;
     struct ctrace_link *link;
     struct cfl_list *head;
 
     min = off + 4;
 
-    snprintf(tmp, sizeof(tmp) - 1, "%*s[span #%i '%s']\n", off, "", id, span->name);
-    sds_cat_safe(buf, tmp);
+    format_label(w, off, "[span #");
+    ctr_writer_int64(w, id);
+    ctr_writer_lit(w, " '");
+    format_sds(w, span->name);
+    ctr_writer_lit(w, "']\n");
 
-    /* trace_id */
-    if (span->trace_id) {
-        id_hex = ctr_id_to_lower_base16(span->trace_id);
-    }
-    else {
-        id_hex = cfl_sds_create(CTR_ID_TRACE_DEFAULT);
-    }
-    snprintf(tmp, sizeof(tmp) - 1, "%*s- trace_id                : %s\n", min, "", id_hex);
-    sds_cat_safe(buf, tmp);
-    cfl_sds_destroy(id_hex);
+    format_label(w, min, "- trace_id                : ");
+    format_id(w, span->trace_id, CTR_ID_TRACE_DEFAULT);
 
-    /* span_id */
-    if (span->span_id) {
-        id_hex = ctr_id_to_lower_base16(span->span_id);
-    }
-    else {
-        id_hex = cfl_sds_create(CTR_ID_SPAN_DEFAULT);
-    }
-    snprintf(tmp, sizeof(tmp) - 1, "%*s- span_id                 : %s\n", min, "", id_hex);
-    sds_cat_safe(buf, tmp);
-    cfl_sds_destroy(id_hex);
+    format_label(w, min, "- span_id                 : ");
+    format_id(w, span->span_id, CTR_ID_SPAN_DEFAULT);
 
-    /* parent_span_id */
-    if (span->parent_span_id) {
-        id_hex = ctr_id_to_lower_base16(span->parent_span_id);
-    }
-    else {
-        id_hex = cfl_sds_create("undefined");
-    }
-    snprintf(tmp, sizeof(tmp) - 1, "%*s- parent_span_id          : %s\n", min, "", id_hex);
-    sds_cat_safe(buf, tmp);
-    cfl_sds_destroy(id_hex);
+    format_label(w, min, "- parent_span_id          : ");
+    format_id(w, span->parent_span_id, "undefined");
 
-    snprintf(tmp, sizeof(tmp) - 1, "%*s- kind                    : %i (%s)\n", min, "",
-             span->kind, ctr_span_kind_string(span));
-    sds_cat_safe(buf, tmp);
+    format_label(w, min, "- kind                    : ");
+    ctr_writer_int64(w, span->kind);
+    ctr_writer_lit(w, " (");
+    ctr_writer_str(w, ctr_span_kind_string(span));
+    ctr_writer_lit(w, ")\n");
 
-    snprintf(tmp, sizeof(tmp) - 1, "%*s- start_time              : %" PRIu64 "\n", min, "",
-             span->start_time_unix_nano);
-    sds_cat_safe(buf, tmp);
+    format_label(w, min, "- start_time              : ");
+    ctr_writer_uint64(w, span->start_time_unix_nano);
+    ctr_writer_char(w, '\n');
 
-    snprintf(tmp, sizeof(tmp) - 1, "%*s- end_time                : %" PRIu64 "\n", min, "",
-             span->end_time_unix_nano);
-    sds_cat_safe(buf, tmp);
+    format_label(w, min, "- end_time                : ");
+    ctr_writer_uint64(w, span->end_time_unix_nano);
+    ctr_writer_char(w, '\n');
 
-    snprintf(tmp, sizeof(tmp) - 1, "%*s- dropped_attributes_count: %" PRIu32 "\n", min, "",
-             span->dropped_attr_count);
-    sds_cat_safe(buf, tmp);
+    format_label(w, min, "- dropped_attributes_count: ");
+    ctr_writer_uint64(w, span->dropped_attr_count);
+    ctr_writer_char(w, '\n');
 
-    snprintf(tmp, sizeof(tmp) - 1, "%*s- dropped_events_count    : %" PRIu32 "\n", min, "",
-             span->dropped_events_count);
-    sds_cat_safe(buf, tmp);
+    format_label(w, min, "- dropped_events_count    : ");
+    ctr_writer_uint64(w, span->dropped_events_count);
+    ctr_writer_char(w, '\n');
 
-    snprintf(tmp, sizeof(tmp) - 1, "%*s- dropped_links_count     : %" PRIu32 "\n", min, "",
-             span->dropped_links_count);
-    sds_cat_safe(buf, tmp);
+    format_label(w, min, "- dropped_links_count     : ");
+    ctr_writer_uint64(w, span->dropped_links_count);
+    ctr_writer_char(w, '\n');
 
-    /* trace_state */
-    snprintf(tmp, sizeof(tmp) - 1, "%*s- trace_state             : %s\n", min, "", span->trace_state);
-    sds_cat_safe(buf, tmp);
+    format_label(w, min, "- trace_state             : ");
+    format_sds(w, span->trace_state);
+    ctr_writer_char(w, '\n');
 
-    /* schema_url */
     if (span->schema_url) {
-        snprintf(tmp, sizeof(tmp) - 1, "%*s- schema_url              : %s\n", min, "", span->schema_url);
-        sds_cat_safe(buf, tmp);
+        format_label(w, min, "- schema_url              : ");
+        format_sds(w, span->schema_url);
+        ctr_writer_char(w, '\n');
     }
 
     /* Status */
-    snprintf(tmp, sizeof(tmp) - 1, "%*s- status:\n", min, "");
-    sds_cat_safe(buf, tmp);
-    snprintf(tmp, sizeof(tmp) - 1, "%*s- code    : %i\n", min + 4, "", span->status.code);
-    sds_cat_safe(buf, tmp);
+    format_label(w, min, "- status:\n");
+    format_label(w, min + 4, "- code    : ");
+    ctr_writer_int64(w, span->status.code);
+    ctr_writer_char(w, '\n');
 
     if (span->status.message) {
-        snprintf(tmp, sizeof(tmp) - 1, "%*s- message : '%s'\n", min + 4, "", span->status.message);
-        sds_cat_safe(buf, tmp);
+        format_label(w, min + 4, "- message : '");
+        format_sds(w, span->status.message);
+        ctr_writer_lit(w, "'\n");
     }
 
     /* span attributes */
     if (ctr_attributes_count(span->attr) == 0) {
-        snprintf(tmp, sizeof(tmp) - 1, "%*s- attributes: none\n", min, "");
-        sds_cat_safe(buf, tmp);
+        format_label(w, min, "- attributes: none\n");
     }
     else {
-        snprintf(tmp, sizeof(tmp) - 1, "%*s- attributes: ", min, "");
-        sds_cat_safe(buf, tmp);
-        format_attributes(buf, span->attr->kv, min);
+        format_label(w, min, "- attributes: ");
+        format_attributes(w, span->attr->kv, min);
     }
 
     /* events */
     if (cfl_list_size(&span->events) == 0) {
-        snprintf(tmp, sizeof(tmp) - 1, "%*s- events: none\n", min, "");
-        sds_cat_safe(buf, tmp);
+        format_label(w, min, "- events: none\n");
     }
     else {
-        snprintf(tmp, sizeof(tmp) - 1, "%*s- events: ", min, "");
-        sds_cat_safe(buf, tmp);
+        format_label(w, min, "- events: ");
 
         cfl_list_foreach(head, &span->events) {
             event = cfl_list_entry(head, struct ctrace_span_event, _head);
-            format_event(buf, event, min);
+            format_event(w, event, min);
         }
     }
 
     /* links */
-    snprintf(tmp, sizeof(tmp) - 1, "%*s- [links]\n", min, "");
-    sds_cat_safe(buf, tmp);
+    format_label(w, min, "- [links]\n");
 
     cfl_list_foreach(head, &span->links) {
         link = cfl_list_entry(head, struct ctrace_link, _head);
 
         off = min + 4;
-
-        snprintf(tmp, sizeof(tmp) - 1, "%*s- link:\n", off, "");
-        sds_cat_safe(buf, tmp);
-
+        format_label(w, off, "- link:\n");
         off += 4;
 
-        /* trace_id */
-        if (link->trace_id) {
-            id_hex = ctr_id_to_lower_base16(link->trace_id);
-        }
-        else {
-            id_hex = cfl_sds_create(CTR_ID_TRACE_DEFAULT);
-        }
-        snprintf(tmp, sizeof(tmp) - 1, "%*s- trace_id             : %s\n", off, "", id_hex);
-        sds_cat_safe(buf, tmp);
-        cfl_sds_destroy(id_hex);
+        format_label(w, off, "- trace_id             : ");
+        format_id(w, link->trace_id, CTR_ID_TRACE_DEFAULT);
 
-        /* span_id */
-        if (link->span_id) {
-            id_hex = ctr_id_to_lower_base16(link->span_id);
-        }
-        else {
-            id_hex = cfl_sds_create(CTR_ID_SPAN_DEFAULT);
-        }
-        snprintf(tmp, sizeof(tmp) - 1, "%*s- span_id              : %s\n", off, "", id_hex);
-        sds_cat_safe(buf, tmp);
-        cfl_sds_destroy(id_hex);
+        format_label(w, off, "- span_id              : ");
+        format_id(w, link->span_id, CTR_ID_SPAN_DEFAULT);
 
-        snprintf(tmp, sizeof(tmp) - 1, "%*s- trace_state          : %s\n", off, "", link->trace_state);
-        sds_cat_safe(buf, tmp);
+        format_label(w, off, "- trace_state          : ");
+        format_sds(w, link->trace_state);
+        ctr_writer_char(w, '\n');
 
-        snprintf(tmp, sizeof(tmp) - 1, "%*s- dropped_events_count : %" PRIu32 "\n", off, "", link->dropped_attr_count);
-        sds_cat_safe(buf, tmp);
+        format_label(w, off, "- dropped_events_count : ");
+        ctr_writer_uint64(w, link->dropped_attr_count);
+        ctr_writer_char(w, '\n');
 
         /* link attributes */
         if (!link->attr) {
-            snprintf(tmp, sizeof(tmp) - 1, "%*s- attributes           : none\n", off, "");
-            sds_cat_safe(buf, tmp);
+            format_label(w, off, "- attributes           : none\n");
         }
         else {
-            snprintf(tmp, sizeof(tmp) - 1, "%*s- attributes           : ", off, "");
-            sds_cat_safe(buf, tmp);
-            format_attributes(buf, link->attr->kv, off);
+            format_label(w, off, "- attributes           : ");
+            format_attributes(w, link->attr->kv, off);
         }
     }
 }
 
-static void format_spans(cfl_sds_t *buf, struct ctrace *ctx, struct cfl_list *spans)
+static void format_spans(struct ctr_writer *w, struct ctrace *ctx, struct cfl_list *spans)
 {
     int id = 0;
     struct cfl_list *head;
     struct ctrace_span *span;
 
-    cfl_sds_printf(buf, "    [spans]\n");
+    ctr_writer_lit(w, "    [spans]\n");
 
-    /* look for spans that belongs to the given resource */
     cfl_list_foreach(head, spans){
         span = cfl_list_entry(head, struct ctrace_span, _head);
 
-        /* skip resource if there is no match */
-        format_span(buf, ctx, id, span, 2);
+        format_span(w, ctx, id, span, 2);
         id++;
     }
 }
 
-static void format_instrumentation_scope(cfl_sds_t *buf,
+static void format_instrumentation_scope(struct ctr_writer *w,
                                          struct ctrace_instrumentation_scope *scope)
 {
-    cfl_sds_printf(buf, "    instrumentation scope:\n");
-    cfl_sds_printf(buf, "        - name                    : %s\n", scope->name);
-    cfl_sds_printf(buf, "        - version                 : %s\n", scope->version);
-    cfl_sds_printf(buf, "        - dropped_attributes_count: %i\n", scope->dropped_attr_count);
+    ctr_writer_lit(w, "    instrumentation scope:\n");
+
+    ctr_writer_lit(w, "        - name                    : ");
+    format_sds(w, scope->name);
+    ctr_writer_char(w, '\n');
+
+    ctr_writer_lit(w, "        - version                 : ");
+    format_sds(w, scope->version);
+    ctr_writer_char(w, '\n');
+
+    ctr_writer_lit(w, "        - dropped_attributes_count: ");
+    ctr_writer_int64(w, (int) scope->dropped_attr_count);
+    ctr_writer_char(w, '\n');
 
     if (scope->attr) {
-        cfl_sds_printf(buf, "        - attributes:");
-        format_attributes(buf, scope->attr->kv, 8);
+        ctr_writer_lit(w, "        - attributes:");
+        format_attributes(w, scope->attr->kv, 8);
     }
     else {
-        cfl_sds_printf(buf, "        - attributes: undefined\n");
+        ctr_writer_lit(w, "        - attributes: undefined\n");
     }
 }
 
-static void format_resource(cfl_sds_t *buf, struct ctrace *ctx, struct ctrace_resource *resource)
+static void format_resource(struct ctr_writer *w, struct ctrace *ctx,
+                            struct ctrace_resource *resource)
 {
-    cfl_sds_printf(buf, "  resource:\n");
-    cfl_sds_printf(buf, "     - attributes:");
-    format_attributes(buf, resource->attr->kv, 8);
-    cfl_sds_printf(buf, "     - dropped_attributes_count: %" PRIu32 "\n", resource->dropped_attr_count);
+    ctr_writer_lit(w, "  resource:\n");
+    ctr_writer_lit(w, "     - attributes:");
+    format_attributes(w, resource->attr->kv, 8);
+    ctr_writer_lit(w, "     - dropped_attributes_count: ");
+    ctr_writer_uint64(w, resource->dropped_attr_count);
+    ctr_writer_char(w, '\n');
 }
 
-static void format_scope_spans(cfl_sds_t *buf, struct ctrace *ctx, struct cfl_list *scope_spans)
+static void format_scope_spans(struct ctr_writer *w, struct ctrace *ctx,
+                               struct cfl_list *scope_spans)
 {
     struct cfl_list *head;
     struct ctrace_scope_span *scope_span;
@@ -401,61 +378,77 @@ static void format_scope_spans(cfl_sds_t *buf, struct ctrace *ctx, struct cfl_li
     cfl_list_foreach(head, scope_spans) {
         scope_span = cfl_list_entry(head, struct ctrace_scope_span, _head);
 
-        cfl_sds_printf(buf, "  [scope_span]\n");
+        ctr_writer_lit(w, "  [scope_span]\n");
 
         /* format 'instrumentation_scope' if set */
         if (scope_span->instrumentation_scope) {
-            format_instrumentation_scope(buf, scope_span->instrumentation_scope);
+            format_instrumentation_scope(w, scope_span->instrumentation_scope);
         }
 
         /* schema_url */
         if (scope_span->schema_url) {
-            cfl_sds_printf(buf, "    schema_url: %s\n", scope_span->schema_url);
+            ctr_writer_lit(w, "    schema_url: ");
+            format_sds(w, scope_span->schema_url);
+            ctr_writer_char(w, '\n');
         }
         else {
-            cfl_sds_printf(buf, "    schema_url: \"\"\n");
+            ctr_writer_lit(w, "    schema_url: \"\"\n");
         }
 
         /* spans */
-        format_spans(buf, ctx, &scope_span->spans);
+        format_spans(w, ctx, &scope_span->spans);
     }
 }
 
-cfl_sds_t ctr_encode_text_create(struct ctrace *ctx)
+int ctr_encode_text_write(struct ctrace *ctx, struct ctr_writer *writer)
 {
-    cfl_sds_t buf;
     struct cfl_list *head;
     struct ctrace_resource_span *resource_span;
 
-    buf = cfl_sds_create_size(1024);
-    if (!buf) {
-        return NULL;
-    }
-
     /* iterate resource_spans */
     cfl_list_foreach(head, &ctx->resource_spans) {
         resource_span = cfl_list_entry(head, struct ctrace_resource_span, _head);
 
-        sds_cat_safe(&buf, "|-------------------- RESOURCE SPAN --------------------|\n");
+        ctr_writer_lit(writer, "|-------------------- RESOURCE SPAN --------------------|\n");
 
         if (resource_span->resource) {
-            format_resource(&buf, ctx, resource_span->resource);
+            format_resource(writer, ctx, resource_span->resource);
         }
         else {
-            cfl_sds_printf(&buf, "  resource: {}\n");
+            ctr_writer_lit(writer, "  resource: {}\n");
         }
 
         /* schema_url */
         if (resource_span->schema_url) {
-            cfl_sds_printf(&buf, "     - schema_url: %s\n", resource_span->schema_url);
+            ctr_writer_lit(writer, "     - schema_url: ");
+            format_sds(writer, resource_span->schema_url);
+            ctr_writer_char(writer, '\n');
         }
         else {
-            cfl_sds_printf(&buf, "     - schema_url: \"\"\n");
+            ctr_writer_lit(writer, "     - schema_url: \"\"\n");
         }
 
         /* scope spans */
-        format_scope_spans(&buf, ctx, &resource_span->scope_spans);
+        format_scope_spans(writer, ctx, &resource_span->scope_spans);
+    }
+
+    return ctr_writer_flush(writer);
+}
+
+cfl_sds_t ctr_encode_text_create(struct ctrace *ctx)
+{
+    cfl_sds_t buf = NULL;
+    struct ctr_writer *writer;
+
+    writer = ctr_writer_buffer_create(1024);
+    if (!writer) {
+        return NULL;
+    }
+
+    if (ctr_encode_text_write(ctx, writer) == 0) {
+        buf = ctr_writer_buffer_take(writer);
     }
+    ctr_writer_destroy(writer);
 
     return buf;
 }
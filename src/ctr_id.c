@@ -18,43 +18,131 @@
  */
 
 #include <ctraces/ctraces.h>
+#include <ctraces/ctr_base16.h>
+
+/* set 'len' random bytes as the ID content */
+static int id_set_random(struct ctrace_id *cid, size_t len)
+{
+    unsigned char *ext = NULL;
+
+    if (len > UINT32_MAX) {
+        return -1;
+    }
+
+    if (len > CTR_ID_INLINE_SIZE) {
+        ext = ctr_arena_alloc(cid->arena, len);
+        if (!ext) {
+            return -1;
+        }
+    }
+
+    ctr_id_reset(cid);
+
+    if (ext) {
+        cid->ext = ext;
+    }
+    else {
+        ext = cid->bytes;
+    }
+
+    ctr_random_fast_get(ext, len);
+    cid->len = len;
+
+    return 0;
+}
 
 /* create an ID with random bytes of length CTR_ID_BUFFER_SIZE (16 bytes) */
 struct ctrace_id *ctr_id_create_random(size_t size)
 {
-    char *buf;
-    ssize_t ret;
     struct ctrace_id *cid;
 
     if (size <= 0) {
         size = CTR_ID_DEFAULT_SIZE;
     }
 
-    buf = calloc(1, size);
-    if (!buf) {
+    cid = calloc(1, sizeof(struct ctrace_id));
+    if (!cid) {
         ctr_errno();
         return NULL;
     }
 
-    ret = ctr_random_get(buf, size);
-    if (ret < 0) {
-        free(buf);
+    if (id_set_random(cid, size) == -1) {
+        free(cid);
         return NULL;
     }
 
-    cid = ctr_id_create(buf, size);
-    free(buf);
-
     return cid;
 }
 
+/*
+ * Generate the span ID of a span, and its trace ID if it does not have one
+ * yet, straight into the span inline storage.
+ */
+int ctr_id_generate_trace_span(struct ctrace_span *span)
+{
+    if (span->noop) {
+        return 0;
+    }
+
+    if (!span->trace_id) {
+        if (id_set_random(&span->trace_id_data, CTR_ID_OTEL_TRACE_SIZE) == -1) {
+            return -1;
+        }
+        span->trace_id = &span->trace_id_data;
+    }
+
+    if (span->span_id && span->span_id != &span->span_id_data) {
+        ctr_id_destroy(span->span_id);
+    }
+    span->span_id = NULL;
+
+    if (id_set_random(&span->span_id_data, CTR_ID_OTEL_SPAN_SIZE) == -1) {
+        return -1;
+    }
+    span->span_id = &span->span_id_data;
+
+    return ctr_index_span_update(span);
+}
+
+/* prepare an ID embedded in a parent structure, it starts empty */
+void ctr_id_init(struct ctrace_id *cid, struct ctr_arena *arena)
+{
+    memset(cid, 0, sizeof(struct ctrace_id));
+    cid->arena = arena;
+    cid->flags = CTR_ID_EMBEDDED;
+}
+
+/* release the ID content, the ID itself is kept */
+void ctr_id_reset(struct ctrace_id *cid)
+{
+    if (cid->ext) {
+        ctr_arena_free(cid->arena, cid->ext);
+        cid->ext = NULL;
+    }
+
+    memset(cid->bytes, 0, CTR_ID_INLINE_SIZE);
+    cid->len = 0;
+}
+
 void ctr_id_destroy(struct ctrace_id *cid)
 {
-    cfl_sds_destroy(cid->buf);
+    ctr_id_reset(cid);
+
+    /* embedded IDs belong to their parent, arena IDs to their arena */
+    if ((cid->flags & CTR_ID_EMBEDDED) || cid->arena) {
+        return;
+    }
+
     free(cid);
 }
 
 struct ctrace_id *ctr_id_create(void *buf, size_t len)
+{
+    return ctr_id_create_arena(NULL, buf, len);
+}
+
+/* create an ID, allocated from the given arena or from the heap if NULL */
+struct ctrace_id *ctr_id_create_arena(struct ctr_arena *arena, void *buf, size_t len)
 {
     int ret;
     struct ctrace_id *cid;
@@ -63,15 +151,15 @@ struct ctrace_id *ctr_id_create(void *buf, size_t len)
         return NULL;
     }
 
-    cid = calloc(1, sizeof(struct ctrace_id));
+    cid = ctr_arena_alloc(arena, sizeof(struct ctrace_id));
     if (!cid) {
-        ctr_errno();
         return NULL;
     }
+    cid->arena = arena;
 
     ret = ctr_id_set(cid, buf, len);
     if (ret == -1) {
-        free(cid);
+        ctr_arena_free(arena, cid);
         return NULL;
     }
 
@@ -80,35 +168,79 @@ struct ctrace_id *ctr_id_create(void *buf, size_t len)
 
 int ctr_id_set(struct ctrace_id *cid, void *buf, size_t len)
 {
-    if (cid->buf) {
-        cfl_sds_destroy(cid->buf);
+    unsigned char *ext = NULL;
+
+    if (len > UINT32_MAX) {
+        return -1;
     }
 
-    cid->buf = cfl_sds_create_len(buf, len);
-    if (!cid->buf) {
+    if (len > CTR_ID_INLINE_SIZE) {
+        ext = ctr_arena_alloc(cid->arena, len);
+        if (!ext) {
+            return -1;
+        }
+        memcpy(ext, buf, len);
+    }
+
+    ctr_id_reset(cid);
+
+    if (ext) {
+        cid->ext = ext;
+    }
+    else {
+        memcpy(cid->bytes, buf, len);
+    }
+    cid->len = len;
+
+    return 0;
+}
+
+/*
+ * Copy an ID into the embedded storage 'data' and expose it through 'ref',
+ * the pointer is left to NULL on failure. An ID previously assigned to 'ref'
+ * by reference is released.
+ */
+int ctr_id_assign(struct ctrace_id **ref, struct ctrace_id *data, void *buf, size_t len)
+{
+    if (!buf || len <= 0) {
+        return -1;
+    }
+
+    if (*ref && *ref != data) {
+        ctr_id_destroy(*ref);
+    }
+
+    *ref = NULL;
+    if (ctr_id_set(data, buf, len) != 0) {
         return -1;
     }
+    *ref = data;
 
     return 0;
 }
 
 int ctr_id_cmp(struct ctrace_id *cid1, struct ctrace_id *cid2)
 {
-    int len1;
-    int len2;
+    uint64_t a[2];
+    uint64_t b[2];
 
     if (!cid1 || !cid2) {
         return -1;
     }
 
-    len1 = cfl_sds_len(cid1->buf);
-    len2 = cfl_sds_len(cid2->buf);
-
-    if (len1 != len2) {
+    if (cid1->len != cid2->len) {
         return -1;
     }
 
-    if (memcmp(cid1->buf, cid2->buf, len1) == 0) {
+    if (cid1->len > CTR_ID_INLINE_SIZE) {
+        return memcmp(cid1->ext, cid2->ext, cid1->len) == 0 ? 0 : -1;
+    }
+
+    /* inline IDs are zero padded */
+    memcpy(a, cid1->bytes, sizeof(a));
+    memcpy(b, cid2->bytes, sizeof(b));
+
+    if (a[0] == b[0] && a[1] == b[1]) {
         return 0;
     }
 
@@ -117,139 +249,120 @@ int ctr_id_cmp(struct ctrace_id *cid1, struct ctrace_id *cid2)
 
 size_t ctr_id_get_len(struct ctrace_id *cid)
 {
-    return cfl_sds_len(cid->buf);
+    return cid->len;
 }
 
 void *ctr_id_get_buf(struct ctrace_id *cid)
 {
-    return cid->buf;
+    if (cid->len > CTR_ID_INLINE_SIZE) {
+        return cid->ext;
+    }
+
+    return cid->bytes;
 }
 
 cfl_sds_t ctr_id_to_lower_base16(struct ctrace_id *cid)
 {
-    int i;
-    int len;
+    size_t len;
     cfl_sds_t out;
-    const char hex[] = "0123456789abcdef";
 
-    if (!cid->buf) {
+    if (cid->len == 0) {
         return NULL;
     }
 
-    len = cfl_sds_len(cid->buf);
-    out = cfl_sds_create_size(len * 2 + 1);
+    len = cid->len * 2;
+
+    out = cfl_sds_create_size(len + 1);
     if (!out) {
         return NULL;
     }
 
-    for (i = 0; i < len; i++) {
-        out[i * 2] = hex[(cid->buf[i] >> 4) & 0xF];
-        out[i * 2 + 1] = hex[(cid->buf[i] >> 0) & 0xF];
-    }
-
-    out[i * 2] = 0;
+    ctr_base16_encode(ctr_id_get_buf(cid), cid->len, out);
+    out[len] = '\0';
+    cfl_sds_set_len(out, len);
 
     return out;
 }
 
-/* This function returns CFL_TRUE on success and CFL_FALSE on
- * failure.
+/*
+ * Write the lowercase hex representation of the ID and a terminator into
+ * 'buf', returns the number of characters or -1 if it does not fit.
  */
-static int decode_hex_digit(char *digit)
+int ctr_id_to_lower_base16_buf(struct ctrace_id *cid, char *buf, size_t size)
 {
-    if (*digit >= '0' && *digit <= '9') {
-        *digit -= '0';
-    }
-    else if (*digit >= 'a' && *digit <= 'f') {
-        *digit -= 'a';
-        *digit += 10;
-    }
-    else if (*digit >= 'A' && *digit <= 'F') {
-        *digit -= 'A';
-        *digit += 10;
+    size_t len;
+
+    if (cid->len == 0) {
+        return -1;
     }
-    else {
-        return CFL_FALSE;
+
+    len = (size_t) cid->len * 2;
+    if (len + 1 > size) {
+        return -1;
     }
 
-    return CFL_TRUE;
+    ctr_base16_encode(ctr_id_get_buf(cid), cid->len, buf);
+    buf[len] = '\0';
+
+    return len;
 }
 
-struct ctrace_id *ctr_id_from_base16(cfl_sds_t id)
+/* set the ID from its hex representation, IDs that fit inline take no allocation */
+int ctr_id_set_base16(struct ctrace_id *cid, const char *hex, size_t len)
 {
-    size_t            output_index;
-    size_t            input_index;
-    cfl_sds_t         decoded_id;
-    struct ctrace_id *result_id;
-    int               result;
-    size_t            length;
-    char              digit;
-    char              value;
+    unsigned char *ext = NULL;
+    unsigned char bytes[CTR_ID_INLINE_SIZE];
 
-    if (id == NULL) {
-        return NULL;
+    if (len < 2 || (len % 2) != 0 || len / 2 > UINT32_MAX) {
+        return -1;
     }
 
-    length = cfl_sds_len(id);
+    if (len / 2 > CTR_ID_INLINE_SIZE) {
+        ext = ctr_arena_alloc(cid->arena, len / 2);
+        if (!ext) {
+            return -1;
+        }
 
-    if (length < 2) {
-        return NULL;
+        if (ctr_base16_decode(hex, len, ext) != 0) {
+            ctr_arena_free(cid->arena, ext);
+            return -1;
+        }
     }
-
-    if ((length % 2) != 0) {
-        return NULL;
+    else if (ctr_base16_decode(hex, len, bytes) != 0) {
+        return -1;
     }
 
-    decoded_id = cfl_sds_create_size(length / 2);
+    ctr_id_reset(cid);
 
-    if (decoded_id == NULL) {
-        return NULL;
+    if (ext) {
+        cid->ext = ext;
     }
+    else {
+        memcpy(cid->bytes, bytes, len / 2);
+    }
+    cid->len = len / 2;
 
-    output_index = 0;
-    input_index = 0;
-    value = 0;
-
-    /* This loop consumes one character per iteration,
-     * on each iteration it verifies that the character
-     * corresponds to the base16 charset and then
-     * it subtracts the correct base to get a number
-     * ranging from 0 to 16.
-     * Then the accumulator is left shifted 4 bits and
-     * the current value is bitwise ORed to its value.
-     * If the character index is odd then the accumulator
-     * value is appended to the decoded id buffer and
-     * reinitialized to be used on the next iteration.
-    */
-
-    while (input_index < length) {
-        digit = id[input_index];
-        result = decode_hex_digit(&digit);
-
-        if (!result) {
-            break;
-        }
-
-        digit  &= 0xF;
-        value <<= 4;
-        value  |= digit;
+    return 0;
+}
 
-        if ((input_index % 2) == 1) {
-            decoded_id[output_index++] = value;
-            value = 0;
-        }
+struct ctrace_id *ctr_id_from_base16(cfl_sds_t id)
+{
+    struct ctrace_id *cid;
 
-        input_index++;
+    if (id == NULL) {
+        return NULL;
     }
 
-    if (result) {
-        result_id = ctr_id_create(decoded_id, length / 2);
-    }
-    else {
-        result_id = NULL;
+    cid = calloc(1, sizeof(struct ctrace_id));
+    if (!cid) {
+        ctr_errno();
+        return NULL;
     }
 
-    cfl_sds_destroy(decoded_id);
+    if (ctr_id_set_base16(cid, id, cfl_sds_len(id)) != 0) {
+        free(cid);
+        return NULL;
+    }
 
-    return result_id;
+    return cid;
 }
@@ -0,0 +1,364 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <ctraces/ctraces.h>
+#include <ctraces/ctr_index.h>
+
+#include <string.h>
+
+#define INDEX_TABLE_INITIAL_SIZE    64
+
+static inline uint64_t id_hash(struct ctrace_id *cid)
+{
+    return cfl_hash_64bits(ctr_id_get_buf(cid), ctr_id_get_len(cid));
+}
+
+static inline int id_equal(struct ctrace_id *cid, void *buf, size_t len)
+{
+    return ctr_id_get_len(cid) == len && memcmp(ctr_id_get_buf(cid), buf, len) == 0;
+}
+
+static int id_is_set(struct ctrace_id *cid)
+{
+    return cid != NULL && ctr_id_get_len(cid) > 0;
+}
+
+static int table_init(struct ctr_index_table *table, size_t size)
+{
+    table->slots = calloc(size, sizeof(struct ctr_index_slot));
+    if (!table->slots) {
+        ctr_errno();
+        return -1;
+    }
+    table->size = size;
+    table->count = 0;
+
+    return 0;
+}
+
+static void table_exit(struct ctr_index_table *table)
+{
+    if (table->slots) {
+        free(table->slots);
+    }
+    memset(table, 0, sizeof(struct ctr_index_table));
+}
+
+static void table_put(struct ctr_index_table *table, uint64_t hash, void *ptr)
+{
+    size_t i;
+    size_t mask;
+
+    mask = table->size - 1;
+    i = hash & mask;
+    while (table->slots[i].ptr) {
+        i = (i + 1) & mask;
+    }
+
+    table->slots[i].hash = hash;
+    table->slots[i].ptr = ptr;
+    table->count++;
+}
+
+/* keep the load factor under 1/2 */
+static int table_insert(struct ctr_index_table *table, uint64_t hash, void *ptr)
+{
+    size_t i;
+    struct ctr_index_table tmp;
+
+    if ((table->count + 1) * 2 > table->size) {
+        if (table_init(&tmp, table->size * 2) != 0) {
+            return -1;
+        }
+
+        for (i = 0; i < table->size; i++) {
+            if (table->slots[i].ptr) {
+                table_put(&tmp, table->slots[i].hash, table->slots[i].ptr);
+            }
+        }
+
+        free(table->slots);
+        *table = tmp;
+    }
+
+    table_put(table, hash, ptr);
+    return 0;
+}
+
+/* remove 'ptr' shifting back the entries of its probe sequence, no tombstones */
+static void table_remove(struct ctr_index_table *table, uint64_t hash, void *ptr)
+{
+    size_t i;
+    size_t j;
+    size_t k;
+    size_t mask;
+
+    mask = table->size - 1;
+    i = hash & mask;
+    while (table->slots[i].ptr != ptr) {
+        if (!table->slots[i].ptr) {
+            return;
+        }
+        i = (i + 1) & mask;
+    }
+
+    j = i;
+    while (1) {
+        j = (j + 1) & mask;
+        if (!table->slots[j].ptr) {
+            break;
+        }
+
+        /* move the entry unless its home slot lies cyclically in (i, j] */
+        k = table->slots[j].hash & mask;
+        if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j)) {
+            continue;
+        }
+
+        table->slots[i] = table->slots[j];
+        i = j;
+    }
+
+    table->slots[i].ptr = NULL;
+    table->count--;
+}
+
+static struct ctrace_span *span_lookup(struct ctr_index *index, uint64_t hash,
+                                       void *buf, size_t len)
+{
+    size_t i;
+    size_t mask;
+    struct ctrace_span *span;
+
+    mask = index->spans.size - 1;
+    for (i = hash & mask; index->spans.slots[i].ptr; i = (i + 1) & mask) {
+        if (index->spans.slots[i].hash != hash) {
+            continue;
+        }
+
+        span = index->spans.slots[i].ptr;
+        if (id_equal(span->span_id, buf, len)) {
+            return span;
+        }
+    }
+
+    return NULL;
+}
+
+static struct ctr_index_trace *trace_lookup(struct ctr_index *index, uint64_t hash,
+                                            void *buf, size_t len)
+{
+    size_t i;
+    size_t mask;
+    struct ctrace_span *span;
+    struct ctr_index_trace *trace;
+
+    mask = index->traces.size - 1;
+    for (i = hash & mask; index->traces.slots[i].ptr; i = (i + 1) & mask) {
+        if (index->traces.slots[i].hash != hash) {
+            continue;
+        }
+
+        /* a trace is released with its last span, compare against the first one */
+        trace = index->traces.slots[i].ptr;
+        span = cfl_list_entry_first(&trace->spans, struct ctrace_span, _head_trace);
+        if (id_equal(span->trace_id, buf, len)) {
+            return trace;
+        }
+    }
+
+    return NULL;
+}
+
+void ctr_index_span_remove(struct ctrace_span *span)
+{
+    struct ctr_index *index;
+    struct ctr_index_trace *trace;
+
+    index = span->ctx->index;
+    if (!index) {
+        return;
+    }
+
+    if (span->indexed) {
+        table_remove(&index->spans, span->index_hash, span);
+        span->indexed = CTR_FALSE;
+    }
+
+    trace = span->index_trace;
+    if (trace) {
+        cfl_list_del(&span->_head_trace);
+        span->index_trace = NULL;
+
+        trace->span_count--;
+        if (trace->span_count == 0) {
+            table_remove(&index->traces, trace->hash, trace);
+            cfl_list_del(&trace->_head);
+            free(trace);
+        }
+    }
+}
+
+int ctr_index_span_update(struct ctrace_span *span)
+{
+    uint64_t hash;
+    struct ctr_index *index;
+    struct ctr_index_trace *trace;
+
+    index = span->ctx->index;
+    if (!index) {
+        return 0;
+    }
+
+    ctr_index_span_remove(span);
+
+    if (id_is_set(span->span_id)) {
+        hash = id_hash(span->span_id);
+        if (table_insert(&index->spans, hash, span) != 0) {
+            return -1;
+        }
+        span->index_hash = hash;
+        span->indexed = CTR_TRUE;
+    }
+
+    if (!id_is_set(span->trace_id)) {
+        return 0;
+    }
+
+    hash = id_hash(span->trace_id);
+    trace = trace_lookup(index, hash, ctr_id_get_buf(span->trace_id),
+                         ctr_id_get_len(span->trace_id));
+    if (!trace) {
+        trace = calloc(1, sizeof(struct ctr_index_trace));
+        if (!trace) {
+            ctr_errno();
+            return -1;
+        }
+        trace->hash = hash;
+        cfl_list_init(&trace->spans);
+
+        if (table_insert(&index->traces, hash, trace) != 0) {
+            free(trace);
+            return -1;
+        }
+        cfl_list_add(&trace->_head, &index->trace_list);
+    }
+
+    cfl_list_add(&span->_head_trace, &trace->spans);
+    trace->span_count++;
+    span->index_trace = trace;
+
+    return 0;
+}
+
+/* build the index for the spans already in the context */
+int ctr_index_enable(struct ctrace *ctx)
+{
+    struct cfl_list *head;
+    struct ctr_index *index;
+    struct ctrace_span *span;
+
+    if (ctx->index) {
+        return 0;
+    }
+
+    index = calloc(1, sizeof(struct ctr_index));
+    if (!index) {
+        ctr_errno();
+        return -1;
+    }
+    cfl_list_init(&index->trace_list);
+
+    if (table_init(&index->spans, INDEX_TABLE_INITIAL_SIZE) != 0 ||
+        table_init(&index->traces, INDEX_TABLE_INITIAL_SIZE) != 0) {
+        table_exit(&index->spans);
+        free(index);
+        return -1;
+    }
+    ctx->index = index;
+
+    cfl_list_foreach(head, &ctx->span_list) {
+        span = cfl_list_entry(head, struct ctrace_span, _head_global);
+        if (ctr_index_span_update(span) != 0) {
+            ctr_index_disable(ctx);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void ctr_index_disable(struct ctrace *ctx)
+{
+    struct cfl_list *tmp;
+    struct cfl_list *head;
+    struct ctr_index *index;
+    struct ctrace_span *span;
+    struct ctr_index_trace *trace;
+
+    index = ctx->index;
+    if (!index) {
+        return;
+    }
+
+    cfl_list_foreach(head, &ctx->span_list) {
+        span = cfl_list_entry(head, struct ctrace_span, _head_global);
+        span->index_trace = NULL;
+        span->indexed = CTR_FALSE;
+    }
+
+    cfl_list_foreach_safe(head, tmp, &index->trace_list) {
+        trace = cfl_list_entry(head, struct ctr_index_trace, _head);
+        cfl_list_del(&trace->_head);
+        free(trace);
+    }
+
+    table_exit(&index->spans);
+    table_exit(&index->traces);
+    free(index);
+
+    ctx->index = NULL;
+}
+
+struct ctrace_span *ctr_index_span_lookup(struct ctrace *ctx, void *span_id, size_t len)
+{
+    if (!ctx->index || !span_id || len == 0) {
+        return NULL;
+    }
+
+    return span_lookup(ctx->index, cfl_hash_64bits(span_id, len), span_id, len);
+}
+
+struct ctr_index_trace *ctr_index_trace_lookup(struct ctrace *ctx, void *trace_id, size_t len)
+{
+    if (!ctx->index || !trace_id || len == 0) {
+        return NULL;
+    }
+
+    return trace_lookup(ctx->index, cfl_hash_64bits(trace_id, len), trace_id, len);
+}
+
+int ctr_index_trace_count(struct ctrace *ctx)
+{
+    if (!ctx->index) {
+        return 0;
+    }
+
+    return ctx->index->traces.count;
+}
@@ -0,0 +1,133 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <ctraces/ctraces.h>
+#include <ctraces/ctr_intern.h>
+
+#include <string.h>
+
+struct ctr_intern *ctr_intern_create()
+{
+    struct ctr_intern *intern;
+
+    intern = calloc(1, sizeof(struct ctr_intern));
+    if (!intern) {
+        ctr_errno();
+        return NULL;
+    }
+
+    intern->size = 256;
+    intern->slots = calloc(intern->size, sizeof(cfl_sds_t));
+    if (!intern->slots) {
+        ctr_errno();
+        free(intern);
+        return NULL;
+    }
+
+    return intern;
+}
+
+void ctr_intern_destroy(struct ctr_intern *intern)
+{
+    size_t i;
+
+    for (i = 0; i < intern->size; i++) {
+        if (intern->slots[i]) {
+            cfl_sds_destroy(intern->slots[i]);
+        }
+    }
+
+    free(intern->slots);
+    free(intern);
+}
+
+static int intern_grow(struct ctr_intern *intern)
+{
+    size_t i;
+    size_t pos;
+    size_t size;
+    cfl_sds_t str;
+    cfl_sds_t *slots;
+
+    size = intern->size * 2;
+    slots = calloc(size, sizeof(cfl_sds_t));
+    if (!slots) {
+        ctr_errno();
+        return -1;
+    }
+
+    for (i = 0; i < intern->size; i++) {
+        str = intern->slots[i];
+        if (!str) {
+            continue;
+        }
+
+        pos = cfl_hash_64bits(str, cfl_sds_len(str)) & (size - 1);
+        while (slots[pos]) {
+            pos = (pos + 1) & (size - 1);
+        }
+        slots[pos] = str;
+    }
+
+    free(intern->slots);
+    intern->slots = slots;
+    intern->size = size;
+
+    return 0;
+}
+
+cfl_sds_t ctr_intern_get(struct ctr_intern *intern, const char *str, size_t len)
+{
+    size_t pos;
+    cfl_sds_t entry;
+
+    pos = cfl_hash_64bits(str, len) & (intern->size - 1);
+    while ((entry = intern->slots[pos]) != NULL) {
+        if (cfl_sds_len(entry) == len && memcmp(entry, str, len) == 0) {
+            return entry;
+        }
+        pos = (pos + 1) & (intern->size - 1);
+    }
+
+    if (intern->count >= CTR_INTERN_MAX_STRINGS) {
+        return NULL;
+    }
+
+    /* keep the load factor under 1/2 */
+    if ((intern->count + 1) * 2 > intern->size) {
+        if (intern_grow(intern) != 0) {
+            return NULL;
+        }
+
+        pos = cfl_hash_64bits(str, len) & (intern->size - 1);
+        while (intern->slots[pos]) {
+            pos = (pos + 1) & (intern->size - 1);
+        }
+    }
+
+    entry = cfl_sds_create_len(str, len);
+    if (!entry) {
+        return NULL;
+    }
+
+    intern->slots[pos] = entry;
+    intern->count++;
+
+    return entry;
+}
@@ -24,28 +24,36 @@ struct ctrace_link *ctr_link_create(struct ctrace_span *span,
                                     void *span_id_buf, size_t span_id_len)
 {
     struct ctrace_link *link;
+    struct ctr_arena *arena;
 
-    link = calloc(1, sizeof(struct ctrace_link));
+    if (span->noop) {
+        return NULL;
+    }
+
+    arena = span->ctx->arena;
+
+    link = ctr_arena_alloc(arena, sizeof(struct ctrace_link));
     if (!link) {
-        ctr_errno();
         return NULL;
     }
+    link->span = span;
+
+    ctr_id_init(&link->trace_id_data, arena);
+    ctr_id_init(&link->span_id_data, arena);
 
     /* trace_id */
     if (trace_id_buf && trace_id_len > 0) {
-        link->trace_id = ctr_id_create(trace_id_buf, trace_id_len);
-        if (!link->trace_id) {
-            free(link);
+        if (ctr_link_set_trace_id(link, trace_id_buf, trace_id_len) != 0) {
+            ctr_arena_free(arena, link);
             return NULL;
         }
     }
 
     /* span_id */
     if (span_id_buf && span_id_len > 0) {
-        link->span_id = ctr_id_create(span_id_buf, span_id_len);
-        if (!link->span_id) {
-            ctr_id_destroy(link->trace_id);
-            free(link);
+        if (ctr_link_set_span_id(link, span_id_buf, span_id_len) != 0) {
+            ctr_id_reset(&link->trace_id_data);
+            ctr_arena_free(arena, link);
             return NULL;
         }
     }
@@ -76,13 +84,40 @@ struct ctrace_link *ctr_link_create_with_cid(struct ctrace_span *span,
     return ctr_link_create(span, trace_id_buf, trace_id_len, span_id_buf, span_id_len);
 }
 
+/* unsampled spans hand out NULL links, the setters ignore them */
+int ctr_link_set_trace_id(struct ctrace_link *link, void *buf, size_t len)
+{
+    if (!link) {
+        return 0;
+    }
+
+    return ctr_id_assign(&link->trace_id, &link->trace_id_data, buf, len);
+}
+
+int ctr_link_set_span_id(struct ctrace_link *link, void *buf, size_t len)
+{
+    if (!link) {
+        return 0;
+    }
+
+    return ctr_id_assign(&link->span_id, &link->span_id_data, buf, len);
+}
+
 int ctr_link_set_trace_state(struct ctrace_link *link, char *trace_state)
 {
-    if (!link || !trace_state) {
+    if (!trace_state) {
         return -1;
     }
 
-    link->trace_state = cfl_sds_create(trace_state);
+    if (!link) {
+        return 0;
+    }
+
+    if (link->trace_state) {
+        ctr_arena_sds_destroy(link->span->ctx->arena, link->trace_state);
+    }
+
+    link->trace_state = ctr_arena_sds_create(link->span->ctx->arena, trace_state);
     if (!link->trace_state) {
         return -1;
     }
@@ -96,22 +131,43 @@ int ctr_link_set_attributes(struct ctrace_link *link, struct ctrace_attributes *
         return -1;
     }
 
+    if (!link) {
+        ctr_attributes_destroy(attr);
+        return 0;
+    }
+
     link->attr = attr;
     return 0;
 }
 
 void ctr_link_set_dropped_attr_count(struct ctrace_link *link, uint32_t count)
 {
+    if (!link) {
+        return;
+    }
+
     link->dropped_attr_count = count;
 }
 
 void ctr_link_set_flags(struct ctrace_link *link, uint32_t flags)
 {
+    if (!link) {
+        return;
+    }
+
     link->flags = flags;
 }
 
 void ctr_link_destroy(struct ctrace_link *link)
 {
+    struct ctr_arena *arena;
+
+    if (!link) {
+        return;
+    }
+
+    arena = link->span->ctx->arena;
+
     if (link->trace_id) {
         ctr_id_destroy(link->trace_id);
     }
@@ -121,7 +177,7 @@ void ctr_link_destroy(struct ctrace_link *link)
     }
 
     if (link->trace_state) {
-        cfl_sds_destroy(link->trace_state);
+        ctr_arena_sds_destroy(arena, link->trace_state);
     }
 
     if (link->attr) {
@@ -129,7 +185,7 @@ void ctr_link_destroy(struct ctrace_link *link)
     }
 
     cfl_list_del(&link->_head);
-    free(link);
+    ctr_arena_free(arena, link);
 }
 
 
@@ -0,0 +1,612 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <ctraces/ctraces.h>
+#include <ctraces/ctr_merge.h>
+
+#include <string.h>
+
+/* resource or scope span of the destination context with its identity hash */
+struct merge_entry {
+    uint64_t hash;
+    void *ptr;                      /* NULL for an empty slot */
+};
+
+/* open addressing with linear probing, 'size' is a power of two */
+struct merge_table {
+    struct merge_entry *entries;
+    size_t size;                    /* slots in use, up to 'capacity' */
+    size_t capacity;
+};
+
+static void hash_variant(cfl_hash_state_t *state, struct cfl_variant *value);
+
+static void hash_bytes(cfl_hash_state_t *state, const void *data, size_t len)
+{
+    /* the length keeps adjacent strings apart */
+    cfl_hash_64bits_update(state, &len, sizeof(len));
+    if (len > 0) {
+        cfl_hash_64bits_update(state, data, len);
+    }
+}
+
+static void hash_string(cfl_hash_state_t *state, char *str)
+{
+    if (str == NULL) {
+        hash_bytes(state, NULL, 0);
+        return;
+    }
+
+    hash_bytes(state, str, strlen(str));
+}
+
+static void hash_kvlist(cfl_hash_state_t *state, struct cfl_kvlist *kvlist)
+{
+    struct cfl_list *head;
+    struct cfl_kvpair *pair;
+
+    if (kvlist == NULL) {
+        return;
+    }
+
+    cfl_list_foreach(head, &kvlist->list) {
+        pair = cfl_list_entry(head, struct cfl_kvpair, _head);
+        hash_string(state, pair->key);
+        hash_variant(state, pair->val);
+    }
+}
+
+static void hash_variant(cfl_hash_state_t *state, struct cfl_variant *value)
+{
+    size_t i;
+    struct cfl_array *array;
+
+    cfl_hash_64bits_update(state, &value->type, sizeof(value->type));
+
+    switch (value->type) {
+        case CFL_VARIANT_STRING:
+            hash_bytes(state, value->data.as_string, cfl_sds_len(value->data.as_string));
+            break;
+        case CFL_VARIANT_BYTES:
+            hash_bytes(state, value->data.as_bytes, cfl_sds_len(value->data.as_bytes));
+            break;
+        case CFL_VARIANT_REFERENCE:
+            hash_string(state, value->data.as_reference);
+            break;
+        case CFL_VARIANT_BOOL:
+            cfl_hash_64bits_update(state, &value->data.as_bool, sizeof(value->data.as_bool));
+            break;
+        case CFL_VARIANT_INT:
+            cfl_hash_64bits_update(state, &value->data.as_int64, sizeof(value->data.as_int64));
+            break;
+        case CFL_VARIANT_DOUBLE:
+            cfl_hash_64bits_update(state, &value->data.as_double, sizeof(value->data.as_double));
+            break;
+        case CFL_VARIANT_ARRAY:
+            array = value->data.as_array;
+            for (i = 0; i < array->entry_count; i++) {
+                hash_variant(state, array->entries[i]);
+            }
+            break;
+        case CFL_VARIANT_KVLIST:
+            hash_kvlist(state, value->data.as_kvlist);
+            break;
+    }
+}
+
+static void hash_attributes(cfl_hash_state_t *state, struct ctrace_attributes *attr)
+{
+    if (attr == NULL) {
+        return;
+    }
+
+    hash_kvlist(state, attr->kv);
+}
+
+static int string_equal(char *a, char *b)
+{
+    if (a == NULL || b == NULL) {
+        return a == b;
+    }
+
+    return strcmp(a, b) == 0;
+}
+
+static int sds_equal(cfl_sds_t a, cfl_sds_t b)
+{
+    return cfl_sds_len(a) == cfl_sds_len(b) && memcmp(a, b, cfl_sds_len(a)) == 0;
+}
+
+static int variant_equal(struct cfl_variant *a, struct cfl_variant *b);
+
+/* attribute lists are compared in order */
+static int kvlist_equal(struct cfl_kvlist *a, struct cfl_kvlist *b)
+{
+    struct cfl_list *head_a;
+    struct cfl_list *head_b;
+    struct cfl_kvpair *pair_a;
+    struct cfl_kvpair *pair_b;
+
+    if (a == NULL || b == NULL) {
+        return a == b;
+    }
+
+    head_b = b->list.next;
+    cfl_list_foreach(head_a, &a->list) {
+        if (head_b == &b->list) {
+            return CTR_FALSE;
+        }
+
+        pair_a = cfl_list_entry(head_a, struct cfl_kvpair, _head);
+        pair_b = cfl_list_entry(head_b, struct cfl_kvpair, _head);
+
+        if (!string_equal(pair_a->key, pair_b->key) ||
+            !variant_equal(pair_a->val, pair_b->val)) {
+            return CTR_FALSE;
+        }
+
+        head_b = head_b->next;
+    }
+
+    return head_b == &b->list;
+}
+
+static int variant_equal(struct cfl_variant *a, struct cfl_variant *b)
+{
+    size_t i;
+
+    if (a->type != b->type) {
+        return CTR_FALSE;
+    }
+
+    switch (a->type) {
+        case CFL_VARIANT_STRING:
+            return sds_equal(a->data.as_string, b->data.as_string);
+        case CFL_VARIANT_BYTES:
+            return sds_equal(a->data.as_bytes, b->data.as_bytes);
+        case CFL_VARIANT_REFERENCE:
+            return string_equal(a->data.as_reference, b->data.as_reference);
+        case CFL_VARIANT_BOOL:
+            return a->data.as_bool == b->data.as_bool;
+        case CFL_VARIANT_INT:
+            return a->data.as_int64 == b->data.as_int64;
+        case CFL_VARIANT_DOUBLE:
+            return memcmp(&a->data.as_double, &b->data.as_double, sizeof(double)) == 0;
+        case CFL_VARIANT_ARRAY:
+            if (a->data.as_array->entry_count != b->data.as_array->entry_count) {
+                return CTR_FALSE;
+            }
+            for (i = 0; i < a->data.as_array->entry_count; i++) {
+                if (!variant_equal(a->data.as_array->entries[i],
+                                   b->data.as_array->entries[i])) {
+                    return CTR_FALSE;
+                }
+            }
+            return CTR_TRUE;
+        case CFL_VARIANT_KVLIST:
+            return kvlist_equal(a->data.as_kvlist, b->data.as_kvlist);
+    }
+
+    /* unknown types are never coalesced */
+    return CTR_FALSE;
+}
+
+static int attributes_equal(struct ctrace_attributes *a, struct ctrace_attributes *b)
+{
+    if (a == NULL || b == NULL) {
+        return a == b;
+    }
+
+    return kvlist_equal(a->kv, b->kv);
+}
+
+static uint64_t resource_span_hash(struct ctrace_resource_span *resource_span)
+{
+    cfl_hash_state_t state;
+
+    cfl_hash_64bits_reset(&state);
+    hash_string(&state, resource_span->schema_url);
+
+    if (resource_span->resource) {
+        cfl_hash_64bits_update(&state, &resource_span->resource->dropped_attr_count,
+                               sizeof(resource_span->resource->dropped_attr_count));
+        hash_attributes(&state, resource_span->resource->attr);
+    }
+
+    return cfl_hash_64bits_digest(&state);
+}
+
+static int resource_span_equal(struct ctrace_resource_span *a, struct ctrace_resource_span *b)
+{
+    if (!string_equal(a->schema_url, b->schema_url)) {
+        return CTR_FALSE;
+    }
+
+    if (a->resource == NULL || b->resource == NULL) {
+        return a->resource == b->resource;
+    }
+
+    return a->resource->dropped_attr_count == b->resource->dropped_attr_count &&
+           attributes_equal(a->resource->attr, b->resource->attr);
+}
+
+static uint64_t scope_span_hash(struct ctrace_scope_span *scope_span)
+{
+    cfl_hash_state_t state;
+    struct ctrace_instrumentation_scope *scope;
+
+    cfl_hash_64bits_reset(&state);
+    hash_string(&state, scope_span->schema_url);
+
+    scope = scope_span->instrumentation_scope;
+    if (scope) {
+        hash_string(&state, scope->name);
+        hash_string(&state, scope->version);
+        cfl_hash_64bits_update(&state, &scope->dropped_attr_count,
+                               sizeof(scope->dropped_attr_count));
+        hash_attributes(&state, scope->attr);
+    }
+
+    return cfl_hash_64bits_digest(&state);
+}
+
+static int scope_span_equal(struct ctrace_scope_span *a, struct ctrace_scope_span *b)
+{
+    struct ctrace_instrumentation_scope *sa;
+    struct ctrace_instrumentation_scope *sb;
+
+    if (!string_equal(a->schema_url, b->schema_url)) {
+        return CTR_FALSE;
+    }
+
+    sa = a->instrumentation_scope;
+    sb = b->instrumentation_scope;
+    if (sa == NULL || sb == NULL) {
+        return sa == sb;
+    }
+
+    return string_equal(sa->name, sb->name) &&
+           string_equal(sa->version, sb->version) &&
+           sa->dropped_attr_count == sb->dropped_attr_count &&
+           attributes_equal(sa->attr, sb->attr);
+}
+
+/* keep the load factor under 1/2 */
+static size_t table_size(size_t count)
+{
+    size_t size = 1;
+
+    while (size < count * 2) {
+        size <<= 1;
+    }
+
+    return size;
+}
+
+/* tables are sized upfront so nothing can fail once spans start moving */
+static int table_init(struct merge_table *table, size_t count)
+{
+    table->capacity = table_size(count);
+    table->size = table->capacity;
+
+    table->entries = calloc(table->capacity, sizeof(struct merge_entry));
+    if (!table->entries) {
+        ctr_errno();
+        return -1;
+    }
+
+    return 0;
+}
+
+static void table_add(struct merge_table *table, uint64_t hash, void *ptr)
+{
+    size_t i;
+    size_t mask;
+
+    mask = table->size - 1;
+    i = hash & mask;
+    while (table->entries[i].ptr) {
+        i = (i + 1) & mask;
+    }
+
+    table->entries[i].hash = hash;
+    table->entries[i].ptr = ptr;
+}
+
+/* empty the table and use only the slots needed for 'count' entries */
+static void table_reset(struct merge_table *table, size_t count)
+{
+    table->size = table_size(count);
+    memset(table->entries, 0, table->size * sizeof(struct merge_entry));
+}
+
+static void table_destroy(struct merge_table *table)
+{
+    free(table->entries);
+}
+
+static void scope_span_move_spans(struct ctrace *dst, struct ctrace_scope_span *from,
+                                  struct ctrace_scope_span *to)
+{
+    struct cfl_list *tmp;
+    struct cfl_list *head;
+    struct ctrace_span *span;
+
+    cfl_list_foreach_safe(head, tmp, &from->spans) {
+        span = cfl_list_entry(head, struct ctrace_span, _head);
+        ctr_span_move(span, dst, to);
+    }
+}
+
+static struct ctrace_resource_span *resource_span_lookup(struct merge_table *table,
+                                                         struct ctrace_resource_span *resource_span,
+                                                         uint64_t hash)
+{
+    size_t i;
+    size_t mask;
+
+    mask = table->size - 1;
+    for (i = hash & mask; table->entries[i].ptr; i = (i + 1) & mask) {
+        if (table->entries[i].hash == hash &&
+            resource_span_equal(table->entries[i].ptr, resource_span)) {
+            return table->entries[i].ptr;
+        }
+    }
+
+    return NULL;
+}
+
+static struct ctrace_scope_span *scope_span_lookup(struct merge_table *table,
+                                                   struct ctrace_scope_span *scope_span,
+                                                   uint64_t hash)
+{
+    size_t i;
+    size_t mask;
+
+    mask = table->size - 1;
+    for (i = hash & mask; table->entries[i].ptr; i = (i + 1) & mask) {
+        if (table->entries[i].hash == hash &&
+            scope_span_equal(table->entries[i].ptr, scope_span)) {
+            return table->entries[i].ptr;
+        }
+    }
+
+    return NULL;
+}
+
+/* move the scope spans of 'from' into the equivalent resource span 'to' */
+static void resource_span_merge(struct ctrace *dst,
+                               struct ctrace_resource_span *from,
+                               struct ctrace_resource_span *to,
+                               struct merge_table *scopes)
+{
+    uint64_t hash;
+    struct cfl_list *tmp;
+    struct cfl_list *head;
+    struct ctrace_scope_span *scope_span;
+    struct ctrace_scope_span *target;
+
+    table_reset(scopes, cfl_list_size(&to->scope_spans) +
+                        cfl_list_size(&from->scope_spans));
+    cfl_list_foreach(head, &to->scope_spans) {
+        scope_span = cfl_list_entry(head, struct ctrace_scope_span, _head);
+        table_add(scopes, scope_span_hash(scope_span), scope_span);
+    }
+
+    cfl_list_foreach_safe(head, tmp, &from->scope_spans) {
+        scope_span = cfl_list_entry(head, struct ctrace_scope_span, _head);
+
+        hash = scope_span_hash(scope_span);
+        target = scope_span_lookup(scopes, scope_span, hash);
+        if (target) {
+            scope_span_move_spans(dst, scope_span, target);
+            ctr_scope_span_destroy(scope_span);
+            continue;
+        }
+
+        table_add(scopes, hash, scope_span);
+
+        cfl_list_del(&scope_span->_head);
+        cfl_list_add(&scope_span->_head, &to->scope_spans);
+        scope_span->resource_span = to;
+        scope_span_move_spans(dst, scope_span, scope_span);
+    }
+}
+
+static void count_spans(struct ctrace *ctx, size_t *resource_spans, size_t *scope_spans)
+{
+    struct cfl_list *head;
+    struct ctrace_resource_span *resource_span;
+
+    cfl_list_foreach(head, &ctx->resource_spans) {
+        resource_span = cfl_list_entry(head, struct ctrace_resource_span, _head);
+        *resource_spans += 1;
+        *scope_spans += cfl_list_size(&resource_span->scope_spans);
+    }
+}
+
+/*
+ * Names interned by 'src' must not outlive its table, re-home them in 'dst'
+ * before moving anything. Every name is created before any is released so
+ * a failure leaves 'src' untouched.
+ */
+static int names_adopt(struct ctrace *dst, struct ctrace *src)
+{
+    int n;
+    int *flags;
+    size_t count = 0;
+    cfl_sds_t *names;
+    struct cfl_list *head;
+    struct ctrace_span *span;
+
+    if (!src->intern || src->intern == dst->intern) {
+        return 0;
+    }
+
+    cfl_list_foreach(head, &src->span_list) {
+        span = cfl_list_entry(head, struct ctrace_span, _head_global);
+        count += ctr_span_names_count(span, dst);
+    }
+
+    if (count == 0) {
+        return 0;
+    }
+
+    names = calloc(count, sizeof(cfl_sds_t));
+    flags = calloc(count, sizeof(int));
+    if (!names || !flags) {
+        ctr_errno();
+        free(names);
+        free(flags);
+        return -1;
+    }
+
+    count = 0;
+    cfl_list_foreach(head, &src->span_list) {
+        span = cfl_list_entry(head, struct ctrace_span, _head_global);
+        n = ctr_span_names_count(span, dst);
+        if (n == 0) {
+            continue;
+        }
+
+        if (ctr_span_names_create(span, dst, names + count, flags + count) != 0) {
+            ctr_span_names_destroy(dst, names, flags, count);
+            free(names);
+            free(flags);
+            return -1;
+        }
+        count += n;
+    }
+
+    count = 0;
+    cfl_list_foreach(head, &src->span_list) {
+        span = cfl_list_entry(head, struct ctrace_span, _head_global);
+        n = ctr_span_names_count(span, dst);
+        if (n == 0) {
+            continue;
+        }
+
+        ctr_span_names_set(span, names + count, flags + count);
+        count += n;
+    }
+
+    free(names);
+    free(flags);
+    return 0;
+}
+
+int ctr_merge(struct ctrace *dst, struct ctrace *src)
+{
+    size_t resource_count = 0;
+    size_t scope_count = 0;
+    uint64_t hash;
+    struct cfl_list *tmp;
+    struct cfl_list *s_tmp;
+    struct cfl_list *head;
+    struct cfl_list *s_head;
+    struct ctr_arena *arena = NULL;
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_resource_span *target;
+    struct ctrace_scope_span *scope_span;
+    struct merge_table resources;
+    struct merge_table scopes;
+
+    if (!dst || !src || dst == src) {
+        return -1;
+    }
+
+    /* arena objects can't be released one by one, heap ones can't be kept in an arena */
+    if ((dst->arena == NULL) != (src->arena == NULL)) {
+        return -1;
+    }
+
+    ctr_stage_collect(dst);
+    ctr_stage_collect(src);
+
+    count_spans(dst, &resource_count, &scope_count);
+    count_spans(src, &resource_count, &scope_count);
+
+    if (table_init(&resources, resource_count) != 0) {
+        return -1;
+    }
+
+    if (table_init(&scopes, scope_count) != 0) {
+        table_destroy(&resources);
+        return -1;
+    }
+
+    /* src keeps working on a new arena once its chunks are handed over */
+    if (src->arena) {
+        arena = ctr_arena_create(src->arena->chunk_size);
+        if (!arena) {
+            table_destroy(&resources);
+            table_destroy(&scopes);
+            return -1;
+        }
+    }
+
+    if (names_adopt(dst, src) != 0) {
+        if (arena) {
+            ctr_arena_destroy(arena);
+        }
+        table_destroy(&resources);
+        table_destroy(&scopes);
+        return -1;
+    }
+
+    cfl_list_foreach(head, &dst->resource_spans) {
+        resource_span = cfl_list_entry(head, struct ctrace_resource_span, _head);
+        table_add(&resources, resource_span_hash(resource_span), resource_span);
+    }
+
+    cfl_list_foreach_safe(head, tmp, &src->resource_spans) {
+        resource_span = cfl_list_entry(head, struct ctrace_resource_span, _head);
+
+        hash = resource_span_hash(resource_span);
+        target = resource_span_lookup(&resources, resource_span, hash);
+
+        if (target) {
+            resource_span_merge(dst, resource_span, target, &scopes);
+            cfl_list_del(&resource_span->_head);
+            ctr_resource_span_destroy(resource_span);
+            continue;
+        }
+
+        table_add(&resources, hash, resource_span);
+
+        /* new resource span: move it as a whole */
+        cfl_list_del(&resource_span->_head);
+        cfl_list_add(&resource_span->_head, &dst->resource_spans);
+
+        cfl_list_foreach_safe(s_head, s_tmp, &resource_span->scope_spans) {
+            scope_span = cfl_list_entry(s_head, struct ctrace_scope_span, _head);
+            scope_span_move_spans(dst, scope_span, scope_span);
+        }
+    }
+
+    if (src->arena) {
+        ctr_arena_merge(dst->arena, src->arena);
+        src->arena = arena;
+    }
+
+    table_destroy(&resources);
+    table_destroy(&scopes);
+
+    return 0;
+}
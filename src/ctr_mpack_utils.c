@@ -18,15 +18,24 @@
  */
 
 #include <ctraces/ctr_mpack_utils.h>
+#include <ctraces/ctr_arena.h>
 #include <cfl/cfl_sds.h>
 #include <mpack/mpack.h>
+#include <string.h>
 
 int ctr_mpack_consume_string_or_nil_tag(mpack_reader_t *reader, cfl_sds_t *output_buffer)
+{
+    return ctr_mpack_consume_string_or_nil_tag_arena(reader, NULL, output_buffer);
+}
+
+int ctr_mpack_consume_string_or_nil_tag_arena(mpack_reader_t *reader,
+                                              struct ctr_arena *arena,
+                                              cfl_sds_t *output_buffer)
 {
     int result;
 
     if (ctr_mpack_peek_type(reader) == mpack_type_str) {
-        result = ctr_mpack_consume_string_tag(reader, output_buffer);
+        result = ctr_mpack_consume_string_tag_arena(reader, arena, output_buffer);
     }
     else if (ctr_mpack_peek_type(reader) == mpack_type_nil) {
         result = ctr_mpack_consume_nil_tag(reader);
@@ -40,6 +49,28 @@ int ctr_mpack_consume_string_or_nil_tag(mpack_reader_t *reader, cfl_sds_t *outpu
     return result;
 }
 
+/* a nil value is returned as a NULL pointer */
+int ctr_mpack_consume_string_or_nil_tag_inplace(mpack_reader_t *reader,
+                                                const char **str, size_t *length)
+{
+    int result;
+
+    if (ctr_mpack_peek_type(reader) == mpack_type_str) {
+        result = ctr_mpack_consume_string_tag_inplace(reader, str, length);
+    }
+    else if (ctr_mpack_peek_type(reader) == mpack_type_nil) {
+        result = ctr_mpack_consume_nil_tag(reader);
+
+        *str = NULL;
+        *length = 0;
+    }
+    else {
+        result = CTR_MPACK_UNEXPECTED_DATA_TYPE_ERROR;
+    }
+
+    return result;
+}
+
 int ctr_mpack_consume_binary_or_nil_tag(mpack_reader_t *reader, cfl_sds_t *output_buffer)
 {
     int result;
@@ -208,6 +239,14 @@ int ctr_mpack_consume_int64_tag(mpack_reader_t *reader, int64_t *output_buffer)
 }
 
 int ctr_mpack_consume_string_tag(mpack_reader_t *reader, cfl_sds_t *output_buffer)
+{
+    return ctr_mpack_consume_string_tag_arena(reader, NULL, output_buffer);
+}
+
+/* when arena is NULL the string is allocated from the heap */
+int ctr_mpack_consume_string_tag_arena(mpack_reader_t *reader,
+                                       struct ctr_arena *arena,
+                                       cfl_sds_t *output_buffer)
 {
     uint32_t    string_length;
     mpack_tag_t tag;
@@ -241,18 +280,16 @@ int ctr_mpack_consume_string_tag(mpack_reader_t *reader, cfl_sds_t *output_buffe
         return CTR_MPACK_CORRUPT_INPUT_DATA_ERROR;
     }
 
-    *output_buffer = cfl_sds_create_size(string_length + 1);
+    *output_buffer = ctr_arena_sds_create_len(arena, NULL, string_length);
 
     if (NULL == *output_buffer) {
         return CTR_MPACK_ALLOCATION_ERROR;
     }
 
-    cfl_sds_set_len(*output_buffer, string_length);
-
     mpack_read_cstr(reader, *output_buffer, string_length + 1, string_length);
 
     if (mpack_ok != mpack_reader_error(reader)) {
-        cfl_sds_destroy(*output_buffer);
+        ctr_arena_sds_destroy(arena, *output_buffer);
 
         *output_buffer = NULL;
 
@@ -262,7 +299,7 @@ int ctr_mpack_consume_string_tag(mpack_reader_t *reader, cfl_sds_t *output_buffe
     mpack_done_str(reader);
 
     if (mpack_ok != mpack_reader_error(reader)) {
-        cfl_sds_destroy(*output_buffer);
+        ctr_arena_sds_destroy(arena, *output_buffer);
 
         *output_buffer = NULL;
 
@@ -328,6 +365,80 @@ int ctr_mpack_consume_binary_tag(mpack_reader_t *reader, cfl_sds_t *output_buffe
     return CTR_MPACK_SUCCESS;
 }
 
+/* reads a string in place, the returned pointer references the reader buffer
+ * and is only valid until the next read. It is not NULL terminated.
+ */
+int ctr_mpack_consume_string_tag_inplace(mpack_reader_t *reader,
+                                         const char **key, size_t *key_length)
+{
+    uint32_t    string_length;
+    mpack_tag_t tag;
+
+    tag = mpack_read_tag(reader);
+
+    if (mpack_ok != mpack_reader_error(reader)) {
+        return CTR_MPACK_ENGINE_ERROR;
+    }
+
+    if (mpack_type_str != mpack_tag_type(&tag)) {
+        return CTR_MPACK_UNEXPECTED_DATA_TYPE_ERROR;
+    }
+
+    string_length = mpack_tag_str_length(&tag);
+
+    if (CTR_MPACK_MAX_STRING_LENGTH < string_length) {
+        return CTR_MPACK_CORRUPT_INPUT_DATA_ERROR;
+    }
+
+    *key = "";
+    *key_length = string_length;
+
+    if (string_length > 0) {
+        *key = mpack_read_bytes_inplace(reader, string_length);
+
+        if (mpack_ok != mpack_reader_error(reader)) {
+            return CTR_MPACK_ENGINE_ERROR;
+        }
+    }
+
+    mpack_done_str(reader);
+
+    if (mpack_ok != mpack_reader_error(reader)) {
+        return CTR_MPACK_ENGINE_ERROR;
+    }
+
+    return CTR_MPACK_SUCCESS;
+}
+
+/* the first byte rejects most candidates before the bounded compare, the
+ * identifier must end exactly where the key does
+ */
+static struct ctr_mpack_map_entry_callback_t *lookup_map_entry(
+                            struct ctr_mpack_map_entry_callback_t *callback_list,
+                            const char *key, size_t key_length)
+{
+    struct ctr_mpack_map_entry_callback_t *callback_entry;
+
+    if (key_length == 0 || memchr(key, '\0', key_length) != NULL) {
+        return NULL;
+    }
+
+    for (callback_entry = callback_list ;
+         NULL != callback_entry->identifier ;
+         callback_entry++) {
+        if (callback_entry->identifier[0] != key[0]) {
+            continue;
+        }
+
+        if (0 == strncmp(callback_entry->identifier, key, key_length) &&
+            '\0' == callback_entry->identifier[key_length]) {
+            return callback_entry;
+        }
+    }
+
+    return NULL;
+}
+
 int ctr_mpack_unpack_map(mpack_reader_t *reader,
                          struct ctr_mpack_map_entry_callback_t *callback_list,
                          void *context)
@@ -335,7 +446,8 @@ int ctr_mpack_unpack_map(mpack_reader_t *reader,
     struct ctr_mpack_map_entry_callback_t *callback_entry;
     uint32_t                               entry_index;
     uint32_t                               entry_count;
-    cfl_sds_t                              key_name;
+    const char                            *key_name;
+    size_t                                 key_length;
     int                                    result;
     mpack_tag_t                            tag;
 
@@ -365,23 +477,17 @@ int ctr_mpack_unpack_map(mpack_reader_t *reader,
     result = 0;
 
     for (entry_index = 0 ; 0 == result && entry_index < entry_count ; entry_index++) {
-        result = ctr_mpack_consume_string_tag(reader, &key_name);
+        result = ctr_mpack_consume_string_tag_inplace(reader, &key_name, &key_length);
 
         if (CTR_MPACK_SUCCESS == result) {
-            callback_entry = callback_list;
-            result = CTR_MPACK_UNEXPECTED_KEY_ERROR;
+            callback_entry = lookup_map_entry(callback_list, key_name, key_length);
 
-            while (CTR_MPACK_UNEXPECTED_KEY_ERROR == result &&
-                   NULL != callback_entry->identifier) {
-
-                if (0 == strcmp(callback_entry->identifier, key_name)) {
-                    result = callback_entry->handler(reader, entry_index, context);
-                }
-
-                callback_entry++;
+            if (NULL == callback_entry) {
+                result = CTR_MPACK_UNEXPECTED_KEY_ERROR;
+            }
+            else {
+                result = callback_entry->handler(reader, entry_index, context);
             }
-
-            cfl_sds_destroy(key_name);
         }
     }
 
@@ -0,0 +1,498 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <ctraces/ctraces.h>
+#include <ctraces/ctr_otlp_wire.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+/*
+ * Parallel OTLP encoding
+ * ----------------------
+ * Repeated fields concatenate on the wire, so the request is cut into
+ * shards written independently: whole resource spans, or the scope spans
+ * of a resource span holding more than its share of the spans, surrounded
+ * by the head and tail of that resource span. Workers size every shard,
+ * the offsets are laid out in output order, then workers write each shard
+ * in place. The bytes are the same as the serial encoder's.
+ *
+ * Workers come from a process wide pool started on first use and grown up
+ * to the largest 'nthreads' asked for, so encoding a request does not pay
+ * for thread creation. Idle workers sleep until a job is queued and live
+ * until the process exits; a forked child starts a pool of its own.
+ */
+
+#define SHARD_RESOURCE_SPAN     0
+#define SHARD_SCOPE_SPAN        1
+#define SHARD_HEAD              2
+#define SHARD_TAIL              3
+
+#define PHASE_SIZE              0
+#define PHASE_WRITE             1
+
+struct parallel_shard {
+    int type;
+    void *ptr;                    /* resource or scope span */
+    size_t scope_spans_size;      /* head: size of the scope spans entries */
+    size_t size;
+    size_t offset;
+    int error;
+    struct ctr_otlp_wire wire;
+};
+
+struct parallel_job {
+    int phase;
+    int count;
+    volatile long next;
+    char *buf;
+    struct parallel_shard *shards;
+
+    /* pool state, protected by the pool lock */
+    int helpers;                  /* workers still wanted */
+    int active;                   /* workers running the job */
+    int queued;
+    struct cfl_list _head;        /* link to 'parallel_pool.jobs' */
+};
+
+#ifdef _WIN32
+#define POOL_LOCK()             AcquireSRWLockExclusive(&pool.lock)
+#define POOL_UNLOCK()           ReleaseSRWLockExclusive(&pool.lock)
+#define POOL_WAIT(cond)         SleepConditionVariableSRW(&cond, &pool.lock, INFINITE, 0)
+#define POOL_BROADCAST(cond)    WakeAllConditionVariable(&cond)
+#else
+#define POOL_LOCK()             pthread_mutex_lock(&pool.lock)
+#define POOL_UNLOCK()           pthread_mutex_unlock(&pool.lock)
+#define POOL_WAIT(cond)         pthread_cond_wait(&cond, &pool.lock)
+#define POOL_BROADCAST(cond)    pthread_cond_broadcast(&cond)
+#endif
+
+struct parallel_pool {
+#ifdef _WIN32
+    SRWLOCK lock;
+    CONDITION_VARIABLE work;      /* a job was queued */
+    CONDITION_VARIABLE done;      /* a worker left a job */
+#else
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+#endif
+    int threads;
+    struct cfl_list jobs;
+};
+
+static struct parallel_pool pool = {
+#ifdef _WIN32
+    SRWLOCK_INIT, CONDITION_VARIABLE_INIT, CONDITION_VARIABLE_INIT,
+#else
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER,
+#endif
+    0, {NULL, NULL}
+};
+
+static int job_next(struct parallel_job *job)
+{
+#ifdef _WIN32
+    return InterlockedIncrement(&job->next) - 1;
+#else
+    return __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+static void shard_size(struct parallel_shard *shard)
+{
+    ssize_t ret;
+
+    switch (shard->type) {
+        case SHARD_RESOURCE_SPAN:
+            ret = ctr_otlp_wire_size_resource_span(&shard->wire, shard->ptr);
+            break;
+        case SHARD_SCOPE_SPAN:
+            ret = ctr_otlp_wire_size_scope_span(&shard->wire, shard->ptr);
+            break;
+        default:
+            /* heads and tails are sized once their scope spans are */
+            return;
+    }
+
+    if (ret < 0) {
+        shard->error = CTR_TRUE;
+        return;
+    }
+    shard->size = ret;
+}
+
+static void shard_write(struct parallel_shard *shard, char *buf)
+{
+    int ret;
+
+    ctr_otlp_wire_set_buffer(&shard->wire, buf + shard->offset, shard->size);
+
+    switch (shard->type) {
+        case SHARD_RESOURCE_SPAN:
+            ret = ctr_otlp_wire_write_resource_span(&shard->wire, shard->ptr);
+            break;
+        case SHARD_SCOPE_SPAN:
+            ret = ctr_otlp_wire_write_scope_span(&shard->wire, shard->ptr);
+            break;
+        case SHARD_HEAD:
+            ret = ctr_otlp_wire_write_resource_span_head(&shard->wire, shard->ptr,
+                                                         shard->scope_spans_size);
+            break;
+        default:
+            ret = ctr_otlp_wire_write_resource_span_tail(&shard->wire, shard->ptr);
+            break;
+    }
+
+    if (ret != 0 || shard->wire.buf_len != shard->size) {
+        shard->error = CTR_TRUE;
+    }
+}
+
+static void job_run(struct parallel_job *job)
+{
+    int i;
+
+    while ((i = job_next(job)) < job->count) {
+        if (job->phase == PHASE_SIZE) {
+            shard_size(&job->shards[i]);
+        }
+        else {
+            shard_write(&job->shards[i], job->buf);
+        }
+    }
+}
+
+static void pool_work(void)
+{
+    struct parallel_job *job;
+
+    POOL_LOCK();
+    while (1) {
+        while (cfl_list_is_empty(&pool.jobs)) {
+            POOL_WAIT(pool.work);
+        }
+
+        job = cfl_list_entry_first(&pool.jobs, struct parallel_job, _head);
+        if (--job->helpers == 0) {
+            cfl_list_del(&job->_head);
+            job->queued = CTR_FALSE;
+        }
+        job->active++;
+        POOL_UNLOCK();
+
+        job_run(job);
+
+        POOL_LOCK();
+        if (--job->active == 0) {
+            POOL_BROADCAST(pool.done);
+        }
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI pool_thread(LPVOID data)
+{
+    pool_work();
+    return 0;
+}
+#else
+static void *pool_thread(void *data)
+{
+    pool_work();
+    return NULL;
+}
+
+/* only the forking thread survives, the child starts its workers again */
+static void pool_atfork_child(void)
+{
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.work, NULL);
+    pthread_cond_init(&pool.done, NULL);
+    pool.threads = 0;
+    cfl_list_init(&pool.jobs);
+}
+#endif
+
+/* start workers up to 'nthreads', called with the lock held */
+static void pool_grow(int nthreads)
+{
+#ifdef _WIN32
+    HANDLE thread;
+#else
+    pthread_t thread;
+    pthread_attr_t attr;
+#endif
+
+    if (pool.jobs.next == NULL) {
+        cfl_list_init(&pool.jobs);
+#ifndef _WIN32
+        pthread_atfork(NULL, NULL, pool_atfork_child);
+#endif
+    }
+
+#ifdef _WIN32
+    while (pool.threads < nthreads) {
+        thread = CreateThread(NULL, 0, pool_thread, NULL, 0, NULL);
+        if (thread == NULL) {
+            break;
+        }
+        CloseHandle(thread);
+        pool.threads++;
+    }
+#else
+    if (pool.threads >= nthreads || pthread_attr_init(&attr) != 0) {
+        return;
+    }
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    while (pool.threads < nthreads) {
+        if (pthread_create(&thread, &attr, pool_thread, NULL) != 0) {
+            break;
+        }
+        pool.threads++;
+    }
+    pthread_attr_destroy(&attr);
+#endif
+}
+
+/* run the job on up to 'nthreads' threads, the caller being one of them */
+static void job_execute(struct parallel_job *job, int nthreads)
+{
+    int shared = CTR_FALSE;
+
+    job->next = 0;
+    job->helpers = 0;
+    job->active = 0;
+    job->queued = CTR_FALSE;
+
+    if (nthreads > job->count) {
+        nthreads = job->count;
+    }
+
+    /* fewer workers than asked for is fine, the caller takes the rest */
+    if (nthreads > 1) {
+        POOL_LOCK();
+        pool_grow(nthreads - 1);
+        job->helpers = nthreads - 1 < pool.threads ? nthreads - 1 : pool.threads;
+        if (job->helpers > 0) {
+            cfl_list_add(&job->_head, &pool.jobs);
+            job->queued = CTR_TRUE;
+            shared = CTR_TRUE;
+            POOL_BROADCAST(pool.work);
+        }
+        POOL_UNLOCK();
+    }
+
+    job_run(job);
+
+    if (!shared) {
+        return;
+    }
+
+    /* workers that did not pick the job up in time are not waited for */
+    POOL_LOCK();
+    if (job->queued) {
+        cfl_list_del(&job->_head);
+        job->queued = CTR_FALSE;
+    }
+    while (job->active > 0) {
+        POOL_WAIT(pool.done);
+    }
+    POOL_UNLOCK();
+}
+
+static size_t resource_span_count(struct ctrace_resource_span *resource_span)
+{
+    size_t count = 0;
+    struct cfl_list *head;
+    struct ctrace_scope_span *scope_span;
+
+    cfl_list_foreach(head, &resource_span->scope_spans) {
+        scope_span = cfl_list_entry(head, struct ctrace_scope_span, _head);
+        count += cfl_list_size(&scope_span->spans);
+    }
+
+    return count;
+}
+
+/* cut the request in shards, returns the number of shards or -1 */
+static int shards_create(struct ctrace *ctx, int nthreads, struct parallel_shard **out)
+{
+    int count = 0;
+    int alloc = 0;
+    size_t spans;
+    size_t share;
+    size_t total = 0;
+    struct cfl_list *head;
+    struct cfl_list *s_head;
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_scope_span *scope_span;
+    struct parallel_shard *shards;
+
+    cfl_list_foreach(head, &ctx->resource_spans) {
+        resource_span = cfl_list_entry(head, struct ctrace_resource_span, _head);
+        total += resource_span_count(resource_span);
+        alloc += cfl_list_size(&resource_span->scope_spans) + 2;
+    }
+
+    shards = calloc(alloc > 0 ? alloc : 1, sizeof(struct parallel_shard));
+    if (!shards) {
+        ctr_errno();
+        return -1;
+    }
+
+    share = total / nthreads;
+
+    cfl_list_foreach(head, &ctx->resource_spans) {
+        resource_span = cfl_list_entry(head, struct ctrace_resource_span, _head);
+        spans = resource_span_count(resource_span);
+
+        if (spans <= share || cfl_list_size(&resource_span->scope_spans) < 2) {
+            shards[count].type = SHARD_RESOURCE_SPAN;
+            shards[count++].ptr = resource_span;
+            continue;
+        }
+
+        shards[count].type = SHARD_HEAD;
+        shards[count++].ptr = resource_span;
+
+        cfl_list_foreach(s_head, &resource_span->scope_spans) {
+            scope_span = cfl_list_entry(s_head, struct ctrace_scope_span, _head);
+            shards[count].type = SHARD_SCOPE_SPAN;
+            shards[count++].ptr = scope_span;
+        }
+
+        shards[count].type = SHARD_TAIL;
+        shards[count++].ptr = resource_span;
+    }
+
+    for (alloc = 0; alloc < count; alloc++) {
+        ctr_otlp_wire_init(&shards[alloc].wire);
+    }
+
+    *out = shards;
+    return count;
+}
+
+/* size heads and tails and lay the shards out, returns the total size or -1 */
+static ssize_t shards_layout(struct parallel_shard *shards, int count)
+{
+    int i;
+    int j;
+    ssize_t ret;
+    size_t offset = 0;
+    struct parallel_shard *shard;
+
+    for (i = 0; i < count; i++) {
+        shard = &shards[i];
+        if (shard->error) {
+            return -1;
+        }
+
+        if (shard->type == SHARD_HEAD) {
+            for (j = i + 1; shards[j].type == SHARD_SCOPE_SPAN; j++) {
+                shard->scope_spans_size += shards[j].size;
+            }
+
+            ret = ctr_otlp_wire_size_resource_span_head(&shard->wire, shard->ptr,
+                                                        shard->scope_spans_size);
+            if (ret < 0) {
+                return -1;
+            }
+            shard->size = ret;
+        }
+        else if (shard->type == SHARD_TAIL) {
+            shard->size = ctr_otlp_wire_size_resource_span_tail(shard->ptr);
+        }
+
+        shard->offset = offset;
+        offset += shard->size;
+    }
+
+    return offset;
+}
+
+cfl_sds_t ctr_encode_opentelemetry_create_parallel(struct ctrace *ctr, int nthreads)
+{
+    int i;
+    int count;
+    ssize_t len;
+    cfl_sds_t buf = NULL;
+    struct parallel_job job;
+    struct parallel_shard *shards;
+
+    if (!ctr) {
+        return NULL;
+    }
+
+    if (nthreads > CTR_ENCODE_OPENTELEMETRY_MAX_THREADS) {
+        nthreads = CTR_ENCODE_OPENTELEMETRY_MAX_THREADS;
+    }
+
+    if (nthreads <= 1) {
+        return ctr_encode_opentelemetry_direct_create(ctr);
+    }
+
+    count = shards_create(ctr, nthreads, &shards);
+    if (count < 0) {
+        return NULL;
+    }
+
+    memset(&job, 0, sizeof(job));
+    job.shards = shards;
+    job.count = count;
+
+    job.phase = PHASE_SIZE;
+    job_execute(&job, nthreads);
+
+    len = shards_layout(shards, count);
+    if (len < 0) {
+        goto exit;
+    }
+
+    buf = cfl_sds_create_size(len);
+    if (!buf) {
+        goto exit;
+    }
+
+    job.phase = PHASE_WRITE;
+    job.buf = buf;
+    job_execute(&job, nthreads);
+
+    for (i = 0; i < count; i++) {
+        if (shards[i].error) {
+            cfl_sds_destroy(buf);
+            buf = NULL;
+            goto exit;
+        }
+    }
+    cfl_sds_set_len(buf, len);
+
+exit:
+    for (i = 0; i < count; i++) {
+        ctr_otlp_wire_exit(&shards[i].wire);
+    }
+    free(shards);
+
+    return buf;
+}
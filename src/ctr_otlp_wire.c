@@ -0,0 +1,1684 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <ctraces/ctraces.h>
+#include <ctraces/ctr_otlp_wire.h>
+
+/*
+ * Sizing helpers
+ * --------------
+ */
+
+static inline size_t varint_size(uint64_t value)
+{
+    size_t size;
+
+    size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+
+    return size;
+}
+
+/* enum and int32 values are sign extended to 64 bits */
+static inline size_t int32_size(int32_t value)
+{
+    return varint_size((uint64_t) (int64_t) value);
+}
+
+static inline size_t tag_size(int field)
+{
+    return varint_size(CTR_OTLP_FIELD_TAG(field, 0));
+}
+
+static inline size_t len_field_size(int field, size_t len)
+{
+    return tag_size(field) + varint_size(len) + len;
+}
+
+/* proto3 scalars and strings are not written when they hold a zero value */
+static inline size_t uint32_field_size(int field, uint32_t value)
+{
+    if (value == 0) {
+        return 0;
+    }
+
+    return tag_size(field) + varint_size(value);
+}
+
+static inline size_t enum_field_size(int field, int32_t value)
+{
+    if (value == 0) {
+        return 0;
+    }
+
+    return tag_size(field) + int32_size(value);
+}
+
+static inline size_t fixed64_field_size(int field, uint64_t value)
+{
+    if (value == 0) {
+        return 0;
+    }
+
+    return tag_size(field) + 8;
+}
+
+static inline size_t string_field_size(int field, char *str)
+{
+    size_t len;
+
+    if (str == NULL) {
+        return 0;
+    }
+
+    len = strlen(str);
+    if (len == 0) {
+        return 0;
+    }
+
+    return len_field_size(field, len);
+}
+
+static inline size_t id_field_size(int field, struct ctrace_id *id)
+{
+    size_t len;
+
+    if (id == NULL) {
+        return 0;
+    }
+
+    len = ctr_id_get_len(id);
+    if (len == 0) {
+        return 0;
+    }
+
+    return len_field_size(field, len);
+}
+
+static int slot_reserve(struct ctr_otlp_wire *wire, size_t *index)
+{
+    size_t alloc;
+    size_t *tmp;
+
+    if (wire->sizes_count == wire->sizes_alloc) {
+        alloc = wire->sizes_alloc * 2;
+        if (alloc == 0) {
+            alloc = 256;
+        }
+
+        tmp = realloc(wire->sizes, alloc * sizeof(size_t));
+        if (!tmp) {
+            ctr_errno();
+            return -1;
+        }
+        wire->sizes = tmp;
+        wire->sizes_alloc = alloc;
+    }
+
+    *index = wire->sizes_count++;
+    return 0;
+}
+
+static inline size_t slot_next(struct ctr_otlp_wire *wire)
+{
+    if (wire->sizes_index >= wire->sizes_count) {
+        wire->error = CTR_TRUE;
+        return 0;
+    }
+
+    return wire->sizes[wire->sizes_index++];
+}
+
+static inline int variant_is_supported(struct cfl_variant *value)
+{
+    switch (value->type) {
+        case CFL_VARIANT_STRING:
+        case CFL_VARIANT_BOOL:
+        case CFL_VARIANT_INT:
+        case CFL_VARIANT_DOUBLE:
+        case CFL_VARIANT_ARRAY:
+        case CFL_VARIANT_KVLIST:
+        case CFL_VARIANT_BYTES:
+        case CFL_VARIANT_REFERENCE:
+            return CTR_TRUE;
+        default:
+            return CTR_FALSE;
+    }
+}
+
+/*
+ * Sizing pass
+ * -----------
+ * Every function returns the size of the message body and stores it in the
+ * slot reserved before visiting its children.
+ */
+
+static ssize_t size_key_value(struct ctr_otlp_wire *wire, struct cfl_kvpair *pair);
+
+static ssize_t size_any_value(struct ctr_otlp_wire *wire, struct cfl_variant *value);
+
+static ssize_t size_array_value(struct ctr_otlp_wire *wire, struct cfl_array *array)
+{
+    size_t i;
+    size_t slot;
+    size_t size = 0;
+    ssize_t ret;
+    struct cfl_variant *entry;
+
+    if (slot_reserve(wire, &slot) != 0) {
+        return -1;
+    }
+
+    for (i = 0; i < array->entry_count; i++) {
+        entry = array->entries[i];
+        if (!variant_is_supported(entry)) {
+            continue;
+        }
+
+        ret = size_any_value(wire, entry);
+        if (ret < 0) {
+            return -1;
+        }
+        size += len_field_size(CTR_OTLP_LIST_VALUES, ret);
+    }
+
+    wire->sizes[slot] = size;
+    return size;
+}
+
+static ssize_t size_kvlist_value(struct ctr_otlp_wire *wire, struct cfl_kvlist *kvlist)
+{
+    size_t slot;
+    size_t size = 0;
+    ssize_t ret;
+    struct cfl_list *head;
+    struct cfl_kvpair *pair;
+
+    if (slot_reserve(wire, &slot) != 0) {
+        return -1;
+    }
+
+    cfl_list_foreach(head, &kvlist->list) {
+        pair = cfl_list_entry(head, struct cfl_kvpair, _head);
+        if (!variant_is_supported(pair->val)) {
+            continue;
+        }
+
+        ret = size_key_value(wire, pair);
+        if (ret < 0) {
+            return -1;
+        }
+        size += len_field_size(CTR_OTLP_LIST_VALUES, ret);
+    }
+
+    wire->sizes[slot] = size;
+    return size;
+}
+
+static ssize_t size_any_value(struct ctr_otlp_wire *wire, struct cfl_variant *value)
+{
+    size_t slot;
+    size_t size = 0;
+    ssize_t ret;
+
+    if (slot_reserve(wire, &slot) != 0) {
+        return -1;
+    }
+
+    /* members of a oneof are always written, even if they hold a zero value */
+    switch (value->type) {
+        case CFL_VARIANT_STRING:
+            size = len_field_size(CTR_OTLP_ANY_VALUE_STRING, strlen(value->data.as_string));
+            break;
+        case CFL_VARIANT_REFERENCE:
+            size = len_field_size(CTR_OTLP_ANY_VALUE_STRING, strlen(value->data.as_reference));
+            break;
+        case CFL_VARIANT_BOOL:
+            size = tag_size(CTR_OTLP_ANY_VALUE_BOOL) + 1;
+            break;
+        case CFL_VARIANT_INT:
+            size = tag_size(CTR_OTLP_ANY_VALUE_INT) + varint_size((uint64_t) value->data.as_int64);
+            break;
+        case CFL_VARIANT_DOUBLE:
+            size = tag_size(CTR_OTLP_ANY_VALUE_DOUBLE) + 8;
+            break;
+        case CFL_VARIANT_ARRAY:
+            ret = size_array_value(wire, value->data.as_array);
+            if (ret < 0) {
+                return -1;
+            }
+            size = len_field_size(CTR_OTLP_ANY_VALUE_ARRAY, ret);
+            break;
+        case CFL_VARIANT_KVLIST:
+            ret = size_kvlist_value(wire, value->data.as_kvlist);
+            if (ret < 0) {
+                return -1;
+            }
+            size = len_field_size(CTR_OTLP_ANY_VALUE_KVLIST, ret);
+            break;
+        case CFL_VARIANT_BYTES:
+            size = len_field_size(CTR_OTLP_ANY_VALUE_BYTES, cfl_sds_len(value->data.as_bytes));
+            break;
+    }
+
+    wire->sizes[slot] = size;
+    return size;
+}
+
+static ssize_t size_key_value(struct ctr_otlp_wire *wire, struct cfl_kvpair *pair)
+{
+    size_t slot;
+    size_t size;
+    ssize_t ret;
+
+    if (slot_reserve(wire, &slot) != 0) {
+        return -1;
+    }
+
+    size = string_field_size(CTR_OTLP_KEY_VALUE_KEY, pair->key);
+
+    ret = size_any_value(wire, pair->val);
+    if (ret < 0) {
+        return -1;
+    }
+    size += len_field_size(CTR_OTLP_KEY_VALUE_VALUE, ret);
+
+    wire->sizes[slot] = size;
+    return size;
+}
+
+/* size of a repeated KeyValue field, this is not a message on its own */
+static ssize_t size_attributes(struct ctr_otlp_wire *wire, int field,
+                               struct ctrace_attributes *attr)
+{
+    size_t size = 0;
+    ssize_t ret;
+    struct cfl_list *head;
+    struct cfl_kvpair *pair;
+
+    if (attr == NULL || attr->kv == NULL) {
+        return 0;
+    }
+
+    cfl_list_foreach(head, &attr->kv->list) {
+        pair = cfl_list_entry(head, struct cfl_kvpair, _head);
+        if (!variant_is_supported(pair->val)) {
+            continue;
+        }
+
+        ret = size_key_value(wire, pair);
+        if (ret < 0) {
+            return -1;
+        }
+        size += len_field_size(field, ret);
+    }
+
+    return size;
+}
+
+static ssize_t size_resource(struct ctr_otlp_wire *wire, struct ctrace_resource *resource)
+{
+    size_t slot;
+    size_t size;
+    ssize_t ret;
+
+    if (slot_reserve(wire, &slot) != 0) {
+        return -1;
+    }
+
+    ret = size_attributes(wire, CTR_OTLP_RESOURCE_ATTRIBUTES, resource->attr);
+    if (ret < 0) {
+        return -1;
+    }
+    size = ret;
+    size += uint32_field_size(CTR_OTLP_RESOURCE_DROPPED_ATTRIBUTES, resource->dropped_attr_count);
+
+    wire->sizes[slot] = size;
+    return size;
+}
+
+static ssize_t size_instrumentation_scope(struct ctr_otlp_wire *wire,
+                                          struct ctrace_instrumentation_scope *scope)
+{
+    size_t slot;
+    size_t size;
+    ssize_t ret;
+
+    if (slot_reserve(wire, &slot) != 0) {
+        return -1;
+    }
+
+    size = string_field_size(CTR_OTLP_SCOPE_NAME, scope->name);
+    size += string_field_size(CTR_OTLP_SCOPE_VERSION, scope->version);
+
+    ret = size_attributes(wire, CTR_OTLP_SCOPE_ATTRIBUTES, scope->attr);
+    if (ret < 0) {
+        return -1;
+    }
+    size += ret;
+    size += uint32_field_size(CTR_OTLP_SCOPE_DROPPED_ATTRIBUTES, scope->dropped_attr_count);
+
+    wire->sizes[slot] = size;
+    return size;
+}
+
+static ssize_t size_event(struct ctr_otlp_wire *wire, struct ctrace_span_event *event)
+{
+    size_t slot;
+    size_t size;
+    ssize_t ret;
+
+    if (slot_reserve(wire, &slot) != 0) {
+        return -1;
+    }
+
+    size = fixed64_field_size(CTR_OTLP_EVENT_TIME, event->time_unix_nano);
+    size += string_field_size(CTR_OTLP_EVENT_NAME, event->name);
+
+    ret = size_attributes(wire, CTR_OTLP_EVENT_ATTRIBUTES, event->attr);
+    if (ret < 0) {
+        return -1;
+    }
+    size += ret;
+    size += uint32_field_size(CTR_OTLP_EVENT_DROPPED_ATTRIBUTES, event->dropped_attr_count);
+
+    wire->sizes[slot] = size;
+    return size;
+}
+
+static ssize_t size_link(struct ctr_otlp_wire *wire, struct ctrace_link *link)
+{
+    size_t slot;
+    size_t size;
+    ssize_t ret;
+
+    if (slot_reserve(wire, &slot) != 0) {
+        return -1;
+    }
+
+    size = id_field_size(CTR_OTLP_LINK_TRACE_ID, link->trace_id);
+    size += id_field_size(CTR_OTLP_LINK_SPAN_ID, link->span_id);
+    size += string_field_size(CTR_OTLP_LINK_TRACE_STATE, link->trace_state);
+
+    ret = size_attributes(wire, CTR_OTLP_LINK_ATTRIBUTES, link->attr);
+    if (ret < 0) {
+        return -1;
+    }
+    size += ret;
+    size += uint32_field_size(CTR_OTLP_LINK_DROPPED_ATTRIBUTES, link->dropped_attr_count);
+
+    wire->sizes[slot] = size;
+    return size;
+}
+
+static ssize_t size_status(struct ctr_otlp_wire *wire, struct ctrace_span_status *status)
+{
+    size_t slot;
+    size_t size;
+
+    if (slot_reserve(wire, &slot) != 0) {
+        return -1;
+    }
+
+    size = string_field_size(CTR_OTLP_STATUS_MESSAGE, status->message);
+    size += enum_field_size(CTR_OTLP_STATUS_CODE, status->code);
+
+    wire->sizes[slot] = size;
+    return size;
+}
+
+static int span_kind(struct ctrace_span *span)
+{
+    if (span->kind < CTRACE_SPAN_UNSPECIFIED || span->kind > CTRACE_SPAN_CONSUMER) {
+        return CTRACE_SPAN_UNSPECIFIED;
+    }
+
+    return span->kind;
+}
+
+static ssize_t size_span(struct ctr_otlp_wire *wire, struct ctrace_span *span)
+{
+    size_t slot;
+    size_t size;
+    ssize_t ret;
+    struct cfl_list *head;
+    struct ctrace_span_event *event;
+    struct ctrace_link *link;
+
+    if (slot_reserve(wire, &slot) != 0) {
+        return -1;
+    }
+
+    size = id_field_size(CTR_OTLP_SPAN_TRACE_ID, span->trace_id);
+    size += id_field_size(CTR_OTLP_SPAN_SPAN_ID, span->span_id);
+    size += string_field_size(CTR_OTLP_SPAN_TRACE_STATE, span->trace_state);
+    size += id_field_size(CTR_OTLP_SPAN_PARENT_SPAN_ID, span->parent_span_id);
+    size += string_field_size(CTR_OTLP_SPAN_NAME, span->name);
+    size += enum_field_size(CTR_OTLP_SPAN_KIND, span_kind(span));
+    size += fixed64_field_size(CTR_OTLP_SPAN_START_TIME, span->start_time_unix_nano);
+    size += fixed64_field_size(CTR_OTLP_SPAN_END_TIME, span->end_time_unix_nano);
+
+    ret = size_attributes(wire, CTR_OTLP_SPAN_ATTRIBUTES, span->attr);
+    if (ret < 0) {
+        return -1;
+    }
+    size += ret;
+    size += uint32_field_size(CTR_OTLP_SPAN_DROPPED_ATTRIBUTES, span->dropped_attr_count);
+
+    cfl_list_foreach(head, &span->events) {
+        event = cfl_list_entry(head, struct ctrace_span_event, _head);
+
+        ret = size_event(wire, event);
+        if (ret < 0) {
+            return -1;
+        }
+        size += len_field_size(CTR_OTLP_SPAN_EVENTS, ret);
+    }
+    size += uint32_field_size(CTR_OTLP_SPAN_DROPPED_EVENTS, span->dropped_events_count);
+
+    cfl_list_foreach(head, &span->links) {
+        link = cfl_list_entry(head, struct ctrace_link, _head);
+
+        ret = size_link(wire, link);
+        if (ret < 0) {
+            return -1;
+        }
+        size += len_field_size(CTR_OTLP_SPAN_LINKS, ret);
+    }
+
+    /* the status message is always present */
+    ret = size_status(wire, &span->status);
+    if (ret < 0) {
+        return -1;
+    }
+    size += len_field_size(CTR_OTLP_SPAN_STATUS, ret);
+
+    wire->sizes[slot] = size;
+    return size;
+}
+
+static ssize_t size_scope_span(struct ctr_otlp_wire *wire, struct ctrace_scope_span *scope_span)
+{
+    size_t slot;
+    size_t size = 0;
+    ssize_t ret;
+    struct cfl_list *head;
+    struct ctrace_span *span;
+
+    if (slot_reserve(wire, &slot) != 0) {
+        return -1;
+    }
+
+    if (scope_span->instrumentation_scope) {
+        ret = size_instrumentation_scope(wire, scope_span->instrumentation_scope);
+        if (ret < 0) {
+            return -1;
+        }
+        size += len_field_size(CTR_OTLP_SCOPE_SPANS_SCOPE, ret);
+    }
+
+    cfl_list_foreach(head, &scope_span->spans) {
+        span = cfl_list_entry(head, struct ctrace_span, _head);
+
+        ret = size_span(wire, span);
+        if (ret < 0) {
+            return -1;
+        }
+        size += len_field_size(CTR_OTLP_SCOPE_SPANS_SPANS, ret);
+    }
+
+    size += string_field_size(CTR_OTLP_SCOPE_SPANS_SCHEMA_URL, scope_span->schema_url);
+
+    wire->sizes[slot] = size;
+    return size;
+}
+
+/* returns the size of the whole 'resource_spans' entry, tag and length included */
+ssize_t ctr_otlp_wire_size_resource_span(struct ctr_otlp_wire *wire,
+                                         struct ctrace_resource_span *resource_span)
+{
+    size_t slot;
+    size_t size = 0;
+    ssize_t ret;
+    struct cfl_list *head;
+    struct ctrace_scope_span *scope_span;
+
+    if (slot_reserve(wire, &slot) != 0) {
+        return -1;
+    }
+
+    if (resource_span->resource) {
+        ret = size_resource(wire, resource_span->resource);
+        if (ret < 0) {
+            return -1;
+        }
+        size += len_field_size(CTR_OTLP_RESOURCE_SPANS_RESOURCE, ret);
+    }
+
+    cfl_list_foreach(head, &resource_span->scope_spans) {
+        scope_span = cfl_list_entry(head, struct ctrace_scope_span, _head);
+
+        ret = size_scope_span(wire, scope_span);
+        if (ret < 0) {
+            return -1;
+        }
+        size += len_field_size(CTR_OTLP_RESOURCE_SPANS_SCOPE_SPANS, ret);
+    }
+
+    size += string_field_size(CTR_OTLP_RESOURCE_SPANS_SCHEMA_URL, resource_span->schema_url);
+
+    wire->sizes[slot] = size;
+
+    return len_field_size(CTR_OTLP_REQUEST_RESOURCE_SPANS, size);
+}
+
+/* returns the size of a 'scope_spans' entry of a resource span, tag and length included */
+ssize_t ctr_otlp_wire_size_scope_span(struct ctr_otlp_wire *wire,
+                                      struct ctrace_scope_span *scope_span)
+{
+    ssize_t ret;
+
+    ret = size_scope_span(wire, scope_span);
+    if (ret < 0) {
+        return -1;
+    }
+
+    return len_field_size(CTR_OTLP_RESOURCE_SPANS_SCOPE_SPANS, ret);
+}
+
+/*
+ * size of a 'resource_spans' entry up to its scope_spans entries, which are
+ * 'scope_spans_size' bytes in total and sized on their own
+ */
+ssize_t ctr_otlp_wire_size_resource_span_head(struct ctr_otlp_wire *wire,
+                                              struct ctrace_resource_span *resource_span,
+                                              size_t scope_spans_size)
+{
+    size_t size = 0;
+    size_t body;
+    ssize_t ret;
+
+    if (resource_span->resource) {
+        ret = size_resource(wire, resource_span->resource);
+        if (ret < 0) {
+            return -1;
+        }
+        size = len_field_size(CTR_OTLP_RESOURCE_SPANS_RESOURCE, ret);
+    }
+
+    body = size + scope_spans_size + ctr_otlp_wire_size_resource_span_tail(resource_span);
+
+    return tag_size(CTR_OTLP_REQUEST_RESOURCE_SPANS) + varint_size(body) + size;
+}
+
+/* size of what follows the scope_spans entries of a 'resource_spans' entry */
+size_t ctr_otlp_wire_size_resource_span_tail(struct ctrace_resource_span *resource_span)
+{
+    return string_field_size(CTR_OTLP_RESOURCE_SPANS_SCHEMA_URL, resource_span->schema_url);
+}
+
+ssize_t ctr_otlp_wire_size_request(struct ctr_otlp_wire *wire, struct ctrace *ctx)
+{
+    size_t size = 0;
+    ssize_t ret;
+    struct cfl_list *head;
+    struct ctrace_resource_span *resource_span;
+
+    cfl_list_foreach(head, &ctx->resource_spans) {
+        resource_span = cfl_list_entry(head, struct ctrace_resource_span, _head);
+
+        ret = ctr_otlp_wire_size_resource_span(wire, resource_span);
+        if (ret < 0) {
+            return -1;
+        }
+        size += ret;
+    }
+
+    return size;
+}
+
+/*
+ * Writing pass
+ * ------------
+ */
+
+/* take over the pending output of the writer */
+static inline void wire_writer_load(struct ctr_otlp_wire *wire)
+{
+    wire->buf = wire->writer->buf;
+    wire->buf_len = wire->writer->len;
+    wire->buf_size = wire->writer->size;
+}
+
+/* hand the bytes written so far back to the writer */
+static inline void wire_writer_store(struct ctr_otlp_wire *wire)
+{
+    wire->writer->len = wire->buf_len;
+}
+
+/* out of room: a streaming writer flushes its chunk, a fixed buffer fails */
+static int wire_room_slow(struct ctr_otlp_wire *wire, size_t len)
+{
+    if (!wire->writer || wire->error) {
+        wire->error = CTR_TRUE;
+        return CTR_FALSE;
+    }
+
+    wire_writer_store(wire);
+    if (!ctr_writer_reserve_slow(wire->writer, len)) {
+        wire->error = CTR_TRUE;
+        return CTR_FALSE;
+    }
+    wire_writer_load(wire);
+
+    return CTR_TRUE;
+}
+
+static inline int wire_room(struct ctr_otlp_wire *wire, size_t len)
+{
+    if (wire->buf_len + len > wire->buf_size) {
+        return wire_room_slow(wire, len);
+    }
+
+    return CTR_TRUE;
+}
+
+static inline void put_varint(struct ctr_otlp_wire *wire, uint64_t value)
+{
+    uint8_t *p;
+
+    if (!wire_room(wire, varint_size(value))) {
+        return;
+    }
+
+    p = (uint8_t *) wire->buf + wire->buf_len;
+    while (value >= 0x80) {
+        *p++ = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    *p++ = (uint8_t) value;
+
+    wire->buf_len = (char *) p - wire->buf;
+}
+
+static inline void put_bytes(struct ctr_otlp_wire *wire, const void *data, size_t len)
+{
+    /* values larger than the writer chunk go straight to its sink */
+    if (wire->writer && len >= wire->buf_size) {
+        if (wire->error) {
+            return;
+        }
+
+        wire_writer_store(wire);
+        ctr_writer_write(wire->writer, data, len);
+        wire_writer_load(wire);
+
+        if (wire->writer->error) {
+            wire->error = CTR_TRUE;
+        }
+        return;
+    }
+
+    if (!wire_room(wire, len)) {
+        return;
+    }
+
+    memcpy(wire->buf + wire->buf_len, data, len);
+    wire->buf_len += len;
+}
+
+static inline void put_fixed64(struct ctr_otlp_wire *wire, uint64_t value)
+{
+    int i;
+    uint8_t tmp[8];
+
+    for (i = 0; i < 8; i++) {
+        tmp[i] = (uint8_t) (value >> (i * 8));
+    }
+
+    put_bytes(wire, tmp, 8);
+}
+
+static inline void put_tag(struct ctr_otlp_wire *wire, int field, int type)
+{
+    put_varint(wire, CTR_OTLP_FIELD_TAG(field, type));
+}
+
+static inline void put_len_field(struct ctr_otlp_wire *wire, int field,
+                                 const void *data, size_t len)
+{
+    put_tag(wire, field, CTR_OTLP_WIRE_LEN);
+    put_varint(wire, len);
+    put_bytes(wire, data, len);
+}
+
+/* writes the header of an embedded message, its length is taken from the next slot */
+static inline void put_message_header(struct ctr_otlp_wire *wire, int field)
+{
+    put_tag(wire, field, CTR_OTLP_WIRE_LEN);
+    put_varint(wire, slot_next(wire));
+}
+
+static inline void put_uint32_field(struct ctr_otlp_wire *wire, int field, uint32_t value)
+{
+    if (value == 0) {
+        return;
+    }
+
+    put_tag(wire, field, CTR_OTLP_WIRE_VARINT);
+    put_varint(wire, value);
+}
+
+static inline void put_enum_field(struct ctr_otlp_wire *wire, int field, int32_t value)
+{
+    if (value == 0) {
+        return;
+    }
+
+    put_tag(wire, field, CTR_OTLP_WIRE_VARINT);
+    put_varint(wire, (uint64_t) (int64_t) value);
+}
+
+static inline void put_fixed64_field(struct ctr_otlp_wire *wire, int field, uint64_t value)
+{
+    if (value == 0) {
+        return;
+    }
+
+    put_tag(wire, field, CTR_OTLP_WIRE_FIXED64);
+    put_fixed64(wire, value);
+}
+
+static inline void put_string_field(struct ctr_otlp_wire *wire, int field, char *str)
+{
+    size_t len;
+
+    if (str == NULL) {
+        return;
+    }
+
+    len = strlen(str);
+    if (len == 0) {
+        return;
+    }
+
+    put_len_field(wire, field, str, len);
+}
+
+static inline void put_id_field(struct ctr_otlp_wire *wire, int field, struct ctrace_id *id)
+{
+    size_t len;
+
+    if (id == NULL) {
+        return;
+    }
+
+    len = ctr_id_get_len(id);
+    if (len == 0) {
+        return;
+    }
+
+    put_len_field(wire, field, ctr_id_get_buf(id), len);
+}
+
+static void write_key_value(struct ctr_otlp_wire *wire, struct cfl_kvpair *pair);
+
+static void write_any_value(struct ctr_otlp_wire *wire, struct cfl_variant *value)
+{
+    size_t i;
+    uint64_t bits;
+    struct cfl_list *head;
+    struct cfl_kvpair *pair;
+    struct cfl_array *array;
+    struct cfl_variant *entry;
+
+    switch (value->type) {
+        case CFL_VARIANT_STRING:
+            put_len_field(wire, CTR_OTLP_ANY_VALUE_STRING, value->data.as_string,
+                          strlen(value->data.as_string));
+            break;
+        case CFL_VARIANT_REFERENCE:
+            put_len_field(wire, CTR_OTLP_ANY_VALUE_STRING, value->data.as_reference,
+                          strlen(value->data.as_reference));
+            break;
+        case CFL_VARIANT_BOOL:
+            put_tag(wire, CTR_OTLP_ANY_VALUE_BOOL, CTR_OTLP_WIRE_VARINT);
+            put_varint(wire, value->data.as_bool ? 1 : 0);
+            break;
+        case CFL_VARIANT_INT:
+            put_tag(wire, CTR_OTLP_ANY_VALUE_INT, CTR_OTLP_WIRE_VARINT);
+            put_varint(wire, (uint64_t) value->data.as_int64);
+            break;
+        case CFL_VARIANT_DOUBLE:
+            memcpy(&bits, &value->data.as_double, sizeof(bits));
+            put_tag(wire, CTR_OTLP_ANY_VALUE_DOUBLE, CTR_OTLP_WIRE_FIXED64);
+            put_fixed64(wire, bits);
+            break;
+        case CFL_VARIANT_ARRAY:
+            put_message_header(wire, CTR_OTLP_ANY_VALUE_ARRAY);
+
+            array = value->data.as_array;
+            for (i = 0; i < array->entry_count; i++) {
+                entry = array->entries[i];
+                if (!variant_is_supported(entry)) {
+                    continue;
+                }
+
+                put_message_header(wire, CTR_OTLP_LIST_VALUES);
+                write_any_value(wire, entry);
+            }
+            break;
+        case CFL_VARIANT_KVLIST:
+            put_message_header(wire, CTR_OTLP_ANY_VALUE_KVLIST);
+
+            cfl_list_foreach(head, &value->data.as_kvlist->list) {
+                pair = cfl_list_entry(head, struct cfl_kvpair, _head);
+                if (!variant_is_supported(pair->val)) {
+                    continue;
+                }
+
+                put_message_header(wire, CTR_OTLP_LIST_VALUES);
+                write_key_value(wire, pair);
+            }
+            break;
+        case CFL_VARIANT_BYTES:
+            put_len_field(wire, CTR_OTLP_ANY_VALUE_BYTES, value->data.as_bytes,
+                          cfl_sds_len(value->data.as_bytes));
+            break;
+    }
+}
+
+static void write_key_value(struct ctr_otlp_wire *wire, struct cfl_kvpair *pair)
+{
+    put_string_field(wire, CTR_OTLP_KEY_VALUE_KEY, pair->key);
+
+    put_message_header(wire, CTR_OTLP_KEY_VALUE_VALUE);
+    write_any_value(wire, pair->val);
+}
+
+static void write_attributes(struct ctr_otlp_wire *wire, int field,
+                             struct ctrace_attributes *attr)
+{
+    struct cfl_list *head;
+    struct cfl_kvpair *pair;
+
+    if (attr == NULL || attr->kv == NULL) {
+        return;
+    }
+
+    cfl_list_foreach(head, &attr->kv->list) {
+        pair = cfl_list_entry(head, struct cfl_kvpair, _head);
+        if (!variant_is_supported(pair->val)) {
+            continue;
+        }
+
+        put_message_header(wire, field);
+        write_key_value(wire, pair);
+    }
+}
+
+static void write_resource(struct ctr_otlp_wire *wire, struct ctrace_resource *resource)
+{
+    write_attributes(wire, CTR_OTLP_RESOURCE_ATTRIBUTES, resource->attr);
+    put_uint32_field(wire, CTR_OTLP_RESOURCE_DROPPED_ATTRIBUTES, resource->dropped_attr_count);
+}
+
+static void write_instrumentation_scope(struct ctr_otlp_wire *wire,
+                                        struct ctrace_instrumentation_scope *scope)
+{
+    put_string_field(wire, CTR_OTLP_SCOPE_NAME, scope->name);
+    put_string_field(wire, CTR_OTLP_SCOPE_VERSION, scope->version);
+    write_attributes(wire, CTR_OTLP_SCOPE_ATTRIBUTES, scope->attr);
+    put_uint32_field(wire, CTR_OTLP_SCOPE_DROPPED_ATTRIBUTES, scope->dropped_attr_count);
+}
+
+static void write_event(struct ctr_otlp_wire *wire, struct ctrace_span_event *event)
+{
+    put_fixed64_field(wire, CTR_OTLP_EVENT_TIME, event->time_unix_nano);
+    put_string_field(wire, CTR_OTLP_EVENT_NAME, event->name);
+    write_attributes(wire, CTR_OTLP_EVENT_ATTRIBUTES, event->attr);
+    put_uint32_field(wire, CTR_OTLP_EVENT_DROPPED_ATTRIBUTES, event->dropped_attr_count);
+}
+
+static void write_link(struct ctr_otlp_wire *wire, struct ctrace_link *link)
+{
+    put_id_field(wire, CTR_OTLP_LINK_TRACE_ID, link->trace_id);
+    put_id_field(wire, CTR_OTLP_LINK_SPAN_ID, link->span_id);
+    put_string_field(wire, CTR_OTLP_LINK_TRACE_STATE, link->trace_state);
+    write_attributes(wire, CTR_OTLP_LINK_ATTRIBUTES, link->attr);
+    put_uint32_field(wire, CTR_OTLP_LINK_DROPPED_ATTRIBUTES, link->dropped_attr_count);
+}
+
+static void write_span(struct ctr_otlp_wire *wire, struct ctrace_span *span)
+{
+    struct cfl_list *head;
+    struct ctrace_span_event *event;
+    struct ctrace_link *link;
+
+    put_id_field(wire, CTR_OTLP_SPAN_TRACE_ID, span->trace_id);
+    put_id_field(wire, CTR_OTLP_SPAN_SPAN_ID, span->span_id);
+    put_string_field(wire, CTR_OTLP_SPAN_TRACE_STATE, span->trace_state);
+    put_id_field(wire, CTR_OTLP_SPAN_PARENT_SPAN_ID, span->parent_span_id);
+    put_string_field(wire, CTR_OTLP_SPAN_NAME, span->name);
+    put_enum_field(wire, CTR_OTLP_SPAN_KIND, span_kind(span));
+    put_fixed64_field(wire, CTR_OTLP_SPAN_START_TIME, span->start_time_unix_nano);
+    put_fixed64_field(wire, CTR_OTLP_SPAN_END_TIME, span->end_time_unix_nano);
+    write_attributes(wire, CTR_OTLP_SPAN_ATTRIBUTES, span->attr);
+    put_uint32_field(wire, CTR_OTLP_SPAN_DROPPED_ATTRIBUTES, span->dropped_attr_count);
+
+    cfl_list_foreach(head, &span->events) {
+        event = cfl_list_entry(head, struct ctrace_span_event, _head);
+
+        put_message_header(wire, CTR_OTLP_SPAN_EVENTS);
+        write_event(wire, event);
+    }
+    put_uint32_field(wire, CTR_OTLP_SPAN_DROPPED_EVENTS, span->dropped_events_count);
+
+    cfl_list_foreach(head, &span->links) {
+        link = cfl_list_entry(head, struct ctrace_link, _head);
+
+        put_message_header(wire, CTR_OTLP_SPAN_LINKS);
+        write_link(wire, link);
+    }
+
+    put_message_header(wire, CTR_OTLP_SPAN_STATUS);
+    put_string_field(wire, CTR_OTLP_STATUS_MESSAGE, span->status.message);
+    put_enum_field(wire, CTR_OTLP_STATUS_CODE, span->status.code);
+}
+
+static void write_scope_span(struct ctr_otlp_wire *wire, struct ctrace_scope_span *scope_span)
+{
+    struct cfl_list *head;
+    struct ctrace_span *span;
+
+    if (scope_span->instrumentation_scope) {
+        put_message_header(wire, CTR_OTLP_SCOPE_SPANS_SCOPE);
+        write_instrumentation_scope(wire, scope_span->instrumentation_scope);
+    }
+
+    cfl_list_foreach(head, &scope_span->spans) {
+        span = cfl_list_entry(head, struct ctrace_span, _head);
+
+        put_message_header(wire, CTR_OTLP_SCOPE_SPANS_SPANS);
+        write_span(wire, span);
+    }
+
+    put_string_field(wire, CTR_OTLP_SCOPE_SPANS_SCHEMA_URL, scope_span->schema_url);
+}
+
+int ctr_otlp_wire_write_resource_span(struct ctr_otlp_wire *wire,
+                                      struct ctrace_resource_span *resource_span)
+{
+    struct cfl_list *head;
+    struct ctrace_scope_span *scope_span;
+
+    put_message_header(wire, CTR_OTLP_REQUEST_RESOURCE_SPANS);
+
+    if (resource_span->resource) {
+        put_message_header(wire, CTR_OTLP_RESOURCE_SPANS_RESOURCE);
+        write_resource(wire, resource_span->resource);
+    }
+
+    cfl_list_foreach(head, &resource_span->scope_spans) {
+        scope_span = cfl_list_entry(head, struct ctrace_scope_span, _head);
+
+        put_message_header(wire, CTR_OTLP_RESOURCE_SPANS_SCOPE_SPANS);
+        write_scope_span(wire, scope_span);
+    }
+
+    put_string_field(wire, CTR_OTLP_RESOURCE_SPANS_SCHEMA_URL, resource_span->schema_url);
+
+    if (wire->error) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int ctr_otlp_wire_write_scope_span(struct ctr_otlp_wire *wire,
+                                   struct ctrace_scope_span *scope_span)
+{
+    put_message_header(wire, CTR_OTLP_RESOURCE_SPANS_SCOPE_SPANS);
+    write_scope_span(wire, scope_span);
+
+    if (wire->error) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int ctr_otlp_wire_write_resource_span_head(struct ctr_otlp_wire *wire,
+                                           struct ctrace_resource_span *resource_span,
+                                           size_t scope_spans_size)
+{
+    size_t size = 0;
+
+    /* the resource size is the next slot */
+    if (resource_span->resource) {
+        if (wire->sizes_index >= wire->sizes_count) {
+            return -1;
+        }
+        size = len_field_size(CTR_OTLP_RESOURCE_SPANS_RESOURCE,
+                              wire->sizes[wire->sizes_index]);
+    }
+
+    put_tag(wire, CTR_OTLP_REQUEST_RESOURCE_SPANS, CTR_OTLP_WIRE_LEN);
+    put_varint(wire, size + scope_spans_size +
+                     ctr_otlp_wire_size_resource_span_tail(resource_span));
+
+    if (resource_span->resource) {
+        put_message_header(wire, CTR_OTLP_RESOURCE_SPANS_RESOURCE);
+        write_resource(wire, resource_span->resource);
+    }
+
+    if (wire->error) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int ctr_otlp_wire_write_resource_span_tail(struct ctr_otlp_wire *wire,
+                                           struct ctrace_resource_span *resource_span)
+{
+    put_string_field(wire, CTR_OTLP_RESOURCE_SPANS_SCHEMA_URL, resource_span->schema_url);
+
+    if (wire->error) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int ctr_otlp_wire_write_request(struct ctr_otlp_wire *wire, struct ctrace *ctx)
+{
+    int ret;
+    struct cfl_list *head;
+    struct ctrace_resource_span *resource_span;
+
+    cfl_list_foreach(head, &ctx->resource_spans) {
+        resource_span = cfl_list_entry(head, struct ctrace_resource_span, _head);
+
+        ret = ctr_otlp_wire_write_resource_span(wire, resource_span);
+        if (ret != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Request splitting
+ * -----------------
+ * Spans are sized one at a time while the running size of the pending
+ * request is kept up to date, including the length prefixes of the open
+ * resource_spans and scope_spans entries. When the next span does not fit
+ * the pending request is closed, written from the sizes recorded so far and
+ * handed to the caller; a new one is started repeating the resource and
+ * scope headers.
+ */
+
+#define SPLIT_RESOURCE_OPEN     0
+#define SPLIT_RESOURCE_CLOSE    1
+#define SPLIT_SCOPE_OPEN        2
+#define SPLIT_SCOPE_CLOSE       3
+#define SPLIT_SPAN              4
+
+struct split_entry {
+    int type;
+    void *ptr;
+};
+
+struct split_ctx {
+    struct ctr_otlp_wire *wire;
+    size_t max_size;
+
+    /* layout of the pending request, in write order */
+    struct split_entry *entries;
+    size_t entries_count;
+    size_t entries_alloc;
+
+    /* size of the completed resource_spans entries */
+    size_t closed;
+
+    /* open resource_spans: body size without the open scope_spans */
+    struct ctrace_resource_span *resource_span;
+    size_t resource_slot;
+    size_t resource_body;
+
+    /* open scope_spans body size */
+    struct ctrace_scope_span *scope_span;
+    size_t scope_slot;
+    size_t scope_body;
+
+    /* the pending request only holds the open headers */
+    int empty;
+
+    ctr_encode_opentelemetry_chunk_fn_t cb;
+    void *data;
+};
+
+static int split_entry_add(struct split_ctx *s, int type, void *ptr)
+{
+    size_t alloc;
+    struct split_entry *tmp;
+
+    if (s->entries_count == s->entries_alloc) {
+        alloc = s->entries_alloc * 2;
+        if (alloc == 0) {
+            alloc = 64;
+        }
+
+        tmp = realloc(s->entries, alloc * sizeof(struct split_entry));
+        if (!tmp) {
+            ctr_errno();
+            return -1;
+        }
+        s->entries = tmp;
+        s->entries_alloc = alloc;
+    }
+
+    s->entries[s->entries_count].type = type;
+    s->entries[s->entries_count].ptr = ptr;
+    s->entries_count++;
+
+    return 0;
+}
+
+/* size of the pending request if the open scope_spans body was 'scope_body' */
+static size_t split_total(struct split_ctx *s, size_t scope_body)
+{
+    size_t size;
+
+    if (!s->resource_span) {
+        return s->closed;
+    }
+
+    size = s->resource_body;
+    if (s->scope_span) {
+        size += len_field_size(CTR_OTLP_RESOURCE_SPANS_SCOPE_SPANS, scope_body);
+    }
+
+    return s->closed + len_field_size(CTR_OTLP_REQUEST_RESOURCE_SPANS, size);
+}
+
+static int split_resource_begin(struct split_ctx *s, struct ctrace_resource_span *resource_span)
+{
+    size_t size = 0;
+    ssize_t ret;
+
+    if (slot_reserve(s->wire, &s->resource_slot) != 0) {
+        return -1;
+    }
+
+    if (resource_span->resource) {
+        ret = size_resource(s->wire, resource_span->resource);
+        if (ret < 0) {
+            return -1;
+        }
+        size += len_field_size(CTR_OTLP_RESOURCE_SPANS_RESOURCE, ret);
+    }
+
+    size += string_field_size(CTR_OTLP_RESOURCE_SPANS_SCHEMA_URL, resource_span->schema_url);
+
+    if (split_entry_add(s, SPLIT_RESOURCE_OPEN, resource_span) != 0) {
+        return -1;
+    }
+
+    s->resource_span = resource_span;
+    s->resource_body = size;
+
+    return 0;
+}
+
+static int split_scope_begin(struct split_ctx *s, struct ctrace_scope_span *scope_span)
+{
+    size_t size = 0;
+    ssize_t ret;
+
+    if (slot_reserve(s->wire, &s->scope_slot) != 0) {
+        return -1;
+    }
+
+    if (scope_span->instrumentation_scope) {
+        ret = size_instrumentation_scope(s->wire, scope_span->instrumentation_scope);
+        if (ret < 0) {
+            return -1;
+        }
+        size += len_field_size(CTR_OTLP_SCOPE_SPANS_SCOPE, ret);
+    }
+
+    size += string_field_size(CTR_OTLP_SCOPE_SPANS_SCHEMA_URL, scope_span->schema_url);
+
+    if (split_entry_add(s, SPLIT_SCOPE_OPEN, scope_span) != 0) {
+        return -1;
+    }
+
+    s->scope_span = scope_span;
+    s->scope_body = size;
+
+    return 0;
+}
+
+static int split_scope_end(struct split_ctx *s)
+{
+    if (split_entry_add(s, SPLIT_SCOPE_CLOSE, s->scope_span) != 0) {
+        return -1;
+    }
+
+    s->wire->sizes[s->scope_slot] = s->scope_body;
+    s->resource_body += len_field_size(CTR_OTLP_RESOURCE_SPANS_SCOPE_SPANS, s->scope_body);
+    s->scope_span = NULL;
+    s->empty = CTR_FALSE;
+
+    return 0;
+}
+
+static int split_resource_end(struct split_ctx *s)
+{
+    if (split_entry_add(s, SPLIT_RESOURCE_CLOSE, s->resource_span) != 0) {
+        return -1;
+    }
+
+    s->wire->sizes[s->resource_slot] = s->resource_body;
+    s->closed += len_field_size(CTR_OTLP_REQUEST_RESOURCE_SPANS, s->resource_body);
+    s->resource_span = NULL;
+    s->empty = CTR_FALSE;
+
+    return 0;
+}
+
+static void split_write(struct split_ctx *s)
+{
+    size_t i;
+    struct split_entry *entry;
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_scope_span *scope_span;
+
+    for (i = 0; i < s->entries_count; i++) {
+        entry = &s->entries[i];
+
+        switch (entry->type) {
+            case SPLIT_RESOURCE_OPEN:
+                resource_span = entry->ptr;
+                put_message_header(s->wire, CTR_OTLP_REQUEST_RESOURCE_SPANS);
+                if (resource_span->resource) {
+                    put_message_header(s->wire, CTR_OTLP_RESOURCE_SPANS_RESOURCE);
+                    write_resource(s->wire, resource_span->resource);
+                }
+                break;
+            case SPLIT_RESOURCE_CLOSE:
+                resource_span = entry->ptr;
+                put_string_field(s->wire, CTR_OTLP_RESOURCE_SPANS_SCHEMA_URL,
+                                 resource_span->schema_url);
+                break;
+            case SPLIT_SCOPE_OPEN:
+                scope_span = entry->ptr;
+                put_message_header(s->wire, CTR_OTLP_RESOURCE_SPANS_SCOPE_SPANS);
+                if (scope_span->instrumentation_scope) {
+                    put_message_header(s->wire, CTR_OTLP_SCOPE_SPANS_SCOPE);
+                    write_instrumentation_scope(s->wire, scope_span->instrumentation_scope);
+                }
+                break;
+            case SPLIT_SCOPE_CLOSE:
+                scope_span = entry->ptr;
+                put_string_field(s->wire, CTR_OTLP_SCOPE_SPANS_SCHEMA_URL, scope_span->schema_url);
+                break;
+            case SPLIT_SPAN:
+                put_message_header(s->wire, CTR_OTLP_SCOPE_SPANS_SPANS);
+                write_span(s->wire, entry->ptr);
+                break;
+        }
+    }
+}
+
+/*
+ * close the open entries, write the pending request and hand it to the
+ * callback, then reopen the same resource and scope in a new request.
+ */
+static int split_flush(struct split_ctx *s)
+{
+    int ret;
+    cfl_sds_t buf;
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_scope_span *scope_span;
+
+    resource_span = s->resource_span;
+    scope_span = s->scope_span;
+
+    if (scope_span && split_scope_end(s) != 0) {
+        return -1;
+    }
+
+    if (resource_span && split_resource_end(s) != 0) {
+        return -1;
+    }
+
+    buf = cfl_sds_create_size(s->closed);
+    if (!buf) {
+        return -1;
+    }
+
+    ctr_otlp_wire_set_buffer(s->wire, buf, s->closed);
+    split_write(s);
+    if (s->wire->error || s->wire->buf_len != s->closed) {
+        cfl_sds_destroy(buf);
+        return -1;
+    }
+    cfl_sds_set_len(buf, s->closed);
+
+    /* the callback owns the buffer from now on */
+    ret = s->cb(buf, s->data);
+    if (ret != 0) {
+        return -1;
+    }
+
+    ctr_otlp_wire_reset(s->wire);
+    s->entries_count = 0;
+    s->closed = 0;
+    s->empty = CTR_TRUE;
+
+    /* a header always fits in an empty request if it fitted before */
+    if (resource_span && split_resource_begin(s, resource_span) != 0) {
+        return -1;
+    }
+
+    if (scope_span && split_scope_begin(s, scope_span) != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int split_resource_open(struct split_ctx *s, struct ctrace_resource_span *resource_span)
+{
+    size_t mark;
+
+    mark = s->wire->sizes_count;
+    if (split_resource_begin(s, resource_span) != 0) {
+        return -1;
+    }
+
+    if (split_total(s, 0) <= s->max_size) {
+        return 0;
+    }
+
+    if (s->empty) {
+        return -1;
+    }
+
+    /* roll back and retry on a new request */
+    s->wire->sizes_count = mark;
+    s->entries_count--;
+    s->resource_span = NULL;
+
+    if (split_flush(s) != 0 || split_resource_begin(s, resource_span) != 0) {
+        return -1;
+    }
+
+    if (split_total(s, 0) > s->max_size) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int split_scope_open(struct split_ctx *s, struct ctrace_scope_span *scope_span)
+{
+    size_t mark;
+
+    mark = s->wire->sizes_count;
+    if (split_scope_begin(s, scope_span) != 0) {
+        return -1;
+    }
+
+    if (split_total(s, s->scope_body) <= s->max_size) {
+        return 0;
+    }
+
+    if (s->empty) {
+        return -1;
+    }
+
+    s->wire->sizes_count = mark;
+    s->entries_count--;
+    s->scope_span = NULL;
+
+    if (split_flush(s) != 0 || split_scope_begin(s, scope_span) != 0) {
+        return -1;
+    }
+
+    if (split_total(s, s->scope_body) > s->max_size) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int split_span_add(struct split_ctx *s, struct ctrace_span *span)
+{
+    size_t mark;
+    size_t size;
+    ssize_t ret;
+
+    mark = s->wire->sizes_count;
+    ret = size_span(s->wire, span);
+    if (ret < 0) {
+        return -1;
+    }
+    size = len_field_size(CTR_OTLP_SCOPE_SPANS_SPANS, ret);
+
+    if (split_total(s, s->scope_body + size) > s->max_size) {
+        if (s->empty) {
+            /* the span does not fit on its own */
+            return -1;
+        }
+
+        s->wire->sizes_count = mark;
+        if (split_flush(s) != 0) {
+            return -1;
+        }
+
+        ret = size_span(s->wire, span);
+        if (ret < 0) {
+            return -1;
+        }
+
+        if (split_total(s, s->scope_body + size) > s->max_size) {
+            return -1;
+        }
+    }
+
+    if (split_entry_add(s, SPLIT_SPAN, span) != 0) {
+        return -1;
+    }
+
+    s->scope_body += size;
+    s->empty = CTR_FALSE;
+
+    return 0;
+}
+
+static int split_request(struct split_ctx *s, struct ctrace *ctx)
+{
+    struct cfl_list *head;
+    struct cfl_list *s_head;
+    struct cfl_list *sp_head;
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_scope_span *scope_span;
+    struct ctrace_span *span;
+
+    cfl_list_foreach(head, &ctx->resource_spans) {
+        resource_span = cfl_list_entry(head, struct ctrace_resource_span, _head);
+
+        if (split_resource_open(s, resource_span) != 0) {
+            return -1;
+        }
+
+        cfl_list_foreach(s_head, &resource_span->scope_spans) {
+            scope_span = cfl_list_entry(s_head, struct ctrace_scope_span, _head);
+
+            if (split_scope_open(s, scope_span) != 0) {
+                return -1;
+            }
+
+            cfl_list_foreach(sp_head, &scope_span->spans) {
+                span = cfl_list_entry(sp_head, struct ctrace_span, _head);
+
+                if (split_span_add(s, span) != 0) {
+                    return -1;
+                }
+            }
+
+            if (split_scope_end(s) != 0) {
+                return -1;
+            }
+        }
+
+        if (split_resource_end(s) != 0) {
+            return -1;
+        }
+    }
+
+    if (!s->empty) {
+        return split_flush(s);
+    }
+
+    return 0;
+}
+
+/*
+ * encode 'ctx' as a sequence of requests of at most 'max_size' bytes each,
+ * every request is passed to 'cb' as soon as it is complete.
+ */
+int ctr_otlp_wire_split_request(struct ctr_otlp_wire *wire, struct ctrace *ctx,
+                                size_t max_size,
+                                ctr_encode_opentelemetry_chunk_fn_t cb, void *data)
+{
+    int ret;
+    struct split_ctx s;
+
+    memset(&s, 0, sizeof(struct split_ctx));
+    s.wire = wire;
+    s.max_size = max_size;
+    s.empty = CTR_TRUE;
+    s.cb = cb;
+    s.data = data;
+
+    ctr_otlp_wire_reset(wire);
+
+    ret = split_request(&s, ctx);
+
+    if (s.entries) {
+        free(s.entries);
+    }
+
+    return ret;
+}
+
+/*
+ * Request streaming
+ * -----------------
+ * The request itself has no length prefix, so every resource_spans entry is
+ * sized and written on its own and the recorded sizes are dropped before the
+ * next one: memory is bounded by the largest entry plus the writer chunk.
+ */
+int ctr_otlp_wire_stream_request(struct ctr_otlp_wire *wire, struct ctrace *ctx,
+                                 struct ctr_writer *writer)
+{
+    int ret = 0;
+    ssize_t len;
+    struct cfl_list *head;
+    struct ctrace_resource_span *resource_span;
+
+    ctr_otlp_wire_reset(wire);
+    wire->writer = writer;
+
+    cfl_list_foreach(head, &ctx->resource_spans) {
+        resource_span = cfl_list_entry(head, struct ctrace_resource_span, _head);
+
+        wire->sizes_count = 0;
+        wire->sizes_index = 0;
+
+        len = ctr_otlp_wire_size_resource_span(wire, resource_span);
+        if (len < 0) {
+            ret = -1;
+            break;
+        }
+
+        wire_writer_load(wire);
+        ret = ctr_otlp_wire_write_resource_span(wire, resource_span);
+        wire_writer_store(wire);
+
+        if (ret != 0) {
+            break;
+        }
+    }
+
+    wire->writer = NULL;
+    wire->buf = NULL;
+    wire->buf_len = 0;
+    wire->buf_size = 0;
+
+    if (ret != 0) {
+        return -1;
+    }
+
+    return ctr_writer_flush(writer);
+}
+
+void ctr_otlp_wire_init(struct ctr_otlp_wire *wire)
+{
+    memset(wire, 0, sizeof(struct ctr_otlp_wire));
+}
+
+/* drop the recorded sizes and the output buffer reference, keep the slots memory */
+void ctr_otlp_wire_reset(struct ctr_otlp_wire *wire)
+{
+    wire->sizes_count = 0;
+    wire->sizes_index = 0;
+    wire->buf = NULL;
+    wire->buf_len = 0;
+    wire->buf_size = 0;
+    wire->writer = NULL;
+    wire->error = CTR_FALSE;
+}
+
+void ctr_otlp_wire_set_buffer(struct ctr_otlp_wire *wire, char *buf, size_t size)
+{
+    wire->buf = buf;
+    wire->buf_len = 0;
+    wire->buf_size = size;
+    wire->sizes_index = 0;
+    wire->error = CTR_FALSE;
+}
+
+void ctr_otlp_wire_exit(struct ctr_otlp_wire *wire)
+{
+    if (wire->sizes) {
+        free(wire->sizes);
+    }
+
+    memset(wire, 0, sizeof(struct ctr_otlp_wire));
+}
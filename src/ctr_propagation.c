@@ -0,0 +1,348 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <ctraces/ctraces.h>
+#include <ctraces/ctr_base16.h>
+#include <ctraces/ctr_propagation.h>
+
+#include <string.h>
+
+/* tracestate limits */
+#define TS_KEY_MAX       256
+#define TS_TENANT_MAX    241
+#define TS_SYSTEM_MAX    14
+#define TS_VALUE_MAX     256
+
+static int is_zero(const unsigned char *buf, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        if (buf[i] != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * traceparent = version "-" trace-id "-" parent-id "-" trace-flags
+ *
+ * Every field is fixed size so the separators are checked by position and
+ * each hex field is decoded straight into the output structure. Only lower
+ * case hex digits are valid.
+ */
+int ctr_propagation_extract(struct ctr_traceparent *tp, const char *header, size_t len)
+{
+    struct ctr_traceparent tmp;
+
+    if (!tp || !header || len < CTR_TRACEPARENT_SIZE) {
+        return -1;
+    }
+
+    if (header[2] != '-' || header[35] != '-' || header[52] != '-') {
+        return -1;
+    }
+
+    if (ctr_base16_decode_lower(header, 2, &tmp.version) != 0) {
+        return -1;
+    }
+
+    /* version ff is forbidden */
+    if (tmp.version == 0xff) {
+        return -1;
+    }
+
+    /*
+     * version 00 has an exact size, future versions may append fields
+     * which must be preceded by a dash.
+     */
+    if (tmp.version == CTR_TRACEPARENT_VERSION) {
+        if (len != CTR_TRACEPARENT_SIZE) {
+            return -1;
+        }
+    }
+    else if (len > CTR_TRACEPARENT_SIZE && header[CTR_TRACEPARENT_SIZE] != '-') {
+        return -1;
+    }
+
+    if (ctr_base16_decode_lower(header + 3, 32, tmp.trace_id) != 0 ||
+        is_zero(tmp.trace_id, sizeof(tmp.trace_id))) {
+        return -1;
+    }
+
+    if (ctr_base16_decode_lower(header + 36, 16, tmp.span_id) != 0 ||
+        is_zero(tmp.span_id, sizeof(tmp.span_id))) {
+        return -1;
+    }
+
+    if (ctr_base16_decode_lower(header + 53, 2, &tmp.flags) != 0) {
+        return -1;
+    }
+
+    *tp = tmp;
+    return 0;
+}
+
+/*
+ * write the traceparent value plus a NUL terminator into 'buf', returns the
+ * number of characters written (not counting the terminator) or -1 if the
+ * buffer is too small. We always emit the version we understand.
+ */
+int ctr_propagation_inject(struct ctr_traceparent *tp, char *buf, size_t size)
+{
+    if (!tp || !buf || size < CTR_TRACEPARENT_SIZE + 1) {
+        return -1;
+    }
+
+    buf[0] = '0';
+    buf[1] = '0';
+    buf[2] = '-';
+    ctr_base16_encode(tp->trace_id, sizeof(tp->trace_id), buf + 3);
+    buf[35] = '-';
+    ctr_base16_encode(tp->span_id, sizeof(tp->span_id), buf + 36);
+    buf[52] = '-';
+    ctr_base16_encode(&tp->flags, 1, buf + 53);
+    buf[CTR_TRACEPARENT_SIZE] = '\0';
+
+    return CTR_TRACEPARENT_SIZE;
+}
+
+int ctr_propagation_from_span(struct ctr_traceparent *tp, struct ctrace_span *span)
+{
+    if (!tp || !span || !span->trace_id || !span->span_id) {
+        return -1;
+    }
+
+    if (ctr_id_get_len(span->trace_id) != CTR_ID_OTEL_TRACE_SIZE ||
+        ctr_id_get_len(span->span_id) != CTR_ID_OTEL_SPAN_SIZE) {
+        return -1;
+    }
+
+    tp->version = CTR_TRACEPARENT_VERSION;
+    tp->flags = span->flags & 0xff;
+    memcpy(tp->trace_id, ctr_id_get_buf(span->trace_id), CTR_ID_OTEL_TRACE_SIZE);
+    memcpy(tp->span_id, ctr_id_get_buf(span->span_id), CTR_ID_OTEL_SPAN_SIZE);
+
+    return 0;
+}
+
+/*
+ * make 'span' a child of the remote context: it joins the trace, the remote
+ * span becomes its parent and the trace flags are copied into the low byte
+ * of the span flags.
+ */
+int ctr_propagation_to_span(struct ctr_traceparent *tp, struct ctrace_span *span)
+{
+    int ret;
+
+    if (!tp || !span) {
+        return -1;
+    }
+
+    ret = ctr_span_set_trace_id(span, tp->trace_id, sizeof(tp->trace_id));
+    if (ret != 0) {
+        return -1;
+    }
+
+    ret = ctr_span_set_parent_span_id(span, tp->span_id, sizeof(tp->span_id));
+    if (ret != 0) {
+        return -1;
+    }
+
+    ctr_span_set_flags(span, (span->flags & ~0xffU) | tp->flags);
+    return 0;
+}
+
+void ctr_tracestate_iter_init(struct ctr_tracestate_iter *it, const char *header, size_t len)
+{
+    it->p = header;
+    it->end = header ? header + len : NULL;
+    it->count = 0;
+}
+
+static inline int is_ows(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+static inline int is_lcalpha(char c)
+{
+    return c >= 'a' && c <= 'z';
+}
+
+static inline int is_key_char(char c)
+{
+    return is_lcalpha(c) || (c >= '0' && c <= '9') ||
+           c == '_' || c == '-' || c == '*' || c == '/';
+}
+
+/*
+ * key = simple-key / multi-tenant-key
+ * simple-key = lcalpha 0*255( lcalpha / DIGIT / "_" / "-"/ "*" / "/" )
+ * multi-tenant-key = tenant-id "@" system-id
+ */
+static int validate_key(const char *key, size_t len)
+{
+    size_t i;
+    size_t at = len;
+
+    if (len == 0 || len > TS_KEY_MAX) {
+        return -1;
+    }
+
+    for (i = 0; i < len; i++) {
+        if (key[i] == '@') {
+            if (at != len) {
+                return -1;
+            }
+            at = i;
+        }
+        else if (!is_key_char(key[i])) {
+            return -1;
+        }
+    }
+
+    if (at == len) {
+        return is_lcalpha(key[0]) ? 0 : -1;
+    }
+
+    /* tenant-id starts with lcalpha or a digit, system-id with lcalpha */
+    if (at == 0 || at > TS_TENANT_MAX ||
+        !(is_lcalpha(key[0]) || (key[0] >= '0' && key[0] <= '9'))) {
+        return -1;
+    }
+
+    if (len - at - 1 == 0 || len - at - 1 > TS_SYSTEM_MAX || !is_lcalpha(key[at + 1])) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/* value = 0*255(chr) nblk-chr, printable ASCII except ',' and '=' */
+static int validate_value(const char *value, size_t len)
+{
+    size_t i;
+
+    if (len == 0 || len > TS_VALUE_MAX || value[len - 1] == ' ') {
+        return -1;
+    }
+
+    for (i = 0; i < len; i++) {
+        if (value[i] < 0x20 || value[i] > 0x7e || value[i] == ',' || value[i] == '=') {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * returns 1 and sets key/value to point into the header for every member,
+ * 0 once the list is exhausted and -1 if the list is malformed. Empty
+ * members are skipped as the specification allows.
+ */
+int ctr_tracestate_next(struct ctr_tracestate_iter *it,
+                        const char **key, size_t *key_len,
+                        const char **value, size_t *value_len)
+{
+    const char *p;
+    const char *k;
+    const char *v;
+    const char *v_end;
+
+    if (!it->p) {
+        return 0;
+    }
+
+    p = it->p;
+
+    /* skip whitespace and empty list members */
+    while (p < it->end && (is_ows(*p) || *p == ',')) {
+        p++;
+    }
+
+    if (p == it->end) {
+        it->p = p;
+        return 0;
+    }
+
+    k = p;
+    while (p < it->end && *p != '=' && *p != ',') {
+        p++;
+    }
+
+    if (p == it->end || *p != '=' || validate_key(k, p - k) != 0) {
+        goto error;
+    }
+
+    v = ++p;
+    while (p < it->end && *p != ',') {
+        p++;
+    }
+
+    v_end = p;
+    while (v_end > v && is_ows(v_end[-1])) {
+        v_end--;
+    }
+
+    if (validate_value(v, v_end - v) != 0) {
+        goto error;
+    }
+
+    if (++it->count > CTR_TRACESTATE_MAX_MEMBERS) {
+        goto error;
+    }
+
+    it->p = p;
+
+    *key = k;
+    *key_len = v - k - 1;
+    *value = v;
+    *value_len = v_end - v;
+
+    return 1;
+
+ error:
+    it->p = it->end;
+    return -1;
+}
+
+/* lookup 'key', returns 0 if found and -1 if missing or the list is invalid */
+int ctr_tracestate_get(const char *header, size_t len, const char *key,
+                       const char **value, size_t *value_len)
+{
+    int ret;
+    size_t klen;
+    size_t mlen;
+    const char *mkey;
+    struct ctr_tracestate_iter it;
+
+    klen = strlen(key);
+    ctr_tracestate_iter_init(&it, header, len);
+
+    while ((ret = ctr_tracestate_next(&it, &mkey, &mlen, value, value_len)) == 1) {
+        if (mlen == klen && memcmp(mkey, key, klen) == 0) {
+            return 0;
+        }
+    }
+
+    return -1;
+}
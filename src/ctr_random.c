@@ -18,6 +18,9 @@
  */
 
 #include <ctraces/ctraces.h>
+#include <cfl/cfl_time.h>
+
+#include <string.h>
 
 #if defined(unix) || defined (__unix) || defined(__unix__) || defined(__linux__) || \
     defined(__APPLE__) || defined(__MACH__) || defined(__FreeBSD__) || defined(__ANDROID__)
@@ -31,6 +34,7 @@
 #ifdef ITS_A_UNIX_FRIEND
 #include <fcntl.h>
 #include <unistd.h>
+#include <pthread.h>
 #else
 // #define needed to link in RtlGenRandom(), a.k.a. SystemFunction036.  See the
 // "Community Additions" comment on MSDN here:
@@ -43,6 +47,42 @@
 
 #include <time.h>
 
+#ifdef _MSC_VER
+#define CTR_THREAD_LOCAL __declspec(thread)
+#else
+#define CTR_THREAD_LOCAL __thread
+#endif
+
+/* number of 64-bit outputs before the generator is seeded again */
+#define RANDOM_RESEED_INTERVAL   (1 << 20)
+
+/* xoshiro256** state, one per thread */
+struct random_state {
+    uint64_t s[4];
+    uint64_t outputs;
+    int seeded;
+};
+
+static CTR_THREAD_LOCAL struct random_state random_state;
+
+#ifdef ITS_A_UNIX_FRIEND
+static pthread_once_t random_atfork_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Only the forking thread survives in the child, drop its state so parent
+ * and child never generate the same sequence of IDs.
+ */
+static void random_atfork_child(void)
+{
+    random_state.seeded = CTR_FALSE;
+}
+
+static void random_atfork_register(void)
+{
+    pthread_atfork(NULL, NULL, random_atfork_child);
+}
+#endif
+
 ssize_t ctr_random_get(void *buf, size_t len)
 {
     int i;
@@ -84,3 +124,101 @@ ssize_t ctr_random_get(void *buf, size_t len)
 
     return ret;
 }
+
+static inline uint64_t rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t splitmix64(uint64_t *x)
+{
+    uint64_t z;
+
+    z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+    return z ^ (z >> 31);
+}
+
+static void random_seed(struct random_state *st)
+{
+    int i;
+    uint64_t x;
+    uint64_t seed;
+
+#ifdef ITS_A_UNIX_FRIEND
+    pthread_once(&random_atfork_once, random_atfork_register);
+#endif
+
+    if (ctr_random_get(&seed, sizeof(seed)) != sizeof(seed)) {
+        /* no entropy source available, mix the clock and the thread state address */
+        seed = cfl_time_now() ^ (uint64_t) (uintptr_t) st;
+    }
+
+    /* expand the seed, splitmix64 never yields an all zero state */
+    x = seed;
+    for (i = 0; i < 4; i++) {
+        st->s[i] = splitmix64(&x);
+    }
+
+    st->outputs = 0;
+    st->seeded = CTR_TRUE;
+}
+
+static inline uint64_t random_next(struct random_state *st)
+{
+    uint64_t t;
+    uint64_t result;
+
+    if (!st->seeded || st->outputs >= RANDOM_RESEED_INTERVAL) {
+        random_seed(st);
+    }
+    st->outputs++;
+
+    result = rotl(st->s[1] * 5, 7) * 9;
+    t = st->s[1] << 17;
+
+    st->s[2] ^= st->s[0];
+    st->s[3] ^= st->s[1];
+    st->s[1] ^= st->s[2];
+    st->s[0] ^= st->s[3];
+    st->s[2] ^= t;
+    st->s[3] = rotl(st->s[3], 45);
+
+    return result;
+}
+
+/*
+ * Fill the buffer from a per-thread xoshiro256** generator which is seeded
+ * from ctr_random_get() and seeded again periodically and in a child process
+ * after fork(). It avoids a system call per ID; like ctr_random_get() it is
+ * not meant for cryptographic use.
+ */
+void ctr_random_fast_get(void *buf, size_t len)
+{
+    uint64_t value;
+    unsigned char *p = buf;
+    struct random_state *st = &random_state;
+
+    while (len >= sizeof(uint64_t)) {
+        value = random_next(st);
+        memcpy(p, &value, sizeof(uint64_t));
+        p += sizeof(uint64_t);
+        len -= sizeof(uint64_t);
+    }
+
+    if (len > 0) {
+        value = random_next(st);
+        memcpy(p, &value, len);
+    }
+}
+
+/*
+ * Discard the calling thread state. Not needed after fork(), the child
+ * discards it automatically.
+ */
+void ctr_random_reseed(void)
+{
+    random_state.seeded = CTR_FALSE;
+}
@@ -157,3 +157,40 @@ void ctr_resource_span_destroy(struct ctrace_resource_span *resource_span)
 
     free(resource_span);
 }
+
+/* copy the resource and schema URL of a resource span, without its scope spans */
+struct ctrace_resource_span *ctr_resource_span_copy(struct ctrace *ctx,
+                                                    struct ctrace_resource_span *from)
+{
+    struct ctrace_attributes *attr;
+    struct ctrace_resource_span *resource_span;
+
+    resource_span = ctr_resource_span_create(ctx);
+    if (!resource_span) {
+        return NULL;
+    }
+
+    if (from->resource) {
+        if (from->resource->attr) {
+            attr = ctr_attributes_copy(from->resource->attr);
+            if (!attr) {
+                goto error;
+            }
+            ctr_resource_set_attributes(resource_span->resource, attr);
+        }
+        ctr_resource_set_dropped_attr_count(resource_span->resource,
+                                            from->resource->dropped_attr_count);
+    }
+
+    if (from->schema_url &&
+        ctr_resource_span_set_schema_url(resource_span, from->schema_url) != 0) {
+        goto error;
+    }
+
+    return resource_span;
+
+error:
+    cfl_list_del(&resource_span->_head);
+    ctr_resource_span_destroy(resource_span);
+    return NULL;
+}
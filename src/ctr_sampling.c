@@ -0,0 +1,733 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <ctraces/ctraces.h>
+#include <ctraces/ctr_sampling.h>
+#include <cfl/cfl_time.h>
+
+#include <string.h>
+
+struct ctr_tail_sampler *ctr_tail_sampler_create(uint64_t decision_wait, size_t max_traces)
+{
+    struct ctrace_opts opts;
+    struct ctr_tail_sampler *ts;
+
+    ts = calloc(1, sizeof(struct ctr_tail_sampler));
+    if (!ts) {
+        ctr_errno();
+        return NULL;
+    }
+    ts->decision_wait = decision_wait;
+    ts->max_traces = max_traces;
+    cfl_list_init(&ts->policies);
+
+    ctr_opts_init(&opts);
+    ctr_opts_set(&opts, CTR_OPTS_ID_INDEX, "on");
+    ts->buffer = ctr_create(&opts);
+    ctr_opts_exit(&opts);
+    if (!ts->buffer) {
+        free(ts);
+        return NULL;
+    }
+
+    return ts;
+}
+
+void ctr_tail_sampler_destroy(struct ctr_tail_sampler *ts)
+{
+    struct cfl_list *tmp;
+    struct cfl_list *head;
+    struct ctr_tail_sampler_policy *policy;
+
+    cfl_list_foreach_safe(head, tmp, &ts->policies) {
+        policy = cfl_list_entry(head, struct ctr_tail_sampler_policy, _head);
+        if (policy->key) {
+            cfl_sds_destroy(policy->key);
+        }
+        if (policy->value) {
+            cfl_sds_destroy(policy->value);
+        }
+        cfl_list_del(&policy->_head);
+        free(policy);
+    }
+
+    ctr_destroy(ts->buffer);
+    if (ts->out) {
+        ctr_destroy(ts->out);
+    }
+    if (ts->map) {
+        free(ts->map);
+    }
+    free(ts);
+}
+
+static struct ctr_tail_sampler_policy *policy_create(struct ctr_tail_sampler *ts, int type)
+{
+    struct ctr_tail_sampler_policy *policy;
+
+    policy = calloc(1, sizeof(struct ctr_tail_sampler_policy));
+    if (!policy) {
+        ctr_errno();
+        return NULL;
+    }
+    policy->type = type;
+    cfl_list_add(&policy->_head, &ts->policies);
+
+    return policy;
+}
+
+int ctr_tail_sampler_policy_error(struct ctr_tail_sampler *ts)
+{
+    if (!policy_create(ts, CTR_TAIL_SAMPLER_POLICY_ERROR)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int ctr_tail_sampler_policy_latency(struct ctr_tail_sampler *ts, uint64_t threshold)
+{
+    struct ctr_tail_sampler_policy *policy;
+
+    policy = policy_create(ts, CTR_TAIL_SAMPLER_POLICY_LATENCY);
+    if (!policy) {
+        return -1;
+    }
+    policy->threshold = threshold;
+
+    return 0;
+}
+
+int ctr_tail_sampler_policy_attribute(struct ctr_tail_sampler *ts, char *key, char *value)
+{
+    struct ctr_tail_sampler_policy *policy;
+
+    if (!key) {
+        return -1;
+    }
+
+    policy = policy_create(ts, CTR_TAIL_SAMPLER_POLICY_ATTRIBUTE);
+    if (!policy) {
+        return -1;
+    }
+
+    policy->key = cfl_sds_create(key);
+    if (value) {
+        policy->value = cfl_sds_create(value);
+    }
+
+    if (!policy->key || (value && !policy->value)) {
+        if (policy->key) {
+            cfl_sds_destroy(policy->key);
+        }
+        cfl_list_del(&policy->_head);
+        free(policy);
+        return -1;
+    }
+
+    return 0;
+}
+
+int ctr_tail_sampler_policy_rate_limit(struct ctr_tail_sampler *ts, int traces_per_second)
+{
+    struct ctr_tail_sampler_policy *policy;
+
+    if (traces_per_second <= 0) {
+        return -1;
+    }
+
+    policy = policy_create(ts, CTR_TAIL_SAMPLER_POLICY_RATE_LIMIT);
+    if (!policy) {
+        return -1;
+    }
+    policy->rate = traces_per_second;
+
+    return 0;
+}
+
+/*
+ * Policies
+ * --------
+ */
+
+static int match_error(struct ctr_index_trace *trace)
+{
+    struct cfl_list *head;
+    struct ctrace_span *span;
+
+    cfl_list_foreach(head, &trace->spans) {
+        span = cfl_list_entry(head, struct ctrace_span, _head_trace);
+        if (span->status.code == CTRACE_SPAN_STATUS_CODE_ERROR) {
+            return CTR_TRUE;
+        }
+    }
+
+    return CTR_FALSE;
+}
+
+/* from the earliest start to the latest end of the spans buffered so far */
+static int match_latency(struct ctr_tail_sampler_policy *policy,
+                         struct ctr_index_trace *trace)
+{
+    uint64_t start = UINT64_MAX;
+    uint64_t end = 0;
+    struct cfl_list *head;
+    struct ctrace_span *span;
+
+    cfl_list_foreach(head, &trace->spans) {
+        span = cfl_list_entry(head, struct ctrace_span, _head_trace);
+        if (span->start_time_unix_nano > 0 && span->start_time_unix_nano < start) {
+            start = span->start_time_unix_nano;
+        }
+        if (span->end_time_unix_nano > end) {
+            end = span->end_time_unix_nano;
+        }
+    }
+
+    return end > start && end - start >= policy->threshold;
+}
+
+static int attribute_match(struct ctr_tail_sampler_policy *policy,
+                           struct ctrace_attributes *attr)
+{
+    struct cfl_variant *value;
+
+    if (!attr) {
+        return CTR_FALSE;
+    }
+
+    value = cfl_kvlist_fetch(attr->kv, policy->key);
+    if (!value) {
+        return CTR_FALSE;
+    }
+
+    if (!policy->value) {
+        return CTR_TRUE;
+    }
+
+    return value->type == CFL_VARIANT_STRING &&
+           cfl_sds_len(value->data.as_string) == cfl_sds_len(policy->value) &&
+           memcmp(value->data.as_string, policy->value, cfl_sds_len(policy->value)) == 0;
+}
+
+static int match_attribute(struct ctr_tail_sampler_policy *policy,
+                           struct ctr_index_trace *trace)
+{
+    struct cfl_list *head;
+    struct ctrace_span *span;
+    struct ctrace_resource *resource;
+
+    cfl_list_foreach(head, &trace->spans) {
+        span = cfl_list_entry(head, struct ctrace_span, _head_trace);
+        if (attribute_match(policy, span->attr)) {
+            return CTR_TRUE;
+        }
+
+        resource = span->scope_span->resource_span->resource;
+        if (resource && attribute_match(policy, resource->attr)) {
+            return CTR_TRUE;
+        }
+    }
+
+    return CTR_FALSE;
+}
+
+static int match_rate_limit(struct ctr_tail_sampler_policy *policy, uint64_t now)
+{
+    uint64_t window;
+
+    window = now / 1000000000;
+    if (window != policy->window) {
+        policy->window = window;
+        policy->window_count = 0;
+    }
+
+    if (policy->window_count >= policy->rate) {
+        return CTR_FALSE;
+    }
+    policy->window_count++;
+
+    return CTR_TRUE;
+}
+
+static int trace_keep(struct ctr_tail_sampler *ts, struct ctr_index_trace *trace,
+                      uint64_t now)
+{
+    int ret = CTR_FALSE;
+    struct cfl_list *head;
+    struct ctr_tail_sampler_policy *policy;
+
+    cfl_list_foreach(head, &ts->policies) {
+        policy = cfl_list_entry(head, struct ctr_tail_sampler_policy, _head);
+
+        switch (policy->type) {
+            case CTR_TAIL_SAMPLER_POLICY_ERROR:
+                ret = match_error(trace);
+                break;
+            case CTR_TAIL_SAMPLER_POLICY_LATENCY:
+                ret = match_latency(policy, trace);
+                break;
+            case CTR_TAIL_SAMPLER_POLICY_ATTRIBUTE:
+                ret = match_attribute(policy, trace);
+                break;
+            case CTR_TAIL_SAMPLER_POLICY_RATE_LIMIT:
+                ret = match_rate_limit(policy, now);
+                break;
+        }
+
+        if (ret) {
+            return CTR_TRUE;
+        }
+    }
+
+    return CTR_FALSE;
+}
+
+/*
+ * Decisions
+ * ---------
+ * Kept spans are moved into a batch context, the resource and scope spans
+ * they belong to are copied on first use. The batch is merged into the
+ * output at the end of every round so resources shared by traces decided in
+ * different rounds are coalesced.
+ */
+
+static void *map_lookup(struct ctr_tail_sampler *ts, void *from)
+{
+    size_t i;
+
+    for (i = 0; i < ts->map_count; i++) {
+        if (ts->map[i].from == from) {
+            return ts->map[i].to;
+        }
+    }
+
+    return NULL;
+}
+
+static int map_add(struct ctr_tail_sampler *ts, void *from, void *to)
+{
+    size_t size;
+    struct ctr_tail_sampler_map *map;
+
+    if (ts->map_count == ts->map_size) {
+        size = ts->map_size ? ts->map_size * 2 : 16;
+        map = realloc(ts->map, size * sizeof(struct ctr_tail_sampler_map));
+        if (!map) {
+            ctr_errno();
+            return -1;
+        }
+        ts->map = map;
+        ts->map_size = size;
+    }
+
+    ts->map[ts->map_count].from = from;
+    ts->map[ts->map_count].to = to;
+    ts->map_count++;
+
+    return 0;
+}
+
+/* the scope span of 'batch' equivalent to the buffered 'from' */
+static struct ctrace_scope_span *batch_scope_span(struct ctr_tail_sampler *ts,
+                                                  struct ctrace *batch,
+                                                  struct ctrace_scope_span *from)
+{
+    struct ctrace_scope_span *scope_span;
+    struct ctrace_resource_span *resource_span;
+
+    scope_span = map_lookup(ts, from);
+    if (scope_span) {
+        return scope_span;
+    }
+
+    resource_span = map_lookup(ts, from->resource_span);
+    if (!resource_span) {
+        resource_span = ctr_resource_span_copy(batch, from->resource_span);
+        if (!resource_span) {
+            return NULL;
+        }
+
+        if (map_add(ts, from->resource_span, resource_span) != 0) {
+            cfl_list_del(&resource_span->_head);
+            ctr_resource_span_destroy(resource_span);
+            return NULL;
+        }
+    }
+
+    scope_span = ctr_scope_span_copy(resource_span, from);
+    if (!scope_span) {
+        return NULL;
+    }
+
+    if (map_add(ts, from, scope_span) != 0) {
+        ctr_scope_span_destroy(scope_span);
+        return NULL;
+    }
+
+    return scope_span;
+}
+
+static int trace_decide(struct ctr_tail_sampler *ts, struct ctrace **batch,
+                        struct ctr_index_trace *trace, uint64_t now)
+{
+    int i;
+    int count;
+    int keep;
+    struct ctrace_span *span;
+    struct ctrace_scope_span *scope_span;
+
+    keep = trace_keep(ts, trace, now);
+
+    if (keep && !*batch) {
+        *batch = ctr_create(NULL);
+        if (!*batch) {
+            return -1;
+        }
+    }
+
+    /* the trace is released with its last span, do not iterate its list */
+    count = trace->span_count;
+    for (i = 0; i < count; i++) {
+        span = cfl_list_entry_first(&trace->spans, struct ctrace_span, _head_trace);
+
+        if (!keep) {
+            ctr_span_destroy(span);
+            continue;
+        }
+
+        scope_span = batch_scope_span(ts, *batch, span->scope_span);
+        if (!scope_span) {
+            return -1;
+        }
+        ctr_span_move(span, *batch, scope_span);
+    }
+
+    if (keep) {
+        ts->stats.traces_kept++;
+        ts->out_traces++;
+    }
+    else {
+        ts->stats.traces_dropped++;
+    }
+
+    return 0;
+}
+
+/* release the resource and scope spans left without spans */
+static void buffer_cleanup(struct ctrace *ctx)
+{
+    struct cfl_list *tmp;
+    struct cfl_list *head;
+    struct cfl_list *s_tmp;
+    struct cfl_list *s_head;
+    struct ctrace_scope_span *scope_span;
+    struct ctrace_resource_span *resource_span;
+
+    cfl_list_foreach_safe(head, tmp, &ctx->resource_spans) {
+        resource_span = cfl_list_entry(head, struct ctrace_resource_span, _head);
+
+        cfl_list_foreach_safe(s_head, s_tmp, &resource_span->scope_spans) {
+            scope_span = cfl_list_entry(s_head, struct ctrace_scope_span, _head);
+            if (cfl_list_is_empty(&scope_span->spans)) {
+                ctr_scope_span_destroy(scope_span);
+            }
+        }
+
+        if (cfl_list_is_empty(&resource_span->scope_spans)) {
+            cfl_list_del(&resource_span->_head);
+            ctr_resource_span_destroy(resource_span);
+        }
+    }
+}
+
+/*
+ * Decide the 'force' oldest traces plus the ones whose decision window
+ * expired at 'now'.
+ */
+static int sampler_round(struct ctr_tail_sampler *ts, uint64_t now, int force)
+{
+    int ret = 0;
+    struct cfl_list *tmp;
+    struct cfl_list *head;
+    struct ctrace *batch = NULL;
+    struct ctr_index_trace *trace;
+
+    cfl_list_foreach_safe(head, tmp, &ts->buffer->index->trace_list) {
+        trace = cfl_list_entry(head, struct ctr_index_trace, _head);
+
+        if (force > 0) {
+            force--;
+        }
+        else if (trace->timestamp + ts->decision_wait > now) {
+            break;
+        }
+
+        ret = trace_decide(ts, &batch, trace, now);
+        if (ret != 0) {
+            break;
+        }
+    }
+
+    buffer_cleanup(ts->buffer);
+    ts->map_count = 0;
+
+    if (batch) {
+        if (!ts->out) {
+            ts->out = batch;
+        }
+        else {
+            if (ctr_merge(ts->out, batch) != 0) {
+                ret = -1;
+            }
+            ctr_destroy(batch);
+        }
+    }
+
+    return ret;
+}
+
+int ctr_tail_sampler_add(struct ctr_tail_sampler *ts, struct ctrace *ctx, uint64_t now)
+{
+    int count;
+    struct cfl_list *tmp;
+    struct cfl_list *head;
+    struct ctrace_span *span;
+    struct ctr_index_trace *trace;
+
+    /* arena memory can not be released trace by trace */
+    if (ctx->arena) {
+        return -1;
+    }
+
+    if (now == 0) {
+        now = cfl_time_now();
+    }
+
+    cfl_list_foreach_safe(head, tmp, &ctx->span_list) {
+        span = cfl_list_entry(head, struct ctrace_span, _head_global);
+        if (!span->trace_id) {
+            ctr_span_destroy(span);
+            ts->stats.spans_dropped++;
+        }
+    }
+
+    if (ctr_merge(ts->buffer, ctx) != 0) {
+        return -1;
+    }
+
+    /* new traces are appended to the list, stamp them with their arrival */
+    head = ts->buffer->index->trace_list.prev;
+    while (head != &ts->buffer->index->trace_list) {
+        trace = cfl_list_entry(head, struct ctr_index_trace, _head);
+        if (trace->timestamp != 0) {
+            break;
+        }
+        trace->timestamp = now;
+        head = head->prev;
+    }
+
+    count = ctr_index_trace_count(ts->buffer);
+    if ((size_t) count > ts->max_traces) {
+        return sampler_round(ts, now, count - ts->max_traces);
+    }
+
+    return 0;
+}
+
+int ctr_tail_sampler_flush(struct ctr_tail_sampler *ts, uint64_t now, struct ctrace **out)
+{
+    int ret;
+    int count;
+
+    if (now == 0) {
+        now = cfl_time_now();
+    }
+
+    ret = sampler_round(ts, now, 0);
+
+    *out = ts->out;
+    count = ts->out_traces;
+    ts->out = NULL;
+    ts->out_traces = 0;
+
+    if (ret != 0) {
+        return -1;
+    }
+
+    return count;
+}
+
+void ctr_tail_sampler_get_stats(struct ctr_tail_sampler *ts, struct ctr_tail_sampler_stats *stats)
+{
+    *stats = ts->stats;
+    stats->traces_pending = ctr_index_trace_count(ts->buffer);
+}
+
+/*
+ * Head sampling
+ * -------------
+ */
+
+#define SAMPLER_MAX_THRESHOLD   (1ULL << CTR_SAMPLER_RANDOMNESS_BITS)
+
+struct ctr_sampler *ctr_sampler_create(double probability)
+{
+    int len;
+    char hex[14];
+    unsigned char buf[7];
+    uint64_t threshold;
+    struct ctr_sampler *sampler;
+
+    sampler = calloc(1, sizeof(struct ctr_sampler));
+    if (!sampler) {
+        ctr_errno();
+        return NULL;
+    }
+
+    /* written this way NaN samples nothing */
+    if (!(probability > 0.0)) {
+        sampler->threshold = SAMPLER_MAX_THRESHOLD;
+        return sampler;
+    }
+
+    if (probability >= 1.0) {
+        threshold = 0;
+    }
+    else {
+        threshold = (uint64_t) ((1.0 - probability) * (double) SAMPLER_MAX_THRESHOLD + 0.5);
+        if (threshold >= SAMPLER_MAX_THRESHOLD) {
+            threshold = SAMPLER_MAX_THRESHOLD - 1;
+        }
+    }
+    sampler->threshold = threshold;
+
+    /* 14 hex digits without the trailing zeros, "0" samples everything */
+    for (len = 0; len < 7; len++) {
+        buf[len] = (threshold >> (8 * (6 - len))) & 0xff;
+    }
+    ctr_base16_encode(buf, sizeof(buf), hex);
+    len = 14;
+    while (len > 1 && hex[len - 1] == '0') {
+        len--;
+    }
+
+    sampler->tracestate_len = snprintf(sampler->tracestate, sizeof(sampler->tracestate),
+                                       "ot=th:%.*s", len, hex);
+
+    return sampler;
+}
+
+void ctr_sampler_destroy(struct ctr_sampler *sampler)
+{
+    free(sampler);
+}
+
+int ctr_sampler_attach(struct ctrace *ctx, struct ctr_sampler *sampler)
+{
+    struct ctrace_span *span;
+
+    /* allocated once so creating unsampled spans never fails */
+    if (sampler && !ctx->noop_span) {
+        span = calloc(1, sizeof(struct ctrace_span));
+        if (!span) {
+            ctr_errno();
+            return -1;
+        }
+
+        span->ctx = ctx;
+        span->noop = CTR_TRUE;
+        cfl_list_init(&span->events);
+        cfl_list_init(&span->links);
+        cfl_list_init(&span->_head);
+        cfl_list_init(&span->_head_global);
+        ctx->noop_span = span;
+    }
+
+    ctx->sampler = sampler;
+    return 0;
+}
+
+/* the explicit randomness of the 'ot' tracestate entry: "rv:" and 14 hex digits */
+static int tracestate_randomness(const char *tracestate, size_t len, uint64_t *out)
+{
+    int i;
+    size_t value_len;
+    const char *p;
+    const char *end;
+    const char *value;
+    unsigned char buf[7];
+
+    if (ctr_tracestate_get(tracestate, len, "ot", &value, &value_len) != 0) {
+        return -1;
+    }
+
+    p = value;
+    end = value + value_len;
+    while (p < end) {
+        if (end - p >= 17 && memcmp(p, "rv:", 3) == 0 &&
+            (end - p == 17 || p[17] == ';') &&
+            ctr_base16_decode_lower(p + 3, 14, buf) == 0) {
+            *out = 0;
+            for (i = 0; i < 7; i++) {
+                *out = (*out << 8) | buf[i];
+            }
+            return 0;
+        }
+
+        /* next sub-key */
+        while (p < end && *p != ';') {
+            p++;
+        }
+        p++;
+    }
+
+    return -1;
+}
+
+int ctr_sampler_sample(struct ctr_sampler *sampler, const void *trace_id, size_t len,
+                       const char *tracestate, size_t tracestate_len)
+{
+    size_t i;
+    uint64_t randomness = 0;
+    const unsigned char *id;
+
+    if (sampler->threshold == 0) {
+        return CTR_TRUE;
+    }
+    if (sampler->threshold >= SAMPLER_MAX_THRESHOLD) {
+        return CTR_FALSE;
+    }
+
+    if (!tracestate ||
+        tracestate_randomness(tracestate, tracestate_len, &randomness) != 0) {
+        /* the least significant 56 bits of the trace ID are random */
+        if (len < 7) {
+            return CTR_TRUE;
+        }
+
+        id = trace_id;
+        randomness = 0;
+        for (i = len - 7; i < len; i++) {
+            randomness = (randomness << 8) | id[i];
+        }
+    }
+
+    return randomness >= sampler->threshold;
+}
@@ -128,3 +128,48 @@ void ctr_instrumentation_scope_destroy(struct ctrace_instrumentation_scope *ins_
     free(ins_scope);
 }
 
+/* copy the instrumentation scope and schema URL of a scope span, without its spans */
+struct ctrace_scope_span *ctr_scope_span_copy(struct ctrace_resource_span *resource_span,
+                                              struct ctrace_scope_span *from)
+{
+    struct ctrace_attributes *attr = NULL;
+    struct ctrace_scope_span *scope_span;
+    struct ctrace_instrumentation_scope *scope;
+    struct ctrace_instrumentation_scope *ins_scope;
+
+    scope_span = ctr_scope_span_create(resource_span);
+    if (!scope_span) {
+        return NULL;
+    }
+
+    scope = from->instrumentation_scope;
+    if (scope) {
+        if (scope->attr) {
+            attr = ctr_attributes_copy(scope->attr);
+            if (!attr) {
+                goto error;
+            }
+        }
+
+        ins_scope = ctr_instrumentation_scope_create(scope->name, scope->version,
+                                                     scope->dropped_attr_count, attr);
+        if (!ins_scope) {
+            if (attr) {
+                ctr_attributes_destroy(attr);
+            }
+            goto error;
+        }
+        ctr_scope_span_set_instrumentation_scope(scope_span, ins_scope);
+    }
+
+    if (from->schema_url &&
+        ctr_scope_span_set_schema_url(scope_span, from->schema_url) != 0) {
+        goto error;
+    }
+
+    return scope_span;
+
+error:
+    ctr_scope_span_destroy(scope_span);
+    return NULL;
+}
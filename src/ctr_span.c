@@ -28,15 +28,121 @@ struct ctrace_span *ctr_span_create(struct ctrace *ctx, struct ctrace_scope_span
 {
     struct ctrace_span *span;
 
+    span = ctr_span_create_detached(ctx, scope_span, name, parent);
+    if (span == NULL || span->noop) {
+        return span;
+    }
+
+    /* link span to struct scope_span->spans */
+    cfl_list_add(&span->_head, &scope_span->spans);
+
+    return span;
+}
+
+/* span and event names are shared through the context table when enabled */
+static cfl_sds_t name_create(struct ctrace *ctx, const char *name, size_t len,
+                             int *interned)
+{
+    cfl_sds_t str;
+
+    if (ctx->intern) {
+        str = ctr_intern_get(ctx->intern, name, len);
+        if (str) {
+            *interned = CTR_TRUE;
+            return str;
+        }
+    }
+
+    /* no table or the table is full: keep a private copy */
+    *interned = CTR_FALSE;
+    return ctr_arena_sds_create_len(ctx->arena, name, len);
+}
+
+static void name_destroy(struct ctrace *ctx, cfl_sds_t name, int interned)
+{
+    if (!interned) {
+        ctr_arena_sds_destroy(ctx->arena, name);
+    }
+}
+
+/*
+ * a sampled root span takes the trace ID used for the decision, children
+ * inherit it. Spans of a remote parent already carry its trace ID.
+ */
+static int span_sampled_init(struct ctrace_span *span, struct ctrace_span *parent,
+                             struct ctr_traceparent *remote, unsigned char *trace_id)
+{
+    struct ctr_sampler *sampler;
+
+    sampler = span->ctx->sampler;
+
+    ctr_span_set_flags(span, span->flags | CTR_TRACEPARENT_SAMPLED);
+
+    if (remote) {
+        return 0;
+    }
+
+    if (!parent) {
+        if (ctr_span_set_trace_id(span, trace_id, CTR_ID_OTEL_TRACE_SIZE) != 0) {
+            return -1;
+        }
+        return ctr_span_set_trace_state(span, sampler->tracestate,
+                                        sampler->tracestate_len);
+    }
+
+    if (parent->trace_id &&
+        ctr_span_set_trace_id_with_cid(span, parent->trace_id) != 0) {
+        return -1;
+    }
+
+    if (parent->trace_state &&
+        ctr_span_set_trace_state(span, parent->trace_state,
+                                 cfl_sds_len(parent->trace_state)) != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static struct ctrace_span *span_create(struct ctrace *ctx,
+                                       struct ctrace_scope_span *scope_span,
+                                       cfl_sds_t name,
+                                       struct ctrace_span *parent,
+                                       struct ctr_traceparent *remote)
+{
+    struct ctrace_span *span;
+    unsigned char trace_id[CTR_ID_OTEL_TRACE_SIZE];
+
     if (!ctx || !scope_span || !name) {
         return NULL;
     }
 
+    /*
+     * unsampled traces share the no-op handle of the context. Children follow
+     * their parent, local or remote, roots are decided on their trace ID.
+     */
+    if (ctx->sampler) {
+        if (parent && parent->noop) {
+            return ctx->noop_span;
+        }
+
+        if (remote) {
+            if (!(remote->flags & CTR_TRACEPARENT_SAMPLED)) {
+                return ctx->noop_span;
+            }
+        }
+        else if (!parent) {
+            ctr_random_fast_get(trace_id, sizeof(trace_id));
+            if (!ctr_sampler_sample(ctx->sampler, trace_id, sizeof(trace_id), NULL, 0)) {
+                return ctx->noop_span;
+            }
+        }
+    }
+
     /* allocate a spanc context */
-    span = calloc(1, sizeof(struct ctrace_span));
+    span = ctr_arena_alloc(ctx->arena, sizeof(struct ctrace_span));
 
     if (span == NULL) {
-        ctr_errno();
         return NULL;
     }
 
@@ -44,10 +150,14 @@ struct ctrace_span *ctr_span_create(struct ctrace *ctx, struct ctrace_scope_span
     span->scope_span = scope_span;
     span->ctx = ctx;
 
+    ctr_id_init(&span->trace_id_data, ctx->arena);
+    ctr_id_init(&span->span_id_data, ctx->arena);
+    ctr_id_init(&span->parent_span_id_data, ctx->arena);
+
     /* name */
-    span->name = cfl_sds_create(name);
+    span->name = name_create(ctx, name, strlen(name), &span->name_interned);
     if (span->name == NULL) {
-        free(span);
+        ctr_arena_free(ctx->arena, span);
 
         return NULL;
     }
@@ -55,8 +165,8 @@ struct ctrace_span *ctr_span_create(struct ctrace *ctx, struct ctrace_scope_span
     /* attributes */
     span->attr = ctr_attributes_create();
     if (span->attr == NULL) {
-        cfl_sds_destroy(span->name);
-        free(span);
+        name_destroy(ctx, span->name, span->name_interned);
+        ctr_arena_free(ctx->arena, span);
 
         return NULL;
     }
@@ -72,12 +182,21 @@ struct ctrace_span *ctr_span_create(struct ctrace *ctx, struct ctrace_scope_span
         ctr_span_set_parent_span_id_with_cid(span, parent->span_id);
     }
 
-    /* link span to struct scope_span->spans */
-    cfl_list_add(&span->_head, &scope_span->spans);
+    cfl_list_init(&span->_head);
 
     /* link span to the struct ctrace->span_list */
     cfl_list_add(&span->_head_global, &ctx->span_list);
 
+    if (remote && ctr_propagation_to_span(remote, span) != 0) {
+        ctr_span_destroy(span);
+        return NULL;
+    }
+
+    if (ctx->sampler && span_sampled_init(span, parent, remote, trace_id) != 0) {
+        ctr_span_destroy(span);
+        return NULL;
+    }
+
     /* set default kind */
     ctr_span_kind_set(span, CTRACE_SPAN_INTERNAL);
 
@@ -87,27 +206,268 @@ struct ctrace_span *ctr_span_create(struct ctrace *ctx, struct ctrace_scope_span
     return span;
 }
 
-/* Set the Span ID with a given buffer and length */
-int ctr_span_set_trace_id(struct ctrace_span *span, void *buf, size_t len)
+/*
+ * Same as ctr_span_create() but the span is not linked to the scope span
+ * list, the caller is responsible of doing it.
+ */
+struct ctrace_span *ctr_span_create_detached(struct ctrace *ctx,
+                                             struct ctrace_scope_span *scope_span,
+                                             cfl_sds_t name,
+                                             struct ctrace_span *parent)
 {
-    if (!buf || len <= 0) {
+    return span_create(ctx, scope_span, name, parent, NULL);
+}
+
+/*
+ * Create a child of the remote span described by 'tp': the span joins its
+ * trace and copies its flags. With a head sampler attached the sampled flag
+ * of the remote parent takes the decision.
+ */
+struct ctrace_span *ctr_span_create_with_traceparent(struct ctrace *ctx,
+                                                     struct ctrace_scope_span *scope_span,
+                                                     cfl_sds_t name,
+                                                     struct ctr_traceparent *tp)
+{
+    struct ctrace_span *span;
+
+    if (!tp) {
+        return NULL;
+    }
+
+    span = span_create(ctx, scope_span, name, NULL, tp);
+    if (span == NULL || span->noop) {
+        return span;
+    }
+
+    cfl_list_add(&span->_head, &scope_span->spans);
+
+    return span;
+}
+
+/*
+ * Drop the defaults set by ctr_span_create() (kind and timestamps), used by
+ * the decoders where an absent field means zero.
+ */
+void ctr_span_clear_defaults(struct ctrace_span *span)
+{
+    if (span->noop) {
+        return;
+    }
+
+    span->kind = CTRACE_SPAN_UNSPECIFIED;
+    span->start_time_unix_nano = 0;
+    span->end_time_unix_nano = 0;
+}
+
+/*
+ * Relink a span into 'scope_span' of context 'ctx', which can be another
+ * context as long as both use the same allocation mode. The span is appended
+ * to the lists of the new owners. Names interned by the previous context must
+ * be adopted first, see ctr_span_names_adopt().
+ */
+void ctr_span_move(struct ctrace_span *span, struct ctrace *ctx,
+                   struct ctrace_scope_span *scope_span)
+{
+    struct cfl_list *head;
+    struct ctrace_link *link;
+
+    ctr_index_span_remove(span);
+
+    /* keep the position when the owner does not change */
+    if (span->scope_span != scope_span) {
+        cfl_list_del(&span->_head);
+        cfl_list_add(&span->_head, &scope_span->spans);
+    }
+
+    if (span->ctx != ctx) {
+        cfl_list_del(&span->_head_global);
+        cfl_list_add(&span->_head_global, &ctx->span_list);
+    }
+
+    span->ctx = ctx;
+    span->scope_span = scope_span;
+
+    /* inline IDs keep a reference to the arena they were created with */
+    span->trace_id_data.arena = ctx->arena;
+    span->span_id_data.arena = ctx->arena;
+    span->parent_span_id_data.arena = ctx->arena;
+
+    cfl_list_foreach(head, &span->links) {
+        link = cfl_list_entry(head, struct ctrace_link, _head);
+        link->trace_id_data.arena = ctx->arena;
+        link->span_id_data.arena = ctx->arena;
+    }
+
+    ctr_index_span_update(span);
+}
+
+/*
+ * Number of names of a span and its events which must be created again to be
+ * owned by 'ctx': zero when the span does not use names interned by its
+ * current context.
+ */
+int ctr_span_names_count(struct ctrace_span *span, struct ctrace *ctx)
+{
+    int count = 1;
+    struct cfl_list *head;
+
+    if (span->noop || !span->ctx->intern || span->ctx->intern == ctx->intern) {
+        return 0;
+    }
+
+    cfl_list_foreach(head, &span->events) {
+        count++;
+    }
+
+    return count;
+}
+
+/*
+ * Create in 'ctx' the names counted by ctr_span_names_count(), slot 0 is the
+ * span name. The span is not modified; nothing is left allocated on failure.
+ */
+int ctr_span_names_create(struct ctrace_span *span, struct ctrace *ctx,
+                          cfl_sds_t *names, int *flags)
+{
+    int count = 0;
+    struct cfl_list *head;
+    struct ctrace_span_event *event;
+
+    names[count] = name_create(ctx, span->name, cfl_sds_len(span->name), &flags[count]);
+    if (names[count] == NULL) {
         return -1;
     }
+    count++;
 
-    /* If trace_id is already set, free it first */
-    if (span->trace_id != NULL) {
-        ctr_id_destroy(span->trace_id);
-        span->trace_id = NULL;
+    cfl_list_foreach(head, &span->events) {
+        event = cfl_list_entry(head, struct ctrace_span_event, _head);
+        names[count] = name_create(ctx, event->name, cfl_sds_len(event->name),
+                                   &flags[count]);
+        if (names[count] == NULL) {
+            ctr_span_names_destroy(ctx, names, flags, count);
+            return -1;
+        }
+        count++;
     }
 
-    span->trace_id = ctr_id_create(buf, len);
-    if (!span->trace_id) {
+    return 0;
+}
+
+/*
+ * Replace the names of a span and its events with the ones created by
+ * ctr_span_names_create(). Private names of the current context are released
+ * with its allocation mode, so it must be called before the span moves.
+ */
+void ctr_span_names_set(struct ctrace_span *span, cfl_sds_t *names, int *flags)
+{
+    int count = 0;
+    struct cfl_list *head;
+    struct ctrace_span_event *event;
+
+    name_destroy(span->ctx, span->name, span->name_interned);
+    span->name = names[count];
+    span->name_interned = flags[count];
+    count++;
+
+    cfl_list_foreach(head, &span->events) {
+        event = cfl_list_entry(head, struct ctrace_span_event, _head);
+        name_destroy(span->ctx, event->name, event->name_interned);
+        event->name = names[count];
+        event->name_interned = flags[count];
+        count++;
+    }
+}
+
+void ctr_span_names_destroy(struct ctrace *ctx, cfl_sds_t *names, int *flags, size_t count)
+{
+    while (count > 0) {
+        count--;
+        name_destroy(ctx, names[count], flags[count]);
+    }
+}
+
+/*
+ * Make the names of a span and its events owned by 'ctx', interned names
+ * of the current context are interned again or copied. Nothing is changed
+ * when it fails.
+ */
+int ctr_span_names_adopt(struct ctrace_span *span, struct ctrace *ctx)
+{
+    int count;
+    int *flags;
+    cfl_sds_t *names;
+
+    count = ctr_span_names_count(span, ctx);
+    if (count == 0) {
+        return 0;
+    }
+
+    names = calloc(count, sizeof(cfl_sds_t));
+    flags = calloc(count, sizeof(int));
+    if (!names || !flags) {
+        ctr_errno();
+        free(names);
+        free(flags);
         return -1;
     }
 
+    if (ctr_span_names_create(span, ctx, names, flags) != 0) {
+        free(names);
+        free(flags);
+        return -1;
+    }
+
+    ctr_span_names_set(span, names, flags);
+
+    free(names);
+    free(flags);
     return 0;
 }
 
+/* replace the span name, a NULL name unsets it */
+int ctr_span_set_name(struct ctrace_span *span, char *name, size_t len)
+{
+    int interned;
+    cfl_sds_t str;
+
+    if (span->noop) {
+        return 0;
+    }
+
+    if (!name) {
+        str = NULL;
+        interned = CTR_FALSE;
+    }
+    else {
+        str = name_create(span->ctx, name, len, &interned);
+        if (!str) {
+            return -1;
+        }
+    }
+
+    if (span->name) {
+        name_destroy(span->ctx, span->name, span->name_interned);
+    }
+    span->name = str;
+    span->name_interned = interned;
+
+    return 0;
+}
+
+/* Set the Span ID with a given buffer and length */
+int ctr_span_set_trace_id(struct ctrace_span *span, void *buf, size_t len)
+{
+    if (span->noop) {
+        return 0;
+    }
+
+    if (ctr_id_assign(&span->trace_id, &span->trace_id_data, buf, len) != 0) {
+        return -1;
+    }
+
+    return ctr_index_span_update(span);
+}
+
 /* Set the Span ID by using a ctrace_id context */
 int ctr_span_set_trace_id_with_cid(struct ctrace_span *span, struct ctrace_id *cid)
 {
@@ -119,18 +479,15 @@ int ctr_span_set_trace_id_with_cid(struct ctrace_span *span, struct ctrace_id *c
 /* Set the Span ID with a given buffer and length */
 int ctr_span_set_span_id(struct ctrace_span *span, void *buf, size_t len)
 {
-    if (!buf || len <= 0) {
-        return -1;
-    }
-    if (span->span_id != NULL) {
-        ctr_id_destroy(span->span_id);
+    if (span->noop) {
+        return 0;
     }
-    span->span_id = ctr_id_create(buf, len);
-    if (!span->span_id) {
+
+    if (ctr_id_assign(&span->span_id, &span->span_id_data, buf, len) != 0) {
         return -1;
     }
 
-    return 0;
+    return ctr_index_span_update(span);
 }
 
 /* Set the Span ID by using a ctrace_id context */
@@ -144,20 +501,11 @@ int ctr_span_set_span_id_with_cid(struct ctrace_span *span, struct ctrace_id *ci
 /* Set the Span Parent ID with a given buffer and length */
 int ctr_span_set_parent_span_id(struct ctrace_span *span, void *buf, size_t len)
 {
-    if (!buf || len <= 0) {
-        return -1;
+    if (span->noop) {
+        return 0;
     }
 
-    if (span->parent_span_id) {
-        ctr_id_destroy(span->parent_span_id);
-    }
-
-    span->parent_span_id = ctr_id_create(buf, len);
-    if (!span->parent_span_id) {
-        return -1;
-    }
-
-    return 0;
+    return ctr_id_assign(&span->parent_span_id, &span->parent_span_id_data, buf, len);
 }
 
 /* Set the Span ID by using a ctrace_id context */
@@ -174,10 +522,20 @@ int ctr_span_kind_set(struct ctrace_span *span, int kind)
         return -1;
     }
 
+    if (span->noop) {
+        return 0;
+    }
+
     span->kind = kind;
     return 0;
 }
 
+/* spans of unsampled traces are not recorded, see ctr_sampling.h */
+int ctr_span_is_recording(struct ctrace_span *span)
+{
+    return !span->noop;
+}
+
 /* returns a read-only version of the Span kind */
 char *ctr_span_kind_string(struct ctrace_span *span)
 {
@@ -207,6 +565,12 @@ int ctr_span_set_attributes(struct ctrace_span *span, struct ctrace_attributes *
         return -1;
     }
 
+    /* the attributes are owned by the span once set */
+    if (span->noop) {
+        ctr_attributes_destroy(attr);
+        return 0;
+    }
+
     if (span->attr) {
         ctr_attributes_destroy(span->attr);
     }
@@ -217,33 +581,58 @@ int ctr_span_set_attributes(struct ctrace_span *span, struct ctrace_attributes *
 
 int ctr_span_set_attribute_string(struct ctrace_span *span, char *key, char *value)
 {
+    if (span->noop) {
+        return 0;
+    }
+
     return ctr_attributes_set_string(span->attr, key, value);
 }
 
 int ctr_span_set_attribute_bool(struct ctrace_span *span, char *key, int b)
 {
+    if (span->noop) {
+        return 0;
+    }
+
     return ctr_attributes_set_bool(span->attr, key, b);
 }
 
 int ctr_span_set_attribute_int64(struct ctrace_span *span, char *key, int64_t value)
 {
+    if (span->noop) {
+        return 0;
+    }
+
     return ctr_attributes_set_int64(span->attr, key, value);
 }
 
 int ctr_span_set_attribute_double(struct ctrace_span *span, char *key, double value)
 {
+    if (span->noop) {
+        return 0;
+    }
+
     return ctr_attributes_set_double(span->attr, key, value);
 }
 
 int ctr_span_set_attribute_array(struct ctrace_span *span, char *key,
                                  struct cfl_array *value)
 {
+    if (span->noop) {
+        cfl_array_destroy(value);
+        return 0;
+    }
+
     return ctr_attributes_set_array(span->attr, key, value);
 }
 
 int ctr_span_set_attribute_kvlist(struct ctrace_span *span, char *key,
                                   struct cfl_kvlist *value)
 {
+    if (span->noop) {
+        cfl_kvlist_destroy(value);
+        return 0;
+    }
 
     return ctr_attributes_set_kvlist(span->attr, key, value);
 }
@@ -258,6 +647,10 @@ void ctr_span_start(struct ctrace *ctx, struct ctrace_span *span)
 
 void ctr_span_start_ts(struct ctrace *ctx, struct ctrace_span *span, uint64_t ts)
 {
+    if (span->noop) {
+        return;
+    }
+
     /* set the initial timestamp */
     span->start_time_unix_nano = ts;
 
@@ -275,6 +668,10 @@ void ctr_span_end(struct ctrace *ctx, struct ctrace_span *span)
 
 void ctr_span_end_ts(struct ctrace *ctx, struct ctrace_span *span, uint64_t ts)
 {
+    if (span->noop) {
+        return;
+    }
+
     span->end_time_unix_nano = ts;
 }
 
@@ -282,13 +679,18 @@ int ctr_span_set_status(struct ctrace_span *span, int code, char *message)
 {
     struct ctrace_span_status *status;
 
+    if (span->noop) {
+        return 0;
+    }
+
     status = &span->status;
     if (status->message) {
-        cfl_sds_destroy(status->message);
+        ctr_arena_sds_destroy(span->ctx->arena, status->message);
+        status->message = NULL;
     }
 
     if (message) {
-        status->message = cfl_sds_create(message);
+        status->message = ctr_arena_sds_create(span->ctx->arena, message);
         if (!status->message) {
             return -1;
         }
@@ -300,11 +702,15 @@ int ctr_span_set_status(struct ctrace_span *span, int code, char *message)
 
 int ctr_span_set_trace_state(struct ctrace_span *span, char *state, int len)
 {
+    if (span->noop) {
+        return 0;
+    }
+
     if (span->trace_state) {
-        cfl_sds_destroy(span->trace_state);
+        ctr_arena_sds_destroy(span->ctx->arena, span->trace_state);
     }
 
-    span->trace_state = cfl_sds_create_len(state, len);
+    span->trace_state = ctr_arena_sds_create_len(span->ctx->arena, state, len);
     if (!span->trace_state) {
         return -1;
     }
@@ -314,36 +720,60 @@ int ctr_span_set_trace_state(struct ctrace_span *span, char *state, int len)
 
 int ctr_span_set_flags(struct ctrace_span *span, uint32_t flags)
 {
+    if (span->noop) {
+        return 0;
+    }
+
     span->flags = flags;
     return 0;
 }
 
 void ctr_span_set_schema_url(struct ctrace_span *span, char *url)
 {
+    if (span->noop) {
+        return;
+    }
+
     if (span->schema_url) {
-        cfl_sds_destroy(span->schema_url);
+        ctr_arena_sds_destroy(span->ctx->arena, span->schema_url);
     }
 
-    span->schema_url = cfl_sds_create(url);
+    span->schema_url = ctr_arena_sds_create(span->ctx->arena, url);
 }
 
 void ctr_span_set_dropped_link_count(struct ctrace_span *span, uint32_t count)
 {
+    if (span->noop) {
+        return;
+    }
+
     span->dropped_links_count = count;
 }
 
 void ctr_span_set_dropped_events_count(struct ctrace_span *span, uint32_t count)
 {
+    if (span->noop) {
+        return;
+    }
+
     span->dropped_events_count = count;
 }
 
 void ctr_span_set_dropped_links_count(struct ctrace_span *span, uint32_t count)
 {
+    if (span->noop) {
+        return;
+    }
+
     span->dropped_links_count = count;
 }
 
 void ctr_span_set_dropped_attributes_count(struct ctrace_span *span, uint32_t count)
 {
+    if (span->noop) {
+        return;
+    }
+
     span->dropped_attr_count = count;
 }
 
@@ -354,9 +784,18 @@ void ctr_span_destroy(struct ctrace_span *span)
     struct ctrace_span_event *event;
     struct ctrace_span_status *status;
     struct ctrace_link *link;
+    struct ctr_arena *arena;
+
+    if (span->noop) {
+        return;
+    }
+
+    arena = span->ctx->arena;
+
+    ctr_index_span_remove(span);
 
     if (span->name != NULL) {
-        cfl_sds_destroy(span->name);
+        name_destroy(span->ctx, span->name, span->name_interned);
     }
 
     if (span->trace_id != NULL) {
@@ -376,11 +815,11 @@ void ctr_span_destroy(struct ctrace_span *span)
         ctr_attributes_destroy(span->attr);
     }
     if (span->trace_state != NULL) {
-        cfl_sds_destroy(span->trace_state);
+        ctr_arena_sds_destroy(arena, span->trace_state);
     }
 
     if (span->schema_url != NULL) {
-        cfl_sds_destroy(span->schema_url);
+        ctr_arena_sds_destroy(arena, span->schema_url);
     }
 
     /* events */
@@ -398,12 +837,12 @@ void ctr_span_destroy(struct ctrace_span *span)
     /* status */
     status = &span->status;
     if (status->message != NULL) {
-        cfl_sds_destroy(status->message);
+        ctr_arena_sds_destroy(arena, status->message);
     }
 
     cfl_list_del(&span->_head);
     cfl_list_del(&span->_head_global);
-    free(span);
+    ctr_arena_free(arena, span);
 }
 
 /*
@@ -413,19 +852,27 @@ void ctr_span_destroy(struct ctrace_span *span)
 struct ctrace_span_event *ctr_span_event_add_ts(struct ctrace_span *span, char *name, uint64_t ts)
 {
     struct ctrace_span_event *ev;
+    struct ctr_arena *arena;
+
+    if (span->noop) {
+        return NULL;
+    }
 
     if (name == NULL) {
         return NULL;
     }
 
-    ev = calloc(1, sizeof(struct ctrace_span_event));
+    arena = span->ctx->arena;
+
+    ev = ctr_arena_alloc(arena, sizeof(struct ctrace_span_event));
     if (ev == NULL) {
-        ctr_errno();
         return NULL;
     }
-    ev->name = cfl_sds_create(name);
+    ev->span = span;
+
+    ev->name = name_create(span->ctx, name, strlen(name), &ev->name_interned);
     if (ev->name == NULL) {
-        free(ev);
+        ctr_arena_free(arena, ev);
         return NULL;
     }
     ev->attr = ctr_attributes_create();
@@ -450,33 +897,62 @@ struct ctrace_span_event *ctr_span_event_add(struct ctrace_span *span, char *nam
 
 int ctr_span_event_set_attribute_string(struct ctrace_span_event *event, char *key, char *value)
 {
+    /* unsampled spans hand out NULL events */
+    if (!event) {
+        return 0;
+    }
+
     return ctr_attributes_set_string(event->attr, key, value);
 }
 
 int ctr_span_event_set_attribute_bool(struct ctrace_span_event *event, char *key, int b)
 {
+    /* unsampled spans hand out NULL events */
+    if (!event) {
+        return 0;
+    }
+
     return ctr_attributes_set_bool(event->attr, key, b);
 }
 
 int ctr_span_event_set_attribute_int64(struct ctrace_span_event *event, char *key, int64_t value)
 {
+    /* unsampled spans hand out NULL events */
+    if (!event) {
+        return 0;
+    }
+
     return ctr_attributes_set_int64(event->attr, key, value);
 }
 
 int ctr_span_event_set_attribute_double(struct ctrace_span_event *event, char *key, double value)
 {
+    /* unsampled spans hand out NULL events */
+    if (!event) {
+        return 0;
+    }
+
     return ctr_attributes_set_double(event->attr, key, value);
 }
 
 int ctr_span_event_set_attribute_array(struct ctrace_span_event *event, char *key,
                                        struct cfl_array *value)
 {
+    if (!event) {
+        cfl_array_destroy(value);
+        return 0;
+    }
+
     return ctr_attributes_set_array(event->attr, key, value);
 }
 
 int ctr_span_event_set_attribute_kvlist(struct ctrace_span_event *event, char *key,
                                         struct cfl_kvlist *value)
 {
+    if (!event) {
+        cfl_kvlist_destroy(value);
+        return 0;
+    }
 
     return ctr_attributes_set_kvlist(event->attr, key, value);
 }
@@ -487,6 +963,11 @@ int ctr_span_event_set_attributes(struct ctrace_span_event *event, struct ctrace
         return -1;
     }
 
+    if (!event) {
+        ctr_attributes_destroy(attr);
+        return 0;
+    }
+
     if (event->attr) {
         ctr_attributes_destroy(event->attr);
     }
@@ -497,13 +978,57 @@ int ctr_span_event_set_attributes(struct ctrace_span_event *event, struct ctrace
 
 void ctr_span_event_set_dropped_attributes_count(struct ctrace_span_event *event, uint32_t count)
 {
+    if (!event) {
+        return;
+    }
+
     event->dropped_attr_count = count;
 }
 
+int ctr_span_event_set_name(struct ctrace_span_event *event, char *name, size_t len)
+{
+    int interned;
+    cfl_sds_t str;
+    struct ctrace *ctx;
+
+    if (!event) {
+        return 0;
+    }
+
+    ctx = event->span->ctx;
+
+    if (!name) {
+        str = NULL;
+        interned = CTR_FALSE;
+    }
+    else {
+        str = name_create(ctx, name, len, &interned);
+        if (!str) {
+            return -1;
+        }
+    }
+
+    if (event->name) {
+        name_destroy(ctx, event->name, event->name_interned);
+    }
+    event->name = str;
+    event->name_interned = interned;
+
+    return 0;
+}
+
 void ctr_span_event_delete(struct ctrace_span_event *event)
 {
+    struct ctr_arena *arena;
+
+    if (!event) {
+        return;
+    }
+
+    arena = event->span->ctx->arena;
+
     if (event->name) {
-        cfl_sds_destroy(event->name);
+        name_destroy(event->span->ctx, event->name, event->name_interned);
     }
 
     if (event->attr) {
@@ -511,6 +1036,6 @@ void ctr_span_event_delete(struct ctrace_span_event *event)
     }
 
     cfl_list_del(&event->_head);
-    free(event);
+    ctr_arena_free(arena, event);
 }
 
@@ -0,0 +1,244 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <ctraces/ctraces.h>
+#include <ctraces/ctr_stage.h>
+
+/* lock-free list of flushed batches: producers push, the owner takes all */
+#ifdef _MSC_VER
+static struct ctr_stage_batch *staged_load(struct ctrace *ctx)
+{
+    return InterlockedCompareExchangePointer((PVOID volatile *) &ctx->staged, NULL, NULL);
+}
+
+static int staged_cas(struct ctrace *ctx,
+                      struct ctr_stage_batch *expected, struct ctr_stage_batch *batch)
+{
+    return InterlockedCompareExchangePointer((PVOID volatile *) &ctx->staged,
+                                             batch, expected) == expected;
+}
+
+static struct ctr_stage_batch *staged_take(struct ctrace *ctx)
+{
+    return InterlockedExchangePointer((PVOID volatile *) &ctx->staged, NULL);
+}
+#else
+static struct ctr_stage_batch *staged_load(struct ctrace *ctx)
+{
+    return __atomic_load_n(&ctx->staged, __ATOMIC_RELAXED);
+}
+
+static int staged_cas(struct ctrace *ctx,
+                      struct ctr_stage_batch *expected, struct ctr_stage_batch *batch)
+{
+    return __atomic_compare_exchange_n(&ctx->staged, &expected, batch, 0,
+                                       __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+static struct ctr_stage_batch *staged_take(struct ctrace *ctx)
+{
+    return __atomic_exchange_n(&ctx->staged, NULL, __ATOMIC_ACQUIRE);
+}
+#endif
+
+struct ctr_stage *ctr_stage_create(struct ctrace *ctx)
+{
+    struct ctr_stage *stage;
+
+    if (!ctx) {
+        return NULL;
+    }
+
+    stage = calloc(1, sizeof(struct ctr_stage));
+    if (!stage) {
+        ctr_errno();
+        return NULL;
+    }
+
+    stage->ctx = ctx;
+    cfl_list_init(&stage->local.resource_spans);
+    cfl_list_init(&stage->local.span_list);
+
+    /* staged spans follow the allocation mode of the shared context */
+    if (ctx->arena) {
+        stage->local.arena = ctr_arena_create(ctx->arena->chunk_size);
+        if (!stage->local.arena) {
+            free(stage);
+            return NULL;
+        }
+    }
+
+    return stage;
+}
+
+/* spans that were not flushed are discarded */
+void ctr_stage_destroy(struct ctr_stage *stage)
+{
+    struct cfl_list *tmp;
+    struct cfl_list *head;
+    struct ctrace_span *span;
+
+    if (!stage) {
+        return;
+    }
+
+    cfl_list_foreach_safe(head, tmp, &stage->local.span_list) {
+        span = cfl_list_entry(head, struct ctrace_span, _head_global);
+        ctr_span_destroy(span);
+    }
+
+    if (stage->local.arena) {
+        ctr_arena_destroy(stage->local.arena);
+    }
+
+    free(stage);
+}
+
+struct ctrace_span *ctr_stage_span_create(struct ctr_stage *stage,
+                                          struct ctrace_scope_span *scope_span,
+                                          cfl_sds_t name,
+                                          struct ctrace_span *parent)
+{
+    if (!stage) {
+        return NULL;
+    }
+
+    /* the sampler is read-only, staged spans follow the one of the shared context */
+    stage->local.sampler = stage->ctx->sampler;
+    stage->local.noop_span = stage->ctx->noop_span;
+
+    return ctr_span_create_detached(&stage->local, scope_span, name, parent);
+}
+
+/* publish the staged spans to the shared context, returns the number of spans */
+int ctr_stage_flush(struct ctr_stage *stage)
+{
+    int count;
+    struct cfl_list *tmp;
+    struct cfl_list *head;
+    struct ctr_arena *arena;
+    struct ctrace_span *span;
+    struct ctr_stage_batch *batch;
+
+    if (cfl_list_is_empty(&stage->local.span_list)) {
+        return 0;
+    }
+
+    batch = calloc(1, sizeof(struct ctr_stage_batch));
+    if (!batch) {
+        ctr_errno();
+        return -1;
+    }
+    cfl_list_init(&batch->spans);
+
+    /* the current arena goes with the batch, the worker continues on a new one */
+    if (stage->local.arena) {
+        arena = ctr_arena_create(stage->local.arena->chunk_size);
+        if (!arena) {
+            free(batch);
+            return -1;
+        }
+        batch->arena = stage->local.arena;
+        stage->local.arena = arena;
+    }
+
+    count = 0;
+    cfl_list_foreach_safe(head, tmp, &stage->local.span_list) {
+        span = cfl_list_entry(head, struct ctrace_span, _head_global);
+        cfl_list_del(&span->_head_global);
+        cfl_list_add(&span->_head_global, &batch->spans);
+        count++;
+    }
+
+    do {
+        batch->next = staged_load(stage->ctx);
+    } while (!staged_cas(stage->ctx, batch->next, batch));
+
+    return count;
+}
+
+/* hand the span over to the shared context */
+static void span_adopt(struct ctrace *ctx, struct ctrace_span *span)
+{
+    struct cfl_list *head;
+    struct ctrace_link *link;
+
+    span->ctx = ctx;
+
+    /* inline IDs keep a reference to the arena they were created with */
+    span->trace_id_data.arena = ctx->arena;
+    span->span_id_data.arena = ctx->arena;
+    span->parent_span_id_data.arena = ctx->arena;
+
+    cfl_list_foreach(head, &span->links) {
+        link = cfl_list_entry(head, struct ctrace_link, _head);
+        link->trace_id_data.arena = ctx->arena;
+        link->span_id_data.arena = ctx->arena;
+    }
+
+    cfl_list_add(&span->_head, &span->scope_span->spans);
+    cfl_list_add(&span->_head_global, &ctx->span_list);
+
+    ctr_index_span_update(span);
+}
+
+/*
+ * Link every flushed span into the context tree, in flush order. It must be
+ * called by the thread owning the context, returns the number of spans.
+ */
+int ctr_stage_collect(struct ctrace *ctx)
+{
+    int count;
+    struct cfl_list *tmp;
+    struct cfl_list *head;
+    struct ctrace_span *span;
+    struct ctr_stage_batch *batch;
+    struct ctr_stage_batch *next;
+    struct ctr_stage_batch *ordered;
+
+    /* the list is LIFO, reverse it */
+    ordered = NULL;
+    batch = staged_take(ctx);
+    while (batch) {
+        next = batch->next;
+        batch->next = ordered;
+        ordered = batch;
+        batch = next;
+    }
+
+    count = 0;
+    for (batch = ordered; batch; batch = next) {
+        next = batch->next;
+
+        cfl_list_foreach_safe(head, tmp, &batch->spans) {
+            span = cfl_list_entry(head, struct ctrace_span, _head_global);
+            cfl_list_del(&span->_head_global);
+            span_adopt(ctx, span);
+            count++;
+        }
+
+        if (batch->arena) {
+            ctr_arena_merge(ctx->arena, batch->arena);
+        }
+
+        free(batch);
+    }
+
+    return count;
+}
@@ -0,0 +1,407 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  CTraces
+ *  =======
+ *  Copyright 2022 The CTraces Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <ctraces/ctraces.h>
+#include <ctraces/ctr_writer.h>
+#include <ctraces/ctr_base16.h>
+
+#include <errno.h>
+
+#ifdef _WIN32
+#include <io.h>
+#endif
+
+static const char writer_digits[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static struct ctr_writer *writer_create(int type, size_t size)
+{
+    struct ctr_writer *writer;
+
+    writer = calloc(1, sizeof(struct ctr_writer));
+    if (!writer) {
+        ctr_errno();
+        return NULL;
+    }
+    writer->type = type;
+    writer->fd = -1;
+
+    if (type == CTR_WRITER_BUFFER) {
+        writer->buf = cfl_sds_create_size(size);
+    }
+    else {
+        writer->buf = malloc(size);
+    }
+
+    if (!writer->buf) {
+        ctr_errno();
+        free(writer);
+        return NULL;
+    }
+    writer->size = size;
+
+    return writer;
+}
+
+struct ctr_writer *ctr_writer_buffer_create(size_t size)
+{
+    if (size == 0) {
+        size = 1024;
+    }
+
+    return writer_create(CTR_WRITER_BUFFER, size);
+}
+
+struct ctr_writer *ctr_writer_file_create(FILE *fp)
+{
+    struct ctr_writer *writer;
+
+    writer = writer_create(CTR_WRITER_FILE, CTR_WRITER_CHUNK_SIZE);
+    if (!writer) {
+        return NULL;
+    }
+    writer->fp = fp;
+
+    return writer;
+}
+
+struct ctr_writer *ctr_writer_fd_create(int fd)
+{
+    struct ctr_writer *writer;
+
+    writer = writer_create(CTR_WRITER_FD, CTR_WRITER_CHUNK_SIZE);
+    if (!writer) {
+        return NULL;
+    }
+    writer->fd = fd;
+
+    return writer;
+}
+
+struct ctr_writer *ctr_writer_callback_create(ctr_writer_cb_t cb, void *data)
+{
+    struct ctr_writer *writer;
+
+    writer = writer_create(CTR_WRITER_CALLBACK, CTR_WRITER_CHUNK_SIZE);
+    if (!writer) {
+        return NULL;
+    }
+    writer->cb = cb;
+    writer->cb_data = data;
+
+    return writer;
+}
+
+void ctr_writer_destroy(struct ctr_writer *writer)
+{
+    if (writer->type == CTR_WRITER_BUFFER) {
+        if (writer->buf) {
+            cfl_sds_destroy(writer->buf);
+        }
+    }
+    else {
+        free(writer->buf);
+    }
+
+    free(writer);
+}
+
+/* pass bytes to the sink of a streaming writer */
+static int sink_write(struct ctr_writer *writer, const char *buf, size_t len)
+{
+    ssize_t ret;
+
+    switch (writer->type) {
+        case CTR_WRITER_FILE:
+            if (fwrite(buf, 1, len, writer->fp) != len) {
+                return -1;
+            }
+            return 0;
+        case CTR_WRITER_FD:
+            while (len > 0) {
+                ret = write(writer->fd, buf, len);
+                if (ret == -1) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    ctr_errno();
+                    return -1;
+                }
+                buf += ret;
+                len -= ret;
+            }
+            return 0;
+        case CTR_WRITER_CALLBACK:
+            return writer->cb(writer->cb_data, buf, len);
+    }
+
+    return -1;
+}
+
+static int chunk_flush(struct ctr_writer *writer)
+{
+    if (writer->error) {
+        return -1;
+    }
+
+    if (writer->len > 0 && sink_write(writer, writer->buf, writer->len) != 0) {
+        writer->error = CTR_TRUE;
+        return -1;
+    }
+    writer->len = 0;
+
+    return 0;
+}
+
+int ctr_writer_flush(struct ctr_writer *writer)
+{
+    if (writer->type == CTR_WRITER_BUFFER) {
+        return writer->error ? -1 : 0;
+    }
+
+    if (chunk_flush(writer) != 0) {
+        return -1;
+    }
+
+    if (writer->type == CTR_WRITER_FILE && fflush(writer->fp) != 0) {
+        writer->error = CTR_TRUE;
+        return -1;
+    }
+
+    return 0;
+}
+
+int ctr_writer_set_chunk_size(struct ctr_writer *writer, size_t size)
+{
+    char *tmp;
+
+    if (writer->type == CTR_WRITER_BUFFER || size == 0) {
+        return -1;
+    }
+
+    if (chunk_flush(writer) != 0) {
+        return -1;
+    }
+
+    tmp = realloc(writer->buf, size);
+    if (!tmp) {
+        ctr_errno();
+        return -1;
+    }
+    writer->buf = tmp;
+    writer->size = size;
+
+    return 0;
+}
+
+cfl_sds_t ctr_writer_buffer_take(struct ctr_writer *writer)
+{
+    cfl_sds_t out;
+
+    if (writer->type != CTR_WRITER_BUFFER || writer->error) {
+        return NULL;
+    }
+
+    /* the sds allocation always keeps room for the terminator */
+    out = writer->buf;
+    out[writer->len] = '\0';
+    cfl_sds_set_len(out, writer->len);
+
+    writer->len = 0;
+    writer->buf = cfl_sds_create_size(writer->size);
+    if (!writer->buf) {
+        ctr_errno();
+        writer->error = CTR_TRUE;
+        writer->size = 0;
+    }
+
+    return out;
+}
+
+static int buffer_grow(struct ctr_writer *writer, size_t len)
+{
+    size_t grow;
+    cfl_sds_t tmp;
+
+    grow = writer->size;
+    if (grow < len) {
+        grow = len;
+    }
+
+    tmp = cfl_sds_increase(writer->buf, grow);
+    if (!tmp) {
+        writer->error = CTR_TRUE;
+        return -1;
+    }
+    writer->buf = tmp;
+    writer->size += grow;
+
+    return 0;
+}
+
+char *ctr_writer_reserve_slow(struct ctr_writer *writer, size_t len)
+{
+    char *tmp;
+
+    if (writer->error) {
+        return NULL;
+    }
+
+    if (writer->type == CTR_WRITER_BUFFER) {
+        if (buffer_grow(writer, len) != 0) {
+            return NULL;
+        }
+        return writer->buf + writer->len;
+    }
+
+    if (chunk_flush(writer) != 0) {
+        return NULL;
+    }
+
+    /* a single item bigger than the chunk */
+    if (len > writer->size) {
+        tmp = realloc(writer->buf, len);
+        if (!tmp) {
+            ctr_errno();
+            writer->error = CTR_TRUE;
+            return NULL;
+        }
+        writer->buf = tmp;
+        writer->size = len;
+    }
+
+    return writer->buf;
+}
+
+void ctr_writer_write_slow(struct ctr_writer *writer, const char *buf, size_t len)
+{
+    if (writer->error) {
+        return;
+    }
+
+    if (writer->type == CTR_WRITER_BUFFER) {
+        if (buffer_grow(writer, len) != 0) {
+            return;
+        }
+        memcpy(writer->buf + writer->len, buf, len);
+        writer->len += len;
+        return;
+    }
+
+    if (chunk_flush(writer) != 0) {
+        return;
+    }
+
+    /* large writes skip the chunk */
+    if (len >= writer->size) {
+        if (sink_write(writer, buf, len) != 0) {
+            writer->error = CTR_TRUE;
+        }
+        return;
+    }
+
+    memcpy(writer->buf, buf, len);
+    writer->len = len;
+}
+
+void ctr_writer_str(struct ctr_writer *writer, const char *str)
+{
+    ctr_writer_write(writer, str, strlen(str));
+}
+
+void ctr_writer_pad(struct ctr_writer *writer, char c, size_t count)
+{
+    size_t len;
+    char *p;
+
+    while (count > 0) {
+        len = count;
+        if (len > CTR_WRITER_CHUNK_SIZE) {
+            len = CTR_WRITER_CHUNK_SIZE;
+        }
+
+        p = ctr_writer_reserve(writer, len);
+        if (!p) {
+            return;
+        }
+        memset(p, c, len);
+        ctr_writer_commit(writer, len);
+
+        count -= len;
+    }
+}
+
+void ctr_writer_uint64(struct ctr_writer *writer, uint64_t val)
+{
+    int pos = 20;
+    char tmp[20];
+
+    while (val >= 100) {
+        pos -= 2;
+        memcpy(tmp + pos, writer_digits + (val % 100) * 2, 2);
+        val /= 100;
+    }
+
+    if (val >= 10) {
+        pos -= 2;
+        memcpy(tmp + pos, writer_digits + val * 2, 2);
+    }
+    else {
+        tmp[--pos] = '0' + val;
+    }
+
+    ctr_writer_write(writer, tmp + pos, sizeof(tmp) - pos);
+}
+
+void ctr_writer_int64(struct ctr_writer *writer, int64_t val)
+{
+    if (val < 0) {
+        ctr_writer_char(writer, '-');
+        ctr_writer_uint64(writer, 0 - (uint64_t) val);
+    }
+    else {
+        ctr_writer_uint64(writer, val);
+    }
+}
+
+void ctr_writer_double(struct ctr_writer *writer, double val)
+{
+    int len;
+    char tmp[32];
+
+    len = snprintf(tmp, sizeof(tmp), "%.17g", val);
+    ctr_writer_write(writer, tmp, len);
+}
+
+void ctr_writer_hex(struct ctr_writer *writer, const void *buf, size_t len)
+{
+    char *p;
+
+    p = ctr_writer_reserve(writer, len * 2);
+    if (!p) {
+        return;
+    }
+
+    ctr_base16_encode(buf, len, p);
+    ctr_writer_commit(writer, len * 2);
+}
@@ -19,6 +19,15 @@
 
 #include <ctraces/ctraces.h>
 
+static int opt_bool(const char *val)
+{
+    if (strcmp(val, "on") == 0 || strcmp(val, "true") == 0 ||
+        strcmp(val, "1") == 0) {
+        return CTR_TRUE;
+    }
+    return CTR_FALSE;
+}
+
 void ctr_opts_init(struct ctrace_opts *opts)
 {
     memset(opts, '\0', sizeof(struct ctrace_opts));
@@ -26,10 +35,26 @@ void ctr_opts_init(struct ctrace_opts *opts)
 
 void ctr_opts_set(struct ctrace_opts *opts, int value, char *val)
 {
-    /* unused */
-    (void) opts;
-    (void) value;
-    (void) val;
+    if (!opts || !val) {
+        return;
+    }
+
+    switch (value) {
+        case CTR_OPTS_ARENA:
+            opts->arena = opt_bool(val);
+            break;
+        case CTR_OPTS_ARENA_CHUNK_SIZE:
+            opts->arena_chunk_size = strtoul(val, NULL, 10);
+            break;
+        case CTR_OPTS_ID_INDEX:
+            opts->id_index = opt_bool(val);
+            break;
+        case CTR_OPTS_INTERN:
+            opts->intern = opt_bool(val);
+            break;
+        default:
+            break;
+    }
 }
 
 void ctr_opts_exit(struct ctrace_opts *opts)
@@ -52,6 +77,36 @@ struct ctrace *ctr_create(struct ctrace_opts *opts)
     cfl_list_init(&ctx->resource_spans);
     cfl_list_init(&ctx->span_list);
 
+    if (opts && opts->arena) {
+        ctx->arena = ctr_arena_create(opts->arena_chunk_size);
+        if (!ctx->arena) {
+            free(ctx);
+            return NULL;
+        }
+    }
+
+    if (opts && opts->id_index) {
+        if (ctr_index_enable(ctx) != 0) {
+            if (ctx->arena) {
+                ctr_arena_destroy(ctx->arena);
+            }
+            free(ctx);
+            return NULL;
+        }
+    }
+
+    if (opts && opts->intern) {
+        ctx->intern = ctr_intern_create();
+        if (!ctx->intern) {
+            ctr_index_disable(ctx);
+            if (ctx->arena) {
+                ctr_arena_destroy(ctx->arena);
+            }
+            free(ctx);
+            return NULL;
+        }
+    }
+
     return ctx;
 }
 
@@ -61,12 +116,32 @@ void ctr_destroy(struct ctrace *ctx)
     struct cfl_list *tmp;
     struct ctrace_resource_span *resource_span;
 
+    /* spans still pending from staging buffers are released with the tree */
+    ctr_stage_collect(ctx);
+
+    /* drop the index at once instead of span by span */
+    ctr_index_disable(ctx);
+
     /* delete resources */
     cfl_list_foreach_safe(head, tmp, &ctx->resource_spans) {
         resource_span = cfl_list_entry(head, struct ctrace_resource_span, _head);
         ctr_resource_span_destroy(resource_span);
     }
 
+    if (ctx->noop_span) {
+        free(ctx->noop_span);
+    }
+
+    /* names are referenced by spans and events until this point */
+    if (ctx->intern) {
+        ctr_intern_destroy(ctx->intern);
+    }
+
+    /* spans, events, links and their strings are released with the arena */
+    if (ctx->arena) {
+        ctr_arena_destroy(ctx->arena);
+    }
+
     free(ctx);
 }
 
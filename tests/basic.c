@@ -52,8 +52,80 @@ void test_options()
     ctr_opts_exit(&opts);
 }
 
+void test_base16()
+{
+    int i;
+    int ret;
+    size_t len;
+    size_t pos;
+    char hex[81];
+    char ref[81];
+    char bad[] = "/:@G`g \x80\xff";
+    unsigned char data[40];
+    unsigned char out[40];
+    cfl_sds_t text;
+    struct ctrace_id *cid;
+    const char digits[] = "0123456789abcdef";
+
+    for (i = 0; i < sizeof(data); i++) {
+        data[i] = (unsigned char) (i * 37 + 11);
+    }
+
+    /* every length goes through the vector and scalar paths */
+    for (len = 0; len <= sizeof(data); len++) {
+        for (i = 0; i < len; i++) {
+            ref[i * 2] = digits[data[i] >> 4];
+            ref[i * 2 + 1] = digits[data[i] & 0x0f];
+        }
+
+        ctr_base16_encode(data, len, hex);
+        TEST_CHECK(memcmp(hex, ref, len * 2) == 0);
+
+        memset(out, 0, sizeof(out));
+        ret = ctr_base16_decode(hex, len * 2, out);
+        TEST_CHECK(ret == 0);
+        TEST_CHECK(memcmp(out, data, len) == 0);
+
+        /* any invalid character is rejected, wherever it is */
+        for (pos = 0; pos < len * 2; pos++) {
+            for (i = 0; bad[i] != '\0'; i++) {
+                memcpy(ref, hex, len * 2);
+                ref[pos] = bad[i];
+                TEST_CHECK(ctr_base16_decode(ref, len * 2, out) == -1);
+            }
+        }
+    }
+
+    /* upper case input */
+    ret = ctr_base16_decode("0A1b2C3d4E5f6A7b", 16, out);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(memcmp(out, "\x0a\x1b\x2c\x3d\x4e\x5f\x6a\x7b", 8) == 0);
+    TEST_CHECK(ctr_base16_decode("abc", 3, out) == -1);
+
+    /* IDs */
+    text = cfl_sds_create(OPTS_TRACE_ID);
+    cid = ctr_id_from_base16(text);
+    cfl_sds_destroy(text);
+    TEST_ASSERT(cid != NULL);
+    TEST_CHECK(ctr_id_get_len(cid) == 8);
+
+    ret = ctr_id_to_lower_base16_buf(cid, hex, sizeof(hex));
+    TEST_CHECK(ret == 16);
+    TEST_CHECK(strcmp(hex, OPTS_TRACE_ID) == 0);
+
+    ret = ctr_id_to_lower_base16_buf(cid, hex, 16);
+    TEST_CHECK(ret == -1);
+
+    ret = ctr_id_set_base16(cid, "zz", 2);
+    TEST_CHECK(ret == -1);
+    TEST_CHECK(ctr_id_get_len(cid) == 8);
+
+    ctr_id_destroy(cid);
+}
+
 TEST_LIST = {
     {"basic", test_basic},
     {"options", test_options},
+    {"base16", test_base16},
     { 0 }
 };
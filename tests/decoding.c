@@ -24,8 +24,15 @@
 #include <ctraces/ctr_encode_msgpack.h>
 #include <ctraces/ctr_decode_msgpack.h>
 #include <ctraces/ctr_encode_text.h>
+#include <ctraces/ctr_encode_json.h>
+#include <ctraces/ctr_encode_opentelemetry.h>
+#include <ctraces/ctr_decode_opentelemetry.h>
 #include "ctr_tests.h"
 
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
 static int generate_dummy_array_attribute_set(struct cfl_array **out_array, size_t current_depth, size_t max_depth);
 static int generate_dummy_kvlist_attribute_set(struct cfl_kvlist **out_kvlist, size_t current_depth, size_t max_depth);
 
@@ -558,6 +565,56 @@ void test_msgpack_to_cmt()
     ctr_destroy(context);
 }
 
+void test_msgpack_to_ctr_arena()
+{
+    struct ctrace      *context;
+    struct ctrace      *heap_context;
+    struct ctrace      *arena_context;
+    struct ctrace_opts  opts;
+    char               *msgpack_buffer;
+    size_t              msgpack_size;
+    char               *heap_text;
+    char               *arena_text;
+    size_t              offset;
+    int                 result;
+
+    context = generate_encoder_test_data();
+    TEST_ASSERT(context != NULL);
+
+    result = ctr_encode_msgpack_create(context, &msgpack_buffer, &msgpack_size);
+    TEST_ASSERT(result == 0);
+
+    offset = 0;
+    result = ctr_decode_msgpack_create(&heap_context, msgpack_buffer, msgpack_size, &offset);
+    TEST_ASSERT(result == 0);
+
+    ctr_opts_init(&opts);
+    ctr_opts_set(&opts, CTR_OPTS_ARENA, "on");
+
+    offset = 0;
+    result = ctr_decode_msgpack_create_with_opts(&arena_context, &opts,
+                                                 msgpack_buffer, msgpack_size, &offset);
+    TEST_ASSERT(result == 0);
+    TEST_CHECK(arena_context->arena != NULL);
+
+    heap_text = ctr_encode_text_create(heap_context);
+    TEST_ASSERT(heap_text != NULL);
+
+    arena_text = ctr_encode_text_create(arena_context);
+    TEST_ASSERT(arena_text != NULL);
+
+    TEST_CHECK(strcmp(heap_text, arena_text) == 0);
+
+    ctr_encode_text_destroy(heap_text);
+    ctr_encode_text_destroy(arena_text);
+    ctr_encode_msgpack_destroy(msgpack_buffer);
+
+    ctr_destroy(heap_context);
+    ctr_destroy(arena_context);
+    ctr_destroy(context);
+    ctr_opts_exit(&opts);
+}
+
 void test_msgpack_to_ctr_with_empty_spans()
 {
     struct ctrace *context;
@@ -729,10 +786,949 @@ void test_simple_to_msgpack_and_back()
     ctr_opts_exit(&opts);
 }
 
+void test_opentelemetry_direct_encoder()
+{
+    struct ctrace *context;
+    cfl_sds_t      packed;
+    cfl_sds_t      direct;
+
+    context = generate_encoder_test_data();
+    TEST_ASSERT(context != NULL);
+
+    packed = ctr_encode_opentelemetry_create(context);
+    TEST_ASSERT(packed != NULL);
+
+    direct = ctr_encode_opentelemetry_direct_create(context);
+    TEST_ASSERT(direct != NULL);
+
+    /* the direct writer must produce the same bytes as protobuf-c */
+    TEST_CHECK(cfl_sds_len(packed) == cfl_sds_len(direct));
+    TEST_CHECK(memcmp(packed, direct, cfl_sds_len(packed)) == 0);
+
+    ctr_encode_opentelemetry_destroy(packed);
+    ctr_encode_opentelemetry_destroy(direct);
+    ctr_destroy(context);
+}
+
+void test_opentelemetry_direct_unsupported_variant()
+{
+    int                          ret;
+    size_t                       offset;
+    cfl_sds_t                    direct;
+    struct cfl_array            *array;
+    struct cfl_variant          *var;
+    struct ctrace               *context;
+    struct ctrace               *decoded;
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_scope_span    *scope_span;
+    struct ctrace_span          *span;
+
+    context = ctr_create(NULL);
+    TEST_ASSERT(context != NULL);
+
+    resource_span = ctr_resource_span_create(context);
+    scope_span = ctr_scope_span_create(resource_span);
+    span = ctr_span_create(context, scope_span, "unsupported", NULL);
+    TEST_ASSERT(span != NULL);
+
+    /* AnyValue has no unsigned member: the pair and the entry are skipped */
+    ctr_span_set_attribute_string(span, "keep", "yes");
+    cfl_kvlist_insert_uint64(span->attr->kv, "skip", 42);
+
+    array = cfl_array_create(2);
+    TEST_ASSERT(array != NULL);
+    cfl_array_append_uint64(array, 7);
+    cfl_array_append_string(array, "entry");
+    ctr_span_set_attribute_array(span, "list", array);
+
+    direct = ctr_encode_opentelemetry_direct_create(context);
+    TEST_ASSERT(direct != NULL);
+
+    offset = 0;
+    ret = ctr_decode_opentelemetry_direct_create(&decoded, direct, cfl_sds_len(direct),
+                                                 &offset);
+    TEST_ASSERT(ret == CTR_DECODE_OPENTELEMETRY_SUCCESS);
+
+    span = cfl_list_entry_first(&decoded->span_list, struct ctrace_span, _head_global);
+    TEST_CHECK(cfl_kvlist_count(span->attr->kv) == 2);
+    TEST_CHECK(cfl_kvlist_contains(span->attr->kv, "keep"));
+    TEST_CHECK(!cfl_kvlist_contains(span->attr->kv, "skip"));
+
+    var = cfl_kvlist_fetch(span->attr->kv, "list");
+    TEST_ASSERT(var != NULL && var->type == CFL_VARIANT_ARRAY);
+    TEST_CHECK(var->data.as_array->entry_count == 1);
+
+    ctr_decode_opentelemetry_destroy(decoded);
+    ctr_encode_opentelemetry_destroy(direct);
+    ctr_destroy(context);
+}
+
+void test_opentelemetry_direct_absent_end_time()
+{
+    int                          ret;
+    size_t                       offset;
+    cfl_sds_t                    direct;
+    struct ctrace               *context;
+    struct ctrace               *decoded;
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_scope_span    *scope_span;
+    struct ctrace_span          *span;
+
+    context = ctr_create(NULL);
+    TEST_ASSERT(context != NULL);
+
+    resource_span = ctr_resource_span_create(context);
+    scope_span = ctr_scope_span_create(resource_span);
+    span = ctr_span_create(context, scope_span, "open", NULL);
+    TEST_ASSERT(span != NULL);
+
+    /* a zero end time is not written */
+    ctr_span_start_ts(context, span, 1000);
+    ctr_span_end_ts(context, span, 0);
+
+    direct = ctr_encode_opentelemetry_direct_create(context);
+    TEST_ASSERT(direct != NULL);
+
+    offset = 0;
+    ret = ctr_decode_opentelemetry_direct_create(&decoded, direct, cfl_sds_len(direct),
+                                                 &offset);
+    TEST_ASSERT(ret == CTR_DECODE_OPENTELEMETRY_SUCCESS);
+
+    span = cfl_list_entry_first(&decoded->span_list, struct ctrace_span, _head_global);
+    TEST_CHECK(span->start_time_unix_nano == 1000);
+    TEST_CHECK(span->end_time_unix_nano == 0);
+
+    ctr_decode_opentelemetry_destroy(decoded);
+    ctr_encode_opentelemetry_destroy(direct);
+    ctr_destroy(context);
+}
+
+void test_opentelemetry_direct_decoder()
+{
+    int            ret;
+    size_t         offset;
+    struct ctrace *context;
+    struct ctrace *decoded;
+    cfl_sds_t      packed;
+    cfl_sds_t      repacked;
+
+    context = generate_encoder_test_data();
+    TEST_ASSERT(context != NULL);
+
+    packed = ctr_encode_opentelemetry_create(context);
+    TEST_ASSERT(packed != NULL);
+
+    offset = 0;
+    ret = ctr_decode_opentelemetry_direct_create(&decoded, packed, cfl_sds_len(packed),
+                                                 &offset);
+    TEST_ASSERT(ret == CTR_DECODE_OPENTELEMETRY_SUCCESS);
+    TEST_CHECK(offset == cfl_sds_len(packed));
+
+    repacked = ctr_encode_opentelemetry_create(decoded);
+    TEST_ASSERT(repacked != NULL);
+
+    TEST_CHECK(cfl_sds_len(packed) == cfl_sds_len(repacked));
+    TEST_CHECK(memcmp(packed, repacked, cfl_sds_len(packed)) == 0);
+
+    /* a truncated payload must be rejected */
+    offset = 0;
+    ret = ctr_decode_opentelemetry_direct_create(&decoded, packed, cfl_sds_len(packed) - 1,
+                                                 &offset);
+    TEST_CHECK(ret == CTR_DECODE_OPENTELEMETRY_CORRUPTED_DATA);
+
+    ctr_encode_opentelemetry_destroy(packed);
+    ctr_encode_opentelemetry_destroy(repacked);
+    ctr_decode_opentelemetry_destroy(decoded);
+    ctr_destroy(context);
+}
+
+void test_opentelemetry_decoder_scratch()
+{
+    int                                      i;
+    int                                      ret;
+    size_t                                   offset;
+    size_t                                   scratch_size = 0;
+    struct ctrace                           *context;
+    struct ctrace                           *decoded;
+    struct ctr_decode_opentelemetry_scratch *scratch;
+    cfl_sds_t                                packed;
+    cfl_sds_t                                expected;
+    cfl_sds_t                                text;
+
+    context = generate_encoder_test_data();
+    TEST_ASSERT(context != NULL);
+
+    packed = ctr_encode_opentelemetry_create(context);
+    TEST_ASSERT(packed != NULL);
+
+    offset = 0;
+    ret = ctr_decode_opentelemetry_create(&decoded, packed, cfl_sds_len(packed), &offset);
+    TEST_ASSERT(ret == CTR_DECODE_OPENTELEMETRY_SUCCESS);
+
+    expected = ctr_encode_opentelemetry_create(decoded);
+    TEST_ASSERT(expected != NULL);
+    ctr_decode_opentelemetry_destroy(decoded);
+
+    /* use a small chunk size so the scratch arena has to grow */
+    scratch = ctr_decode_opentelemetry_scratch_create(512);
+    TEST_ASSERT(scratch != NULL);
+
+    /* the scratch context is reused across calls */
+    for (i = 0; i < 3; i++) {
+        offset = 0;
+        ret = ctr_decode_opentelemetry_create_with_scratch(&decoded, scratch, packed,
+                                                           cfl_sds_len(packed), &offset);
+        TEST_ASSERT(ret == CTR_DECODE_OPENTELEMETRY_SUCCESS);
+        TEST_CHECK(offset == cfl_sds_len(packed));
+
+        /* the chunks reserved by the first call are reused by the next ones */
+        if (i == 0) {
+            scratch_size = ctr_decode_opentelemetry_scratch_size(scratch);
+            TEST_CHECK(scratch_size > 512);
+        }
+        TEST_CHECK(ctr_decode_opentelemetry_scratch_size(scratch) == scratch_size);
+
+        text = ctr_encode_opentelemetry_create(decoded);
+        TEST_ASSERT(text != NULL);
+        TEST_CHECK(cfl_sds_len(text) == cfl_sds_len(expected));
+        TEST_CHECK(memcmp(text, expected, cfl_sds_len(expected)) == 0);
+
+        ctr_encode_opentelemetry_destroy(text);
+        ctr_decode_opentelemetry_destroy(decoded);
+    }
+
+    ctr_decode_opentelemetry_scratch_destroy(scratch);
+    ctr_encode_opentelemetry_destroy(expected);
+    ctr_encode_opentelemetry_destroy(packed);
+    ctr_destroy(context);
+}
+
+void test_msgpack_to_buffer()
+{
+    int            result;
+    char          *buf;
+    char          *msgpack_buffer;
+    size_t         msgpack_size;
+    size_t         written;
+    ssize_t        size;
+    struct ctrace *context;
+
+    context = generate_encoder_test_data();
+    TEST_ASSERT(context != NULL);
+
+    result = ctr_encode_msgpack_create(context, &msgpack_buffer, &msgpack_size);
+    TEST_ASSERT(result == 0);
+
+    size = ctr_encode_msgpack_size(context);
+    TEST_CHECK(size == msgpack_size);
+
+    buf = malloc(msgpack_size);
+    TEST_ASSERT(buf != NULL);
+
+    result = ctr_encode_msgpack_to_buffer(context, buf, msgpack_size, &written);
+    TEST_CHECK(result == 0);
+    TEST_CHECK(written == msgpack_size);
+    TEST_CHECK(memcmp(buf, msgpack_buffer, msgpack_size) == 0);
+
+    /* not enough room */
+    result = ctr_encode_msgpack_to_buffer(context, buf, msgpack_size - 1, &written);
+    TEST_CHECK(result == -1);
+
+    free(buf);
+    ctr_encode_msgpack_destroy(msgpack_buffer);
+    ctr_destroy(context);
+}
+
+void test_msgpack_stream()
+{
+    int                               result;
+    int                               count;
+    char                             *buf;
+    char                             *msgpack_buffer;
+    size_t                            msgpack_size;
+    size_t                            offset;
+    struct cfl_list                  *head;
+    struct ctrace                    *context;
+    struct ctrace                    *decoded;
+    struct ctr_decode_msgpack_stream *stream;
+
+    context = generate_encoder_test_data();
+    TEST_ASSERT(context != NULL);
+
+    result = ctr_encode_msgpack_create(context, &msgpack_buffer, &msgpack_size);
+    TEST_ASSERT(result == 0);
+
+    /* three concatenated payloads */
+    buf = malloc(msgpack_size * 3);
+    TEST_ASSERT(buf != NULL);
+
+    memcpy(buf, msgpack_buffer, msgpack_size);
+    memcpy(&buf[msgpack_size], msgpack_buffer, msgpack_size);
+    memcpy(&buf[msgpack_size * 2], msgpack_buffer, msgpack_size);
+
+    stream = ctr_decode_msgpack_stream_create(NULL, 0);
+    TEST_ASSERT(stream != NULL);
+
+    /* the second object is only partially available */
+    offset = 0;
+    count = 0;
+    while ((result = ctr_decode_msgpack_stream_next(stream, &decoded, buf,
+                                                    msgpack_size + msgpack_size / 2,
+                                                    &offset)) == 0) {
+        ctr_destroy(decoded);
+        count++;
+    }
+    TEST_CHECK(result == CTR_DECODE_MSGPACK_INSUFFICIENT_DATA);
+    TEST_CHECK(count == 1);
+    TEST_CHECK(offset == msgpack_size);
+
+    /* resume once the rest arrived */
+    while ((result = ctr_decode_msgpack_stream_next(stream, &decoded, buf,
+                                                    msgpack_size * 3,
+                                                    &offset)) == 0) {
+        ctr_destroy(decoded);
+        count++;
+    }
+    TEST_CHECK(result == CTR_DECODE_MSGPACK_INSUFFICIENT_DATA);
+    TEST_CHECK(count == 3);
+    TEST_CHECK(offset == msgpack_size * 3);
+
+    ctr_decode_msgpack_stream_destroy(stream);
+
+    /* merge every object into one context */
+    stream = ctr_decode_msgpack_stream_create(NULL, CTR_DECODE_MSGPACK_STREAM_MERGE);
+    TEST_ASSERT(stream != NULL);
+
+    offset = 0;
+    while ((result = ctr_decode_msgpack_stream_next(stream, NULL, buf,
+                                                    msgpack_size * 3,
+                                                    &offset)) == 0);
+    TEST_CHECK(result == CTR_DECODE_MSGPACK_INSUFFICIENT_DATA);
+
+    decoded = ctr_decode_msgpack_stream_take(stream);
+    TEST_ASSERT(decoded != NULL);
+
+    count = 0;
+    cfl_list_foreach(head, &decoded->resource_spans) {
+        count++;
+    }
+    TEST_CHECK(count == 3 * cfl_list_size(&context->resource_spans));
+
+    ctr_destroy(decoded);
+    ctr_decode_msgpack_stream_destroy(stream);
+
+    free(buf);
+    ctr_encode_msgpack_destroy(msgpack_buffer);
+    ctr_destroy(context);
+}
+
+struct split_chunks {
+    int count;
+    size_t max_size;
+    int oversized;
+    cfl_sds_t bufs[256];
+};
+
+static int split_chunk_collect(cfl_sds_t buf, void *data)
+{
+    struct split_chunks *chunks = data;
+
+    if (cfl_sds_len(buf) > chunks->max_size) {
+        chunks->oversized++;
+    }
+
+    if (chunks->count == 256) {
+        ctr_encode_opentelemetry_destroy(buf);
+        return -1;
+    }
+
+    chunks->bufs[chunks->count++] = buf;
+    return 0;
+}
+
+static void split_chunks_release(struct split_chunks *chunks)
+{
+    int i;
+
+    for (i = 0; i < chunks->count; i++) {
+        ctr_encode_opentelemetry_destroy(chunks->bufs[i]);
+    }
+    chunks->count = 0;
+}
+
+void test_opentelemetry_split()
+{
+    int                          i;
+    int                          r;
+    int                          s;
+    int                          ret;
+    int                          span_count;
+    size_t                       offset;
+    char                         name[32];
+    cfl_sds_t                    direct;
+    struct cfl_list             *head;
+    struct cfl_list             *s_head;
+    struct cfl_list             *sp_head;
+    struct ctrace               *context;
+    struct ctrace               *decoded;
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_scope_span    *scope_span;
+    struct ctrace_span          *span;
+    struct split_chunks          chunks;
+
+    context = ctr_create(NULL);
+    TEST_ASSERT(context != NULL);
+
+    for (r = 0; r < 2; r++) {
+        resource_span = ctr_resource_span_create(context);
+        ctr_resource_span_set_schema_url(resource_span, "http://resource.schema.url/spec.json");
+        generate_sample_resource_attributes(resource_span->resource);
+
+        for (s = 0; s < 2; s++) {
+            scope_span = ctr_scope_span_create(resource_span);
+            ctr_scope_span_set_schema_url(scope_span, "http://scope.schema.url/spec.json");
+            generate_sample_instrumentation_scope(scope_span);
+
+            for (i = 0; i < 40; i++) {
+                snprintf(name, sizeof(name) - 1, "span %d", (r * 2 + s) * 40 + i);
+                span = ctr_span_create(context, scope_span, name, NULL);
+                ctr_span_set_trace_id(span, "CTR_TRACE_000001", 16);
+                ctr_span_set_span_id(span, "SPAN_001", 8);
+                ctr_span_set_attribute_string(span, "http.method", "GET");
+                ctr_span_set_attribute_int64(span, "http.status_code", 200 + i);
+            }
+        }
+    }
+
+    /* a large enough limit produces the same bytes as the regular encoder */
+    memset(&chunks, 0, sizeof(chunks));
+    chunks.max_size = 1024 * 1024;
+    ret = ctr_encode_opentelemetry_split(context, chunks.max_size, split_chunk_collect, &chunks);
+    TEST_CHECK(ret == 0);
+    TEST_ASSERT(chunks.count == 1);
+
+    direct = ctr_encode_opentelemetry_direct_create(context);
+    TEST_ASSERT(direct != NULL);
+    TEST_CHECK(cfl_sds_len(direct) == cfl_sds_len(chunks.bufs[0]));
+    TEST_CHECK(memcmp(direct, chunks.bufs[0], cfl_sds_len(direct)) == 0);
+    split_chunks_release(&chunks);
+
+    /* small limit: every payload is a valid request and spans keep their order */
+    chunks.max_size = 4096;
+    ret = ctr_encode_opentelemetry_split(context, chunks.max_size, split_chunk_collect, &chunks);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(chunks.count > 4);
+    TEST_CHECK(chunks.oversized == 0);
+
+    span_count = 0;
+    for (i = 0; i < chunks.count; i++) {
+        offset = 0;
+        ret = ctr_decode_opentelemetry_direct_create(&decoded, chunks.bufs[i],
+                                                     cfl_sds_len(chunks.bufs[i]), &offset);
+        TEST_ASSERT(ret == CTR_DECODE_OPENTELEMETRY_SUCCESS);
+
+        cfl_list_foreach(head, &decoded->resource_spans) {
+            resource_span = cfl_list_entry(head, struct ctrace_resource_span, _head);
+            TEST_CHECK(resource_span->schema_url != NULL);
+            TEST_CHECK(cfl_list_size(&resource_span->resource->attr->kv->list) > 0);
+
+            cfl_list_foreach(s_head, &resource_span->scope_spans) {
+                scope_span = cfl_list_entry(s_head, struct ctrace_scope_span, _head);
+                TEST_CHECK(scope_span->instrumentation_scope != NULL);
+
+                cfl_list_foreach(sp_head, &scope_span->spans) {
+                    span = cfl_list_entry(sp_head, struct ctrace_span, _head);
+                    snprintf(name, sizeof(name) - 1, "span %d", span_count);
+                    TEST_CHECK(strcmp(span->name, name) == 0);
+                    span_count++;
+                }
+            }
+        }
+        ctr_decode_opentelemetry_destroy(decoded);
+    }
+    TEST_CHECK(span_count == 160);
+    split_chunks_release(&chunks);
+
+    /* a span that can never fit */
+    chunks.max_size = 64;
+    ret = ctr_encode_opentelemetry_split(context, chunks.max_size, split_chunk_collect, &chunks);
+    TEST_CHECK(ret == -1);
+    split_chunks_release(&chunks);
+
+    ctr_encode_opentelemetry_destroy(direct);
+    ctr_destroy(context);
+}
+
+struct stream_chunks {
+    size_t chunk_size;
+    int count;
+    int oversized;
+    int fail_at;
+    cfl_sds_t buf;
+};
+
+static int stream_chunk_collect(void *data, const char *buf, size_t len)
+{
+    struct stream_chunks *chunks = data;
+
+    if (++chunks->count == chunks->fail_at) {
+        return -1;
+    }
+
+    if (len > chunks->chunk_size) {
+        chunks->oversized++;
+    }
+
+    return cfl_sds_cat_safe(&chunks->buf, buf, len);
+}
+
+void test_opentelemetry_stream()
+{
+    int                          ret;
+    char                         value[200];
+    cfl_sds_t                    direct;
+    struct ctrace               *context;
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_scope_span    *scope_span;
+    struct ctrace_span          *span;
+    struct ctr_writer           *writer;
+    struct stream_chunks         chunks;
+
+    context = generate_encoder_test_data();
+    TEST_ASSERT(context != NULL);
+
+    /* a value larger than a chunk */
+    resource_span = ctr_resource_span_create(context);
+    scope_span = ctr_scope_span_create(resource_span);
+    span = ctr_span_create(context, scope_span, "large", NULL);
+    TEST_ASSERT(span != NULL);
+    memset(value, 'v', sizeof(value) - 1);
+    value[sizeof(value) - 1] = '\0';
+    ctr_span_set_attribute_string(span, "value", value);
+
+    direct = ctr_encode_opentelemetry_create(context);
+    TEST_ASSERT(direct != NULL);
+
+    /* small chunks add up to the regular payload */
+    memset(&chunks, 0, sizeof(chunks));
+    chunks.chunk_size = 64;
+    chunks.buf = cfl_sds_create_size(64);
+    TEST_ASSERT(chunks.buf != NULL);
+
+    ret = ctr_encode_opentelemetry_stream(context, chunks.chunk_size,
+                                          stream_chunk_collect, &chunks);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(chunks.count > 1);
+    TEST_CHECK(chunks.oversized == 1);
+    TEST_CHECK(cfl_sds_len(chunks.buf) == cfl_sds_len(direct));
+    TEST_CHECK(memcmp(chunks.buf, direct, cfl_sds_len(direct)) == 0);
+
+    /* the callback stops the encoding */
+    cfl_sds_set_len(chunks.buf, 0);
+    chunks.count = 0;
+    chunks.fail_at = 3;
+    ret = ctr_encode_opentelemetry_stream(context, chunks.chunk_size,
+                                          stream_chunk_collect, &chunks);
+    TEST_CHECK(ret == -1);
+    TEST_CHECK(chunks.count == 3);
+    cfl_sds_destroy(chunks.buf);
+
+    /* a buffer writer grows to the whole payload */
+    writer = ctr_writer_buffer_create(16);
+    TEST_ASSERT(writer != NULL);
+    ret = ctr_encode_opentelemetry_write(context, writer);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(writer->len == cfl_sds_len(direct));
+    TEST_CHECK(memcmp(writer->buf, direct, cfl_sds_len(direct)) == 0);
+    ctr_writer_destroy(writer);
+
+    ctr_encode_opentelemetry_destroy(direct);
+    ctr_destroy(context);
+}
+
+#ifndef _WIN32
+struct parallel_caller {
+    struct ctrace *context;
+    cfl_sds_t direct;
+    int mismatches;
+};
+
+static void *parallel_caller_run(void *data)
+{
+    int i;
+    cfl_sds_t parallel;
+    struct parallel_caller *caller = data;
+
+    for (i = 0; i < 20; i++) {
+        parallel = ctr_encode_opentelemetry_create_parallel(caller->context, 4);
+        if (!parallel || cfl_sds_len(parallel) != cfl_sds_len(caller->direct) ||
+            memcmp(parallel, caller->direct, cfl_sds_len(parallel)) != 0) {
+            caller->mismatches++;
+        }
+        if (parallel) {
+            ctr_encode_opentelemetry_destroy(parallel);
+        }
+    }
+
+    return NULL;
+}
+#endif
+
+void test_opentelemetry_parallel()
+{
+    int                          i;
+    int                          r;
+    int                          s;
+    int                          n;
+    int                          threads[] = {0, 2, 3, 8};
+    char                         name[64];
+    cfl_sds_t                    direct;
+    cfl_sds_t                    parallel;
+    struct ctrace               *context;
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_scope_span    *scope_span;
+    struct ctrace_span          *span;
+
+    /* one resource span holds most spans and gets cut at its scope spans */
+    context = ctr_create(NULL);
+    TEST_ASSERT(context != NULL);
+
+    for (r = 0; r < 3; r++) {
+        resource_span = ctr_resource_span_create(context);
+        if (r != 1) {
+            ctr_resource_span_set_schema_url(resource_span, "http://resource.schema.url/spec.json");
+        }
+        generate_sample_resource_attributes(resource_span->resource);
+
+        for (s = 0; s < (r == 0 ? 6 : 1); s++) {
+            scope_span = ctr_scope_span_create(resource_span);
+            generate_sample_instrumentation_scope(scope_span);
+
+            for (i = 0; i < (r == 0 ? 50 : 10); i++) {
+                snprintf(name, sizeof(name) - 1, "span %d.%d.%d", r, s, i);
+                span = ctr_span_create(context, scope_span, name, NULL);
+                TEST_ASSERT(span != NULL);
+                ctr_span_set_attribute_int64(span, "index", i);
+            }
+        }
+    }
+
+    direct = ctr_encode_opentelemetry_direct_create(context);
+    TEST_ASSERT(direct != NULL);
+
+    for (n = 0; n < (int) (sizeof(threads) / sizeof(int)); n++) {
+        parallel = ctr_encode_opentelemetry_create_parallel(context, threads[n]);
+        TEST_ASSERT(parallel != NULL);
+        TEST_CHECK(cfl_sds_len(parallel) == cfl_sds_len(direct));
+        TEST_CHECK(memcmp(parallel, direct, cfl_sds_len(direct)) == 0);
+        TEST_MSG("threads: %d", threads[n]);
+        ctr_encode_opentelemetry_destroy(parallel);
+    }
+
+    ctr_encode_opentelemetry_destroy(direct);
+    ctr_destroy(context);
+
+    /* the common test data */
+    context = generate_encoder_test_data();
+    TEST_ASSERT(context != NULL);
+
+    direct = ctr_encode_opentelemetry_direct_create(context);
+    parallel = ctr_encode_opentelemetry_create_parallel(context, 4);
+    TEST_ASSERT(direct != NULL && parallel != NULL);
+    TEST_CHECK(cfl_sds_len(parallel) == cfl_sds_len(direct));
+    TEST_CHECK(memcmp(parallel, direct, cfl_sds_len(direct)) == 0);
+
+    ctr_encode_opentelemetry_destroy(parallel);
+
+#ifndef _WIN32
+    /* concurrent callers share the worker pool */
+    {
+        pthread_t callers[4];
+        struct parallel_caller caller[4];
+
+        for (n = 0; n < 4; n++) {
+            caller[n].context = context;
+            caller[n].direct = direct;
+            caller[n].mismatches = 0;
+            TEST_ASSERT(pthread_create(&callers[n], NULL, parallel_caller_run,
+                                       &caller[n]) == 0);
+        }
+
+        for (n = 0; n < 4; n++) {
+            pthread_join(callers[n], NULL);
+            TEST_CHECK(caller[n].mismatches == 0);
+        }
+    }
+#endif
+    ctr_encode_opentelemetry_destroy(direct);
+    ctr_destroy(context);
+}
+
+void test_json_encoder()
+{
+    struct ctrace *context;
+    struct ctrace_span *span;
+    struct ctrace_span_event *event;
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_scope_span *scope_span;
+    struct ctrace_instrumentation_scope *scope;
+    cfl_sds_t json;
+    char *expected;
+    int i;
+    char bytes[10000];
+    struct cfl_kvlist *kv;
+    struct ctr_writer *writer;
+    struct stream_chunks chunks;
+
+    context = ctr_create(NULL);
+    TEST_ASSERT(context != NULL);
+
+    resource_span = ctr_resource_span_create(context);
+    ctr_attributes_set_string(resource_span->resource->attr, "service.name", "frontend");
+
+    scope_span = ctr_scope_span_create(resource_span);
+    scope = ctr_instrumentation_scope_create("lib", "1.0", 0, NULL);
+    ctr_scope_span_set_instrumentation_scope(scope_span, scope);
+    ctr_scope_span_set_schema_url(scope_span, "https://schema");
+
+    span = ctr_span_create(context, scope_span, "GET \"/\"\n\x01", NULL);
+    TEST_ASSERT(span != NULL);
+    ctr_span_set_trace_id(span, "\x01\x23\x45\x67\x89\xab\xcd\xef\x01\x23\x45\x67\x89\xab\xcd\xef", 16);
+    ctr_span_set_span_id(span, "\xfe\xdc\xba\x98\x76\x54\x32\x10", 8);
+    ctr_span_kind_set(span, CTRACE_SPAN_SERVER);
+    ctr_span_start_ts(context, span, 1700000000000000001ULL);
+    ctr_span_end_ts(context, span, 18446744073709551615ULL);
+    ctr_span_set_attribute_int64(span, "retries", -9223372036854775807LL - 1);
+    ctr_span_set_attribute_double(span, "ratio", 0.5);
+    ctr_span_set_attribute_bool(span, "cached", CTR_TRUE);
+    ctr_span_set_status(span, CTRACE_SPAN_STATUS_CODE_ERROR, "tab\there");
+
+    event = ctr_span_event_add_ts(span, "retry", 42);
+    TEST_ASSERT(event != NULL);
+
+    json = ctr_encode_json_create(context);
+    TEST_ASSERT(json != NULL);
+
+    expected =
+        "{\"resourceSpans\":[{\"resource\":{\"attributes\":[{\"key\":\"service.name\","
+        "\"value\":{\"stringValue\":\"frontend\"}}]},\"scopeSpans\":[{\"scope\":"
+        "{\"name\":\"lib\",\"version\":\"1.0\"},\"spans\":[{"
+        "\"traceId\":\"0123456789abcdef0123456789abcdef\","
+        "\"spanId\":\"fedcba9876543210\","
+        "\"name\":\"GET \\\"/\\\"\\n\\u0001\",\"kind\":2,"
+        "\"startTimeUnixNano\":\"1700000000000000001\","
+        "\"endTimeUnixNano\":\"18446744073709551615\","
+        "\"attributes\":["
+        "{\"key\":\"retries\",\"value\":{\"intValue\":\"-9223372036854775808\"}},"
+        "{\"key\":\"ratio\",\"value\":{\"doubleValue\":0.5}},"
+        "{\"key\":\"cached\",\"value\":{\"boolValue\":true}}],"
+        "\"events\":[{\"timeUnixNano\":\"42\",\"name\":\"retry\"}],"
+        "\"status\":{\"message\":\"tab\\there\",\"code\":2}}],"
+        "\"schemaUrl\":\"https://schema\"}]}]}";
+
+    TEST_CHECK(strcmp(json, expected) == 0);
+    TEST_CHECK(cfl_sds_len(json) == strlen(expected));
+    TEST_MSG("json: %s", json);
+    ctr_encode_json_destroy(json);
+
+    /* streaming produces the same document, base64 values are written per chunk */
+    for (i = 0; i < (int) sizeof(bytes); i++) {
+        bytes[i] = (char) i;
+    }
+    kv = cfl_kvlist_create();
+    TEST_ASSERT(kv != NULL);
+    cfl_kvlist_insert_bytes(kv, "payload", bytes, sizeof(bytes), CFL_FALSE);
+    ctr_span_set_attribute_kvlist(span, "blob", kv);
+
+    json = ctr_encode_json_create(context);
+    TEST_ASSERT(json != NULL);
+
+    memset(&chunks, 0, sizeof(chunks));
+    chunks.chunk_size = CTR_WRITER_CHUNK_SIZE;
+    chunks.buf = cfl_sds_create_size(64);
+    TEST_ASSERT(chunks.buf != NULL);
+
+    writer = ctr_writer_callback_create(stream_chunk_collect, &chunks);
+    TEST_ASSERT(writer != NULL);
+    TEST_CHECK(ctr_encode_json_write(context, writer) == 0);
+    ctr_writer_destroy(writer);
+
+    TEST_CHECK(chunks.count > 1);
+    TEST_CHECK(chunks.oversized == 0);
+    TEST_CHECK(cfl_sds_len(chunks.buf) == cfl_sds_len(json));
+    TEST_CHECK(memcmp(chunks.buf, json, cfl_sds_len(json)) == 0);
+
+    cfl_sds_destroy(chunks.buf);
+    ctr_encode_json_destroy(json);
+    ctr_destroy(context);
+}
+
+void test_json_decoder()
+{
+    int                            result;
+    int                            count;
+    char                          *buf;
+    size_t                         len;
+    size_t                         offset;
+    size_t                         chunk;
+    cfl_sds_t                      json;
+    cfl_sds_t                      json_again;
+    struct ctrace                 *context;
+    struct ctrace                 *decoded;
+    struct ctrace_span            *span;
+    struct ctrace_scope_span      *scope_span;
+    struct ctrace_resource_span   *resource_span;
+    struct ctr_decode_json_stream *stream;
+
+    context = generate_encoder_test_data();
+    TEST_ASSERT(context != NULL);
+
+    json = ctr_encode_json_create(context);
+    TEST_ASSERT(json != NULL);
+    len = cfl_sds_len(json);
+
+    /* one shot, the re-encoded document must be identical */
+    offset = 0;
+    result = ctr_decode_json_create(&decoded, json, len, &offset);
+    TEST_ASSERT(result == CTR_DECODE_JSON_SUCCESS);
+    TEST_CHECK(offset == len);
+
+    json_again = ctr_encode_json_create(decoded);
+    TEST_ASSERT(json_again != NULL);
+    TEST_CHECK(strcmp(json, json_again) == 0);
+    ctr_encode_json_destroy(json_again);
+    ctr_decode_json_destroy(decoded);
+
+    /* two newline delimited documents fed in small chunks */
+    buf = malloc(len * 2 + 2);
+    TEST_ASSERT(buf != NULL);
+    memcpy(buf, json, len);
+    buf[len] = '\n';
+    memcpy(&buf[len + 1], json, len);
+    buf[len * 2 + 1] = '\n';
+
+    stream = ctr_decode_json_stream_create(NULL);
+    TEST_ASSERT(stream != NULL);
+
+    count = 0;
+    for (chunk = 0; chunk < len * 2 + 2; chunk += 7) {
+        offset = 0;
+        while (1) {
+            result = ctr_decode_json_stream_next(stream, &decoded, &buf[chunk],
+                                                 (len * 2 + 2 - chunk) < 7 ?
+                                                 (len * 2 + 2 - chunk) : 7, &offset);
+            if (result != CTR_DECODE_JSON_SUCCESS) {
+                break;
+            }
+
+            json_again = ctr_encode_json_create(decoded);
+            TEST_ASSERT(json_again != NULL);
+            TEST_CHECK(strcmp(json, json_again) == 0);
+            ctr_encode_json_destroy(json_again);
+            ctr_decode_json_destroy(decoded);
+            count++;
+        }
+        TEST_CHECK(result == CTR_DECODE_JSON_INSUFFICIENT_DATA);
+    }
+    TEST_CHECK(count == 2);
+    ctr_decode_json_stream_destroy(stream);
+
+    /* truncated and corrupted input */
+    offset = 0;
+    result = ctr_decode_json_create(&decoded, json, len - 1, &offset);
+    TEST_CHECK(result == CTR_DECODE_JSON_INSUFFICIENT_DATA);
+
+    memcpy(buf, json, len);
+    buf[len / 2] = '\x01';
+    offset = 0;
+    result = ctr_decode_json_create(&decoded, buf, len, &offset);
+    TEST_CHECK(result == CTR_DECODE_JSON_CORRUPTED_DATA);
+
+    /* OTLP/JSON written by other producers */
+    strcpy(buf, "{\"resource_spans\": [{\"scopeSpans\": [{\"spans\": [{"
+                "\"traceId\": \"0123456789ABCDEF0123456789abcdef\", "
+                "\"name\": \"caf\\u00e9 \\ud83d\\ude00\", "
+                "\"kind\": \"SPAN_KIND_CLIENT\", \"startTimeUnixNano\": 5, "
+                "\"status\": {\"code\": \"STATUS_CODE_OK\"}, "
+                "\"unknown\": {\"a\": [1, true, null]}}]}]}]}");
+    offset = 0;
+    result = ctr_decode_json_create(&decoded, buf, strlen(buf), &offset);
+    TEST_ASSERT(result == CTR_DECODE_JSON_SUCCESS);
+
+    resource_span = cfl_list_entry_first(&decoded->resource_spans,
+                                         struct ctrace_resource_span, _head);
+    scope_span = cfl_list_entry_first(&resource_span->scope_spans,
+                                      struct ctrace_scope_span, _head);
+    span = cfl_list_entry_first(&scope_span->spans, struct ctrace_span, _head);
+    TEST_CHECK(strcmp(span->name, "caf\xc3\xa9 \xf0\x9f\x98\x80") == 0);
+    TEST_CHECK(span->kind == CTRACE_SPAN_CLIENT);
+    TEST_CHECK(span->start_time_unix_nano == 5);
+    TEST_CHECK(span->end_time_unix_nano == 0);
+    TEST_CHECK(span->status.code == CTRACE_SPAN_STATUS_CODE_OK);
+    TEST_CHECK(span->trace_id != NULL &&
+               memcmp(ctr_id_get_buf(span->trace_id),
+                      "\x01\x23\x45\x67\x89\xab\xcd\xef\x01\x23\x45\x67\x89\xab\xcd\xef",
+                      16) == 0);
+    ctr_decode_json_destroy(decoded);
+
+    /* invalid hex digits in escapes and IDs */
+    strcpy(buf, "{\"name\": \"caf\\u00g9\"}");
+    offset = 0;
+    result = ctr_decode_json_create(&decoded, buf, strlen(buf), &offset);
+    TEST_CHECK(result == CTR_DECODE_JSON_CORRUPTED_DATA);
+
+    strcpy(buf, "{\"resourceSpans\": [{\"scopeSpans\": [{\"spans\": [{"
+                "\"spanId\": \"0123456789abcdeg\"}]}]}]}");
+    offset = 0;
+    result = ctr_decode_json_create(&decoded, buf, strlen(buf), &offset);
+    TEST_CHECK(result == CTR_DECODE_JSON_INVALID_PAYLOAD);
+
+    /* empty keys and strings as the first tokens of a decoder */
+    strcpy(buf, "{\"\": 1}");
+    offset = 0;
+    result = ctr_decode_json_create(&decoded, buf, strlen(buf), &offset);
+    TEST_ASSERT(result == CTR_DECODE_JSON_SUCCESS);
+    TEST_CHECK(cfl_list_is_empty(&decoded->resource_spans));
+    ctr_decode_json_destroy(decoded);
+
+    strcpy(buf, "{\"\": \"\"}\n"
+                "{\"resourceSpans\": [{\"scopeSpans\": [{\"spans\": [{\"name\": \"\"}]}]}]}\n");
+    stream = ctr_decode_json_stream_create(NULL);
+    TEST_ASSERT(stream != NULL);
+    offset = 0;
+    result = ctr_decode_json_stream_next(stream, &decoded, buf, strlen(buf), &offset);
+    TEST_ASSERT(result == CTR_DECODE_JSON_SUCCESS);
+    ctr_decode_json_destroy(decoded);
+
+    result = ctr_decode_json_stream_next(stream, &decoded, buf, strlen(buf), &offset);
+    TEST_ASSERT(result == CTR_DECODE_JSON_SUCCESS);
+    TEST_CHECK(cfl_list_size(&decoded->span_list) == 1);
+    span = cfl_list_entry_first(&decoded->span_list, struct ctrace_span, _head_global);
+    TEST_CHECK(span->name != NULL && cfl_sds_len(span->name) == 0);
+    ctr_decode_json_destroy(decoded);
+    ctr_decode_json_stream_destroy(stream);
+
+    free(buf);
+    ctr_encode_json_destroy(json);
+    ctr_destroy(context);
+}
 
 TEST_LIST = {
     {"cmt_simple_to_msgpack_and_back", test_simple_to_msgpack_and_back},
     {"cmt_msgpack",                    test_msgpack_to_cmt},
+    {"msgpack_arena",                  test_msgpack_to_ctr_arena},
+    {"msgpack_to_buffer",              test_msgpack_to_buffer},
+    {"msgpack_stream",                 test_msgpack_stream},
     {"empty_spans",                    test_msgpack_to_ctr_with_empty_spans},
+    {"opentelemetry_direct",           test_opentelemetry_direct_encoder},
+    {"opentelemetry_direct_variant",   test_opentelemetry_direct_unsupported_variant},
+    {"opentelemetry_direct_decoder",   test_opentelemetry_direct_decoder},
+    {"opentelemetry_direct_end_time",  test_opentelemetry_direct_absent_end_time},
+    {"opentelemetry_decoder_scratch",  test_opentelemetry_decoder_scratch},
+    {"opentelemetry_split",            test_opentelemetry_split},
+    {"opentelemetry_stream",           test_opentelemetry_stream},
+    {"opentelemetry_parallel",         test_opentelemetry_parallel},
+    {"json_encoder",                   test_json_encoder},
+    {"json_decoder",                   test_json_decoder},
     { 0 }
 };
@@ -26,6 +26,12 @@
 
 #include "ctr_tests.h"
 
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
 void test_span()
 {
     int ret;
@@ -68,6 +74,19 @@ void test_span()
     ret = ctr_id_cmp(span_child->parent_span_id, span_root->span_id);
     TEST_CHECK(ret == 0);
 
+    /* IDs are stored inline in the span */
+    TEST_CHECK(span_root->span_id == &span_root->span_id_data);
+    TEST_CHECK(span_root->trace_id == NULL);
+
+    /* IDs longer than the inline storage */
+    id = ctr_id_create_random(CTR_ID_INLINE_SIZE * 2);
+    TEST_CHECK(id != NULL);
+    ret = ctr_span_set_trace_id_with_cid(span_child, id);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(ctr_id_get_len(span_child->trace_id) == CTR_ID_INLINE_SIZE * 2);
+    TEST_CHECK(ctr_id_cmp(span_child->trace_id, id) == 0);
+    ctr_id_destroy(id);
+
     /* add attributes to span_child */
     ctr_span_set_attribute_string(span_child, "agent", "fluent bit");
     ctr_span_set_attribute_bool(span_child, "bool_t", 1);
@@ -86,7 +105,1372 @@ void test_span()
     ctr_destroy(ctx);
 }
 
+void test_span_arena()
+{
+    int ret;
+    struct ctrace *ctx;
+    struct ctrace_opts opts;
+    struct ctrace_span *span_root;
+    struct ctrace_span *span_child;
+    struct ctrace_span_event *event;
+    struct ctrace_link *link;
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_scope_span *scope_span;
+    struct ctrace_id *id;
+    cfl_sds_t text;
+
+    ctr_opts_init(&opts);
+    ctr_opts_set(&opts, CTR_OPTS_ARENA, "on");
+
+    /* use a tiny chunk size so the test crosses chunk boundaries */
+    ctr_opts_set(&opts, CTR_OPTS_ARENA_CHUNK_SIZE, "256");
+
+    ctx = ctr_create(&opts);
+    TEST_CHECK(ctx != NULL);
+    TEST_CHECK(ctx->arena != NULL);
+
+    resource_span = ctr_resource_span_create(ctx);
+    scope_span = ctr_scope_span_create(resource_span);
+
+    span_root = ctr_span_create(ctx, scope_span, "main", NULL);
+    TEST_CHECK(span_root != NULL);
+
+    id = ctr_id_create_random(CTR_ID_OTEL_SPAN_SIZE);
+    TEST_CHECK(id != NULL);
+    ctr_span_set_span_id_with_cid(span_root, id);
+    ctr_id_destroy(id);
+
+    /* ids created for the span must come from the arena */
+    TEST_CHECK(span_root->span_id->arena == ctx->arena);
+
+    span_child = ctr_span_create(ctx, scope_span, "do-work", span_root);
+    TEST_CHECK(span_child != NULL);
+
+    ret = ctr_id_cmp(span_child->parent_span_id, span_root->span_id);
+    TEST_CHECK(ret == 0);
+
+    /* overwrite arena backed fields */
+    ctr_span_set_status(span_child, CTRACE_SPAN_STATUS_CODE_OK, "first");
+    ctr_span_set_status(span_child, CTRACE_SPAN_STATUS_CODE_ERROR, "second");
+    ctr_span_set_trace_state(span_child, "a=1", 3);
+    ctr_span_set_trace_state(span_child, "b=2", 3);
+    ctr_span_set_schema_url(span_child, "https://ctraces/schema");
+    TEST_CHECK(strcmp(span_child->status.message, "second") == 0);
+    TEST_CHECK(cfl_sds_len(span_child->trace_state) == 3);
+
+    ctr_span_set_attribute_string(span_child, "agent", "fluent bit");
+    ctr_span_set_attribute_int64(span_child, "integer", 123456789);
+
+    event = ctr_span_event_add_ts(span_child, "an event with a rather long name", 1);
+    TEST_CHECK(event != NULL);
+    ctr_span_event_set_attribute_bool(event, "bool", 1);
+
+    link = ctr_link_create(span_child, "0123456789abcdef", 16, "01234567", 8);
+    TEST_CHECK(link != NULL);
+    ctr_link_set_trace_state(link, "c=3");
+
+    /* deleting objects individually must be safe too */
+    ctr_span_event_delete(event);
+    ctr_span_destroy(span_root);
+
+    text = ctr_encode_text_create(ctx);
+    TEST_CHECK(text != NULL);
+    ctr_encode_text_destroy(text);
+
+    ctr_destroy(ctx);
+    ctr_opts_exit(&opts);
+}
+
+void test_span_generate_ids()
+{
+    int ret;
+    struct ctrace *ctx;
+    struct ctrace_span *span_root;
+    struct ctrace_span *span_child;
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_scope_span *scope_span;
+    struct ctrace_id *id1;
+    struct ctrace_id *id2;
+
+    ctx = ctr_create(NULL);
+    TEST_ASSERT(ctx != NULL);
+
+    resource_span = ctr_resource_span_create(ctx);
+    scope_span = ctr_scope_span_create(resource_span);
+
+    span_root = ctr_span_create(ctx, scope_span, "main", NULL);
+    ret = ctr_id_generate_trace_span(span_root);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(ctr_id_get_len(span_root->trace_id) == CTR_ID_OTEL_TRACE_SIZE);
+    TEST_CHECK(ctr_id_get_len(span_root->span_id) == CTR_ID_OTEL_SPAN_SIZE);
+    TEST_CHECK(span_root->trace_id == &span_root->trace_id_data);
+    TEST_CHECK(span_root->span_id == &span_root->span_id_data);
+
+    /* a child keeps the trace id it was given */
+    span_child = ctr_span_create(ctx, scope_span, "child", span_root);
+    ctr_span_set_trace_id_with_cid(span_child, span_root->trace_id);
+    ret = ctr_id_generate_trace_span(span_child);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(ctr_id_cmp(span_child->trace_id, span_root->trace_id) == 0);
+    TEST_CHECK(ctr_id_cmp(span_child->span_id, span_root->span_id) != 0);
+    TEST_CHECK(ctr_id_cmp(span_child->parent_span_id, span_root->span_id) == 0);
+
+    /* consecutive random ids must differ */
+    id1 = ctr_id_create_random(CTR_ID_OTEL_TRACE_SIZE);
+    id2 = ctr_id_create_random(CTR_ID_OTEL_TRACE_SIZE);
+    TEST_CHECK(id1 != NULL && id2 != NULL);
+    TEST_CHECK(ctr_id_cmp(id1, id2) != 0);
+    ctr_id_destroy(id1);
+    ctr_id_destroy(id2);
+
+    /* long ids do not fit inline */
+    id1 = ctr_id_create_random(CTR_ID_INLINE_SIZE + 3);
+    TEST_CHECK(id1 != NULL);
+    TEST_CHECK(ctr_id_get_len(id1) == CTR_ID_INLINE_SIZE + 3);
+    ctr_id_destroy(id1);
+
+#ifndef _WIN32
+    /* a forked child must not repeat the ids of its parent */
+    {
+        int fds[2];
+        pid_t pid;
+        char buf[CTR_ID_OTEL_TRACE_SIZE];
+
+        TEST_ASSERT(pipe(fds) == 0);
+        pid = fork();
+        TEST_ASSERT(pid >= 0);
+        if (pid == 0) {
+            id1 = ctr_id_create_random(CTR_ID_OTEL_TRACE_SIZE);
+            ret = write(fds[1], ctr_id_get_buf(id1), CTR_ID_OTEL_TRACE_SIZE);
+            _exit(ret == CTR_ID_OTEL_TRACE_SIZE ? 0 : 1);
+        }
+        close(fds[1]);
+
+        id1 = ctr_id_create_random(CTR_ID_OTEL_TRACE_SIZE);
+        TEST_CHECK(read(fds[0], buf, sizeof(buf)) == sizeof(buf));
+        close(fds[0]);
+        waitpid(pid, &ret, 0);
+        TEST_CHECK(WIFEXITED(ret) && WEXITSTATUS(ret) == 0);
+        TEST_CHECK(memcmp(ctr_id_get_buf(id1), buf, sizeof(buf)) != 0);
+        ctr_id_destroy(id1);
+    }
+#endif
+
+    ctr_destroy(ctx);
+}
+
+#define STAGE_WORKERS            4
+#define STAGE_SPANS_PER_WORKER   500
+
+struct stage_worker {
+    struct ctr_stage *stage;
+    struct ctrace_scope_span *scope_span;
+};
+
+static void *stage_worker_run(void *data)
+{
+    int i;
+    struct ctrace_span *span;
+    struct ctrace_link *link;
+    struct stage_worker *worker = data;
+
+    for (i = 0; i < STAGE_SPANS_PER_WORKER; i++) {
+        span = ctr_stage_span_create(worker->stage, worker->scope_span, "work", NULL);
+        if (!span) {
+            return NULL;
+        }
+
+        /* a 32 bytes trace id does not fit inline and uses the stage arena */
+        ctr_span_set_trace_id(span, "0123456789abcdef0123456789abcdef", 32);
+        ctr_span_set_attribute_int64(span, "index", i);
+        ctr_span_event_add_ts(span, "event", i);
+
+        link = ctr_link_create(span, "0123456789abcdef", 16, "01234567", 8);
+        ctr_link_set_trace_state(link, "a=1");
+
+        ctr_span_end(NULL, span);
+
+        if (i % 100 == 99) {
+            ctr_stage_flush(worker->stage);
+        }
+    }
+
+    return NULL;
+}
+
+static void span_stage(int arena)
+{
+    int i;
+    int ret;
+    int count;
+    struct cfl_list *head;
+    struct ctrace *ctx;
+    struct ctrace_opts opts;
+    struct ctrace_span *span;
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_scope_span *scope_span;
+    struct stage_worker workers[STAGE_WORKERS];
+#ifndef _WIN32
+    pthread_t threads[STAGE_WORKERS];
+#endif
+    cfl_sds_t text;
+
+    ctr_opts_init(&opts);
+    if (arena) {
+        ctr_opts_set(&opts, CTR_OPTS_ARENA, "on");
+        ctr_opts_set(&opts, CTR_OPTS_ARENA_CHUNK_SIZE, "1024");
+    }
+
+    ctx = ctr_create(&opts);
+    TEST_ASSERT(ctx != NULL);
+
+    resource_span = ctr_resource_span_create(ctx);
+    scope_span = ctr_scope_span_create(resource_span);
+
+    for (i = 0; i < STAGE_WORKERS; i++) {
+        workers[i].stage = ctr_stage_create(ctx);
+        TEST_ASSERT(workers[i].stage != NULL);
+        workers[i].scope_span = scope_span;
+    }
+
+#ifndef _WIN32
+    for (i = 0; i < STAGE_WORKERS; i++) {
+        ret = pthread_create(&threads[i], NULL, stage_worker_run, &workers[i]);
+        TEST_ASSERT(ret == 0);
+    }
+    for (i = 0; i < STAGE_WORKERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+#else
+    for (i = 0; i < STAGE_WORKERS; i++) {
+        stage_worker_run(&workers[i]);
+    }
+#endif
+
+    /* nothing is visible before collecting */
+    TEST_CHECK(cfl_list_is_empty(&scope_span->spans));
+
+    count = ctr_stage_collect(ctx);
+    TEST_CHECK(count == STAGE_WORKERS * STAGE_SPANS_PER_WORKER);
+
+    count = 0;
+    cfl_list_foreach(head, &ctx->span_list) {
+        span = cfl_list_entry(head, struct ctrace_span, _head_global);
+        TEST_CHECK(span->ctx == ctx);
+        TEST_CHECK(span->scope_span == scope_span);
+        count++;
+    }
+    TEST_CHECK(count == STAGE_WORKERS * STAGE_SPANS_PER_WORKER);
+    TEST_CHECK(cfl_list_size(&scope_span->spans) == count);
+
+    /* spans collected from a stage behave like any other span */
+    span = cfl_list_entry_first(&scope_span->spans, struct ctrace_span, _head);
+    ctr_span_set_trace_id(span, "fedcba9876543210fedcba9876543210", 32);
+    ctr_span_destroy(span);
+
+    text = ctr_encode_text_create(ctx);
+    TEST_CHECK(text != NULL);
+    ctr_encode_text_destroy(text);
+
+    /* unflushed spans are dropped with the stage, flushed ones with the context */
+    span = ctr_stage_span_create(workers[0].stage, scope_span, "dropped", NULL);
+    TEST_CHECK(span != NULL);
+    span = ctr_stage_span_create(workers[1].stage, scope_span, "pending", NULL);
+    TEST_CHECK(ctr_stage_flush(workers[1].stage) == 1);
+
+    for (i = 0; i < STAGE_WORKERS; i++) {
+        ctr_stage_destroy(workers[i].stage);
+    }
+
+    ctr_destroy(ctx);
+    ctr_opts_exit(&opts);
+}
+
+void test_span_stage()
+{
+    span_stage(CTR_FALSE);
+    span_stage(CTR_TRUE);
+}
+
+void test_span_propagation()
+{
+    int i;
+    int ret;
+    int count;
+    char buf[CTR_TRACEPARENT_SIZE + 1];
+    char list[33 * 4];
+    const char *key;
+    const char *value;
+    size_t key_len;
+    size_t value_len;
+    struct ctrace *ctx;
+    struct ctrace_span *span;
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_scope_span *scope_span;
+    struct ctr_traceparent tp;
+    struct ctr_traceparent tp2;
+    struct ctr_tracestate_iter it;
+    const char *header = "00-0af7651916cd43dd8448eb211c80319c-b7ad6b7169203331-01";
+    const char *invalid[] = {
+        "00-0AF7651916CD43DD8448EB211C80319C-b7ad6b7169203331-01",
+        "00-00000000000000000000000000000000-b7ad6b7169203331-01",
+        "00-0af7651916cd43dd8448eb211c80319c-0000000000000000-01",
+        "00_0af7651916cd43dd8448eb211c80319c-b7ad6b7169203331-01",
+        "ff-0af7651916cd43dd8448eb211c80319c-b7ad6b7169203331-01",
+        "00-0af7651916cd43dd8448eb211c80319c-b7ad6b7169203331-01-",
+        "01-0af7651916cd43dd8448eb211c80319c-b7ad6b7169203331-01x",
+        "00-0af7651916cd43dd8448eb211c80319c-b7ad6b7169203331-0",
+        NULL
+    };
+
+    ret = ctr_propagation_extract(&tp, header, strlen(header));
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(tp.version == 0);
+    TEST_CHECK(tp.flags == CTR_TRACEPARENT_SAMPLED);
+    TEST_CHECK(tp.trace_id[0] == 0x0a && tp.trace_id[15] == 0x9c);
+    TEST_CHECK(tp.span_id[0] == 0xb7 && tp.span_id[7] == 0x31);
+
+    for (i = 0; invalid[i]; i++) {
+        ret = ctr_propagation_extract(&tp2, invalid[i], strlen(invalid[i]));
+        TEST_CHECK_(ret == -1, "traceparent '%s'", invalid[i]);
+    }
+
+    /* future versions may carry extra fields */
+    ret = ctr_propagation_extract(&tp2,
+                                  "cc-0af7651916cd43dd8448eb211c80319c-b7ad6b7169203331-01-what",
+                                  59);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(tp2.version == 0xcc);
+
+    ret = ctr_propagation_inject(&tp, buf, sizeof(buf) - 1);
+    TEST_CHECK(ret == -1);
+    ret = ctr_propagation_inject(&tp, buf, sizeof(buf));
+    TEST_CHECK(ret == CTR_TRACEPARENT_SIZE);
+    TEST_CHECK(strcmp(buf, header) == 0);
+
+    /* span round trip */
+    ctx = ctr_create(NULL);
+    TEST_ASSERT(ctx != NULL);
+
+    resource_span = ctr_resource_span_create(ctx);
+    scope_span = ctr_scope_span_create(resource_span);
+    span = ctr_span_create(ctx, scope_span, "server", NULL);
+
+    ret = ctr_propagation_to_span(&tp, span);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(span->flags == CTR_TRACEPARENT_SAMPLED);
+    TEST_CHECK(memcmp(ctr_id_get_buf(span->parent_span_id), tp.span_id, 8) == 0);
+
+    ctr_id_generate_trace_span(span);
+    ret = ctr_propagation_from_span(&tp2, span);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(memcmp(tp2.trace_id, tp.trace_id, sizeof(tp.trace_id)) == 0);
+    TEST_CHECK(memcmp(tp2.span_id, tp.span_id, sizeof(tp.span_id)) != 0);
+    TEST_CHECK(tp2.flags == CTR_TRACEPARENT_SAMPLED);
+
+    ctr_destroy(ctx);
+
+    /* tracestate */
+    header = " rojo=00f067aa0ba902b7 ,, congo=t61rcWkgMzE,tenant1@vendor=a b\t";
+    ctr_tracestate_iter_init(&it, header, strlen(header));
+
+    ret = ctr_tracestate_next(&it, &key, &key_len, &value, &value_len);
+    TEST_CHECK(ret == 1);
+    TEST_CHECK(key_len == 4 && strncmp(key, "rojo", 4) == 0);
+    TEST_CHECK(value_len == 16 && strncmp(value, "00f067aa0ba902b7", 16) == 0);
+
+    ret = ctr_tracestate_next(&it, &key, &key_len, &value, &value_len);
+    TEST_CHECK(ret == 1);
+    TEST_CHECK(key_len == 5 && strncmp(key, "congo", 5) == 0);
+
+    ret = ctr_tracestate_next(&it, &key, &key_len, &value, &value_len);
+    TEST_CHECK(ret == 1);
+    TEST_CHECK(key_len == 14 && strncmp(key, "tenant1@vendor", 14) == 0);
+    TEST_CHECK(value_len == 3 && strncmp(value, "a b", 3) == 0);
+
+    ret = ctr_tracestate_next(&it, &key, &key_len, &value, &value_len);
+    TEST_CHECK(ret == 0);
+
+    ret = ctr_tracestate_get(header, strlen(header), "congo", &value, &value_len);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(value_len == 11 && strncmp(value, "t61rcWkgMzE", 11) == 0);
+
+    ret = ctr_tracestate_get(header, strlen(header), "con", &value, &value_len);
+    TEST_CHECK(ret == -1);
+
+    /* invalid keys and values */
+    ret = ctr_tracestate_get("Rojo=1", 6, "Rojo", &value, &value_len);
+    TEST_CHECK(ret == -1);
+    ret = ctr_tracestate_get("rojo=", 5, "rojo", &value, &value_len);
+    TEST_CHECK(ret == -1);
+    ret = ctr_tracestate_get("a@b@c=1", 7, "a@b@c", &value, &value_len);
+    TEST_CHECK(ret == -1);
+
+    /* member limit */
+    for (i = 0; i < 33; i++) {
+        list[i * 4] = 'a' + (i % 26);
+        list[i * 4 + 1] = '=';
+        list[i * 4 + 2] = '1';
+        list[i * 4 + 3] = ',';
+    }
+
+    count = 0;
+    ctr_tracestate_iter_init(&it, list, sizeof(list));
+    while ((ret = ctr_tracestate_next(&it, &key, &key_len, &value, &value_len)) == 1) {
+        count++;
+    }
+    TEST_CHECK(count == CTR_TRACESTATE_MAX_MEMBERS);
+    TEST_CHECK(ret == -1);
+}
+
+/* one resource span with a 'service.name' resource and a single scope */
+static struct ctrace *merge_context(struct ctrace_opts *opts, char *service, char *scope_name,
+                                    int spans)
+{
+    int i;
+    struct ctrace *ctx;
+    struct ctrace_span *span;
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_scope_span *scope_span;
+    struct ctrace_instrumentation_scope *scope;
+
+    ctx = ctr_create(opts);
+    if (!ctx) {
+        return NULL;
+    }
+
+    resource_span = ctr_resource_span_create(ctx);
+    ctr_resource_span_set_schema_url(resource_span, "https://ctraces/resource_span_schema_url");
+    ctr_attributes_set_string(resource_span->resource->attr, "service.name", service);
+
+    scope_span = ctr_scope_span_create(resource_span);
+    scope = ctr_instrumentation_scope_create(scope_name, "1.0.0", 0, NULL);
+    ctr_scope_span_set_instrumentation_scope(scope_span, scope);
+
+    for (i = 0; i < spans; i++) {
+        span = ctr_span_create(ctx, scope_span, "span", NULL);
+        ctr_span_set_span_id(span, "SPAN_001", 8);
+        ctr_span_event_add(span, "event");
+        ctr_link_create(span, "CTR_TRACE_800000", 16, "SPAN_801", 8);
+    }
+
+    return ctx;
+}
+
+static void span_merge(int arena)
+{
+    int i;
+    int n;
+    int ret;
+    char service[32];
+    struct ctrace *dst;
+    struct ctrace *src;
+    struct ctrace *other;
+    struct ctrace_opts opts;
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_scope_span *scope_span;
+    struct ctrace_span *span;
+
+    ctr_opts_init(&opts);
+    if (arena) {
+        ctr_opts_set(&opts, CTR_OPTS_ARENA, "on");
+    }
+
+    dst = merge_context(&opts, "frontend", "http", 2);
+    TEST_ASSERT(dst != NULL);
+
+    /* same resource and scope: spans are appended to the existing scope span */
+    src = merge_context(&opts, "frontend", "http", 3);
+    TEST_ASSERT(src != NULL);
+    ret = ctr_merge(dst, src);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(cfl_list_size(&dst->resource_spans) == 1);
+    TEST_CHECK(cfl_list_size(&dst->span_list) == 5);
+    TEST_CHECK(cfl_list_is_empty(&src->resource_spans));
+    TEST_CHECK(cfl_list_is_empty(&src->span_list));
+
+    resource_span = cfl_list_entry_first(&dst->resource_spans, struct ctrace_resource_span, _head);
+    TEST_CHECK(cfl_list_size(&resource_span->scope_spans) == 1);
+    scope_span = cfl_list_entry_first(&resource_span->scope_spans, struct ctrace_scope_span, _head);
+    TEST_CHECK(cfl_list_size(&scope_span->spans) == 5);
+
+    /* the emptied source can still be used */
+    span = ctr_span_create(src, ctr_scope_span_create(ctr_resource_span_create(src)),
+                           "after merge", NULL);
+    TEST_CHECK(span != NULL);
+    ctr_destroy(src);
+
+    /* same resource, different scope */
+    src = merge_context(&opts, "frontend", "grpc", 1);
+    TEST_ASSERT(src != NULL);
+    ret = ctr_merge(dst, src);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(cfl_list_size(&dst->resource_spans) == 1);
+    TEST_CHECK(cfl_list_size(&resource_span->scope_spans) == 2);
+    scope_span = cfl_list_entry_last(&resource_span->scope_spans, struct ctrace_scope_span, _head);
+    TEST_CHECK(scope_span->resource_span == resource_span);
+    span = cfl_list_entry_first(&scope_span->spans, struct ctrace_span, _head);
+    TEST_CHECK(span->ctx == dst && span->scope_span == scope_span);
+    ctr_destroy(src);
+
+    /* different resource */
+    src = merge_context(&opts, "backend", "http", 2);
+    TEST_ASSERT(src != NULL);
+    ret = ctr_merge(dst, src);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(cfl_list_size(&dst->resource_spans) == 2);
+    TEST_CHECK(cfl_list_size(&dst->span_list) == 8);
+    ctr_destroy(src);
+
+    /* many resources: each one is coalesced with its own copy only */
+    for (i = 0; i < 2; i++) {
+        src = ctr_create(&opts);
+        TEST_ASSERT(src != NULL);
+        for (n = 0; n < 40; n++) {
+            snprintf(service, sizeof(service) - 1, "service-%i", n);
+            other = merge_context(&opts, service, "http", 1);
+            TEST_ASSERT(other != NULL);
+            TEST_CHECK(ctr_merge(src, other) == 0);
+            ctr_destroy(other);
+        }
+        TEST_CHECK(cfl_list_size(&src->resource_spans) == 40);
+
+        ret = ctr_merge(dst, src);
+        TEST_CHECK(ret == 0);
+        TEST_CHECK(cfl_list_size(&dst->resource_spans) == 42);
+        TEST_CHECK(cfl_list_size(&dst->span_list) == 8 + 40 * (i + 1));
+        ctr_destroy(src);
+    }
+
+    resource_span = cfl_list_entry_last(&dst->resource_spans, struct ctrace_resource_span, _head);
+    TEST_CHECK(cfl_list_size(&resource_span->scope_spans) == 1);
+    scope_span = cfl_list_entry_first(&resource_span->scope_spans, struct ctrace_scope_span, _head);
+    TEST_CHECK(cfl_list_size(&scope_span->spans) == 2);
+
+    /* contexts using different allocation modes can't be merged */
+    src = ctr_create(NULL);
+    TEST_ASSERT(src != NULL);
+    ret = ctr_merge(dst, src);
+    TEST_CHECK(ret == (arena ? -1 : 0));
+    ctr_destroy(src);
+
+    ctr_destroy(dst);
+    ctr_opts_exit(&opts);
+}
+
+void test_span_merge()
+{
+    span_merge(CTR_FALSE);
+    span_merge(CTR_TRUE);
+}
+
+void test_span_index()
+{
+    int i;
+    int ret;
+    int count;
+    uint64_t id;
+    struct ctrace *ctx;
+    struct ctrace_opts opts;
+    struct ctrace_span *span;
+    struct ctrace_span *spans[1000];
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_scope_span *scope_span;
+    struct ctr_index_trace *trace;
+    struct cfl_list *head;
+
+    ctr_opts_init(&opts);
+    ctr_opts_set(&opts, CTR_OPTS_ID_INDEX, "on");
+
+    ctx = ctr_create(&opts);
+    TEST_ASSERT(ctx != NULL);
+    TEST_ASSERT(ctx->index != NULL);
+
+    resource_span = ctr_resource_span_create(ctx);
+    scope_span = ctr_scope_span_create(resource_span);
+
+    /* 1000 spans over 100 traces, enough to grow and wrap the tables */
+    for (i = 0; i < 1000; i++) {
+        spans[i] = ctr_span_create(ctx, scope_span, "span", NULL);
+        TEST_ASSERT(spans[i] != NULL);
+
+        id = i % 100;
+        ctr_span_set_trace_id(spans[i], &id, sizeof(id));
+        id = i;
+        ctr_span_set_span_id(spans[i], &id, sizeof(id));
+    }
+    TEST_CHECK(ctr_index_trace_count(ctx) == 100);
+
+    id = 421;
+    span = ctr_index_span_lookup(ctx, &id, sizeof(id));
+    TEST_CHECK(span == spans[421]);
+
+    id = 21;
+    trace = ctr_index_trace_lookup(ctx, &id, sizeof(id));
+    TEST_ASSERT(trace != NULL);
+    TEST_CHECK(trace->span_count == 10);
+
+    count = 0;
+    cfl_list_foreach(head, &trace->spans) {
+        span = cfl_list_entry(head, struct ctrace_span, _head_trace);
+        TEST_CHECK(span == spans[count * 100 + 21]);
+        count++;
+    }
+    TEST_CHECK(count == 10);
+
+    /* moving a span to another trace */
+    id = 22;
+    ctr_span_set_trace_id(spans[21], &id, sizeof(id));
+    TEST_CHECK(trace->span_count == 9);
+    trace = ctr_index_trace_lookup(ctx, &id, sizeof(id));
+    TEST_CHECK(trace != NULL && trace->span_count == 11);
+
+    /* destroy every odd span, the even ones must still be found */
+    for (i = 1; i < 1000; i += 2) {
+        ctr_span_destroy(spans[i]);
+        spans[i] = NULL;
+    }
+
+    for (i = 0; i < 1000; i++) {
+        id = i;
+        span = ctr_index_span_lookup(ctx, &id, sizeof(id));
+        TEST_CHECK_(span == spans[i], "span %i", i);
+    }
+    TEST_CHECK(ctr_index_trace_count(ctx) == 50);
+
+    /* generated IDs are indexed as well */
+    span = ctr_span_create(ctx, scope_span, "generated", NULL);
+    ret = ctr_id_generate_trace_span(span);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(ctr_index_span_lookup(ctx, ctr_id_get_buf(span->span_id),
+                                     ctr_id_get_len(span->span_id)) == span);
+    TEST_CHECK(ctr_index_trace_count(ctx) == 51);
+
+    /* the index can be dropped and rebuilt from the span list */
+    ctr_index_disable(ctx);
+    TEST_CHECK(ctx->index == NULL);
+    TEST_CHECK(ctr_index_span_lookup(ctx, ctr_id_get_buf(span->span_id),
+                                     ctr_id_get_len(span->span_id)) == NULL);
+
+    ret = ctr_index_enable(ctx);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(ctr_index_trace_count(ctx) == 51);
+
+    id = 998;
+    TEST_CHECK(ctr_index_span_lookup(ctx, &id, sizeof(id)) == spans[998]);
+
+    ctr_destroy(ctx);
+    ctr_opts_exit(&opts);
+}
+
+static struct ctrace_span *sampler_span(struct ctrace *ctx, int trace, uint64_t start,
+                                        uint64_t duration, int code)
+{
+    char id[16];
+    struct ctrace_span *span;
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_scope_span *scope_span;
+
+    resource_span = cfl_list_entry_first(&ctx->resource_spans, struct ctrace_resource_span, _head);
+    scope_span = cfl_list_entry_first(&resource_span->scope_spans, struct ctrace_scope_span, _head);
+
+    span = ctr_span_create(ctx, scope_span, "span", NULL);
+    if (!span) {
+        return NULL;
+    }
+
+    if (trace > 0) {
+        memset(id, trace, sizeof(id));
+        ctr_span_set_trace_id(span, id, sizeof(id));
+    }
+    ctr_span_start_ts(ctx, span, start);
+    ctr_span_end_ts(ctx, span, start + duration);
+    ctr_span_set_status(span, code, NULL);
+
+    return span;
+}
+
+void test_span_tail_sampler()
+{
+    int i;
+    int ret;
+    uint64_t now;
+    struct ctrace *ctx;
+    struct ctrace *out;
+    struct ctrace_opts opts;
+    struct ctrace_span *span;
+    struct ctrace_resource_span *resource_span;
+    struct ctr_tail_sampler *ts;
+    struct ctr_tail_sampler_stats stats;
+
+    /* decide 10 seconds after the first span, keep at most 8 traces pending */
+    ts = ctr_tail_sampler_create(10000000000ULL, 8);
+    TEST_ASSERT(ts != NULL);
+
+    ctr_tail_sampler_policy_error(ts);
+    ctr_tail_sampler_policy_latency(ts, 100000000);
+    ctr_tail_sampler_policy_attribute(ts, "sampling.keep", "true");
+    ctr_tail_sampler_policy_rate_limit(ts, 1);
+
+    now = 1000000000000ULL;
+
+    ctx = merge_context(NULL, "frontend", "http", 0);
+    TEST_ASSERT(ctx != NULL);
+    sampler_span(ctx, 1, now, 1000, CTRACE_SPAN_STATUS_CODE_OK);
+    sampler_span(ctx, 1, now, 1000, CTRACE_SPAN_STATUS_CODE_ERROR);
+    sampler_span(ctx, 2, now, 500000000, CTRACE_SPAN_STATUS_CODE_OK);
+    span = sampler_span(ctx, 3, now, 1000, CTRACE_SPAN_STATUS_CODE_UNSET);
+    ctr_span_set_attribute_string(span, "sampling.keep", "true");
+    sampler_span(ctx, 4, now, 1000, CTRACE_SPAN_STATUS_CODE_UNSET);
+    sampler_span(ctx, 0, now, 1000, CTRACE_SPAN_STATUS_CODE_UNSET);
+
+    ret = ctr_tail_sampler_add(ts, ctx, now);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(cfl_list_is_empty(&ctx->span_list));
+    ctr_destroy(ctx);
+
+    /* a late span of trace 1 and two new traces */
+    ctx = merge_context(NULL, "frontend", "http", 0);
+    TEST_ASSERT(ctx != NULL);
+    sampler_span(ctx, 1, now, 1000, CTRACE_SPAN_STATUS_CODE_OK);
+    sampler_span(ctx, 5, now, 1000, CTRACE_SPAN_STATUS_CODE_OK);
+    sampler_span(ctx, 6, now, 1000, CTRACE_SPAN_STATUS_CODE_OK);
+    ret = ctr_tail_sampler_add(ts, ctx, now + 1000000000);
+    TEST_CHECK(ret == 0);
+    ctr_destroy(ctx);
+
+    ctr_tail_sampler_get_stats(ts, &stats);
+    TEST_CHECK(stats.traces_pending == 6);
+    TEST_CHECK(stats.spans_dropped == 1);
+
+    /* nothing expired yet */
+    ret = ctr_tail_sampler_flush(ts, now + 5000000000ULL, &out);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(out == NULL);
+
+    /* traces 1 to 4 expire: error, latency, attribute and rate limit */
+    ret = ctr_tail_sampler_flush(ts, now + 10500000000ULL, &out);
+    TEST_CHECK(ret == 4);
+    TEST_ASSERT(out != NULL);
+    TEST_CHECK(cfl_list_size(&out->span_list) == 6);
+    TEST_CHECK(cfl_list_size(&out->resource_spans) == 1);
+    resource_span = cfl_list_entry_first(&out->resource_spans, struct ctrace_resource_span, _head);
+    TEST_CHECK(cfl_kvlist_fetch(resource_span->resource->attr->kv, "service.name") != NULL);
+    span = cfl_list_entry_first(&out->span_list, struct ctrace_span, _head_global);
+    TEST_CHECK(span->ctx == out);
+    ctr_destroy(out);
+
+    /* traces 5 and 6 only match the rate limit, which keeps one per second */
+    ret = ctr_tail_sampler_flush(ts, now + 20000000000ULL, &out);
+    TEST_CHECK(ret == 1);
+    TEST_ASSERT(out != NULL);
+    TEST_CHECK(cfl_list_size(&out->span_list) == 1);
+    ctr_destroy(out);
+
+    ctr_tail_sampler_get_stats(ts, &stats);
+    TEST_CHECK(stats.traces_kept == 5);
+    TEST_CHECK(stats.traces_dropped == 1);
+    TEST_CHECK(stats.traces_pending == 0);
+
+    /* exceeding max_traces decides the oldest traces right away */
+    now += 30000000000ULL;
+    ctx = merge_context(NULL, "backend", "grpc", 0);
+    TEST_ASSERT(ctx != NULL);
+    for (i = 10; i < 20; i++) {
+        sampler_span(ctx, i, now, 1000, CTRACE_SPAN_STATUS_CODE_OK);
+    }
+    ret = ctr_tail_sampler_add(ts, ctx, now);
+    TEST_CHECK(ret == 0);
+    ctr_destroy(ctx);
+
+    ctr_tail_sampler_get_stats(ts, &stats);
+    TEST_CHECK(stats.traces_pending == 8);
+    TEST_CHECK(stats.traces_kept == 6);
+    TEST_CHECK(stats.traces_dropped == 2);
+
+    /* arena contexts are rejected */
+    ctr_opts_init(&opts);
+    ctr_opts_set(&opts, CTR_OPTS_ARENA, "on");
+    ctx = merge_context(&opts, "frontend", "http", 1);
+    TEST_ASSERT(ctx != NULL);
+    ret = ctr_tail_sampler_add(ts, ctx, now);
+    TEST_CHECK(ret == -1);
+    ctr_destroy(ctx);
+    ctr_opts_exit(&opts);
+
+    /* pending traces and decided ones not flushed are released */
+    ctr_tail_sampler_destroy(ts);
+}
+
+void test_span_head_sampler()
+{
+    int i;
+    int ret;
+    int kept;
+    char *ts;
+    unsigned char id[16];
+    struct ctrace *ctx;
+    struct ctrace_span *span;
+    struct ctrace_span *child;
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_scope_span *scope_span;
+    struct ctr_sampler *sampler;
+    struct ctr_stage *stage;
+    struct ctr_traceparent tp;
+
+    /* thresholds, 56 bits encoded without trailing zeros */
+    sampler = ctr_sampler_create(1.0);
+    TEST_ASSERT(sampler != NULL);
+    TEST_CHECK(sampler->threshold == 0);
+    TEST_CHECK(strcmp(sampler->tracestate, "ot=th:0") == 0);
+    ctr_sampler_destroy(sampler);
+
+    sampler = ctr_sampler_create(0.25);
+    TEST_ASSERT(sampler != NULL);
+    TEST_CHECK(strcmp(sampler->tracestate, "ot=th:c") == 0);
+    ctr_sampler_destroy(sampler);
+
+    sampler = ctr_sampler_create(0.5);
+    TEST_ASSERT(sampler != NULL);
+    TEST_CHECK(sampler->threshold == 1ULL << 55);
+    TEST_CHECK(strcmp(sampler->tracestate, "ot=th:8") == 0);
+
+    /* decisions come from the last 7 bytes of the trace ID */
+    memset(id, 0xff, sizeof(id));
+    id[9] = 0x80;
+    memset(id + 10, 0, 6);
+    TEST_CHECK(ctr_sampler_sample(sampler, id, sizeof(id), NULL, 0) == CTR_TRUE);
+    id[9] = 0x7f;
+    memset(id + 10, 0xff, 6);
+    TEST_CHECK(ctr_sampler_sample(sampler, id, sizeof(id), NULL, 0) == CTR_FALSE);
+
+    /* explicit randomness in the tracestate wins over the trace ID */
+    ts = "congo=t61rcWkgMzE,ot=th:8;rv:ffffffffffffff";
+    TEST_CHECK(ctr_sampler_sample(sampler, id, sizeof(id), ts, strlen(ts)) == CTR_TRUE);
+    ts = "ot=rv:00000000000001";
+    memset(id, 0xff, sizeof(id));
+    TEST_CHECK(ctr_sampler_sample(sampler, id, sizeof(id), ts, strlen(ts)) == CTR_FALSE);
+
+    /* about half of the generated traces are kept */
+    ctx = ctr_create(NULL);
+    TEST_ASSERT(ctx != NULL);
+    ret = ctr_sampler_attach(ctx, sampler);
+    TEST_CHECK(ret == 0);
+    resource_span = ctr_resource_span_create(ctx);
+    scope_span = ctr_scope_span_create(resource_span);
+
+    kept = 0;
+    for (i = 0; i < 1000; i++) {
+        span = ctr_span_create(ctx, scope_span, "root", NULL);
+        TEST_ASSERT(span != NULL);
+        if (ctr_span_is_recording(span)) {
+            kept++;
+        }
+    }
+    TEST_CHECK(kept > 400 && kept < 600);
+    TEST_CHECK(cfl_list_size(&ctx->span_list) == kept);
+    TEST_CHECK(cfl_list_size(&scope_span->spans) == kept);
+    ctr_destroy(ctx);
+    ctr_sampler_destroy(sampler);
+
+    /* sampled spans: children inherit the trace ID and tracestate */
+    sampler = ctr_sampler_create(1.0);
+    TEST_ASSERT(sampler != NULL);
+    ctx = ctr_create(NULL);
+    TEST_ASSERT(ctx != NULL);
+    ctr_sampler_attach(ctx, sampler);
+    resource_span = ctr_resource_span_create(ctx);
+    scope_span = ctr_scope_span_create(resource_span);
+
+    span = ctr_span_create(ctx, scope_span, "root", NULL);
+    TEST_ASSERT(span != NULL);
+    TEST_CHECK(ctr_span_is_recording(span));
+    TEST_ASSERT(span->trace_id != NULL);
+    TEST_CHECK(ctr_id_get_len(span->trace_id) == 16);
+    TEST_CHECK(span->flags & CTR_TRACEPARENT_SAMPLED);
+    TEST_CHECK(strcmp(span->trace_state, "ot=th:0") == 0);
+
+    ctr_id_generate_trace_span(span);
+    child = ctr_span_create(ctx, scope_span, "child", span);
+    TEST_ASSERT(child != NULL);
+    TEST_CHECK(ctr_span_is_recording(child));
+    TEST_CHECK(ctr_id_cmp(child->trace_id, span->trace_id) == 0);
+    TEST_CHECK(ctr_id_cmp(child->parent_span_id, span->span_id) == 0);
+    TEST_CHECK(strcmp(child->trace_state, "ot=th:0") == 0);
+    ctr_destroy(ctx);
+    ctr_sampler_destroy(sampler);
+
+    /* unsampled traces only hand out the no-op span */
+    sampler = ctr_sampler_create(0.0);
+    TEST_ASSERT(sampler != NULL);
+    ctx = ctr_create(NULL);
+    TEST_ASSERT(ctx != NULL);
+    ctr_sampler_attach(ctx, sampler);
+    resource_span = ctr_resource_span_create(ctx);
+    scope_span = ctr_scope_span_create(resource_span);
+
+    span = ctr_span_create(ctx, scope_span, "root", NULL);
+    TEST_ASSERT(span != NULL);
+    TEST_CHECK(!ctr_span_is_recording(span));
+    TEST_CHECK(ctr_span_set_attribute_string(span, "key", "value") == 0);
+    TEST_CHECK(ctr_span_set_attribute_array(span, "array", cfl_array_create(1)) == 0);
+    TEST_CHECK(ctr_span_set_status(span, CTRACE_SPAN_STATUS_CODE_ERROR, "error") == 0);
+    TEST_CHECK(ctr_id_generate_trace_span(span) == 0);
+    TEST_CHECK(span->trace_id == NULL && span->attr == NULL);
+    TEST_CHECK(ctr_span_event_add(span, "event") == NULL);
+    TEST_CHECK(ctr_link_create(span, "CTR_TRACE_800000", 16, "SPAN_801", 8) == NULL);
+    ctr_span_end(ctx, span);
+
+    child = ctr_span_create(ctx, scope_span, "child", span);
+    TEST_CHECK(child == span);
+    ctr_span_destroy(child);
+
+    TEST_CHECK(cfl_list_is_empty(&ctx->span_list));
+    TEST_CHECK(cfl_list_is_empty(&scope_span->spans));
+
+    /* children of a remote parent follow its sampled flag */
+    memset(&tp, 0, sizeof(tp));
+    memcpy(tp.trace_id, "CTR_TRACE_000001", 16);
+    memcpy(tp.span_id, "SPAN_001", 8);
+    span = ctr_span_create_with_traceparent(ctx, scope_span, "remote", &tp);
+    TEST_CHECK(span == ctx->noop_span);
+
+    tp.flags = CTR_TRACEPARENT_SAMPLED;
+    span = ctr_span_create_with_traceparent(ctx, scope_span, "remote", &tp);
+    TEST_ASSERT(span != NULL);
+    TEST_CHECK(ctr_span_is_recording(span));
+    TEST_CHECK(span->flags & CTR_TRACEPARENT_SAMPLED);
+    TEST_ASSERT(span->trace_id != NULL && span->parent_span_id != NULL);
+    TEST_CHECK(memcmp(ctr_id_get_buf(span->trace_id), tp.trace_id, 16) == 0);
+    TEST_CHECK(memcmp(ctr_id_get_buf(span->parent_span_id), tp.span_id, 8) == 0);
+    TEST_CHECK(span->trace_state == NULL);
+    TEST_CHECK(cfl_list_size(&scope_span->spans) == 1);
+    ctr_span_destroy(span);
+
+    /* staged spans follow the sampler of the shared context */
+    stage = ctr_stage_create(ctx);
+    TEST_ASSERT(stage != NULL);
+    span = ctr_stage_span_create(stage, scope_span, "staged", NULL);
+    TEST_CHECK(span == ctx->noop_span);
+    TEST_CHECK(ctr_stage_flush(stage) == 0);
+    ctr_stage_destroy(stage);
+
+    /* detached, spans are recorded again */
+    ctr_sampler_attach(ctx, NULL);
+    span = ctr_span_create(ctx, scope_span, "root", NULL);
+    TEST_ASSERT(span != NULL);
+    TEST_CHECK(ctr_span_is_recording(span));
+    TEST_CHECK(span->trace_id == NULL);
+
+    ctr_destroy(ctx);
+    ctr_sampler_destroy(sampler);
+}
+
+/* every setter must leave the shared no-op span untouched */
+void test_span_noop_setters()
+{
+    struct ctrace *ctx;
+    struct ctrace_span *span;
+    struct ctrace_span snapshot;
+    struct ctrace_span_event *event;
+    struct ctrace_link *link;
+    struct ctrace_id *cid;
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_scope_span *scope_span;
+    struct ctr_sampler *sampler;
+
+    sampler = ctr_sampler_create(0.0);
+    TEST_ASSERT(sampler != NULL);
+    ctx = ctr_create(NULL);
+    TEST_ASSERT(ctx != NULL);
+    ctr_sampler_attach(ctx, sampler);
+    resource_span = ctr_resource_span_create(ctx);
+    scope_span = ctr_scope_span_create(resource_span);
+
+    span = ctr_span_create(ctx, scope_span, "root", NULL);
+    TEST_ASSERT(span != NULL && span == ctx->noop_span);
+    memcpy(&snapshot, span, sizeof(snapshot));
+
+    cid = ctr_id_create_random(CTR_ID_OTEL_TRACE_SIZE);
+    TEST_ASSERT(cid != NULL);
+
+    TEST_CHECK(ctr_span_set_name(span, "name", 4) == 0);
+    TEST_CHECK(ctr_span_set_status(span, CTRACE_SPAN_STATUS_CODE_OK, "ok") == 0);
+    TEST_CHECK(ctr_span_set_trace_state(span, "ot=th:0", 7) == 0);
+    TEST_CHECK(ctr_span_set_flags(span, 1) == 0);
+    TEST_CHECK(ctr_span_kind_set(span, CTRACE_SPAN_SERVER) == 0);
+    ctr_span_set_schema_url(span, "http://schema.url");
+    ctr_span_set_dropped_events_count(span, 1);
+    ctr_span_set_dropped_links_count(span, 2);
+    ctr_span_set_dropped_attributes_count(span, 3);
+
+    TEST_CHECK(ctr_span_set_trace_id(span, "CTR_TRACE_000001", 16) == 0);
+    TEST_CHECK(ctr_span_set_trace_id_with_cid(span, cid) == 0);
+    TEST_CHECK(ctr_span_set_span_id(span, "SPAN_001", 8) == 0);
+    TEST_CHECK(ctr_span_set_span_id_with_cid(span, cid) == 0);
+    TEST_CHECK(ctr_span_set_parent_span_id(span, "SPAN_000", 8) == 0);
+    TEST_CHECK(ctr_span_set_parent_span_id_with_cid(span, cid) == 0);
+    TEST_CHECK(ctr_id_generate_trace_span(span) == 0);
+
+    TEST_CHECK(ctr_span_set_attributes(span, ctr_attributes_create()) == 0);
+    TEST_CHECK(ctr_span_set_attribute_string(span, "string", "value") == 0);
+    TEST_CHECK(ctr_span_set_attribute_bool(span, "bool", CTR_TRUE) == 0);
+    TEST_CHECK(ctr_span_set_attribute_int64(span, "int64", 1) == 0);
+    TEST_CHECK(ctr_span_set_attribute_double(span, "double", 1.5) == 0);
+    TEST_CHECK(ctr_span_set_attribute_array(span, "array", cfl_array_create(1)) == 0);
+    TEST_CHECK(ctr_span_set_attribute_kvlist(span, "kvlist", cfl_kvlist_create()) == 0);
+
+    ctr_span_start(ctx, span);
+    ctr_span_start_ts(ctx, span, 1000);
+    ctr_span_end(ctx, span);
+    ctr_span_end_ts(ctx, span, 2000);
+
+    /* events and links are not created, their setters accept NULL */
+    event = ctr_span_event_add(span, "event");
+    TEST_CHECK(event == NULL);
+    event = ctr_span_event_add_ts(span, "event", 1000);
+    TEST_CHECK(event == NULL);
+    TEST_CHECK(ctr_span_event_set_name(event, "event", 5) == 0);
+    TEST_CHECK(ctr_span_event_set_attributes(event, ctr_attributes_create()) == 0);
+    TEST_CHECK(ctr_span_event_set_attribute_string(event, "string", "value") == 0);
+    TEST_CHECK(ctr_span_event_set_attribute_bool(event, "bool", CTR_TRUE) == 0);
+    TEST_CHECK(ctr_span_event_set_attribute_int64(event, "int64", 1) == 0);
+    TEST_CHECK(ctr_span_event_set_attribute_double(event, "double", 1.5) == 0);
+    TEST_CHECK(ctr_span_event_set_attribute_array(event, "array", cfl_array_create(1)) == 0);
+    TEST_CHECK(ctr_span_event_set_attribute_kvlist(event, "kvlist", cfl_kvlist_create()) == 0);
+    ctr_span_event_set_dropped_attributes_count(event, 1);
+    ctr_span_event_delete(event);
+
+    link = ctr_link_create(span, "CTR_TRACE_800000", 16, "SPAN_801", 8);
+    TEST_CHECK(link == NULL);
+    link = ctr_link_create_with_cid(span, cid, NULL);
+    TEST_CHECK(link == NULL);
+    TEST_CHECK(ctr_link_set_trace_id(link, "CTR_TRACE_800000", 16) == 0);
+    TEST_CHECK(ctr_link_set_span_id(link, "SPAN_801", 8) == 0);
+    TEST_CHECK(ctr_link_set_trace_state(link, "aaabbbccc") == 0);
+    TEST_CHECK(ctr_link_set_attributes(link, ctr_attributes_create()) == 0);
+    ctr_link_set_dropped_attr_count(link, 1);
+    ctr_link_set_flags(link, 1);
+    ctr_link_destroy(link);
+
+    TEST_CHECK(memcmp(&snapshot, span, sizeof(snapshot)) == 0);
+    TEST_CHECK(!ctr_span_is_recording(span));
+    TEST_CHECK(cfl_list_is_empty(&ctx->span_list));
+
+    ctr_id_destroy(cid);
+    ctr_destroy(ctx);
+    ctr_sampler_destroy(sampler);
+}
+
+void test_span_columns()
+{
+    int i;
+    int errors;
+    uint32_t index;
+    uint64_t id;
+    uint8_t selection[20];
+    cfl_sds_t text;
+    cfl_sds_t text_copy;
+    struct ctrace *ctx;
+    struct ctrace *copy;
+    struct ctrace_span *span;
+    struct ctrace_span_event *event;
+    struct ctrace_link *link;
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_scope_span *scope_span = NULL;
+    struct ctrace_instrumentation_scope *scope;
+    struct ctr_columns *cols;
+    struct ctr_columns_attr *attr;
+    struct cfl_variant *value;
+
+    ctx = ctr_create(NULL);
+    TEST_ASSERT(ctx != NULL);
+
+    resource_span = ctr_resource_span_create(ctx);
+    ctr_resource_span_set_schema_url(resource_span, "https://ctraces/resource_span_schema_url");
+    ctr_attributes_set_string(resource_span->resource->attr, "service.name", "frontend");
+
+    /* two scopes of the same resource */
+    for (i = 0; i < 20; i++) {
+        if (i % 10 == 0) {
+            scope_span = ctr_scope_span_create(resource_span);
+            scope = ctr_instrumentation_scope_create(i == 0 ? "http" : "grpc", "1.0.0", 0, NULL);
+            ctr_scope_span_set_instrumentation_scope(scope_span, scope);
+        }
+
+        span = ctr_span_create(ctx, scope_span, i % 2 ? "GET /" : "POST /", NULL);
+        ctr_span_set_trace_id(span, "CTR_TRACE_000001", 16);
+        id = i + 1;
+        ctr_span_set_span_id(span, &id, sizeof(id));
+        ctr_span_start_ts(ctx, span, 1000000 + i);
+        ctr_span_end_ts(ctx, span, 2000000 + i * 1000);
+        ctr_span_set_status(span, i % 5 ? CTRACE_SPAN_STATUS_CODE_OK : CTRACE_SPAN_STATUS_CODE_ERROR,
+                            i % 5 ? NULL : "failed");
+
+        ctr_span_set_attribute_string(span, "http.method", i % 2 ? "GET" : "POST");
+        ctr_span_set_attribute_int64(span, "http.status_code", 200 + i);
+        ctr_span_set_attribute_bool(span, "cached", i % 3 == 0);
+        if (i % 4 == 0) {
+            ctr_span_set_attribute_double(span, "ratio", i / 4.0);
+        }
+        ctr_span_set_attribute_array(span, "tags", cfl_array_create(1));
+
+        if (i % 3 == 0) {
+            event = ctr_span_event_add_ts(span, "retry", 1500000 + i);
+            ctr_span_event_set_attribute_int64(event, "attempt", i);
+        }
+        if (i % 7 == 0) {
+            link = ctr_link_create(span, "CTR_TRACE_800000", 16, "SPAN_801", 8);
+            ctr_link_set_trace_state(link, "ot=th:8");
+        }
+    }
+
+    cols = ctr_columns_create(ctx);
+    TEST_ASSERT(cols != NULL);
+    TEST_CHECK(cols->rows == 20);
+    TEST_CHECK(cols->scope_count == 2);
+    TEST_CHECK(cols->events.count == 7);
+    TEST_CHECK(cols->links.count == 3);
+    TEST_CHECK(cols->scope[9] == 0 && cols->scope[10] == 1);
+
+    /* names are dictionary encoded */
+    index = ctr_columns_string_lookup(cols, "GET /", 5);
+    TEST_CHECK(index != CTR_COLUMNS_NONE);
+    TEST_CHECK(cols->name[1] == index && cols->name[3] == index && cols->name[0] != index);
+    TEST_CHECK(strcmp(ctr_columns_string(cols, cols->name[0]), "POST /") == 0);
+    TEST_CHECK(ctr_columns_string_lookup(cols, "PUT /", 5) == CTR_COLUMNS_NONE);
+
+    errors = 0;
+    for (i = 0; i < 20; i++) {
+        if (cols->status_code[i] == CTRACE_SPAN_STATUS_CODE_ERROR) {
+            errors++;
+        }
+        TEST_CHECK(cols->end_time[i] - cols->start_time[i] == 1000000 + i * 999);
+    }
+    TEST_CHECK(errors == 4);
+
+    /* typed attribute columns */
+    attr = ctr_columns_attr_get(cols, "http.status_code");
+    TEST_ASSERT(attr != NULL);
+    TEST_CHECK(attr->type == CFL_VARIANT_INT && attr->i64[7] == 207 && attr->valid[7]);
+
+    attr = ctr_columns_attr_get(cols, "ratio");
+    TEST_ASSERT(attr != NULL);
+    TEST_CHECK(attr->type == CFL_VARIANT_DOUBLE && attr->valid[8] && !attr->valid[9]);
+    TEST_CHECK(attr->f64[8] == 2.0);
+
+    attr = ctr_columns_attr_get(cols, "http.method");
+    TEST_ASSERT(attr != NULL);
+    TEST_CHECK(strcmp(ctr_columns_string(cols, attr->str[4]), "POST") == 0);
+
+    /* arrays are not columnar */
+    TEST_CHECK(ctr_columns_attr_get(cols, "tags") == NULL);
+    TEST_ASSERT(cols->attr_other[0] != NULL);
+    value = cfl_kvlist_fetch(cols->attr_other[0]->kv, "tags");
+    TEST_CHECK(value != NULL && value->type == CFL_VARIANT_ARRAY);
+
+    /* events and links per span */
+    TEST_CHECK(cols->events.offset[3] == 1 && cols->events.offset[4] == 2);
+    TEST_CHECK(cols->events.time[1] == 1500003);
+    TEST_CHECK(cols->links.offset[7] == 1 && cols->links.offset[8] == 2);
+    TEST_CHECK(memcmp(cols->links.span_id[1], "SPAN_801", 8) == 0);
+
+    /* back to a context: identical content */
+    copy = ctr_columns_to_ctrace(cols, NULL);
+    TEST_ASSERT(copy != NULL);
+    text = ctr_encode_text_create(ctx);
+    text_copy = ctr_encode_text_create(copy);
+    TEST_CHECK(strcmp(text, text_copy) == 0);
+    ctr_encode_text_destroy(text);
+    ctr_encode_text_destroy(text_copy);
+    ctr_destroy(copy);
+
+    /* a filtered batch only keeps the selected spans and their scopes */
+    for (i = 0; i < 20; i++) {
+        selection[i] = cols->status_code[i] == CTRACE_SPAN_STATUS_CODE_ERROR && i >= 10;
+    }
+    copy = ctr_columns_to_ctrace(cols, selection);
+    TEST_ASSERT(copy != NULL);
+    TEST_CHECK(cfl_list_size(&copy->span_list) == 2);
+    resource_span = cfl_list_entry_first(&copy->resource_spans, struct ctrace_resource_span, _head);
+    TEST_CHECK(cfl_list_size(&copy->resource_spans) == 1);
+    TEST_CHECK(cfl_list_size(&resource_span->scope_spans) == 1);
+    ctr_destroy(copy);
+
+    ctr_columns_destroy(cols);
+
+    /* IDs must have the OpenTelemetry sizes */
+    span = ctr_span_create(ctx, scope_span, "odd", NULL);
+    ctr_span_set_span_id(span, "ID", 2);
+    TEST_CHECK(ctr_columns_create(ctx) == NULL);
+
+    ctr_destroy(ctx);
+}
+
+void test_span_intern()
+{
+    int i;
+    int ret;
+    char name[32];
+    struct ctrace *ctx;
+    struct ctrace *dst;
+    struct ctrace_opts opts;
+    struct ctrace_span *span;
+    struct ctrace_span *other;
+    struct ctrace_span_event *event;
+    struct ctrace_span_event *other_event;
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_scope_span *scope_span;
+
+    ctr_opts_init(&opts);
+    ctr_opts_set(&opts, CTR_OPTS_INTERN, "on");
+
+    ctx = ctr_create(&opts);
+    TEST_ASSERT(ctx != NULL);
+    TEST_CHECK(ctx->intern != NULL);
+
+    resource_span = ctr_resource_span_create(ctx);
+    scope_span = ctr_scope_span_create(resource_span);
+
+    /* spans and events with the same name share one copy */
+    span = ctr_span_create(ctx, scope_span, "GET /users", NULL);
+    other = ctr_span_create(ctx, scope_span, "GET /users", NULL);
+    TEST_ASSERT(span != NULL && other != NULL);
+    TEST_CHECK(span->name_interned && other->name_interned);
+    TEST_CHECK(span->name == other->name);
+
+    event = ctr_span_event_add(span, "retry");
+    other_event = ctr_span_event_add(other, "retry");
+    TEST_ASSERT(event != NULL && other_event != NULL);
+    TEST_CHECK(event->name == other_event->name);
+
+    /* renaming one span does not affect the other */
+    ret = ctr_span_set_name(other, "GET /orders", 11);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(strcmp(other->name, "GET /orders") == 0);
+    TEST_CHECK(strcmp(span->name, "GET /users") == 0);
+
+    ret = ctr_span_event_set_name(other_event, "timeout", 7);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(strcmp(other_event->name, "timeout") == 0);
+    TEST_CHECK(strcmp(event->name, "retry") == 0);
+
+    ctr_span_event_delete(other_event);
+    ctr_span_destroy(other);
+    TEST_CHECK(strcmp(span->name, "GET /users") == 0);
+
+    /* a full table falls back to private copies */
+    for (i = ctx->intern->count; i < CTR_INTERN_MAX_STRINGS; i++) {
+        snprintf(name, sizeof(name) - 1, "name-%i", i);
+        TEST_ASSERT(ctr_intern_get(ctx->intern, name, strlen(name)) != NULL);
+    }
+    other = ctr_span_create(ctx, scope_span, "not interned", NULL);
+    TEST_ASSERT(other != NULL);
+    TEST_CHECK(!other->name_interned);
+    TEST_CHECK(strcmp(other->name, "not interned") == 0);
+
+    /* existing names are still shared */
+    other = ctr_span_create(ctx, scope_span, "GET /users", NULL);
+    TEST_ASSERT(other != NULL);
+    TEST_CHECK(other->name == span->name);
+
+    /* merged names survive the source context */
+    dst = ctr_create(NULL);
+    TEST_ASSERT(dst != NULL);
+    ret = ctr_merge(dst, ctx);
+    TEST_CHECK(ret == 0);
+    ctr_destroy(ctx);
+
+    TEST_CHECK(cfl_list_size(&dst->span_list) == 3);
+    TEST_CHECK(!span->name_interned);
+    TEST_CHECK(strcmp(span->name, "GET /users") == 0);
+    event = cfl_list_entry_first(&span->events, struct ctrace_span_event, _head);
+    TEST_CHECK(strcmp(event->name, "retry") == 0);
+
+    ctr_destroy(dst);
+    ctr_opts_exit(&opts);
+}
+
+static int text_chunk_cb(void *data, const char *buf, size_t len)
+{
+    cfl_sds_t *out = data;
+
+    TEST_CHECK(len > 0);
+
+    return cfl_sds_cat_safe(out, buf, len);
+}
+
+void test_span_text_writer()
+{
+    int i;
+    int ret;
+    char value[3000];
+    cfl_sds_t text;
+    cfl_sds_t streamed;
+    struct ctrace *ctx;
+    struct ctrace_span *span;
+    struct ctrace_resource_span *resource_span;
+    struct ctrace_scope_span *scope_span;
+    struct ctr_writer *writer;
+
+    ctx = ctr_create(NULL);
+    TEST_ASSERT(ctx != NULL);
+
+    resource_span = ctr_resource_span_create(ctx);
+    scope_span = ctr_scope_span_create(resource_span);
+
+    /* values longer than a line used to be cut */
+    memset(value, 'x', sizeof(value) - 1);
+    value[sizeof(value) - 1] = '\0';
+
+    for (i = 0; i < 50; i++) {
+        span = ctr_span_create(ctx, scope_span, "span", NULL);
+        TEST_ASSERT(span != NULL);
+        ctr_span_start_ts(ctx, span, 1000 + i);
+        ctr_span_end_ts(ctx, span, 2000 + i);
+        ctr_span_set_attribute_int64(span, "index", -i);
+        ctr_span_set_attribute_string(span, "value", value);
+    }
+
+    text = ctr_encode_text_create(ctx);
+    TEST_ASSERT(text != NULL);
+    TEST_CHECK(strstr(text, value) != NULL);
+    TEST_CHECK(strstr(text, "- index: -49\n") != NULL);
+    TEST_CHECK(strstr(text, "- start_time              : 1049\n") != NULL);
+
+    /* streaming through a callback produces the same bytes */
+    streamed = cfl_sds_create_size(64);
+    TEST_ASSERT(streamed != NULL);
+
+    writer = ctr_writer_callback_create(text_chunk_cb, &streamed);
+    TEST_ASSERT(writer != NULL);
+
+    ret = ctr_encode_text_write(ctx, writer);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(writer->size == CTR_WRITER_CHUNK_SIZE);
+    ctr_writer_destroy(writer);
+
+    TEST_CHECK(cfl_sds_len(streamed) == cfl_sds_len(text));
+    TEST_CHECK(memcmp(streamed, text, cfl_sds_len(text)) == 0);
+
+    cfl_sds_destroy(streamed);
+    ctr_encode_text_destroy(text);
+    ctr_destroy(ctx);
+}
+
 TEST_LIST = {
     {"span", test_span},
+    {"span_arena", test_span_arena},
+    {"span_generate_ids", test_span_generate_ids},
+    {"span_stage", test_span_stage},
+    {"span_propagation", test_span_propagation},
+    {"span_merge", test_span_merge},
+    {"span_index", test_span_index},
+    {"span_tail_sampler", test_span_tail_sampler},
+    {"span_head_sampler", test_span_head_sampler},
+    {"span_noop_setters", test_span_noop_setters},
+    {"span_columns", test_span_columns},
+    {"span_intern", test_span_intern},
+    {"span_text_writer", test_span_text_writer},
     { 0 }
 };